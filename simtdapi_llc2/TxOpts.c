@@ -25,6 +25,7 @@
 
 #include "mkxtest.h"
 #include "TxOpts.h"
+#include "llc-api-ext.h"
 
 // identifier this module for debugging
 #define D_SUBMODULE TXAPP_Module
@@ -251,6 +252,11 @@ void TxOpts_PrintUsage ()
     { 'e', "EtherType",      "Ethernet Type", "uint16" },
     { 'd', "DstAddr",        "Destination MAC Address", "aa:bb:cc:dd:ee:ff" },
     { 'u', "UDPforwardPort", "UDP forwarding port", "12345" },
+    { 'R', "RxThread",       "Receive from the MKx on a dedicated thread", "" },
+    { 'Q', "TxQueues",       "Prioritise frames in LLC software queues",
+      "off | strict | weighted" },
+    { 'K', "Check",          "Check of the frames sent to other vehicles",
+      "xor | crc32c | auto" },
     { 0, 0, 0, 0 }
   };
 
@@ -323,6 +329,9 @@ void TxOpts_Print (tTxOpts * pTxOpts)
   printf("Packet Log File:   %s\n", pTxOpts->pPacketLogFileName);
   printf("DumpPayload:       %d\n", pTxOpts->DumpPayload);
   printf("DumpToStdout:      %d\n", pTxOpts->DumpToStdout);
+  printf("RxThread:          %d\n", pTxOpts->RxThread);
+  printf("TxQueues:          %d\n", pTxOpts->TxQueues);
+  printf("Check:             %d\n", pTxOpts->Check);
 
   printf("Interface:         %s\n", pTxOpts->pInterfaceName);
 
@@ -404,6 +413,9 @@ int TxOpts_New (int argc, char **argv, tTxOpts *pTxOpts)
     { "EtherType",      required_argument, 0, 'e' },
     { "DstAddr",        required_argument, 0, 'd' },
     { "UDPforwardPort", required_argument, 0, 'u' },
+    { "RxThread",       no_argument,       0, 'R' }, // LLC receive thread
+    { "TxQueues",       required_argument, 0, 'Q' }, // LLC software queues
+    { "Check",          required_argument, 0, 'K' }, // Frame check
     { 0, 0, 0, 0 }
   };
 #endif
@@ -431,6 +443,9 @@ int TxOpts_New (int argc, char **argv, tTxOpts *pTxOpts)
   pTxOpts->PayloadMode = PAYLOADMODE_BYTE;
   // disable UDP forward by default
   pTxOpts->UDPforwardPort = 0;
+  pTxOpts->RxThread = false; // true if option present
+  pTxOpts->TxQueues = LLC_TXQ_SCHED_OFF;
+  pTxOpts->Check = TXOPTS_CHECK_XOR;
 
   // CCH Tx Descriptor Lists
   pTxOpts->TxCHOpts.ChannelNumber = 178;//TEST_DEFAULT_CHANNELNUMBER;
@@ -457,7 +472,7 @@ int TxOpts_New (int argc, char **argv, tTxOpts *pTxOpts)
   pTxOpts->TxCHOpts.UDPforwardSocket = -1;
 
 #if defined(__QNX__)
-  strcpy(short_options, "s:n:r:f:hyog:i:tz:c:l:m:w:p:x:q:v:a:e:d:");
+  strcpy(short_options, "s:n:r:f:hyog:i:tz:c:l:m:w:p:x:q:v:a:e:d:RQ:K:");
 #else
   // Build the short options from the Long
   copyopts(long_options, (char *) (&short_options));
@@ -736,6 +751,32 @@ int TxOpts_New (int argc, char **argv, tTxOpts *pTxOpts)
         pTxOpts->UDPforwardPort = strtoul(optarg, NULL, 0);
       } break;
 
+      case 'R': // LLC receive thread? Yes if present
+        pTxOpts->RxThread = true;
+        break;
+
+      case 'Q': // LLC software transmit queues
+        if (strcmp(optarg, "off") == 0)
+          pTxOpts->TxQueues = LLC_TXQ_SCHED_OFF;
+        else if (strcmp(optarg, "strict") == 0)
+          pTxOpts->TxQueues = LLC_TXQ_SCHED_STRICT;
+        else if (strcmp(optarg, "weighted") == 0)
+          pTxOpts->TxQueues = LLC_TXQ_SCHED_WEIGHTED;
+        else
+          ErrCode = TXOPTS_ERR_INVALIDOPTIONARG;
+        break;
+
+      case 'K': // Frame check
+        if (strcmp(optarg, "xor") == 0)
+          pTxOpts->Check = TXOPTS_CHECK_XOR;
+        else if (strcmp(optarg, "crc32c") == 0)
+          pTxOpts->Check = TXOPTS_CHECK_CRC32C;
+        else if (strcmp(optarg, "auto") == 0)
+          pTxOpts->Check = TXOPTS_CHECK_AUTO;
+        else
+          ErrCode = TXOPTS_ERR_INVALIDOPTIONARG;
+        break;
+
       default:
         ErrCode = TXOPTS_ERR_INVALIDOPTION;
         break;
@@ -49,6 +49,17 @@ typedef enum TxMode_tag
 } eTxMode;
 typedef int tTxMode;
 
+/// Check of the frames exchanged with other vehicles
+typedef enum TxCheck_tag
+{
+  /// XOR check byte (understood by all nodes)
+  TXOPTS_CHECK_XOR = 0,
+  /// CRC32C (only understood by nodes that support it)
+  TXOPTS_CHECK_CRC32C = 1,
+  /// CRC32C, unless a node that only knows the XOR check was heard recently
+  TXOPTS_CHECK_AUTO = 2
+} eTxCheck;
+
 /// Specify an integer list
 typedef struct RangeSpec_tag
 {
@@ -140,6 +151,15 @@ typedef struct TxOpts_tag
   /// UDP port to listen on and forward packets from
   int32_t UDPforwardPort;
 
+  /// Receive from the MKx on the LLC library's own thread?
+  bool RxThread;
+
+  /// LLC library software transmit queues (LLC_TXQ_SCHED_...)
+  uint8_t TxQueues;
+
+  /// Check of the frames sent to other vehicles (TXOPTS_CHECK_...)
+  uint8_t Check;
+
 } tTxOpts;
 
 void TxOpts_PrintUsage ();
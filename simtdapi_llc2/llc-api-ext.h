@@ -0,0 +1,603 @@
+/**
+ * @addtogroup cohda_llc_intern_lib LLC API library
+ * @{
+ *
+ * @file
+ * LLC: Extensions to the MKx API provided by this library
+ *
+ * These are not part of the MKx API (linux/cohda/llc/llc-api.h) and are only
+ * available when linked against this LLC library implementation.
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2013 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+#ifndef __COHDA__APP__LLC__LIB__LLC_API_EXT_H__
+#define __COHDA__APP__LLC__LIB__LLC_API_EXT_H__
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "linux/cohda/llc/llc-api.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// TxCnf() status (and Hdr.Ret) when no TxCnf arrived within the timeout
+/// set by MKx_TxCnfTimeout()
+#define LLC_TXSTATUS_TIMEOUT (-ETIMEDOUT)
+
+/// TxCnf() status (and Hdr.Ret) of a TxReq purged by TxFlush()
+#define LLC_TXSTATUS_FLUSHED (-ECANCELED)
+
+/// TxFlush() queue argument to purge every queue of the radio/channel
+#define LLC_TXQ_ALL (MKX_TXQ_COUNT)
+
+/// Message types counted by MKx_GetLibStats() (indexed by the MKXIF type)
+#define LLC_STATS_TYPE_CNT (16)
+
+/// Buckets in the MKx_GetLibStats() handler duration histograms
+#define LLC_STATS_HIST_BINS (20)
+
+/// Channel load samples kept per radio and channel (see MKx_GetChannelLoad())
+#define LLC_CBR_SAMPLE_CNT (64)
+
+/// Software transmit queue scheduling (see MKx_TxQueueConfig())
+#define LLC_TXQ_SCHED_OFF      (0)
+#define LLC_TXQ_SCHED_STRICT   (1)
+#define LLC_TXQ_SCHED_WEIGHTED (2)
+
+/// What a radio config request changes (see MKx_ConfigAsync())
+#define LLC_CFG_CHANGED_MODE       (0x001)
+/// ... ChannelFreq or Bandwidth of a channel (i.e. a retune)
+#define LLC_CFG_CHANGED_FREQ(Chan) (0x002 << (4 * (Chan)))
+/// ... antennas, DefaultMCS or DefaultTxPower of a channel
+#define LLC_CFG_CHANGED_PHY(Chan)  (0x004 << (4 * (Chan)))
+/// ... MAC config (EDCA, address matching etc.) of a channel
+#define LLC_CFG_CHANGED_MAC(Chan)  (0x008 << (4 * (Chan)))
+/// ... interval/guard durations of a channel
+#define LLC_CFG_CHANGED_LLC(Chan)  (0x010 << (4 * (Chan)))
+/// ... everything (nothing confirmed by the MKx yet to compare with)
+#define LLC_CFG_CHANGED_ALL        (0x1FF)
+
+/// Most C2X security commands outstanding at once (see MKx_C2XSecConfig())
+#define LLC_SEC_WINDOW_MAX (64)
+/// Default C2X security command window
+#define LLC_SEC_WINDOW_DEFAULT (16)
+/// Default C2X security command timeout [ms]
+#define LLC_SEC_TIMEOUT_DEFAULT (100)
+/// USNs from here up are only used by MKx_C2XSecSubmit() commands
+#define LLC_SEC_USN_FIRST (0x8000)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+/// Statistics for one type of message from the MKx
+typedef struct LLCMsgTypeStats
+{
+  /// Number of messages handled
+  uint64_t Cnt;
+  /// Total length of those messages [bytes]
+  uint64_t Bytes;
+  /// Total time spent handling them, including the callbacks [ns]
+  uint64_t Time;
+  /// Handling time histogram: Hist[0] counts those under 1us, Hist[i] those
+  /// of [2^(i-1), 2^i) us and the last bucket everything longer
+  uint32_t Hist[LLC_STATS_HIST_BINS];
+} tLLCMsgTypeStats;
+
+/// LLC library statistics (see MKx_GetLibStats())
+typedef struct LLCLibStats
+{
+  /// Per message type (e.g. Type[MKXIF_RXPACKET])
+  tLLCMsgTypeStats Type[LLC_STATS_TYPE_CNT];
+  /// Messages of an unknown type (not counted in Type[])
+  uint64_t Unknown;
+  /// Messages shorter than their header, or than the length in it
+  uint64_t Truncated;
+  /// Driver echoes of our own messages (ignored)
+  uint64_t Echoes;
+  /// Received packets dropped by the receive thread (see MKx_RxThread())
+  uint64_t RxDropped;
+} tLLCLibStats;
+
+/// Channel load over one MKx stats interval (see MKx_GetChannelLoad())
+typedef struct LLCChannelSample
+{
+  /// When the stats message was received (CLOCK_MONOTONIC) [us]
+  uint64_t Time;
+  /// TSF at the end of the interval (from the stats message)
+  tMKxTSF TSF;
+  /// Length of the interval (zero for the first sample) [us]
+  uint32_t Period;
+  /// Channel busy ratio reported by the MKx [0.1%]
+  uint16_t CBR;
+  /// Estimated fraction of the interval spent transmitting [0.1%]
+  uint16_t TxDuty;
+  /// Estimated fraction of the interval spent receiving (CBR - TxDuty) [0.1%]
+  uint16_t RxDuty;
+  /// Average idle power reported by the MKx [dBm]
+  int8_t IdlePower;
+} tLLCChannelSample;
+
+/// Software transmit queue configuration (see MKx_TxQueueConfig())
+typedef struct LLCTxQConfig
+{
+  /// LLC_TXQ_SCHED_OFF, LLC_TXQ_SCHED_STRICT or LLC_TXQ_SCHED_WEIGHTED
+  uint8_t Sched;
+  /// Frames passed to the MKx per radio/channel before holding the rest
+  uint16_t InFlightMax;
+  /// Most frames held in each queue
+  uint16_t Depth;
+  /// Share of the dequeues for each queue (LLC_TXQ_SCHED_WEIGHTED only),
+  /// indexed by tMKxTxQueue
+  uint8_t Weight[MKX_TXQ_COUNT];
+} tLLCTxQConfig;
+
+/// Software transmit queue counters (see MKx_TxQueueStats())
+typedef struct LLCTxQStats
+{
+  /// Frames held now
+  uint32_t Depth;
+  /// Most frames ever held at once
+  uint32_t DepthMax;
+  /// Frames passed on to the MKx
+  uint64_t Sent;
+  /// Frames rejected because the queue was full
+  uint64_t Full;
+  /// Frames dropped because their Expiry passed while held
+  uint64_t Expired;
+  /// Frames purged by TxFlush() while held
+  uint64_t Flushed;
+} tLLCTxQStats;
+
+/**
+ * @brief Radio config request completion (see MKx_ConfigAsync())
+ * @param pMKx MKx handle
+ * @param Radio The radio that was configured
+ * @param Changed LLC_CFG_CHANGED_* bits of what the request changed
+ * @param Result Zero if the MKx confirmed it, otherwise the MKx's Ret value,
+ *        -ETIMEDOUT if it never replied or -ECANCELED if a newer request
+ *        replaced it before it was sent
+ * @param pPriv As passed to MKx_ConfigAsync()
+ */
+typedef void (*fLLC_ConfigDone) (struct MKx *pMKx,
+                                 tMKxRadio Radio,
+                                 uint32_t Changed,
+                                 tMKxStatus Result,
+                                 void *pPriv);
+
+/// Radio config request counters (see MKx_ConfigStats())
+typedef struct LLCConfigStats
+{
+  /// Config requests made (with Config() or MKx_ConfigAsync())
+  uint32_t Requests;
+  /// Requests sent to the MKx
+  uint32_t Sent;
+  /// Requests that changed nothing (not sent)
+  uint32_t Unchanged;
+  /// Requests replaced by a newer one while waiting to be sent
+  uint32_t Superseded;
+  /// Requests confirmed by the MKx
+  uint32_t Confirmed;
+  /// Requests rejected by the MKx or not replied to
+  uint32_t Failed;
+  /// LLC_CFG_CHANGED_* bits of the last request sent
+  uint32_t Changed;
+  /// A request is waiting for the MKx's reply
+  bool Pending;
+} tLLCConfigStats;
+
+/**
+ * @brief C2X security command completion (see MKx_C2XSecSubmit())
+ * @param pMKx MKx handle
+ * @param USN The command's sequence number (as returned by MKx_C2XSecSubmit())
+ * @param pRsp The response (only valid during the call), or NULL if none
+ *        arrived within the timeout
+ * @param Result The response's Hdr.Ret, or -ETIMEDOUT
+ * @param pPriv As passed to MKx_C2XSecSubmit()
+ */
+typedef void (*fLLC_C2XSecDone) (struct MKx *pMKx,
+                                 uint16_t USN,
+                                 tMKxC2XSec *pRsp,
+                                 tMKxStatus Result,
+                                 void *pPriv);
+
+/// C2X security command pipeline configuration (see MKx_C2XSecConfig())
+typedef struct LLCC2XSecConfig
+{
+  /// Most commands outstanding at once (1 to LLC_SEC_WINDOW_MAX)
+  uint16_t Window;
+  /// Complete a command with -ETIMEDOUT after this long [ms]
+  uint32_t Timeout;
+} tLLCC2XSecConfig;
+
+/// C2X security command pipeline counters (see MKx_C2XSecStats())
+typedef struct LLCC2XSecStats
+{
+  /// Commands sent
+  uint64_t Sent;
+  /// Commands completed by their response
+  uint64_t Completed;
+  /// Commands completed by the timeout
+  uint64_t TimedOut;
+  /// Commands refused because the window was full
+  uint64_t Full;
+  /// Responses with a pipelined USN that matched no outstanding command,
+  /// e.g. one that had timed out (passed to C2XSecRsp())
+  uint64_t Unmatched;
+  /// Commands outstanding now
+  uint32_t InFlight;
+  /// Most commands ever outstanding at once
+  uint32_t InFlightMax;
+  /// Total and largest command to response latency [us]
+  uint64_t Latency;
+  uint32_t LatencyMax;
+  /// Latency histogram: Hist[0] counts those under 1us, Hist[i] those of
+  /// [2^(i-1), 2^i) us and the last bucket everything longer
+  uint32_t Hist[LLC_STATS_HIST_BINS];
+} tLLCC2XSecStats;
+
+/// Smoothed channel load of a radio and channel (see MKx_GetChannelLoad())
+typedef struct LLCChannelLoad
+{
+  /// Number of samples taken (since MKx_Init())
+  uint32_t Cnt;
+  /// Smoothed channel busy ratio [0.1%]
+  uint16_t CBR;
+  /// Smoothed transmit duty cycle [0.1%]
+  uint16_t TxDuty;
+  /// Smoothed receive duty cycle [0.1%]
+  uint16_t RxDuty;
+  /// The latest sample
+  tLLCChannelSample Last;
+} tLLCChannelLoad;
+
+//------------------------------------------------------------------------------
+// Function declarations
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Initialise the LLC for a particular MKx network interface
+ * @param pIfName Interface name (NULL for the default, as used by MKx_Init())
+ * @param ppMKx Set to the MKx handle for the interface
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *
+ * Each interface gets its own MKx handle (and state), so one process can
+ * drive several radios with a MKx_Recv() loop per handle. Calling it again
+ * for an interface returns the existing handle. Release with MKx_Exit(),
+ * which must not be called while MKx_Recv() is running on the same handle.
+ * MKx_Exit() frees the handle's state, so the handle (and any copy of it)
+ * must not be used after it.
+ * The default interface is taken from the LLC_IFNAME environment variable
+ * when it is set (e.g. to run against the llc-standin program). LLC_TRANSPORT
+ * selects how the interface is accessed: "ring" (TPACKET_V3 receive ring),
+ * "raw" (recvmmsg()/sendmmsg()), "pcap" (libpcap) or "shm" (shared memory to
+ * 'llc-standin -m'). By default the ring is used, falling back to libpcap.
+ */
+tMKxStatus MKx_InitIf (const char *pIfName,
+                       struct MKx **ppMKx);
+
+/**
+ * @brief Handle received messages, within a budget
+ * @param pMKx MKx handle
+ * @param MaxMsgs Most messages to handle (0 for no limit)
+ * @param MaxUs Longest time to spend handling them [us] (0 for no limit)
+ * @return 1 if the budget ran out (more may be pending), zero if there is
+ *         nothing left to receive, or a negative errno
+ *
+ * A bounded alternative to MKx_Recv() for event loops that also service other
+ * file descriptors: call it when MKx_Fd() is readable and, while it returns
+ * 1, again soon (e.g. after a zero timeout poll()) rather than waiting for
+ * MKx_Fd(). The interface is switched to non-blocking mode on the first call,
+ * so neither this nor MKx_Recv() then waits for the pcap read timeout once
+ * the socket is empty. The time budget is checked between messages, so one
+ * slow callback can still overrun it.
+ */
+tMKxStatus MKx_RecvBudget (struct MKx *pMKx,
+                           unsigned int MaxMsgs,
+                           unsigned int MaxUs);
+
+/**
+ * @brief Request the transmission of several packets at once
+ * @param pMKx MKx handle
+ * @param ppTxPkts Array of Cnt packets (as would be passed to TxReq())
+ * @param ppPriv Array of Cnt pPriv's for the TxCnf() callbacks (or NULL)
+ * @param Cnt Number of packets
+ * @param pResults Array of Cnt per-packet results (as TxReq() would return)
+ * @return The number of packets accepted, or a negative errno
+ *
+ * Equivalent to calling TxReq() for each packet in turn, except that
+ * sequence numbers are assigned to the whole batch in one pass and the
+ * transport sends them with as few system calls as possible. A TxCnf() is
+ * only generated for packets whose result is zero. With the software queues
+ * enabled those packets must stay valid until their TxCnf() (see
+ * MKx_TxQueueConfig()).
+ */
+tMKxStatus MKx_TxReqBatch (struct MKx *pMKx,
+                           tMKxTxPacket **ppTxPkts,
+                           void **ppPriv,
+                           int Cnt,
+                           tMKxStatus *pResults);
+
+/**
+ * @brief Set how long to wait for a TxCnf before giving up on a TxReq
+ * @param pMKx MKx handle
+ * @param Timeout_ms Timeout [ms] (0 to wait forever)
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *
+ * A TxReq with no TxCnf after this long has its sequence number reclaimed and
+ * TxCnf() is called for it with a status of LLC_TXSTATUS_TIMEOUT. A real
+ * TxCnf arriving after that is ignored.
+ */
+tMKxStatus MKx_TxCnfTimeout (struct MKx *pMKx,
+                             unsigned int Timeout_ms);
+
+/**
+ * @brief Set how long TxReq() may wait for a free sequence number
+ * @param pMKx MKx handle
+ * @param Deadline_ms Longest wait [ms] (0 to fail immediately with -ENOMEM)
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *
+ * While waiting, TxReq() processes incoming messages (as MKx_Recv() would)
+ * so that TxCnf's can free up sequence numbers, then fails with -ETIMEDOUT
+ * at the deadline. TxReq() never waits when called from within a callback.
+ */
+tMKxStatus MKx_TxBlock (struct MKx *pMKx,
+                        unsigned int Deadline_ms);
+
+/**
+ * @brief Configure (or disable) the software transmit queues
+ * @param pMKx MKx handle
+ * @param pConfig The queue configuration
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *
+ * By default TxReq() passes every frame straight to the MKx, so frames of
+ * all priorities compete first come first served for its queues. With the
+ * software queues enabled no more than InFlightMax frames per radio/channel
+ * are passed to the MKx at a time. The rest are held in one queue per
+ * access category (from the QoS TID, i.e. the tMK2Priority, or
+ * MKX_TXQ_NON_QOS) and released as TxCnf's arrive, either strictly by
+ * priority (VO, VI, BE, non-QoS, BK) or in proportion to their Weight.
+ * A held frame whose Expiry (TSF) has passed is dropped before it is sent
+ * and TxCnf() is called for it with MKXSTATUS_TX_FAIL_TTL. TxReq() fails with
+ * MKXSTATUS_TX_FAIL_QUEUEFULL when the frame's queue already holds Depth
+ * frames. Disabling the queues sends any held frames at once.
+ * A held frame is sent later from the caller's buffer, so while the queues
+ * are enabled a packet passed to TxReq() (or MKx_TxReqBatch()) must stay
+ * valid until its TxCnf() (with the queues disabled it may be released as
+ * soon as TxReq() returns).
+ */
+tMKxStatus MKx_TxQueueConfig (struct MKx *pMKx,
+                              const tLLCTxQConfig *pConfig);
+
+/**
+ * @brief Get the software transmit queue counters of a radio and channel
+ * @param pMKx MKx handle
+ * @param Radio MKX_RADIO_A or MKX_RADIO_B
+ * @param Chan MKX_CHANNEL_0 or MKX_CHANNEL_1
+ * @param pStats Array of MKX_TXQ_COUNT, indexed by tMKxTxQueue
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ */
+tMKxStatus MKx_TxQueueStats (struct MKx *pMKx,
+                             tMKxRadio Radio,
+                             tMKxChannel Chan,
+                             tLLCTxQStats *pStats);
+
+/**
+ * @brief Request a new radio config, with a callback once the MKx has it
+ * @param pMKx MKx handle
+ * @param Radio MKX_RADIO_A or MKX_RADIO_B
+ * @param pConfig The complete new config of the radio
+ * @param Done Called when the request completes (may be NULL)
+ * @param pPriv Passed to Done
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno (Done isn't called)
+ *
+ * The request is compared with the config the MKx last confirmed (or the
+ * one already on its way to it), and is not sent at all if nothing changed:
+ * Done is then called straight away with Changed set to zero. Only one
+ * request per radio is outstanding at a time. A request made while one is
+ * waiting for the MKx's reply is held, and sent when that reply arrives,
+ * and a newer request replaces a held one (whose Done gets -ECANCELED).
+ * Done is otherwise called from MKx_Recv() when the MKXIF_RADIOxCFG reply is
+ * handled, just before the NotifInd() for it. If no reply arrives within a
+ * second, MKx_Recv() completes the request with -ETIMEDOUT and sends the held
+ * one. Config() takes the same path (without a callback).
+ */
+tMKxStatus MKx_ConfigAsync (struct MKx *pMKx,
+                            tMKxRadio Radio,
+                            const tMKxRadioConfigData *pConfig,
+                            fLLC_ConfigDone Done,
+                            void *pPriv);
+
+/**
+ * @brief Get the config request counters of a radio
+ * @param pMKx MKx handle
+ * @param Radio MKX_RADIO_A or MKX_RADIO_B
+ * @param pStats Set to the counters
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ */
+tMKxStatus MKx_ConfigStats (struct MKx *pMKx,
+                            tMKxRadio Radio,
+                            tLLCConfigStats *pStats);
+
+/**
+ * @brief Set the window and timeout of the C2X security command pipeline
+ * @param pMKx MKx handle
+ * @param pConfig The configuration
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *
+ * Applies to commands submitted from then on. The defaults are
+ * LLC_SEC_WINDOW_DEFAULT and LLC_SEC_TIMEOUT_DEFAULT.
+ */
+tMKxStatus MKx_C2XSecConfig (struct MKx *pMKx,
+                             const tLLCC2XSecConfig *pConfig);
+
+/**
+ * @brief Send a C2X security command without waiting for its response
+ * @param pMKx MKx handle
+ * @param pMsg The command (Hdr.Len and the APDU set, the USN is filled in)
+ * @param Done Called with the response, or on the timeout (may be NULL)
+ * @param pPriv Passed to Done
+ * @return The command's USN (LLC_SEC_USN_FIRST to 65535), or a negative errno
+ *         (-EBUSY if the window is full)
+ *
+ * C2XSecCmd() leaves it to the caller to tell the responses apart. Here each
+ * command is given its own USN (big endian, in the APDU) which the security
+ * hardware returns in the response, so up to the window's worth of commands
+ * can be outstanding and their responses are matched in any order. Done is
+ * called from MKx_Recv(). The USNs from LLC_SEC_USN_FIRST up are kept for
+ * these commands, so commands sent with C2XSecCmd() must use USNs below it.
+ * Their responses, and any that match no outstanding command, still go to
+ * C2XSecRsp().
+ */
+int MKx_C2XSecSubmit (struct MKx *pMKx,
+                      tMKxC2XSec *pMsg,
+                      fLLC_C2XSecDone Done,
+                      void *pPriv);
+
+/**
+ * @brief Get the C2X security command pipeline counters
+ * @param pMKx MKx handle
+ * @param pStats Set to the counters
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ */
+tMKxStatus MKx_C2XSecStats (struct MKx *pMKx,
+                            tLLCC2XSecStats *pStats);
+
+/**
+ * @brief Get the number of TxReq's still waiting for their TxCnf
+ * @param pMKx MKx handle
+ * @return The number of TxReq's in flight, or a negative errno
+ */
+int MKx_TxInFlight (struct MKx *pMKx);
+
+/**
+ * @brief Get the current TSF estimate and its error bound
+ * @param pMKx MKx handle
+ * @param pTSF Set to the estimated TSF (as GetTSF() would return)
+ * @param pErr Set to the error bound of the estimate [us]
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *         (-EAGAIN if no TSF has been received from the MKx yet)
+ *
+ * GetTSF() does not query the MKx: it extrapolates (with CLOCK_MONOTONIC and
+ * a measured drift) from the TSFs in received RxPacket, TxEvent and stats
+ * messages. The error bound grows with the time since the last of those.
+ */
+tMKxStatus MKx_GetTSFError (struct MKx *pMKx,
+                            tMKxTSF *pTSF,
+                            uint32_t *pErr);
+
+/**
+ * @brief Enable (or disable) zero-copy delivery of received packets
+ * @param pMKx MKx handle
+ * @param Enable true to pass received packets to RxInd() in place
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *         (-EOPNOTSUPP if the transport cannot deliver in place)
+ *
+ * When enabled the RxAlloc() callback is no longer called. Instead the
+ * tMKxRxPacket passed to RxInd() points directly into the receive ring and
+ * the pPriv is a reference on the ring slot holding it. The slot is returned
+ * to the transport once every reference has been dropped with
+ * MKx_RxRelease(), so RxInd() must call MKx_RxRelease() (instead of
+ * PktBuf_Free()) exactly once for every packet it is given, and must not
+ * modify the packet.
+ */
+tMKxStatus MKx_RxZeroCopy (struct MKx *pMKx,
+                           bool Enable);
+
+/**
+ * @brief Drop a reference on a received packet delivered in place
+ * @param pMKx MKx handle
+ * @param pPriv The pPriv that was passed to the RxInd() callback
+ *
+ * May be called from any thread, and after RxInd() has returned.
+ */
+void MKx_RxRelease (struct MKx *pMKx,
+                    void *pPriv);
+
+/**
+ * @brief Receive messages from the MKx on a dedicated thread
+ * @param pMKx MKx handle
+ * @param Enable true to start the receive thread, false to stop it
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *         (-EOPNOTSUPP if threads are not supported on this platform)
+ *
+ * The thread drains the interface as soon as messages arrive and queues
+ * them (TxEvent's, RxPacket's and the rest separately) for MKx_Recv(), so a
+ * slow callback no longer holds up the interface. The callbacks are still
+ * called from MKx_Recv() on the application's thread, but MKx_Fd() returns
+ * an eventfd (which is readable while messages are queued) instead of the
+ * interface's file descriptor, so fetch it again after enabling the thread.
+ * RxPacket's that arrive while their queue is full are dropped, the other
+ * messages wait for space.
+ *
+ * Must not be called from within a callback. MKx_RxZeroCopy() must be set
+ * before starting the thread. Messages still queued when the thread is
+ * stopped are delivered before this returns.
+ */
+tMKxStatus MKx_RxThread (struct MKx *pMKx,
+                         bool Enable);
+
+/**
+ * @brief Get a snapshot of the library's message statistics
+ * @param pMKx MKx handle
+ * @param pStats Set to the statistics (cumulative since MKx_Init())
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *
+ * Every message from the MKx is counted, by type, with its length and how
+ * long it took to handle (i.e. mostly the time spent in the callbacks).
+ * The counters are always on and are updated without locking, so a snapshot
+ * taken while MKx_Recv() runs on another thread can be a message out between
+ * fields. Compare two snapshots for rates.
+ */
+tMKxStatus MKx_GetLibStats (struct MKx *pMKx,
+                            tLLCLibStats *pStats);
+
+/**
+ * @brief Get the smoothed channel load of a radio and channel
+ * @param pMKx MKx handle
+ * @param Radio MKX_RADIO_A or MKX_RADIO_B
+ * @param Chan MKX_CHANNEL_0 or MKX_CHANNEL_1
+ * @param pLoad Set to the channel load
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *         (-EAGAIN if no stats have been received for it yet)
+ *
+ * A sample is taken from each MKXIF_RADIOxSTATS message, i.e. once per
+ * channel interval (see the UtilPeriod channel config). The MKx only reports
+ * the channel busy ratio, so the transmit duty cycle is estimated from the
+ * length of our own confirmed transmissions (at the 6Mbps default rate) and
+ * the rest of the busy time is attributed to reception. The smoothing is an
+ * exponentially weighted average with a weight of 1/4 for each new sample.
+ */
+tMKxStatus MKx_GetChannelLoad (struct MKx *pMKx,
+                               tMKxRadio Radio,
+                               tMKxChannel Chan,
+                               tLLCChannelLoad *pLoad);
+
+/**
+ * @brief Get the most recent channel load samples of a radio and channel
+ * @param pMKx MKx handle
+ * @param Radio MKX_RADIO_A or MKX_RADIO_B
+ * @param Chan MKX_CHANNEL_0 or MKX_CHANNEL_1
+ * @param pSamples Array to fill, oldest sample first
+ * @param Cnt Size of the pSamples array (at most LLC_CBR_SAMPLE_CNT are kept)
+ * @return The number of samples copied, or a negative errno
+ */
+int MKx_GetChannelSamples (struct MKx *pMKx,
+                           tMKxRadio Radio,
+                           tMKxChannel Chan,
+                           tLLCChannelSample *pSamples,
+                           int Cnt);
+
+#endif // #ifndef __COHDA__APP__LLC__LIB__LLC_API_EXT_H__
+/**
+ * @}
+ */
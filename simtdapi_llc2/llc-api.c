@@ -14,6 +14,7 @@
 // Included headers
 //------------------------------------------------------------------------------
 #include <errno.h>
+#include <stdlib.h>
 #if defined(__QNX__)
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -38,9 +39,6 @@
 // Variables
 //------------------------------------------------------------------------------
 
-// LLC state storage
-static struct LLCDev __LLCDev;
-
 //------------------------------------------------------------------------------
 // Functions
 //------------------------------------------------------------------------------
@@ -49,39 +47,45 @@ static struct LLCDev __LLCDev;
  * @copydoc MKx_Init
  */
 tMKxStatus MKx_Init (struct MKx **ppMKx)
+{
+  return MKx_InitIf(NULL, ppMKx);
+}
+
+/**
+ * @copydoc MKx_InitIf
+ */
+tMKxStatus MKx_InitIf (const char *pIfName,
+                       struct MKx **ppMKx)
 {
   int Res = LLC_STATUS_ERROR;
   struct LLCDev *pDev = NULL;
-  struct MKx *pMKx = NULL;
 
-  d_fnstart(D_API, NULL, "(ppMKx %p)\n", ppMKx);
+  // LLC_IFNAME can point the applications at another interface (e.g. a
+  // stand-in for the MKx, see llc-standin.c)
+  if (pIfName == NULL)
+    pIfName = getenv("LLC_IFNAME");
+  if ((pIfName == NULL) || (pIfName[0] == '\0'))
+    pIfName = LLC_IFNAME_DEFAULT;
+
+  d_fnstart(D_API, NULL, "(%s ppMKx %p)\n", pIfName, ppMKx);
   d_assert(ppMKx != NULL);
+  *ppMKx = NULL;
 
-  // MKx_Init() can be called multiple times
-  // and only initialised on first invocation
-  pDev = LLC_DeviceGet();
-  if (pDev == NULL)
+  if (strlen(pIfName) >= IFNAMSIZ)
   {
-    pDev = &__LLCDev;
-    Res = LLC_DeviceSetup(pDev);
-    if (Res != 0)
-      goto Error;
-
-    pMKx = &(pDev->MKx);
-
-    // Get the MKx driver state
-    Res = MKx_Get(pMKx);
-    if (Res == LLC_STATUS_SUCCESS);
-    *ppMKx = pMKx;
+    Res = -EINVAL;
+    goto Error;
   }
-  else
-  {
+
+  // MKx_InitIf() can be called multiple times (per interface)
+  // and only initialised on first invocation
+  Res = LLC_DeviceGet(pIfName, &pDev);
+  if (Res == LLC_STATUS_SUCCESS)
     *ppMKx = &(pDev->MKx);
-    Res = LLC_STATUS_SUCCESS;
-  }
 
 Error:
-  d_fnend(D_API, NULL, "(ppMKx %p [%p]) = %d\n", ppMKx, *ppMKx, Res);
+  d_fnend(D_API, NULL, "(%s ppMKx %p [%p]) = %d\n",
+          pIfName, ppMKx, *ppMKx, Res);
   return Res;
 }
 
@@ -99,8 +103,11 @@ tMKxStatus MKx_Exit (struct MKx *pMKx)
 
   pDev = LLC_Device(pMKx);
   d_printf(D_DBG, NULL, "pDev %p\n", pDev);
-  d_assert(pDev != NULL);
-  d_assert(pDev == &__LLCDev);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
 
   // Turn off the calllbacks
   pMKx->API.Callbacks.TxCnf     = NULL;
@@ -110,8 +117,9 @@ tMKxStatus MKx_Exit (struct MKx *pMKx)
   pMKx->API.Callbacks.DebugInd  = NULL;
   pMKx->API.Callbacks.C2XSecRsp = NULL;
 
-  // Release the LLC
+  // Release the LLC (pMKx must not be used from here on)
   LLC_DeviceRelease(pDev);
+  free(pDev);
 
   Res = LLC_STATUS_SUCCESS;
 
@@ -150,7 +158,8 @@ tMKxStatus MKx_Get (tMKx *pMKx)
   Bak.API.Callbacks.DebugInd  = pMKx->API.Callbacks.DebugInd;
   Bak.API.Callbacks.C2XSecRsp = pMKx->API.Callbacks.C2XSecRsp;
 
-  // Invoke the ioctl() on the 'cw-llc' interface
+  // Invoke the ioctl() on the 'cw-llc' interface (if there is a driver)
+  if (pDev->If.pTransport->NoDriver == false)
   {
     #if defined(__QNX__)
     struct ifdrv *pIfd = &(pDev->If.Ifd);
@@ -183,6 +192,14 @@ tMKxStatus MKx_Get (tMKx *pMKx)
     pIfr->ifr_data = (caddr_t)pMKx;
 
     Res = ioctl(pDev->If.Fd, SIOCDEVPRIVATE + LLC_IOMSG_MKX, pIfr);
+    if ((Res < 0) && (errno == EOPNOTSUPP))
+    {
+      // Not the LLC driver (e.g. a TAP or veth with a stand-in for the MKx):
+      // carry on with the locally held state
+      d_printf(D_WARN, NULL, "No LLC driver on %s, using the local state\n",
+               pIfr->ifr_name);
+      Res = 0;
+    }
     #endif
     if (Res < 0)
       d_error(D_ERR, NULL, "Unable to perform ioctl on llc device %s: %s\n",
@@ -194,6 +211,11 @@ tMKxStatus MKx_Get (tMKx *pMKx)
               strerror(errno));
     //d_dump(D_VERBOSE, NULL, pMKx, sizeof(*pMKx));
   }
+  else
+  {
+    // Nothing to get (e.g. the shared memory transport to llc-standin)
+    Res = 0;
+  }
 
   // Restore the backup values and API pointers
   pMKx->pPriv                   = Bak.pPriv;
@@ -241,8 +263,8 @@ int MKx_Fd (tMKx *pMKx)
     goto Error;
   }
 
-  // The file descriptor for the'cw-llc' netdev
-  Res = pDev->If.Fd;
+  // The file descriptor for the'cw-llc' netdev (or the receive thread)
+  Res = LLC_MsgFd(pDev);
 
 Error:
   d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
@@ -261,12 +283,10 @@ tMKxStatus MKx_Recv (tMKx *pMKx)
 
   d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
 
-  // Calling MKx_Recv(NULL) exits any loops below
+  // Calling MKx_Recv(NULL) exits any loops below (for every interface)
   if (pMKx == NULL)
   {
-    pDev = LLC_DeviceGet();
-    if (pDev != NULL)
-      pDev->Exit = true;
+    LLC_DeviceExitAll();
     Res = -EAGAIN;
     goto Error;
   }
@@ -299,6 +319,14 @@ tMKxStatus MKx_Recv (tMKx *pMKx)
       Res = 0;
   }
 
+  // Complete any TxReq's whose TxCnf has been lost
+  LLC_MsgTxReclaim(pDev);
+  // ... and config requests whose reply has been lost
+  LLC_CfgReclaim(pDev);
+  // ... and security commands whose response has been outstanding longer
+  // than their timeout
+  LLC_SecReclaim(pDev);
+
 Error:
   d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
   return Res;
@@ -306,19 +334,19 @@ Error:
 
 
 /**
- * @copydoc fMKx_Config
+ * @copydoc MKx_RecvBudget
  *
  */
-tMKxStatus LLC_Config (struct MKx *pMKx,
-                       tMKxRadio Radio,
-                       tMKxRadioConfig *pConfig)
+tMKxStatus MKx_RecvBudget (struct MKx *pMKx,
+                           unsigned int MaxMsgs,
+                           unsigned int MaxUs)
 {
   int Res = -ENOSYS;
   struct LLCDev *pDev = NULL;
 
-  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
-
-  if ((pMKx == NULL) || (pConfig == NULL))
+  d_fnstart(D_API, NULL, "(pMKx %p MaxMsgs %u MaxUs %u)\n",
+            pMKx, MaxMsgs, MaxUs);
+  if (pMKx == NULL)
   {
     Res = -EINVAL;
     goto Error;
@@ -331,8 +359,55 @@ tMKxStatus LLC_Config (struct MKx *pMKx,
     Res = -ENODEV;
     goto Error;
   }
+  // Exit with an error early is the 'Exit' fag is set
+  if (pDev->Exit == true)
+  {
+    Res = -EPIPE;
+    goto Error;
+  }
+
+  // Never wait for the pcap read timeout once the socket is empty
+  (void)LLC_InterfaceNonBlock(pDev);
+
+  // Consume queued messages until empty or out of budget
+  {
+    unsigned int Cnt = 0;
+    uint64_t Deadline = LLC_MsgTime() + MaxUs;
+
+    while (1)
+    {
+      if ((pDev->Exit == true) ||
+          ((MaxMsgs != 0) && (Cnt >= MaxMsgs)) ||
+          ((MaxUs != 0) && (LLC_MsgTime() >= Deadline)))
+      {
+        Res = 1; // Out of budget: there may be more
+        break;
+      }
+      Res = LLC_MsgRecv(pDev);
+      if (Res == -EAGAIN)
+      {
+        Res = 0; // Drained
+        break;
+      }
+      if (Res != 0)
+      {
+        // As MKx_Recv(): stop at a failure, but report it only if it's all
+        // there was (otherwise let the caller come back for the rest)
+        if (Cnt > 0)
+          Res = 1;
+        break;
+      }
+      Cnt++;
+    }
+  }
 
-  Res = LLC_MsgCfgReq(pDev, Radio, pConfig);
+  // Complete any TxReq's whose TxCnf has been lost
+  LLC_MsgTxReclaim(pDev);
+  // ... and config requests whose reply has been lost
+  LLC_CfgReclaim(pDev);
+  // ... and security commands whose response has been outstanding longer
+  // than their timeout
+  LLC_SecReclaim(pDev);
 
 Error:
   d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
@@ -341,18 +416,17 @@ Error:
 
 
 /**
- * @copydoc fMKx_TxReq
+ * @copydoc MKx_TxCnfTimeout
  *
  */
-tMKxStatus LLC_TxReq (struct MKx *pMKx,
-                      tMKxTxPacket *pTxPkt,
-                      void *pPriv)
+tMKxStatus MKx_TxCnfTimeout (struct MKx *pMKx,
+                             unsigned int Timeout_ms)
 {
   int Res = -ENOSYS;
   struct LLCDev *pDev = NULL;
 
-  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
-  if ((pMKx == NULL) || (pTxPkt == NULL))
+  d_fnstart(D_API, NULL, "(pMKx %p Timeout_ms %u)\n", pMKx, Timeout_ms);
+  if (pMKx == NULL)
   {
     Res = -EINVAL;
     goto Error;
@@ -366,46 +440,62 @@ tMKxStatus LLC_TxReq (struct MKx *pMKx,
     goto Error;
   }
 
-  Res = LLC_MsgTxReq(pDev, pTxPkt, pPriv);
+  pDev->Msg.TxCnfTimeout = Timeout_ms;
+  Res = LLC_STATUS_SUCCESS;
 
 Error:
-  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  d_fnend(D_API, NULL, "(pMKx %p Timeout_ms %u) = %d\n", pMKx, Timeout_ms, Res);
   return Res;
 }
 
 
 /**
- * @copydoc fMKx_TxFlush
+ * @copydoc MKx_TxBlock
  *
  */
-tMKxStatus LLC_TxFlush (struct MKx *pMKx,
-                        tMKxRadio Radio,
-                        tMKxChannel Chan,
-                        tMKxTxQueue TxQ)
+tMKxStatus MKx_TxBlock (struct MKx *pMKx,
+                        unsigned int Deadline_ms)
 {
   int Res = -ENOSYS;
-  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+  struct LLCDev *pDev = NULL;
 
-  // TODO
+  d_fnstart(D_API, NULL, "(pMKx %p Deadline_ms %u)\n", pMKx, Deadline_ms);
+  if (pMKx == NULL)
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
 
-  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  pDev->Msg.TxBlock = Deadline_ms;
+  Res = LLC_STATUS_SUCCESS;
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p Deadline_ms %u) = %d\n", pMKx, Deadline_ms,
+          Res);
   return Res;
 }
 
 
 /**
- * @copydoc fMKx_TempCfg
+ * @copydoc MKx_TxQueueConfig
  *
  */
-tMKxStatus LLC_TempCfg (struct MKx *pMKx,
-                        tMKxTempConfig *pCfg)
+tMKxStatus MKx_TxQueueConfig (struct MKx *pMKx,
+                              const tLLCTxQConfig *pConfig)
 {
   int Res = -ENOSYS;
   struct LLCDev *pDev = NULL;
 
-  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
-
-  if ((pMKx == NULL) || (pCfg == NULL))
+  d_fnstart(D_API, NULL, "(pMKx %p pConfig %p)\n", pMKx, pConfig);
+  if ((pMKx == NULL) || (pConfig == NULL))
   {
     Res = -EINVAL;
     goto Error;
@@ -419,27 +509,28 @@ tMKxStatus LLC_TempCfg (struct MKx *pMKx,
     goto Error;
   }
 
-  Res = LLC_MsgTempCfgReq(pDev, pCfg);
+  Res = LLC_MsgTxQConfig(pDev, pConfig);
 
 Error:
-  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  d_fnend(D_API, NULL, "(pMKx %p pConfig %p) = %d\n", pMKx, pConfig, Res);
   return Res;
 }
 
 
 /**
- * @copydoc fMKx_Temp
+ * @copydoc MKx_TxQueueStats
  *
  */
-tMKxStatus LLC_Temp (struct MKx *pMKx,
-                     tMKxTemp *pTemp)
+tMKxStatus MKx_TxQueueStats (struct MKx *pMKx,
+                             tMKxRadio Radio,
+                             tMKxChannel Chan,
+                             tLLCTxQStats *pStats)
 {
   int Res = -ENOSYS;
   struct LLCDev *pDev = NULL;
 
-  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
-
-  if ((pMKx == NULL) || (pTemp == NULL))
+  d_fnstart(D_API, NULL, "(pMKx %p Radio %d Chan %d)\n", pMKx, Radio, Chan);
+  if ((pMKx == NULL) || (pStats == NULL))
   {
     Res = -EINVAL;
     goto Error;
@@ -453,26 +544,26 @@ tMKxStatus LLC_Temp (struct MKx *pMKx,
     goto Error;
   }
 
-  Res = LLC_MsgTempReq(pDev, pTemp);
+  Res = LLC_MsgTxQStats(pDev, Radio, Chan, pStats);
 
 Error:
-  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  d_fnend(D_API, NULL, "(pMKx %p Radio %d Chan %d) = %d\n",
+          pMKx, Radio, Chan, Res);
   return Res;
 }
 
+
 /**
- * @copydoc fMKx_PowerDetCfg
+ * @copydoc MKx_TxInFlight
  *
  */
-tMKxStatus LLC_PowerDetCfg (struct MKx *pMKx,
-                        tMKxPowerDetConfig *pCfg)
+int MKx_TxInFlight (struct MKx *pMKx)
 {
   int Res = -ENOSYS;
   struct LLCDev *pDev = NULL;
 
   d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
-
-  if ((pMKx == NULL) || (pCfg == NULL))
+  if (pMKx == NULL)
   {
     Res = -EINVAL;
     goto Error;
@@ -486,7 +577,7 @@ tMKxStatus LLC_PowerDetCfg (struct MKx *pMKx,
     goto Error;
   }
 
-  Res = LLC_MsgPowerDetCfgReq(pDev, pCfg);
+  Res = pDev->Msg.InFlight.Cnt;
 
 Error:
   d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
@@ -495,31 +586,16 @@ Error:
 
 
 /**
- * @copydoc fMKx_GetTSF
- *
- */
-tMKxTSF LLC_GetTSF (struct MKx *pMKx)
-{
-  int Res = -ENOSYS;
-  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
-
-  // TODO
-
-  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
-  return Res;
-}
-
-/**
- * @copydoc fMKx_SetTSF
+ * @copydoc MKx_RxZeroCopy
  *
  */
-tMKxStatus LLC_SetTSF (struct MKx *pMKx,
-                       tMKxTSF TSF)
+tMKxStatus MKx_RxZeroCopy (struct MKx *pMKx,
+                           bool Enable)
 {
   int Res = -ENOSYS;
   struct LLCDev *pDev = NULL;
 
-  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+  d_fnstart(D_API, NULL, "(pMKx %p Enable %d)\n", pMKx, Enable);
   if (pMKx == NULL)
   {
     Res = -EINVAL;
@@ -534,127 +610,122 @@ tMKxStatus LLC_SetTSF (struct MKx *pMKx,
     goto Error;
   }
 
-  Res = LLC_MsgSetTSFReq(pDev, TSF);
+  // Only possible if frames can be held in the transport's receive buffer
+  if (Enable && (LLC_InterfaceRxInPlace(pDev) == false))
+  {
+    Res = -EOPNOTSUPP;
+    goto Error;
+  }
+  // The receive thread decides how to queue each packet
+  if (pDev->Thread.Enabled)
+  {
+    Res = -EBUSY;
+    goto Error;
+  }
+
+  pDev->Msg.RxZeroCopy = Enable;
+  Res = LLC_STATUS_SUCCESS;
 
 Error:
-  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  d_fnend(D_API, NULL, "(pMKx %p Enable %d) = %d\n", pMKx, Enable, Res);
   return Res;
 }
 
 
 /**
- * @copydoc fMKx_TxCnf
+ * @copydoc MKx_RxRelease
  *
- * If the client has set the callback function pointer (non NULL) then call it!
  */
-// mask by myself
-/*tMKxStatus LLC_TxCnf (struct MKx *pMKx,
-                      tMKxTxPacket *pTxPkt,
-                      tMKxTxEvent *pTxEvent,
-                      void *pPriv)
+void MKx_RxRelease (struct MKx *pMKx,
+                    void *pPriv)
 {
-  int Res = LLC_STATUS_ERROR;
-  d_fnstart(D_API, NULL, "(pMKx %p pTxPkt %p pTxEvent %p pPriv %p)\n",
-            pMKx, pTxPkt, pTxEvent, pPriv);
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
 
-  if (pMKx->API.Callbacks.TxCnf != NULL)
+  d_fnstart(D_API, NULL, "(pMKx %p pPriv %p)\n", pMKx, pPriv);
+  if ((pMKx == NULL) || (pPriv == NULL))
   {
-    Res = pMKx->API.Callbacks.TxCnf(pMKx, pTxPkt, pTxEvent, pPriv);
+    Res = -EINVAL;
+    goto Error;
   }
 
-  d_fnend(D_API, NULL, "(pMKx %p pTxPkt %p pTxEvent %p pPriv %p) = %d\n",
-          pMKx, pTxPkt, pTxEvent, pPriv, Res);
-  return Res;
-}
-*/
-/**
- * @copydoc fMKx_RxAlloc
- *
- * If the client has set the callback function pointer (non NULL) then call it!
- */
-/*
-tMKxStatus LLC_RxAlloc (struct MKx *pMKx,
-                        int BufLen,
-                        uint8_t **ppBuf,
-                        void **ppPriv)
-{
-  int Res = LLC_STATUS_ERROR;
-  d_fnstart(D_API, NULL, "(pMKx %p BufLen %d ppBuf %p ppPriv %p)\n",
-            pMKx, BufLen, ppBuf, ppPriv);
-
-  if (pMKx->API.Callbacks.RxAlloc != NULL)
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
   {
-    Res = pMKx->API.Callbacks.RxAlloc(pMKx, BufLen, ppBuf, ppPriv);
+    Res = -ENODEV;
+    goto Error;
   }
 
-  d_fnend(D_API, NULL, "(pMKx %p BufLen %d ppBuf %p ppPriv %p) = %d\n",
-          pMKx, BufLen, ppBuf, ppPriv, Res);
-  return Res;
-}*/
+  Res = LLC_InterfaceRxRelease(pDev, pPriv);
+  if (Res != 0)
+    d_error(D_WARN, NULL, "Invalid pPriv %p\n", pPriv);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p pPriv %p) = void '%d'\n", pMKx, pPriv, Res);
+  return;
+}
+
 
 /**
- * @copydoc fMKx_RxInd
+ * @copydoc MKx_RxThread
  *
- * If the client has set the callback function pointer (non NULL) then call it!
  */
-/*
-tMKxStatus LLC_RxInd (struct MKx *pMKx,
-                      tMKxRxPacket *pRxPkt,
-                      void *pPriv)
+tMKxStatus MKx_RxThread (struct MKx *pMKx,
+                         bool Enable)
 {
-  int Res = LLC_STATUS_ERROR;
-  d_fnstart(D_API, NULL, "(pMKx %p pRxPkt %p pPriv %p)\n",
-            pMKx, pRxPkt, pPriv);
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
 
-  if (pMKx->API.Callbacks.RxInd != NULL)
+  d_fnstart(D_API, NULL, "(pMKx %p Enable %d)\n", pMKx, Enable);
+  if (pMKx == NULL)
   {
-    Res = pMKx->API.Callbacks.RxInd(pMKx, pRxPkt, pPriv);
+    Res = -EINVAL;
+    goto Error;
   }
 
-  d_fnend(D_API, NULL, "(pMKx %p pRxPkt %p pPriv %p) = %d\n",
-          pMKx, pRxPkt, pPriv, Res);
-  return Res;
-}
-
-*/
-/**
- * @copydoc fMKx_NotifInd
- *
- * If the client has set the callback function pointer (non NULL) then call it!
- */
-tMKxStatus LLC_NotifInd (struct MKx *pMKx,
-                         tMKxNotif Notif)
-{
-  int Res = LLC_STATUS_ERROR;
-  d_fnstart(D_VERBOSE, NULL, "(pMKx %p Notif 0x%08X)\n", pMKx, Notif);
-
-  if (pMKx->API.Callbacks.NotifInd != NULL)
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
   {
-    Res = pMKx->API.Callbacks.NotifInd(pMKx, Notif);
+    Res = -ENODEV;
+    goto Error;
+  }
+  // Not from within a callback (MKx_Recv() would be using the queues)
+  if (pDev->Msg.InRecv)
+  {
+    Res = -EBUSY;
+    goto Error;
   }
+
+  if (Enable == pDev->Thread.Enabled)
+    Res = LLC_STATUS_SUCCESS;
+  else if (Enable)
+    Res = LLC_ThreadStart(pDev);
   else
   {
-    // No callback should not mean a failure
+    LLC_ThreadStop(pDev, true);
     Res = LLC_STATUS_SUCCESS;
   }
 
-  d_fnend(D_VERBOSE, NULL, "(pMKx %p Notif 0x%08X) = %d\n", pMKx, Notif, Res);
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p Enable %d) = %d\n", pMKx, Enable, Res);
   return Res;
 }
 
 
 /**
- * @copydoc fC2XSec_CommandReq
+ * @copydoc MKx_GetLibStats
  *
  */
-tMKxStatus LLC_C2XSecReq (struct MKx *pMKx,
-                          tMKxC2XSec *pMsg)
+tMKxStatus MKx_GetLibStats (struct MKx *pMKx,
+                            tLLCLibStats *pStats)
 {
   int Res = -ENOSYS;
   struct LLCDev *pDev = NULL;
 
-  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
-  if ((pMKx == NULL) || (pMsg == NULL))
+  d_fnstart(D_API, NULL, "(pMKx %p pStats %p)\n", pMKx, pStats);
+  if ((pMKx == NULL) || (pStats == NULL))
   {
     Res = -EINVAL;
     goto Error;
@@ -668,7 +739,731 @@ tMKxStatus LLC_C2XSecReq (struct MKx *pMKx,
     goto Error;
   }
 
-  Res = LLC_MsgSecReq(pDev, pMsg);
+  *pStats = pDev->Msg.Stats;
+  pStats->RxDropped = pDev->Thread.RxDropped;
+  Res = LLC_STATUS_SUCCESS;
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p pStats %p) = %d\n", pMKx, pStats, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc MKx_GetChannelLoad
+ *
+ */
+tMKxStatus MKx_GetChannelLoad (struct MKx *pMKx,
+                               tMKxRadio Radio,
+                               tMKxChannel Chan,
+                               tLLCChannelLoad *pLoad)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p Radio %d Chan %d)\n", pMKx, Radio, Chan);
+  if ((pMKx == NULL) || (pLoad == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_CBRGet(pDev, Radio, Chan, pLoad);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p Radio %d Chan %d) = %d\n",
+          pMKx, Radio, Chan, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc MKx_GetChannelSamples
+ *
+ */
+int MKx_GetChannelSamples (struct MKx *pMKx,
+                           tMKxRadio Radio,
+                           tMKxChannel Chan,
+                           tLLCChannelSample *pSamples,
+                           int Cnt)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p Radio %d Chan %d)\n", pMKx, Radio, Chan);
+  if ((pMKx == NULL) || ((pSamples == NULL) && (Cnt != 0)))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_CBRSamples(pDev, Radio, Chan, pSamples, Cnt);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p Radio %d Chan %d) = %d\n",
+          pMKx, Radio, Chan, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc MKx_ConfigAsync
+ *
+ */
+tMKxStatus MKx_ConfigAsync (struct MKx *pMKx,
+                            tMKxRadio Radio,
+                            const tMKxRadioConfigData *pConfig,
+                            fLLC_ConfigDone Done,
+                            void *pPriv)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p Radio %d)\n", pMKx, Radio);
+  if ((pMKx == NULL) || (pConfig == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_CfgApply(pDev, Radio, pConfig, Done, pPriv);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p Radio %d) = %d\n", pMKx, Radio, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc MKx_ConfigStats
+ *
+ */
+tMKxStatus MKx_ConfigStats (struct MKx *pMKx,
+                            tMKxRadio Radio,
+                            tLLCConfigStats *pStats)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p Radio %d)\n", pMKx, Radio);
+  if ((pMKx == NULL) || (pStats == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_CfgStats(pDev, Radio, pStats);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p Radio %d) = %d\n", pMKx, Radio, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc fMKx_Config
+ *
+ * Goes through the config shadow (see MKx_ConfigAsync()).
+ */
+tMKxStatus LLC_Config (struct MKx *pMKx,
+                       tMKxRadio Radio,
+                       tMKxRadioConfig *pConfig)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+
+  if ((pMKx == NULL) || (pConfig == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_CfgApply(pDev, Radio, &(pConfig->RadioConfigData), NULL, NULL);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc fMKx_TxReq
+ *
+ */
+tMKxStatus LLC_TxReq (struct MKx *pMKx,
+                      tMKxTxPacket *pTxPkt,
+                      void *pPriv)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+  if ((pMKx == NULL) || (pTxPkt == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_MsgTxReq(pDev, pTxPkt, pPriv);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc MKx_TxReqBatch
+ *
+ */
+tMKxStatus MKx_TxReqBatch (struct MKx *pMKx,
+                           tMKxTxPacket **ppTxPkts,
+                           void **ppPriv,
+                           int Cnt,
+                           tMKxStatus *pResults)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+  int i;
+
+  d_fnstart(D_API, NULL, "(pMKx %p Cnt %d)\n", pMKx, Cnt);
+  if ((pMKx == NULL) || (ppTxPkts == NULL) || (pResults == NULL) || (Cnt < 0))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+  for (i = 0; i < Cnt; i++)
+  {
+    if (ppTxPkts[i] == NULL)
+    {
+      Res = -EINVAL;
+      goto Error;
+    }
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_MsgTxReqBatch(pDev, ppTxPkts, ppPriv, Cnt, pResults);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p Cnt %d) = %d\n", pMKx, Cnt, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc fMKx_TxFlush
+ *
+ */
+tMKxStatus LLC_TxFlush (struct MKx *pMKx,
+                        tMKxRadio Radio,
+                        tMKxChannel Chan,
+                        tMKxTxQueue TxQ)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+  if (pMKx == NULL)
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_MsgTxFlushReq(pDev, Radio, Chan, TxQ);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc fMKx_TempCfg
+ *
+ */
+tMKxStatus LLC_TempCfg (struct MKx *pMKx,
+                        tMKxTempConfig *pCfg)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+
+  if ((pMKx == NULL) || (pCfg == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_MsgTempCfgReq(pDev, pCfg);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc fMKx_Temp
+ *
+ */
+tMKxStatus LLC_Temp (struct MKx *pMKx,
+                     tMKxTemp *pTemp)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+
+  if ((pMKx == NULL) || (pTemp == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_MsgTempReq(pDev, pTemp);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  return Res;
+}
+
+/**
+ * @copydoc fMKx_PowerDetCfg
+ *
+ */
+tMKxStatus LLC_PowerDetCfg (struct MKx *pMKx,
+                        tMKxPowerDetConfig *pCfg)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+
+  if ((pMKx == NULL) || (pCfg == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_MsgPowerDetCfgReq(pDev, pCfg);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc fMKx_GetTSF
+ *
+ */
+tMKxTSF LLC_GetTSF (struct MKx *pMKx)
+{
+  tMKxTSF TSF = 0;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+  if (pMKx == NULL)
+    goto Error;
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+    goto Error;
+
+  // Extrapolated locally from the last TSF(s) seen (zero if none yet)
+  (void)LLC_TSFGet(pDev, &TSF, NULL);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p) = %llu\n", pMKx, (unsigned long long)TSF);
+  return TSF;
+}
+
+/**
+ * @copydoc MKx_GetTSFError
+ *
+ */
+tMKxStatus MKx_GetTSFError (struct MKx *pMKx,
+                            tMKxTSF *pTSF,
+                            uint32_t *pErr)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+  if ((pMKx == NULL) || (pTSF == NULL) || (pErr == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_TSFGet(pDev, pTSF, pErr);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  return Res;
+}
+
+/**
+ * @copydoc fMKx_SetTSF
+ *
+ */
+tMKxStatus LLC_SetTSF (struct MKx *pMKx,
+                       tMKxTSF TSF)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+  if (pMKx == NULL)
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_MsgSetTSFReq(pDev, TSF);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc fMKx_TxCnf
+ *
+ * If the client has set the callback function pointer (non NULL) then call it!
+ */
+// mask by myself
+/*tMKxStatus LLC_TxCnf (struct MKx *pMKx,
+                      tMKxTxPacket *pTxPkt,
+                      tMKxTxEvent *pTxEvent,
+                      void *pPriv)
+{
+  int Res = LLC_STATUS_ERROR;
+  d_fnstart(D_API, NULL, "(pMKx %p pTxPkt %p pTxEvent %p pPriv %p)\n",
+            pMKx, pTxPkt, pTxEvent, pPriv);
+
+  if (pMKx->API.Callbacks.TxCnf != NULL)
+  {
+    Res = pMKx->API.Callbacks.TxCnf(pMKx, pTxPkt, pTxEvent, pPriv);
+  }
+
+  d_fnend(D_API, NULL, "(pMKx %p pTxPkt %p pTxEvent %p pPriv %p) = %d\n",
+          pMKx, pTxPkt, pTxEvent, pPriv, Res);
+  return Res;
+}
+*/
+/**
+ * @copydoc fMKx_RxAlloc
+ *
+ * If the client has set the callback function pointer (non NULL) then call it!
+ */
+/*
+tMKxStatus LLC_RxAlloc (struct MKx *pMKx,
+                        int BufLen,
+                        uint8_t **ppBuf,
+                        void **ppPriv)
+{
+  int Res = LLC_STATUS_ERROR;
+  d_fnstart(D_API, NULL, "(pMKx %p BufLen %d ppBuf %p ppPriv %p)\n",
+            pMKx, BufLen, ppBuf, ppPriv);
+
+  if (pMKx->API.Callbacks.RxAlloc != NULL)
+  {
+    Res = pMKx->API.Callbacks.RxAlloc(pMKx, BufLen, ppBuf, ppPriv);
+  }
+
+  d_fnend(D_API, NULL, "(pMKx %p BufLen %d ppBuf %p ppPriv %p) = %d\n",
+          pMKx, BufLen, ppBuf, ppPriv, Res);
+  return Res;
+}*/
+
+/**
+ * @copydoc fMKx_RxInd
+ *
+ * If the client has set the callback function pointer (non NULL) then call it!
+ */
+/*
+tMKxStatus LLC_RxInd (struct MKx *pMKx,
+                      tMKxRxPacket *pRxPkt,
+                      void *pPriv)
+{
+  int Res = LLC_STATUS_ERROR;
+  d_fnstart(D_API, NULL, "(pMKx %p pRxPkt %p pPriv %p)\n",
+            pMKx, pRxPkt, pPriv);
+
+  if (pMKx->API.Callbacks.RxInd != NULL)
+  {
+    Res = pMKx->API.Callbacks.RxInd(pMKx, pRxPkt, pPriv);
+  }
+
+  d_fnend(D_API, NULL, "(pMKx %p pRxPkt %p pPriv %p) = %d\n",
+          pMKx, pRxPkt, pPriv, Res);
+  return Res;
+}
+
+*/
+/**
+ * @copydoc fMKx_NotifInd
+ *
+ * If the client has set the callback function pointer (non NULL) then call it!
+ */
+tMKxStatus LLC_NotifInd (struct MKx *pMKx,
+                         tMKxNotif Notif)
+{
+  int Res = LLC_STATUS_ERROR;
+  d_fnstart(D_VERBOSE, NULL, "(pMKx %p Notif 0x%08X)\n", pMKx, Notif);
+
+  if (pMKx->API.Callbacks.NotifInd != NULL)
+  {
+    Res = pMKx->API.Callbacks.NotifInd(pMKx, Notif);
+  }
+  else
+  {
+    // No callback should not mean a failure
+    Res = LLC_STATUS_SUCCESS;
+  }
+
+  d_fnend(D_VERBOSE, NULL, "(pMKx %p Notif 0x%08X) = %d\n", pMKx, Notif, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc fC2XSec_CommandReq
+ *
+ */
+tMKxStatus LLC_C2XSecReq (struct MKx *pMKx,
+                          tMKxC2XSec *pMsg)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+  if ((pMKx == NULL) || (pMsg == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_MsgSecReq(pDev, pMsg);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc MKx_C2XSecConfig
+ *
+ */
+tMKxStatus MKx_C2XSecConfig (struct MKx *pMKx,
+                             const tLLCC2XSecConfig *pConfig)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+  if ((pMKx == NULL) || (pConfig == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_SecConfig(pDev, pConfig);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc MKx_C2XSecSubmit
+ *
+ */
+int MKx_C2XSecSubmit (struct MKx *pMKx,
+                      tMKxC2XSec *pMsg,
+                      fLLC_C2XSecDone Done,
+                      void *pPriv)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p pMsg %p)\n", pMKx, pMsg);
+  if ((pMKx == NULL) || (pMsg == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Res = LLC_SecSubmit(pDev, pMsg, Done, pPriv);
+
+Error:
+  d_fnend(D_API, NULL, "(pMKx %p pMsg %p) = %d\n", pMKx, pMsg, Res);
+  return Res;
+}
+
+
+/**
+ * @copydoc MKx_C2XSecStats
+ *
+ */
+tMKxStatus MKx_C2XSecStats (struct MKx *pMKx,
+                            tLLCC2XSecStats *pStats)
+{
+  int Res = -ENOSYS;
+  struct LLCDev *pDev = NULL;
+
+  d_fnstart(D_API, NULL, "(pMKx %p)\n", pMKx);
+  if ((pMKx == NULL) || (pStats == NULL))
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Get a handle of the overarching device
+  pDev = LLC_Device(pMKx);
+  if (pDev == NULL)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  *pStats = pDev->Sec.Stats;
+  Res = LLC_STATUS_SUCCESS;
 
 Error:
   d_fnend(D_API, NULL, "(pMKx %p) = %d\n", pMKx, Res);
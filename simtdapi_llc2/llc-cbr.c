@@ -0,0 +1,224 @@
+/**
+ * @addtogroup cohda_llc_intern_lib LLC API library
+ * @{
+ *
+ * @file
+ * LLC: Channel load history (from the MKXIF_RADIOxSTATS messages)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2013 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <errno.h>
+#include <string.h>
+#include "llc-lib.h"
+
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Weight of a new sample in the smoothed values (1/4)
+#define LLC_CBR_EWMA_SHIFT   (2)
+/// Full scale of the ChannelBusyRatio reported by the MKx
+#define LLC_CBR_MKX_SCALE    (255)
+/// Full scale of the CBR and duty cycles kept here (0.1%)
+#define LLC_CBR_SCALE        (1000)
+/// PHY rate assumed for our own transmissions (6 Mbps, 10 MHz) [bit/us]
+#define LLC_CBR_PHY_RATE     (6)
+/// Preamble + header airtime of each transmission [us]
+#define LLC_CBR_PHY_OVERHEAD (40)
+/// Longest believable interval between stats messages (by TSF) [us]
+#define LLC_CBR_PERIOD_MAX   (10000000)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Clear the channel load history
+ * @param pDev LLC device pointer
+ */
+void LOCAL LLC_CBRSetup (struct LLCDev *pDev)
+{
+  d_assert(pDev != NULL);
+
+  memset(&(pDev->CBR), 0, sizeof(pDev->CBR));
+}
+
+/**
+ * @brief Account for the airtime of one of our own (confirmed) transmissions
+ * @param pDev LLC device pointer
+ * @param pTxPkt The packet that was passed to TxReq()
+ */
+void LOCAL LLC_CBRTx (struct LLCDev *pDev,
+                      tMKxTxPacket *pTxPkt)
+{
+  tMKxRadio Radio = pTxPkt->TxPacketData.RadioID;
+  tMKxChannel Chan = pTxPkt->TxPacketData.ChannelID;
+
+  if (!LLC_RADIO_CHAN_VALID(Radio, Chan))
+    return;
+
+  pDev->CBR.Chan[Radio][Chan].TxAirtime += LLC_CBR_PHY_OVERHEAD +
+    ((pTxPkt->TxPacketData.TxFrameLength * 8) / LLC_CBR_PHY_RATE);
+}
+
+/**
+ * @brief Take a channel load sample from a stats message
+ * @param pDev LLC device pointer
+ * @param Radio The radio the stats are for
+ * @param Chan The channel whose interval just ended
+ * @param pStats The stats reported by the MKx
+ * @param Now When the message was received (CLOCK_MONOTONIC) [us]
+ *
+ * The MKx sends a stats message at the end of each channel interval, so the
+ * time since the radio's previous one is the length of the interval that our
+ * transmit airtime is measured against. That is taken from their TSFs (which
+ * don't suffer from the receive latency) unless the TSF has been stepped.
+ */
+void LOCAL LLC_CBRSample (struct LLCDev *pDev,
+                          tMKxRadio Radio,
+                          tMKxChannel Chan,
+                          const tMKxRadioStatsData *pStats,
+                          uint64_t Now)
+{
+  struct LLCCBRChan *pChan;
+  tLLCChannelSample *pSample;
+  uint32_t CBR;
+  uint32_t Tx = 0;
+
+  if (!LLC_RADIO_CHAN_VALID(Radio, Chan))
+    return;
+  pChan = &(pDev->CBR.Chan[Radio][Chan]);
+
+  pSample = &(pChan->Samples[pChan->Cnt % LLC_CBR_SAMPLE_CNT]);
+  memset(pSample, 0, sizeof(*pSample));
+  pSample->Time = Now;
+  pSample->TSF = pStats->TSF;
+  if ((pDev->CBR.LastTSF[Radio] != 0) &&
+      (pStats->TSF > pDev->CBR.LastTSF[Radio]) &&
+      ((pStats->TSF - pDev->CBR.LastTSF[Radio]) < LLC_CBR_PERIOD_MAX))
+    pSample->Period = pStats->TSF - pDev->CBR.LastTSF[Radio];
+  else if (pDev->CBR.LastTime[Radio] != 0)
+    pSample->Period = Now - pDev->CBR.LastTime[Radio];
+  pDev->CBR.LastTime[Radio] = Now;
+  pDev->CBR.LastTSF[Radio] = pStats->TSF;
+
+  CBR = (pStats->Chan[Chan].ChannelBusyRatio * LLC_CBR_SCALE) /
+        LLC_CBR_MKX_SCALE;
+  if (pSample->Period != 0)
+    Tx = ((uint64_t)pChan->TxAirtime * LLC_CBR_SCALE) / pSample->Period;
+  pChan->TxAirtime = 0;
+  if (Tx > LLC_CBR_SCALE)
+    Tx = LLC_CBR_SCALE;
+
+  pSample->CBR = CBR;
+  pSample->TxDuty = Tx;
+  pSample->RxDuty = (CBR > Tx) ? (CBR - Tx) : 0;
+  pSample->IdlePower = pStats->Chan[Chan].AverageIdlePower;
+
+  // Smooth (starting from the first sample)
+  if (pChan->Cnt == 0)
+  {
+    pChan->CBR = pSample->CBR << LLC_CBR_EWMA_SHIFT;
+    pChan->TxDuty = pSample->TxDuty << LLC_CBR_EWMA_SHIFT;
+    pChan->RxDuty = pSample->RxDuty << LLC_CBR_EWMA_SHIFT;
+  }
+  else
+  {
+    pChan->CBR += pSample->CBR - (pChan->CBR >> LLC_CBR_EWMA_SHIFT);
+    pChan->TxDuty += pSample->TxDuty - (pChan->TxDuty >> LLC_CBR_EWMA_SHIFT);
+    pChan->RxDuty += pSample->RxDuty - (pChan->RxDuty >> LLC_CBR_EWMA_SHIFT);
+  }
+  pChan->Cnt++;
+
+  d_printf(D_DEBUG, NULL, "CBR %c%d: %u Tx %u Rx %u (%u us)\n",
+           (Radio == MKX_RADIO_A) ? 'A' : 'B', Chan,
+           pSample->CBR, pSample->TxDuty, pSample->RxDuty, pSample->Period);
+}
+
+/**
+ * @brief Get the smoothed channel load of a radio and channel
+ * @param pDev LLC device pointer
+ * @param Radio
+ * @param Chan
+ * @param pLoad Set to the channel load
+ * @return Zero (LLC_STATUS_SUCCESS), -EINVAL or -EAGAIN if no samples yet
+ */
+int LOCAL LLC_CBRGet (struct LLCDev *pDev,
+                      tMKxRadio Radio,
+                      tMKxChannel Chan,
+                      tLLCChannelLoad *pLoad)
+{
+  struct LLCCBRChan *pChan;
+  uint32_t Cnt;
+
+  if (!LLC_RADIO_CHAN_VALID(Radio, Chan))
+    return -EINVAL;
+  pChan = &(pDev->CBR.Chan[Radio][Chan]);
+
+  memset(pLoad, 0, sizeof(*pLoad));
+  Cnt = pChan->Cnt;
+  if (Cnt == 0)
+    return -EAGAIN;
+
+  pLoad->Cnt = Cnt;
+  pLoad->CBR = pChan->CBR >> LLC_CBR_EWMA_SHIFT;
+  pLoad->TxDuty = pChan->TxDuty >> LLC_CBR_EWMA_SHIFT;
+  pLoad->RxDuty = pChan->RxDuty >> LLC_CBR_EWMA_SHIFT;
+  pLoad->Last = pChan->Samples[(Cnt - 1) % LLC_CBR_SAMPLE_CNT];
+  return LLC_STATUS_SUCCESS;
+}
+
+/**
+ * @brief Copy out the most recent channel load samples
+ * @param pDev LLC device pointer
+ * @param Radio
+ * @param Chan
+ * @param pSamples Array to fill, oldest sample first
+ * @param Cnt Size of the pSamples array
+ * @return The number of samples copied, or -EINVAL
+ */
+int LOCAL LLC_CBRSamples (struct LLCDev *pDev,
+                          tMKxRadio Radio,
+                          tMKxChannel Chan,
+                          tLLCChannelSample *pSamples,
+                          int Cnt)
+{
+  struct LLCCBRChan *pChan;
+  uint32_t First;
+  int i;
+
+  if ((!LLC_RADIO_CHAN_VALID(Radio, Chan)) || (Cnt < 0))
+    return -EINVAL;
+  pChan = &(pDev->CBR.Chan[Radio][Chan]);
+
+  if ((uint32_t)Cnt > pChan->Cnt)
+    Cnt = pChan->Cnt;
+  if (Cnt > LLC_CBR_SAMPLE_CNT)
+    Cnt = LLC_CBR_SAMPLE_CNT;
+
+  First = pChan->Cnt - Cnt;
+  for (i = 0; i < Cnt; i++)
+    pSamples[i] = pChan->Samples[(First + i) % LLC_CBR_SAMPLE_CNT];
+  return Cnt;
+}
+
+/**
+ * @}
+ */
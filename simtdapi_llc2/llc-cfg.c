@@ -0,0 +1,354 @@
+/**
+ * @addtogroup cohda_llc_intern_lib LLC API library
+ * @{
+ *
+ * @file
+ * LLC: Radio config shadow (skips unchanged and superseded config requests)
+ *
+ * The MKx only accepts a radio's complete config, and applying one restarts
+ * the radio's channels, so each request is first compared with the config
+ * the MKx last confirmed (or the one already sent to it). Requests that
+ * change nothing are dropped, and only one request per radio is in flight:
+ * later ones wait (the newest replacing any older one) for its
+ * MKXIF_RADIOxCFG reply.
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2013 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <errno.h>
+#include <string.h>
+#include "llc-lib.h"
+
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Give up on a config request with no reply after this long [us]
+#define LLC_CFG_TIMEOUT (1000000)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Forget the config shadow (nothing confirmed or in flight)
+ * @param pDev LLC device pointer
+ */
+void LOCAL LLC_CfgSetup (struct LLCDev *pDev)
+{
+  d_assert(pDev != NULL);
+
+  memset(&(pDev->Cfg), 0, sizeof(pDev->Cfg));
+}
+
+/**
+ * @brief Work out what differs between two radio configs
+ * @param pOld
+ * @param pNew
+ * @return LLC_CFG_CHANGED_* bits (zero if they are the same)
+ */
+static uint32_t LLC_CfgDiff (const tMKxRadioConfigData *pOld,
+                             const tMKxRadioConfigData *pNew)
+{
+  const tMKxChanConfig *pO;
+  const tMKxChanConfig *pN;
+  uint32_t Changed = 0;
+  int Chan;
+
+  if (pOld->Mode != pNew->Mode)
+    Changed |= LLC_CFG_CHANGED_MODE;
+
+  for (Chan = MKX_CHANNEL_0; Chan < MKX_CHANNEL_COUNT; Chan++)
+  {
+    pO = &(pOld->ChanConfig[Chan]);
+    pN = &(pNew->ChanConfig[Chan]);
+    if ((pO->PHY.ChannelFreq != pN->PHY.ChannelFreq) ||
+        (pO->PHY.Bandwidth != pN->PHY.Bandwidth))
+      Changed |= LLC_CFG_CHANGED_FREQ(Chan);
+    if ((pO->PHY.TxAntenna != pN->PHY.TxAntenna) ||
+        (pO->PHY.RxAntenna != pN->PHY.RxAntenna) ||
+        (pO->PHY.DefaultMCS != pN->PHY.DefaultMCS) ||
+        (pO->PHY.DefaultTxPower != pN->PHY.DefaultTxPower))
+      Changed |= LLC_CFG_CHANGED_PHY(Chan);
+    if (memcmp(&(pO->MAC), &(pN->MAC), sizeof(pO->MAC)) != 0)
+      Changed |= LLC_CFG_CHANGED_MAC(Chan);
+    if (memcmp(&(pO->LLC), &(pN->LLC), sizeof(pO->LLC)) != 0)
+      Changed |= LLC_CFG_CHANGED_LLC(Chan);
+  }
+  return Changed;
+}
+
+/**
+ * @brief Complete a config request
+ * @param pDev LLC device pointer
+ * @param Radio
+ * @param pReq The request
+ * @param Result Passed to its callback
+ */
+static void LLC_CfgDone (struct LLCDev *pDev,
+                         tMKxRadio Radio,
+                         const struct LLCCfgReq *pReq,
+                         tMKxStatus Result)
+{
+  if (pReq->Done != NULL)
+    pReq->Done(&(pDev->MKx), Radio, pReq->Changed, Result, pReq->pPriv);
+}
+
+/**
+ * @brief Send the held request of a radio (unless it no longer changes
+ *        anything)
+ * @param pDev LLC device pointer
+ * @param Radio
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ */
+static int LLC_CfgSendNext (struct LLCDev *pDev,
+                            tMKxRadio Radio)
+{
+  struct LLCCfgRadio *pCfg = &(pDev->Cfg[Radio]);
+  struct LLCCfgReq Req;
+  int Res;
+
+  pCfg->Held = false;
+  Req = pCfg->Next;
+
+  if (pCfg->Valid)
+  {
+    Req.Changed = LLC_CfgDiff(&(pCfg->Confirmed),
+                              &(Req.Config.RadioConfigData));
+    if (Req.Changed == 0)
+    {
+      pCfg->Stats.Unchanged++;
+      LLC_CfgDone(pDev, Radio, &Req, LLC_STATUS_SUCCESS);
+      return LLC_STATUS_SUCCESS;
+    }
+  }
+
+  pCfg->Sent = Req;
+  pCfg->Busy = true;
+  pCfg->SentTime = LLC_MsgTime();
+  pCfg->Stats.Sent++;
+  pCfg->Stats.Changed = Req.Changed;
+  d_printf(D_INFO, NULL, "Radio %c config: changes 0x%03X\n",
+           (Radio == MKX_RADIO_A) ? 'A' : 'B', Req.Changed);
+
+  Res = LLC_MsgCfgReq(pDev, Radio, &(pCfg->Sent.Config));
+  if (Res != 0)
+  {
+    pCfg->Busy = false;
+    pCfg->Stats.Failed++;
+  }
+  return Res;
+}
+
+/**
+ * @brief Give up on the request in flight if the MKx never replied to it
+ * @param pDev LLC device pointer
+ * @param Radio
+ *
+ * Its Done gets -ETIMEDOUT, after the held request (if any) has been sent.
+ */
+static void LLC_CfgTimeout (struct LLCDev *pDev,
+                            tMKxRadio Radio)
+{
+  struct LLCCfgRadio *pCfg = &(pDev->Cfg[Radio]);
+  struct LLCCfgReq Req;
+
+  if (!pCfg->Busy ||
+      ((LLC_MsgTime() - pCfg->SentTime) <= LLC_CFG_TIMEOUT))
+    return;
+
+  d_printf(D_WARN, NULL, "Radio %c config: no reply\n",
+           (Radio == MKX_RADIO_A) ? 'A' : 'B');
+  Req = pCfg->Sent;
+  pCfg->Busy = false;
+  pCfg->Stats.Failed++;
+
+  // As in LLC_CfgInd(), the next request goes out before the callback
+  if (pCfg->Held)
+  {
+    int Res = LLC_CfgSendNext(pDev, Radio);
+    if (Res != 0)
+      LLC_CfgDone(pDev, Radio, &(pCfg->Sent), Res);
+  }
+  LLC_CfgDone(pDev, Radio, &Req, -ETIMEDOUT);
+}
+
+/**
+ * @brief Request a new radio config
+ * @param pDev LLC device pointer
+ * @param Radio
+ * @param pConfig The complete new config
+ * @param Done Called when the request completes (or NULL)
+ * @param pPriv Passed to Done
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno (Done isn't called)
+ *
+ * See MKx_ConfigAsync().
+ */
+int LOCAL LLC_CfgApply (struct LLCDev *pDev,
+                        tMKxRadio Radio,
+                        const tMKxRadioConfigData *pConfig,
+                        fLLC_ConfigDone Done,
+                        void *pPriv)
+{
+  int Res = -EINVAL;
+  struct LLCCfgRadio *pCfg;
+  const tMKxRadioConfigData *pBase = NULL;
+  struct LLCCfgReq Req;
+
+  d_fnstart(D_TST, NULL, "(pDev %p Radio %d)\n", pDev, Radio);
+  d_assert(pDev != NULL);
+
+  if ((Radio < MKX_RADIO_A) || (Radio >= MKX_RADIO_COUNT))
+    goto Error;
+  pCfg = &(pDev->Cfg[Radio]);
+  pCfg->Stats.Requests++;
+
+  // The MKx never replied to the request in flight
+  LLC_CfgTimeout(pDev, Radio);
+
+  // Compare with what the MKx will have once everything before this is done
+  if (pCfg->Held)
+    pBase = &(pCfg->Next.Config.RadioConfigData);
+  else if (pCfg->Busy)
+    pBase = &(pCfg->Sent.Config.RadioConfigData);
+  else if (pCfg->Valid)
+    pBase = &(pCfg->Confirmed);
+
+  memset(&Req, 0, sizeof(Req));
+  memcpy(&(Req.Config.RadioConfigData), pConfig, sizeof(*pConfig));
+  Req.Changed = (pBase != NULL) ? LLC_CfgDiff(pBase, pConfig) :
+                LLC_CFG_CHANGED_ALL;
+  Req.Done = Done;
+  Req.pPriv = pPriv;
+
+  Res = LLC_STATUS_SUCCESS;
+  if (Req.Changed == 0)
+  {
+    pCfg->Stats.Unchanged++;
+    LLC_CfgDone(pDev, Radio, &Req, LLC_STATUS_SUCCESS);
+    goto Error;
+  }
+
+  // Keep the MKx structure as the latest requested config
+  // (overwritten by the contents of the reply message)
+  memcpy((void *)&(pDev->MKx.Config.Radio[Radio]), pConfig, sizeof(*pConfig));
+
+  if (pCfg->Held)
+  {
+    pCfg->Stats.Superseded++;
+    LLC_CfgDone(pDev, Radio, &(pCfg->Next), -ECANCELED);
+  }
+  pCfg->Next = Req;
+  pCfg->Held = true;
+  if (!pCfg->Busy)
+    Res = LLC_CfgSendNext(pDev, Radio);
+
+Error:
+  d_fnend(D_TST, NULL, "(pDev %p Radio %d) = %d\n", pDev, Radio, Res);
+  return Res;
+}
+
+/**
+ * @brief Update the config shadow from a MKXIF_RADIOxCFG message
+ * @param pDev LLC device pointer
+ * @param Radio
+ * @param pConfig The config reported by the MKx
+ * @param Ret The message's Ret value
+ *
+ * Completes the request in flight (if any) and sends the held one.
+ */
+void LOCAL LLC_CfgInd (struct LLCDev *pDev,
+                       tMKxRadio Radio,
+                       const tMKxRadioConfigData *pConfig,
+                       tMKxStatus Ret)
+{
+  struct LLCCfgRadio *pCfg;
+  struct LLCCfgReq Req;
+  bool Busy;
+
+  if ((Radio < MKX_RADIO_A) || (Radio >= MKX_RADIO_COUNT))
+    return;
+  pCfg = &(pDev->Cfg[Radio]);
+
+  if (Ret == MKXSTATUS_SUCCESS)
+  {
+    memcpy(&(pCfg->Confirmed), pConfig, sizeof(*pConfig));
+    pCfg->Valid = true;
+  }
+
+  Busy = pCfg->Busy;
+  Req = pCfg->Sent;
+  pCfg->Busy = false;
+  if (Busy)
+  {
+    if (Ret == MKXSTATUS_SUCCESS)
+      pCfg->Stats.Confirmed++;
+    else
+      pCfg->Stats.Failed++;
+  }
+
+  // The next request goes out before the callback, which may make another
+  if (pCfg->Held)
+  {
+    int Res = LLC_CfgSendNext(pDev, Radio);
+    if (Res != 0)
+      LLC_CfgDone(pDev, Radio, &(pCfg->Sent), Res);
+  }
+  if (Busy)
+    LLC_CfgDone(pDev, Radio, &Req, Ret);
+}
+
+/**
+ * @brief Give up on config requests whose reply has been lost
+ * @param pDev LLC device pointer
+ *
+ * Called from MKx_Recv(), so a radio doesn't stay busy (with its held
+ * request never sent) until the next LLC_CfgApply().
+ */
+void LOCAL LLC_CfgReclaim (struct LLCDev *pDev)
+{
+  tMKxRadio Radio;
+
+  d_assert(pDev != NULL);
+
+  for (Radio = MKX_RADIO_A; Radio < MKX_RADIO_COUNT; Radio++)
+    LLC_CfgTimeout(pDev, Radio);
+}
+
+/**
+ * @brief Get the config request counters of a radio
+ * @param pDev LLC device pointer
+ * @param Radio
+ * @param pStats Set to the counters
+ * @return Zero (LLC_STATUS_SUCCESS) or -EINVAL
+ */
+int LOCAL LLC_CfgStats (struct LLCDev *pDev,
+                        tMKxRadio Radio,
+                        tLLCConfigStats *pStats)
+{
+  if ((Radio < MKX_RADIO_A) || (Radio >= MKX_RADIO_COUNT))
+    return -EINVAL;
+
+  *pStats = pDev->Cfg[Radio].Stats;
+  pStats->Pending = pDev->Cfg[Radio].Busy;
+  return LLC_STATUS_SUCCESS;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,195 @@
+/**
+ * @addtogroup cohda_llc_intern_app LLC application
+ * @{
+ *
+ * @file
+ * LLC: CRC32C (see llc-crc32c.h)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2015 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <string.h>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "llc-crc32c.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// The (reflected) Castagnoli polynomial
+#define LLC_CRC32C_POLY (0x82F63B78)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+#if !defined(__SSE4_2__) && !defined(__ARM_FEATURE_CRC32)
+/// Slice-by-8 tables (Table[k][n] is the CRC of byte n followed by k zeros)
+static uint32_t LLC_Crc32cTable[8][256];
+static pthread_once_t LLC_Crc32cOnce = PTHREAD_ONCE_INIT;
+#endif
+
+//------------------------------------------------------------------------------
+// Functions definitions
+//------------------------------------------------------------------------------
+
+#if defined(__SSE4_2__)
+
+/**
+ * @brief Update a (non-inverted) CRC with the SSE4.2 instructions
+ */
+static uint32_t LLC_Crc32cUpdate (uint32_t Crc,
+                                  const uint8_t *pByte,
+                                  size_t Len)
+{
+#if defined(__x86_64__)
+  uint64_t Word;
+
+  for (; Len >= 8; Len -= 8, pByte += 8)
+  {
+    memcpy(&Word, pByte, 8);
+    Crc = (uint32_t)_mm_crc32_u64(Crc, Word);
+  }
+#else
+  uint32_t Word;
+
+  for (; Len >= 4; Len -= 4, pByte += 4)
+  {
+    memcpy(&Word, pByte, 4);
+    Crc = _mm_crc32_u32(Crc, Word);
+  }
+#endif
+  for (; Len > 0; Len--)
+    Crc = _mm_crc32_u8(Crc, *pByte++);
+  return Crc;
+}
+
+#elif defined(__ARM_FEATURE_CRC32)
+
+/**
+ * @brief Update a (non-inverted) CRC with the ARMv8 CRC instructions
+ */
+static uint32_t LLC_Crc32cUpdate (uint32_t Crc,
+                                  const uint8_t *pByte,
+                                  size_t Len)
+{
+  uint64_t Word;
+
+  for (; Len >= 8; Len -= 8, pByte += 8)
+  {
+    memcpy(&Word, pByte, 8);
+    Crc = __crc32cd(Crc, Word);
+  }
+  for (; Len > 0; Len--)
+    Crc = __crc32cb(Crc, *pByte++);
+  return Crc;
+}
+
+#else
+
+/**
+ * @brief Build the slice-by-8 tables (once)
+ */
+static void LLC_Crc32cTableInit (void)
+{
+  uint32_t Crc;
+  int n, k;
+
+  for (n = 0; n < 256; n++)
+  {
+    Crc = n;
+    for (k = 0; k < 8; k++)
+      Crc = (Crc >> 1) ^ ((Crc & 1) ? LLC_CRC32C_POLY : 0);
+    LLC_Crc32cTable[0][n] = Crc;
+  }
+  for (n = 0; n < 256; n++)
+  {
+    Crc = LLC_Crc32cTable[0][n];
+    for (k = 1; k < 8; k++)
+    {
+      Crc = (Crc >> 8) ^ LLC_Crc32cTable[0][Crc & 0xFF];
+      LLC_Crc32cTable[k][n] = Crc;
+    }
+  }
+}
+
+/**
+ * @brief Update a (non-inverted) CRC eight bytes at a time
+ */
+static uint32_t LLC_Crc32cUpdate (uint32_t Crc,
+                                  const uint8_t *pByte,
+                                  size_t Len)
+{
+  const uint32_t (*pTable)[256] = LLC_Crc32cTable;
+  uint32_t Lo, Hi;
+
+  (void)pthread_once(&LLC_Crc32cOnce, LLC_Crc32cTableInit);
+
+  for (; Len >= 8; Len -= 8, pByte += 8)
+  {
+    // Byte by byte, so it is the same on either endian
+    Lo = Crc ^ (pByte[0] | (pByte[1] << 8) |
+                (pByte[2] << 16) | ((uint32_t)pByte[3] << 24));
+    Hi = pByte[4] | (pByte[5] << 8) |
+         (pByte[6] << 16) | ((uint32_t)pByte[7] << 24);
+    Crc = pTable[7][Lo & 0xFF] ^ pTable[6][(Lo >> 8) & 0xFF] ^
+          pTable[5][(Lo >> 16) & 0xFF] ^ pTable[4][Lo >> 24] ^
+          pTable[3][Hi & 0xFF] ^ pTable[2][(Hi >> 8) & 0xFF] ^
+          pTable[1][(Hi >> 16) & 0xFF] ^ pTable[0][Hi >> 24];
+  }
+  for (; Len > 0; Len--)
+    Crc = (Crc >> 8) ^ pTable[0][(Crc ^ *pByte++) & 0xFF];
+  return Crc;
+}
+
+#endif
+
+/**
+ * @brief CRC32C of a buffer
+ * @param Crc Zero, or the CRC of the preceding bytes (to continue it)
+ * @param pBuf
+ * @param Len [bytes]
+ * @return The CRC (e.g. 0xE3069283 for "123456789")
+ */
+uint32_t LLC_Crc32c (uint32_t Crc,
+                     const void *pBuf,
+                     size_t Len)
+{
+  return ~LLC_Crc32cUpdate(~Crc, (const uint8_t *)pBuf, Len);
+}
+
+/**
+ * @brief How LLC_Crc32c() is computed (for the logs)
+ */
+const char *LLC_Crc32cImpl (void)
+{
+#if defined(__SSE4_2__)
+  return "sse4.2";
+#elif defined(__ARM_FEATURE_CRC32)
+  return "armv8-crc";
+#else
+  return "slice-by-8";
+#endif
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,46 @@
+/**
+ * @addtogroup cohda_llc_intern_app LLC application
+ * @{
+ *
+ * @file
+ * LLC: CRC32C (Castagnoli) of the frames exchanged with other vehicles
+ *
+ * Uses the CRC32C instructions when the compiler targets them (e.g. with
+ * -msse4.2 on x86, or -march=armv8-a+crc on ARM), and otherwise a table
+ * driven slice-by-8 loop (built the first time it is needed).
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2015 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+#ifndef __LLC_CRC32C_H__
+#define __LLC_CRC32C_H__
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Length of a CRC32C (in a frame, least significant byte first) [bytes]
+#define LLC_CRC32C_LEN (4)
+
+//------------------------------------------------------------------------------
+// Function declarations
+//------------------------------------------------------------------------------
+
+uint32_t LLC_Crc32c (uint32_t Crc,
+                     const void *pBuf,
+                     size_t Len);
+const char *LLC_Crc32cImpl (void);
+
+#endif // __LLC_CRC32C_H__
+
+/**
+ * @}
+ */
@@ -15,6 +15,9 @@
 // Included headers
 //------------------------------------------------------------------------------
 #include <stddef.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
 #include "linux/cohda/llc/llc-api.h"
 #include "llc-lib.h"
 
@@ -36,8 +39,10 @@
 // Variables
 //------------------------------------------------------------------------------
 
-/// Local copy of lib pointer
-struct LLCDev *_pDev = NULL;
+/// List of all setup LLC devices (one per interface)
+static struct LLCDev *_pDevs = NULL;
+/// Protects _pDevs
+static pthread_mutex_t _DevsLock = PTHREAD_MUTEX_INITIALIZER;
 
 //------------------------------------------------------------------------------
 // Functions
@@ -46,20 +51,35 @@ struct LLCDev *_pDev = NULL;
 /**
  * @brief Setup the LLC device structure
  * @param pDev LLC device pointer
+ * @param pIfName Name of the MKx network interface
  * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
  */
-int LOCAL LLC_DeviceSetup (struct LLCDev *pDev)
+int LOCAL LLC_DeviceSetup (struct LLCDev *pDev,
+                           const char *pIfName)
 {
   int Res;
 
-  d_fnstart(D_DBG, NULL, "(pDev %p)\n", pDev);
+  d_fnstart(D_DBG, NULL, "(pDev %p %s)\n", pDev, pIfName);
   d_assert(pDev != NULL);
+  d_assert(pIfName != NULL);
 
   memset(pDev->Msg.TxReqs, 0, sizeof(pDev->Msg.TxReqs));
+  snprintf(pDev->If.Name, sizeof(pDev->If.Name), "%s", pIfName);
 
   // Enable MKx_Recv()
   pDev->Exit = false;
 
+  // Nothing known about the TSF yet
+  LLC_TSFSetup(pDev);
+  // No channel load history yet
+  LLC_CBRSetup(pDev);
+  // No radio config confirmed yet
+  LLC_CfgSetup(pDev);
+  // No security commands outstanding
+  LLC_SecSetup(pDev);
+  // No receive thread until MKx_RxThread()
+  LLC_ThreadSetup(pDev);
+
   // Open the 'cw-llc' network interface
   Res = LLC_InterfaceSetup(pDev);
   if (Res != 0)
@@ -70,7 +90,6 @@ int LOCAL LLC_DeviceSetup (struct LLCDev *pDev)
     goto ErrorMsg;
 
   pDev->Magic = LLC_DEV_MAGIC;
-  _pDev = pDev;
   Res = 0;
   goto Success;
 
@@ -85,6 +104,26 @@ Success:
   return Res;
 }
 
+/**
+ * @brief Close a setup LLC device (that is no longer on the device list)
+ * @param pDev LLC device pointer
+ */
+static void LLC_DeviceClose (struct LLCDev *pDev)
+{
+  if (pDev->Magic == LLC_DEV_MAGIC)
+  {
+    // The callbacks are off, so just drop anything still queued
+    LLC_ThreadStop(pDev, false);
+    LLC_MsgRelease(pDev);
+    // Close the 'cw-llc' network interface
+    LLC_InterfaceRelease(pDev);
+
+    // No longer a device (MKx_Exit() then frees it, so its handle must not be
+    // used again)
+    pDev->Magic = 0;
+  }
+}
+
 /**
  * @brief Release (cleanup) the LLC device structure
  * @param pDev LLC device pointer
@@ -93,38 +132,119 @@ Success:
 void LOCAL LLC_DeviceRelease (struct LLCDev *pDev)
 {
   int Res = LLC_STATUS_ERROR;
+  struct LLCDev **ppDev;
 
   d_fnstart(D_DBG, NULL, "(pDev %p)\n", pDev);
   d_assert(pDev != NULL);
 
   pDev->Exit = true;
 
-  if (pDev == _pDev)
+  pthread_mutex_lock(&_DevsLock);
+  for (ppDev = &_pDevs; *ppDev != NULL; ppDev = &((*ppDev)->pNext))
   {
-    LLC_MsgRelease(pDev);
-    // Close the 'cw-llc' network interface
-    LLC_InterfaceRelease(pDev);
-
-    _pDev = NULL;
+    if (*ppDev == pDev)
+      break;
   }
+  if (*ppDev == pDev)
+    *ppDev = pDev->pNext;
+  pthread_mutex_unlock(&_DevsLock);
+
+  LLC_DeviceClose(pDev);
 
   d_fnend(D_DBG, NULL, "(pDev %p) = void '%d'\n", pDev, Res);
   return;
 }
 
 /**
- * @brief Get the LLC device structure
- * @return LLC device pointer
+ * @brief Find the LLC device structure for an interface (_DevsLock held)
+ * @param pIfName Name of the MKx network interface
+ * @return LLC device pointer (NULL if the interface has not been setup)
+ */
+static struct LLCDev *LLC_DeviceFind (const char *pIfName)
+{
+  struct LLCDev *pDev;
+
+  for (pDev = _pDevs; pDev != NULL; pDev = pDev->pNext)
+  {
+    if (strncmp(pDev->If.Name, pIfName, sizeof(pDev->If.Name)) == 0)
+      break;
+  }
+  return pDev;
+}
+
+/**
+ * @brief Get the LLC device structure for an interface, setting it up (and
+ *        getting the MKx driver state) if need be
+ * @param pIfName Name of the MKx network interface
+ * @param ppDev Set to the LLC device pointer
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *
+ * The find and the setup are done under one hold of _DevsLock, so concurrent
+ * calls for an interface can't both setup a device for it. A device is only
+ * added to the list once it is fully setup.
  */
-struct LLCDev LOCAL *LLC_DeviceGet (void)
+int LOCAL LLC_DeviceGet (const char *pIfName,
+                         struct LLCDev **ppDev)
 {
-  return _pDev;
+  int Res = LLC_STATUS_SUCCESS;
+  struct LLCDev *pDev;
+
+  d_fnstart(D_DBG, NULL, "(%s)\n", pIfName);
+
+  pthread_mutex_lock(&_DevsLock);
+  pDev = LLC_DeviceFind(pIfName);
+  if (pDev != NULL)
+    goto Unlock;
+
+  pDev = calloc(1, sizeof(struct LLCDev));
+  if (pDev == NULL)
+  {
+    Res = -ENOMEM;
+    goto Unlock;
+  }
+  Res = LLC_DeviceSetup(pDev, pIfName);
+  if (Res != 0)
+    goto ErrorSetup;
+
+  // Get the MKx driver state
+  Res = MKx_Get(&(pDev->MKx));
+  if (Res != LLC_STATUS_SUCCESS)
+    goto ErrorGet;
+
+  pDev->pNext = _pDevs;
+  _pDevs = pDev;
+  goto Unlock;
+
+ErrorGet:
+  pDev->Exit = true;
+  LLC_DeviceClose(pDev);
+ErrorSetup:
+  free(pDev);
+  pDev = NULL;
+Unlock:
+  pthread_mutex_unlock(&_DevsLock);
+  *ppDev = pDev;
+  d_fnend(D_DBG, NULL, "(%s) = %d [%p]\n", pIfName, Res, pDev);
+  return Res;
+}
+
+/**
+ * @brief Set the 'Exit' flag of every LLC device (see MKx_Recv(NULL))
+ */
+void LOCAL LLC_DeviceExitAll (void)
+{
+  struct LLCDev *pDev;
+
+  pthread_mutex_lock(&_DevsLock);
+  for (pDev = _pDevs; pDev != NULL; pDev = pDev->pNext)
+    pDev->Exit = true;
+  pthread_mutex_unlock(&_DevsLock);
 }
 
 /**
  * @brief Morph the API pointer to the internal device strucuture
- * @param pMKx MKx handle
- * @return A handle to the internal device
+ * @param pMKx MKx handle (not one already passed to MKx_Exit())
+ * @return A handle to the internal device (NULL if it isn't setup)
  */
 struct LLCDev LOCAL *LLC_Device (struct MKx *pMKx)
 {
@@ -137,8 +257,7 @@ struct LLCDev LOCAL *LLC_Device (struct MKx *pMKx)
   if (pDev->Magic != LLC_DEV_MAGIC)
     pDev = NULL;
 
-  d_printf(D_DBG, NULL, "pDev %p _pDev %p\n", pDev, _pDev);
-  d_assert(pDev == _pDev);
+  d_printf(D_DBG, NULL, "pDev %p\n", pDev);
   return pDev;
 }
 
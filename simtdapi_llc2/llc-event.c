@@ -0,0 +1,497 @@
+/**
+ * @addtogroup cohda_llc_intern_app LLC application
+ * @{
+ *
+ * @file
+ * LLC: Application event loop (see llc-event.h)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2015 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "llc-event.h"
+#include "timer_queue.h"
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Most events taken from the kernel per pass
+#define LLC_EVENT_BATCH (16)
+
+/// Don't re-arm the timer_queue timerfd for a change smaller than this [us]
+#define LLC_EVENT_TQ_SLACK (1000)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions definitions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Current CLOCK_MONOTONIC time [us]
+ */
+static uint64_t LLC_EventTime (void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return (Now.tv_sec * 1000000ULL) + (Now.tv_nsec / 1000);
+}
+
+/**
+ * @brief Find the registration of a file descriptor
+ * @param pLoop
+ * @param Fd
+ * @return The registration, or NULL
+ */
+static struct LLCEvent *LLC_EventFind (tLLCEventLoop *pLoop,
+                                       int Fd)
+{
+  struct LLCEvent *pEv;
+
+  for (pEv = pLoop->pList; pEv != NULL; pEv = pEv->pNext)
+  {
+    if (pEv->Fd == Fd)
+      break;
+  }
+  return pEv;
+}
+
+/**
+ * @brief Call a handler, noting whether it has more to do
+ * @param pLoop
+ * @param pEv The registration
+ * @param Events Passed to the handler
+ */
+static void LLC_EventCall (tLLCEventLoop *pLoop,
+                           struct LLCEvent *pEv,
+                           uint32_t Events)
+{
+  int Res;
+
+  pEv->Pass = pLoop->Pass;
+  Res = pEv->Handler(pEv->Fd, Events, pEv->pPriv);
+  if (Res < 0)
+    d_printf(D_WARN, NULL, "Fd %d handler (events 0x%02x) = %d\n",
+             pEv->Fd, Events, Res);
+
+  // It may have deleted itself
+  if (pEv->Handler == NULL)
+    return;
+  if ((Res > 0) != pEv->Again)
+  {
+    pEv->Again = (Res > 0);
+    pLoop->AgainCnt += pEv->Again ? 1 : -1;
+  }
+}
+
+/**
+ * @brief Handler for the timerfds (calls the timer's handler)
+ */
+static int LLC_EventTimerEvent (int Fd,
+                                uint32_t Events,
+                                void *pPriv)
+{
+  tLLCEventTimer *pTimer = (tLLCEventTimer *)pPriv;
+  uint64_t Expiries;
+
+  if (read(Fd, &Expiries, sizeof(Expiries)) != sizeof(Expiries))
+    return (errno == EAGAIN) ? 0 : -errno;
+
+  pTimer->Expiries += Expiries;
+  if (pTimer->Handler != NULL)
+    pTimer->Handler(pTimer, pTimer->pPriv);
+  return 0;
+}
+
+/**
+ * @brief Run the expired timer_queue timers and arm the bridge timerfd for
+ *        the next one
+ * @param pLoop
+ *
+ * Called at the end of each pass, as any handler may have set a timer.
+ */
+static void LLC_EventQueue (tLLCEventLoop *pLoop)
+{
+  struct itimerspec Spec;
+  struct timeval *pRemaining;
+  uint64_t Deadline;
+  int64_t Delay;
+  int64_t Diff;
+
+  memset(&Spec, 0, sizeof(Spec));
+  pRemaining = timer_age_queue();
+  if (pRemaining == NULL)
+  {
+    if (pLoop->TQ.Armed)
+      (void)timerfd_settime(pLoop->TQ.Timer.Fd, 0, &Spec, NULL);
+    pLoop->TQ.Armed = false;
+    return;
+  }
+
+  Delay = (pRemaining->tv_sec * 1000000LL) + pRemaining->tv_usec;
+  if (Delay < 1)
+    Delay = 1;
+  Deadline = LLC_EventTime() + Delay;
+
+  // Most passes leave the earliest timer as it was
+  Diff = Deadline - pLoop->TQ.Deadline;
+  if (pLoop->TQ.Armed &&
+      (Diff < LLC_EVENT_TQ_SLACK) && (Diff > -LLC_EVENT_TQ_SLACK))
+    return;
+
+  Spec.it_value.tv_sec = Delay / 1000000;
+  Spec.it_value.tv_nsec = (Delay % 1000000) * 1000;
+  if (timerfd_settime(pLoop->TQ.Timer.Fd, 0, &Spec, NULL) < 0)
+  {
+    d_error(D_ERR, NULL, "timerfd_settime() failed: %s\n", strerror(errno));
+    pLoop->TQ.Armed = false;
+    return;
+  }
+  pLoop->TQ.Armed = true;
+  pLoop->TQ.Deadline = Deadline;
+}
+
+/**
+ * @brief Create the epoll instance (and the timer_queue bridge)
+ * @param pLoop
+ * @return Zero or a negative errno
+ */
+int LLC_EventInit (tLLCEventLoop *pLoop)
+{
+  int Res;
+
+  d_fnstart(D_TST, NULL, "(pLoop %p)\n", pLoop);
+
+  memset(pLoop, 0, sizeof(*pLoop));
+  pLoop->TQ.Timer.Fd = -1;
+  pLoop->EpollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (pLoop->EpollFd < 0)
+  {
+    Res = -errno;
+    d_error(D_ERR, NULL, "epoll_create1() failed: %s\n", strerror(errno));
+    goto Error;
+  }
+
+  // Nothing to do with the expiry itself: LLC_EventQueue() runs at pass end
+  Res = LLC_EventTimerAdd(pLoop, &(pLoop->TQ.Timer), NULL, NULL);
+  if (Res < 0)
+    goto Error;
+  LLC_EventQueue(pLoop);
+
+Error:
+  if (Res < 0)
+    LLC_EventExit(pLoop);
+  d_fnend(D_TST, NULL, "(pLoop %p) = %d\n", pLoop, Res);
+  return Res;
+}
+
+/**
+ * @brief Free the registrations and close the epoll instance
+ * @param pLoop
+ *
+ * The registered file descriptors (other than the timerfds) are left open.
+ */
+void LLC_EventExit (tLLCEventLoop *pLoop)
+{
+  struct LLCEvent *pEv;
+
+  if (pLoop->EpollFd < 0)
+    return;
+
+  while ((pEv = pLoop->pList) != NULL)
+  {
+    pLoop->pList = pEv->pNext;
+    if (pEv->Handler == LLC_EventTimerEvent)
+      close(pEv->Fd);
+    free(pEv);
+  }
+  while ((pEv = pLoop->pDead) != NULL)
+  {
+    pLoop->pDead = pEv->pNextDead;
+    free(pEv);
+  }
+  close(pLoop->EpollFd);
+  pLoop->EpollFd = -1;
+  pLoop->TQ.Timer.Fd = -1;
+}
+
+/**
+ * @brief Register a file descriptor
+ * @param pLoop
+ * @param Fd
+ * @param Events LLC_EVENT_IN and/or LLC_EVENT_OUT, optionally LLC_EVENT_EDGE
+ * @param Handler Called when any of them (or an error) occurs
+ * @param pPriv Passed to Handler
+ * @return Zero or a negative errno (-EEXIST if it is already registered)
+ */
+int LLC_EventAdd (tLLCEventLoop *pLoop,
+                  int Fd,
+                  uint32_t Events,
+                  fLLCEventHandler Handler,
+                  void *pPriv)
+{
+  int Res = -EINVAL;
+  struct LLCEvent *pEv = NULL;
+  struct epoll_event Ev;
+
+  d_fnstart(D_TST, NULL, "(Fd %d Events 0x%02x)\n", Fd, Events);
+
+  if ((Fd < 0) || (Handler == NULL))
+    goto Error;
+  if (LLC_EventFind(pLoop, Fd) != NULL)
+  {
+    Res = -EEXIST;
+    goto Error;
+  }
+
+  pEv = calloc(1, sizeof(*pEv));
+  if (pEv == NULL)
+  {
+    Res = -ENOMEM;
+    goto Error;
+  }
+  pEv->Fd = Fd;
+  pEv->Events = Events;
+  pEv->Handler = Handler;
+  pEv->pPriv = pPriv;
+  pEv->Pass = pLoop->Pass;
+
+  memset(&Ev, 0, sizeof(Ev));
+  Ev.events = Events;
+  Ev.data.ptr = pEv;
+  if (epoll_ctl(pLoop->EpollFd, EPOLL_CTL_ADD, Fd, &Ev) < 0)
+  {
+    Res = -errno;
+    d_error(D_ERR, NULL, "epoll_ctl(ADD, %d) failed: %s\n", Fd, strerror(errno));
+    free(pEv);
+    goto Error;
+  }
+
+  pEv->pNext = pLoop->pList;
+  pLoop->pList = pEv;
+  Res = 0;
+
+Error:
+  d_fnend(D_TST, NULL, "(Fd %d Events 0x%02x) = %d\n", Fd, Events, Res);
+  return Res;
+}
+
+/**
+ * @brief Change the events waited for on a registered file descriptor
+ * @param pLoop
+ * @param Fd
+ * @param Events See LLC_EventAdd()
+ * @return Zero or a negative errno (-ENOENT if it isn't registered)
+ */
+int LLC_EventMod (tLLCEventLoop *pLoop,
+                  int Fd,
+                  uint32_t Events)
+{
+  struct LLCEvent *pEv;
+  struct epoll_event Ev;
+
+  pEv = LLC_EventFind(pLoop, Fd);
+  if (pEv == NULL)
+    return -ENOENT;
+
+  memset(&Ev, 0, sizeof(Ev));
+  Ev.events = Events;
+  Ev.data.ptr = pEv;
+  if (epoll_ctl(pLoop->EpollFd, EPOLL_CTL_MOD, Fd, &Ev) < 0)
+    return -errno;
+  pEv->Events = Events;
+  return 0;
+}
+
+/**
+ * @brief Unregister a file descriptor (before it is closed)
+ * @param pLoop
+ * @param Fd
+ * @return Zero or -ENOENT if it isn't registered
+ *
+ * May be called from any handler (including its own): the registration is
+ * only freed once the events already taken from the kernel are dispatched.
+ */
+int LLC_EventDel (tLLCEventLoop *pLoop,
+                  int Fd)
+{
+  struct LLCEvent **ppEv;
+  struct LLCEvent *pEv;
+
+  for (ppEv = &(pLoop->pList); *ppEv != NULL; ppEv = &((*ppEv)->pNext))
+  {
+    if ((*ppEv)->Fd == Fd)
+      break;
+  }
+  pEv = *ppEv;
+  if (pEv == NULL)
+    return -ENOENT;
+
+  (void)epoll_ctl(pLoop->EpollFd, EPOLL_CTL_DEL, Fd, NULL);
+  // Unlinked, but pNext is left for a walk of the list that is on it
+  *ppEv = pEv->pNext;
+  if (pEv->Again)
+    pLoop->AgainCnt--;
+  pEv->Again = false;
+  pEv->Handler = NULL;
+  pEv->pNextDead = pLoop->pDead;
+  pLoop->pDead = pEv;
+  return 0;
+}
+
+/**
+ * @brief Create and register a timer (initially disarmed)
+ * @param pLoop
+ * @param pTimer The timer (must stay valid until LLC_EventTimerDel())
+ * @param Handler Called on expiry
+ * @param pPriv Passed to Handler
+ * @return Zero or a negative errno
+ */
+int LLC_EventTimerAdd (tLLCEventLoop *pLoop,
+                       tLLCEventTimer *pTimer,
+                       fLLCEventTimerHandler Handler,
+                       void *pPriv)
+{
+  int Res;
+
+  memset(pTimer, 0, sizeof(*pTimer));
+  pTimer->Handler = Handler;
+  pTimer->pPriv = pPriv;
+  pTimer->Fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (pTimer->Fd < 0)
+  {
+    Res = -errno;
+    d_error(D_ERR, NULL, "timerfd_create() failed: %s\n", strerror(errno));
+    return Res;
+  }
+
+  Res = LLC_EventAdd(pLoop, pTimer->Fd, LLC_EVENT_IN, LLC_EventTimerEvent,
+                     pTimer);
+  if (Res < 0)
+  {
+    close(pTimer->Fd);
+    pTimer->Fd = -1;
+  }
+  return Res;
+}
+
+/**
+ * @brief Arm (or disarm) a timer
+ * @param pTimer
+ * @param Delay Until the first expiry (zero to disarm) [ms]
+ * @param Period Between later expiries (zero for a one-shot) [ms]
+ * @return Zero or a negative errno
+ */
+int LLC_EventTimerSet (tLLCEventTimer *pTimer,
+                       uint32_t Delay,
+                       uint32_t Period)
+{
+  struct itimerspec Spec;
+
+  Spec.it_value.tv_sec = Delay / 1000;
+  Spec.it_value.tv_nsec = (Delay % 1000) * 1000000;
+  Spec.it_interval.tv_sec = Period / 1000;
+  Spec.it_interval.tv_nsec = (Period % 1000) * 1000000;
+  if (timerfd_settime(pTimer->Fd, 0, &Spec, NULL) < 0)
+    return -errno;
+  return 0;
+}
+
+/**
+ * @brief Unregister and close a timer
+ * @param pLoop
+ * @param pTimer
+ * @return Zero or a negative errno
+ */
+int LLC_EventTimerDel (tLLCEventLoop *pLoop,
+                       tLLCEventTimer *pTimer)
+{
+  int Res;
+
+  if (pTimer->Fd < 0)
+    return -EINVAL;
+  Res = LLC_EventDel(pLoop, pTimer->Fd);
+  close(pTimer->Fd);
+  pTimer->Fd = -1;
+  return Res;
+}
+
+/**
+ * @brief Wait for and dispatch one batch of events
+ * @param pLoop
+ * @param Timeout Longest wait (-1 for no limit) [ms]
+ * @return The number of events dispatched, or a negative errno (-EINTR if a
+ *         signal arrived)
+ *
+ * Doesn't wait at all while a handler has more to do.
+ */
+int LLC_EventRun (tLLCEventLoop *pLoop,
+                  int Timeout)
+{
+  struct epoll_event Events[LLC_EVENT_BATCH];
+  struct LLCEvent *pEv;
+  int Cnt;
+  int i;
+
+  if (pLoop->AgainCnt > 0)
+    Timeout = 0;
+  Cnt = epoll_wait(pLoop->EpollFd, Events, LLC_EVENT_BATCH, Timeout);
+  if (Cnt < 0)
+    return -errno;
+  pLoop->Pass++;
+
+  for (i = 0; i < Cnt; i++)
+  {
+    pEv = (struct LLCEvent *)Events[i].data.ptr;
+    // Deleted by an earlier handler in this batch
+    if (pEv->Handler == NULL)
+      continue;
+    LLC_EventCall(pLoop, pEv, Events[i].events);
+  }
+
+  // Handlers with more to do that had no event of their own this pass
+  if (pLoop->AgainCnt > 0)
+  {
+    for (pEv = pLoop->pList; pEv != NULL; pEv = pEv->pNext)
+    {
+      if (pEv->Again && (pEv->Pass != pLoop->Pass))
+        LLC_EventCall(pLoop, pEv, 0);
+    }
+  }
+
+  LLC_EventQueue(pLoop);
+
+  while ((pEv = pLoop->pDead) != NULL)
+  {
+    pLoop->pDead = pEv->pNextDead;
+    free(pEv);
+  }
+  return Cnt;
+}
+
+/**
+ * @}
+ */
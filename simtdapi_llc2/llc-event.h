@@ -0,0 +1,163 @@
+/**
+ * @addtogroup cohda_llc_intern_app LLC application
+ * @{
+ *
+ * @file
+ * LLC: Application event loop (epoll based, with timerfd timers)
+ *
+ * Each component registers its file descriptors (with a handler) and timers
+ * with the loop, so adding one doesn't change the main loop. The timer_queue
+ * timers (TimerTask.c) are driven from a timerfd armed for the earliest of
+ * them, so the loop only wakes up when there is something to do.
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2015 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+#ifndef __LLC_EVENT_H__
+#define __LLC_EVENT_H__
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Wait for input
+#define LLC_EVENT_IN    (EPOLLIN | EPOLLPRI)
+/// Wait for room to write
+#define LLC_EVENT_OUT   (EPOLLOUT)
+/// Error or hang up (always reported)
+#define LLC_EVENT_ERROR (EPOLLERR | EPOLLHUP)
+/// Edge triggered (the handler must read until EAGAIN)
+#define LLC_EVENT_EDGE  (EPOLLET)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief File descriptor handler
+ * @param Fd The file descriptor
+ * @param Events The LLC_EVENT_* that occurred (zero if called again, see
+ *        below)
+ * @param pPriv As registered
+ * @return Zero, a negative errno (logged), or greater than zero if there is
+ *         more to do: it is then called again on the next pass without waiting
+ *         for the file descriptor (e.g. when a receive budget runs out)
+ */
+typedef int (*fLLCEventHandler) (int Fd,
+                                 uint32_t Events,
+                                 void *pPriv);
+
+struct LLCEventTimer;
+
+/**
+ * @brief Timer handler
+ * @param pTimer The timer that expired
+ * @param pPriv As registered
+ */
+typedef void (*fLLCEventTimerHandler) (struct LLCEventTimer *pTimer,
+                                       void *pPriv);
+
+/// A registered file descriptor
+struct LLCEvent
+{
+  /// Next registration
+  struct LLCEvent *pNext;
+  /// Next registration waiting to be freed (see LLC_EventDel())
+  struct LLCEvent *pNextDead;
+  /// File descriptor
+  int Fd;
+  /// LLC_EVENT_* waited for
+  uint32_t Events;
+  /// Handler (NULL once deleted)
+  fLLCEventHandler Handler;
+  /// Passed to the handler
+  void *pPriv;
+  /// The handler has more to do
+  bool Again;
+  /// Pass in which the handler was last called
+  uint32_t Pass;
+};
+
+/// A timer (backed by a timerfd)
+typedef struct LLCEventTimer
+{
+  /// The timerfd
+  int Fd;
+  /// Handler
+  fLLCEventTimerHandler Handler;
+  /// Passed to the handler
+  void *pPriv;
+  /// Number of expiries (more than the handler calls if it fell behind)
+  uint64_t Expiries;
+} tLLCEventTimer;
+
+/// Event loop state
+typedef struct LLCEventLoop
+{
+  /// epoll instance (-1 if not initialised)
+  int EpollFd;
+  /// Registered file descriptors
+  struct LLCEvent *pList;
+  /// Deleted registrations, freed at the end of the pass
+  struct LLCEvent *pDead;
+  /// Number of handlers with more to do
+  int AgainCnt;
+  /// Pass counter
+  uint32_t Pass;
+  /// timer_queue bridge
+  struct
+  {
+    /// Armed for the earliest timer_queue timer
+    tLLCEventTimer Timer;
+    /// Armed
+    bool Armed;
+    /// When it is armed for (CLOCK_MONOTONIC) [us]
+    uint64_t Deadline;
+  } TQ;
+} tLLCEventLoop;
+
+//------------------------------------------------------------------------------
+// Function declarations
+//------------------------------------------------------------------------------
+
+int LLC_EventInit (tLLCEventLoop *pLoop);
+void LLC_EventExit (tLLCEventLoop *pLoop);
+
+int LLC_EventAdd (tLLCEventLoop *pLoop,
+                  int Fd,
+                  uint32_t Events,
+                  fLLCEventHandler Handler,
+                  void *pPriv);
+int LLC_EventMod (tLLCEventLoop *pLoop,
+                  int Fd,
+                  uint32_t Events);
+int LLC_EventDel (tLLCEventLoop *pLoop,
+                  int Fd);
+
+int LLC_EventTimerAdd (tLLCEventLoop *pLoop,
+                       tLLCEventTimer *pTimer,
+                       fLLCEventTimerHandler Handler,
+                       void *pPriv);
+int LLC_EventTimerSet (tLLCEventTimer *pTimer,
+                       uint32_t Delay,
+                       uint32_t Period);
+int LLC_EventTimerDel (tLLCEventLoop *pLoop,
+                       tLLCEventTimer *pTimer);
+
+int LLC_EventRun (tLLCEventLoop *pLoop,
+                  int Timeout);
+
+#endif // __LLC_EVENT_H__
+
+/**
+ * @}
+ */
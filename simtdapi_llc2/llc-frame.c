@@ -0,0 +1,208 @@
+/**
+ * @addtogroup cohda_llc_intern_app LLC application
+ * @{
+ *
+ * @file
+ * LLC: Incremental parser for the '0x29 0x29' frames (see llc-frame.h)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2015 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <string.h>
+#include <errno.h>
+
+#include "llc-frame.h"
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+/// How a candidate frame looks
+typedef enum LLCFrameState
+{
+  /// Valid
+  LLC_FRAME_VALID = 0,
+  /// Not all there yet
+  LLC_FRAME_PARTIAL,
+  /// Not a frame
+  LLC_FRAME_INVALID,
+  /// Right length, but a bad check or end byte
+  LLC_FRAME_BAD,
+} eLLCFrameState;
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions definitions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Look at the candidate frame at the start of a buffer
+ * @param pBuf Starts with the two LLC_FRAME_SYNC bytes
+ * @param Len Bytes available
+ * @param pFrameLen Set to the frame length (if it is valid)
+ * @return How it looks
+ */
+static eLLCFrameState LLC_FrameState (const uint8_t *pBuf,
+                                      int Len,
+                                      int *pFrameLen)
+{
+  uint8_t Check = 0;
+  int FrameLen;
+  int i;
+
+  if (Len < LLC_FRAME_HDR_LEN)
+    return LLC_FRAME_PARTIAL;
+  // Length covers the data, check and end bytes
+  FrameLen = LLC_FRAME_HDR_LEN + (pBuf[8] | (pBuf[9] << 8));
+  if ((FrameLen < LLC_FRAME_HDR_LEN + 2) || (FrameLen > LLC_FRAME_MAX))
+    return LLC_FRAME_INVALID;
+  if (Len < FrameLen)
+    return LLC_FRAME_PARTIAL;
+
+  for (i = 0; i < FrameLen - 1; i++)
+    Check ^= pBuf[i];
+  if ((Check != 0) || (pBuf[FrameLen - 1] != LLC_FRAME_END))
+    return LLC_FRAME_BAD;
+
+  *pFrameLen = FrameLen;
+  return LLC_FRAME_VALID;
+}
+
+/**
+ * @brief Forget any partial frame (e.g. for a new connection)
+ * @param pParser
+ */
+void LLC_FrameReset (tLLCFrameParser *pParser)
+{
+  memset(pParser, 0, sizeof(*pParser));
+}
+
+/**
+ * @brief Check whether a buffer starts with a complete, valid frame
+ * @param pBuf
+ * @param Len
+ * @return The frame's length, or zero
+ */
+int LLC_FrameCheck (const uint8_t *pBuf,
+                    int Len)
+{
+  int FrameLen = 0;
+
+  if ((Len < 2) || (pBuf[0] != LLC_FRAME_SYNC) || (pBuf[1] != LLC_FRAME_SYNC))
+    return 0;
+  if (LLC_FrameState(pBuf, Len, &FrameLen) != LLC_FRAME_VALID)
+    return 0;
+  return FrameLen;
+}
+
+/**
+ * @brief Parse the bytes of one read
+ * @param pParser The stream's parser
+ * @param pData The bytes read
+ * @param Len Number of bytes read (at most LLC_FRAME_MAX)
+ * @param Handler Called with each complete frame
+ * @param pPriv Passed to Handler
+ * @return The number of frames passed to Handler, or -EINVAL
+ *
+ * Until a stream has carried a frame, a read that doesn't start with one is
+ * passed on whole as a 'legacy' write (older clients send one message per
+ * write, without the length or check).
+ * Handler may LLC_FrameReset() the parser (e.g. when closing the stream), in
+ * which case the rest of the read is discarded.
+ */
+int LLC_FrameFeed (tLLCFrameParser *pParser,
+                   const uint8_t *pData,
+                   int Len,
+                   fLLCFrameHandler Handler,
+                   void *pPriv)
+{
+  eLLCFrameState State;
+  uint8_t *pSync;
+  int FrameLen = 0;
+  int Cnt = 0;
+  int Pos = 0;
+
+  if ((Len < 0) || (Len > LLC_FRAME_MAX))
+    return -EINVAL;
+
+  if (!pParser->Framed)
+  {
+    if (LLC_FrameCheck(pData, Len) == 0)
+    {
+      Handler((uint8_t *)pData, Len, true, pPriv);
+      return 1;
+    }
+    pParser->Framed = true;
+  }
+
+  // At most a partial frame (under LLC_FRAME_MAX) is kept, so this fits
+  memcpy(pParser->Buf + pParser->Len, pData, Len);
+  pParser->Len += Len;
+
+  while ((pParser->Len - Pos) >= 2)
+  {
+    // Resynchronise on the start bytes
+    pSync = memchr(pParser->Buf + Pos, LLC_FRAME_SYNC, pParser->Len - Pos);
+    if (pSync == NULL)
+    {
+      pParser->Stats.Skipped += pParser->Len - Pos;
+      Pos = pParser->Len;
+      break;
+    }
+    pParser->Stats.Skipped += (pSync - pParser->Buf) - Pos;
+    Pos = pSync - pParser->Buf;
+    if ((pParser->Len - Pos) < 2)
+      break;
+    if (pParser->Buf[Pos + 1] != LLC_FRAME_SYNC)
+    {
+      pParser->Stats.Skipped++;
+      Pos++;
+      continue;
+    }
+
+    State = LLC_FrameState(pParser->Buf + Pos, pParser->Len - Pos, &FrameLen);
+    if (State == LLC_FRAME_PARTIAL)
+      break;
+    if (State != LLC_FRAME_VALID)
+    {
+      if (State == LLC_FRAME_BAD)
+        pParser->Stats.Bad++;
+      // The next frame may start within this one
+      pParser->Stats.Skipped++;
+      Pos++;
+      continue;
+    }
+
+    Handler(pParser->Buf + Pos, FrameLen, false, pPriv);
+    // The handler closed the stream (and reset the parser)
+    if (pParser->Len == 0)
+      return Cnt + 1;
+    pParser->Stats.Frames++;
+    Cnt++;
+    Pos += FrameLen;
+  }
+
+  // Keep the partial frame (or lone start byte) for the next read
+  pParser->Len -= Pos;
+  if (pParser->Len > 0)
+    memmove(pParser->Buf, pParser->Buf + Pos, pParser->Len);
+  return Cnt;
+}
+
+/**
+ * @}
+ */
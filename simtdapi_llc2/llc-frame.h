@@ -0,0 +1,99 @@
+/**
+ * @addtogroup cohda_llc_intern_app LLC application
+ * @{
+ *
+ * @file
+ * LLC: Incremental parser for the '0x29 0x29' frames on a byte stream
+ *
+ * A frame (as built by packetmessage()) is
+ * @verbatim
+    0x29 0x29 Protocol Seq[4] Hop Length[2] Data[Length - 2] Check 0x0d
+   @endverbatim
+ * with Seq and Length little endian, and Check making the XOR of everything
+ * up to and including it zero. Bytes are fed in as they are read: each
+ * complete, valid frame is passed on, a partial one is kept for the next
+ * read, and anything else is skipped until the next '0x29 0x29'. (A false
+ * '0x29 0x29' in the skipped bytes can hold the frames behind it back until
+ * as many bytes as its length field claims have arrived, but not lose them.)
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2015 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+#ifndef __LLC_FRAME_H__
+#define __LLC_FRAME_H__
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Frame start bytes
+#define LLC_FRAME_SYNC    (0x29)
+/// Frame end byte
+#define LLC_FRAME_END     (0x0d)
+/// Bytes before the data
+#define LLC_FRAME_HDR_LEN (10)
+/// Longest frame [bytes]
+#define LLC_FRAME_MAX     (2048)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Called with each frame found
+ * @param pFrame The frame (LLC_FRAME_SYNC to LLC_FRAME_END)
+ * @param Len Its length [bytes]
+ * @param Legacy It is a whole read that isn't a frame (see LLC_FrameFeed())
+ * @param pPriv As passed to LLC_FrameFeed()
+ */
+typedef void (*fLLCFrameHandler) (uint8_t *pFrame,
+                                  int Len,
+                                  bool Legacy,
+                                  void *pPriv);
+
+/// Parser state (one per stream)
+typedef struct LLCFrameParser
+{
+  /// The stream has carried a frame (so is no longer read as legacy writes)
+  bool Framed;
+  /// Bytes kept from earlier reads
+  int Len;
+  uint8_t Buf[2 * LLC_FRAME_MAX];
+  /// Counters
+  struct
+  {
+    /// Frames passed on
+    uint32_t Frames;
+    /// Bytes skipped looking for a frame
+    uint32_t Skipped;
+    /// Candidate frames with a bad check or end byte
+    uint32_t Bad;
+  } Stats;
+} tLLCFrameParser;
+
+//------------------------------------------------------------------------------
+// Function declarations
+//------------------------------------------------------------------------------
+
+void LLC_FrameReset (tLLCFrameParser *pParser);
+int LLC_FrameCheck (const uint8_t *pBuf,
+                    int Len);
+int LLC_FrameFeed (tLLCFrameParser *pParser,
+                   const uint8_t *pData,
+                   int Len,
+                   fLLCFrameHandler Handler,
+                   void *pPriv);
+
+#endif // __LLC_FRAME_H__
+
+/**
+ * @}
+ */
@@ -0,0 +1,290 @@
+/**
+ * @addtogroup cohda_llc_intern_lib LLC API library
+ * @{
+ *
+ * @file
+ * LLC: 'cw-llc' raw interface transport (libpcap)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2013 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "linux/cohda/llc/llc-api.h"
+#include "llc-lib.h"
+
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions definitions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Make LLC_PcapRecv() return -EAGAIN at once when there is nothing to
+ *        receive (rather than after the pcap read timeout)
+ * @param pDev
+ * @return zero on success, otherwise a negative errno
+ */
+static int LLC_PcapNonBlock (struct LLCDev *pDev)
+{
+  int Res = 0;
+  char ErrorString[PCAP_ERRBUF_SIZE];
+
+  if (pcap_setnonblock(pDev->If.pCap, 1, ErrorString) < 0)
+  {
+    d_error(D_WARN, NULL, "pcap_setnonblock(%s) failed, %s\n",
+            pDev->If.Name, ErrorString);
+    Res = -EIO;
+  }
+  return Res;
+}
+
+/**
+ * @brief Open the raw interface with libpcap
+ * @param pDev
+ * @return zero on success, otherwise a negative errno
+ */
+static int LLC_PcapSetup (struct LLCDev *pDev)
+{
+  int Res = -ENOSYS;
+  char *pInputFileName = NULL;
+  char *pInputInterfaceName = pDev->If.Name;
+  char ErrorString[PCAP_ERRBUF_SIZE];
+
+  d_fnstart(D_TST, NULL, "()\n");
+  d_assert(pDev != NULL);
+
+  // Open the capture file or interface
+  if (pInputFileName != NULL)
+  {
+    pDev->If.pCap = pcap_open_offline(pInputFileName, ErrorString);
+    if (pDev->If.pCap == NULL)
+    {
+      d_error(D_ERR, NULL, "Open failed on '%s', %s\n",
+              pInputFileName, ErrorString);
+      Res = -EINVAL;
+      goto Error;
+    }
+  }
+  // OR: Open live pcap interface
+  else if (pInputInterfaceName != NULL)
+  {
+    // PCAP: Max packet length
+    int SnapLength = (1024 * 4); // 4kB
+    // PCAP: promiscious mode?
+    int Promisc = 1;
+    // PCAP: pcap read time-out [ms]
+#ifdef BOARD_QNX
+    int ReadTimeout = 1;
+#else
+    int ReadTimeout = 1;
+#endif
+
+    pDev->If.pCap = pcap_open_live(pInputInterfaceName,
+                                   SnapLength,
+                                   Promisc,
+                                   ReadTimeout,
+                                   ErrorString);
+#if defined(__QNX__)
+    if (pDev->If.pCap == NULL)
+    {
+      // try again using a different SOCK prefix to get the correct io-pkt instance
+      setenv("SOCK", "/llc", 0);
+      pDev->If.pCap = pcap_open_live(pInputInterfaceName,
+                                     SnapLength,
+                                     Promisc,
+                                     ReadTimeout,
+                                     ErrorString);
+    }
+#endif
+    if (pDev->If.pCap == NULL)
+    {
+      d_error(D_ERR, NULL, "Open failed on %s, %s\n",
+              pInputInterfaceName, ErrorString);
+      Res = -EINVAL;
+      goto Error;
+    }
+
+    #if defined(__QNX__)
+    // Set 'immediate' mode (no delay before returning Rx packets)
+    {
+      unsigned int Immediate = 1;
+      Res =  ioctl(pcap_fileno(pDev->If.pCap), BIOCIMMEDIATE, &Immediate);
+      if (Res != 0)
+      {
+        d_printf(D_WARN, NULL, "Cannot enable immediate mode %d %s\n",
+                 Res, strerror(errno));
+      }
+    }
+    #endif // __QNX__
+
+    // Set the socket Rx buffer size
+    {
+      // ... Requires some inside knowledge of pcap_t (from pcap-int.h)
+      int BufLen = 256*1024; // 256 KB Rx buffer
+      setsockopt(pcap_fileno(pDev->If.pCap), SOL_SOCKET, SO_RCVBUF,
+                 (char *)&BufLen, sizeof(BufLen));
+    }
+
+    // Check that the linktype is appropriate - i.e. RAW mode
+    {
+      int LinkType = pcap_datalink(pDev->If.pCap);
+      d_printf(D_INFO, NULL, "PCAP LinkType is: %d\n", LinkType);
+
+      ; // Nothing yet
+    }
+
+    pDev->If.Fd = pcap_fileno(pDev->If.pCap);
+    Res = 0;
+  } // else if (pInputInterfaceName)
+
+Error:
+  d_fnend(D_TST, NULL, "() = %d\n", Res);
+  return Res;
+}
+
+/**
+ * @brief Close the libpcap handle
+ * @param pDev
+ */
+static void LLC_PcapRelease (struct LLCDev *pDev)
+{
+  if (pDev->If.pCap == NULL)
+    return;
+
+  pcap_close(pDev->If.pCap);
+  pDev->If.pCap = NULL;
+  pDev->If.Fd = -1;
+}
+
+/**
+ * @brief Send a message over the raw interface using libpcap
+ * @param pDev
+ * @param pBuf
+ * @param Len
+ * @return The number of bytes sent, or -1
+ */
+static int LLC_PcapSend (struct LLCDev *pDev,
+                         char *pBuf,
+                         int Len)
+{
+  int Cnt;
+  #if defined(__QNX__)
+  // QNX BPF over LLC intefaces seems to assume a header to be reserved.(radiotap or something?)
+  // Bytes 13,14 is used as a 16bits payload length which overlaps with LLC's IfMsg.Radio
+  // Bytes 3,4 is modified(not sure the usage,it is static)
+  // Bytes 5,6 seems to be sequence number.
+  // Data beyound 12 seems not touched by pcap.
+  const int OrigLen = Len;
+
+  // The hack to add 14 more byte at the head to be trashed by pcap
+  // Since pcap_inject is a sink only, it should be safe to do following dirty hack.
+  // The 14 bytes extra head will be dropped in llc driver.
+  pBuf -= 14;
+  Len += 14;
+  #endif
+
+  Cnt = pcap_inject(pDev->If.pCap, pBuf, Len);
+  if (Cnt < 0)
+  {
+    d_error(D_WARN, NULL, "pcap_inject(%p, %p, %d) = %s\n",
+            pDev->If.pCap, pBuf, Len,
+            pcap_geterr(pDev->If.pCap));
+    Cnt = -1;
+  }
+  #if defined(__QNX__)
+  // make sure we return the number of bytes which the caller expected
+  if (Cnt > OrigLen)
+    Cnt = OrigLen;
+  #endif
+  return Cnt;
+}
+
+/**
+ * @brief Get the next packet from libpcap
+ * @param pDev
+ * @param ppBuf Set to the packet (valid until the next call)
+ * @param pLen Set to the packet length
+ * @return zero on success, -EAGAIN on the read timeout, otherwise a negative
+ *         errno
+ */
+static int LLC_PcapRecv (struct LLCDev *pDev,
+                         char **ppBuf,
+                         int *pLen)
+{
+  int Res = -ENOSYS;
+  struct pcap_pkthdr *pPcapHdr; // The header that pcap gives us
+  char *pPcapPkt;      // The actual packet
+
+  // Grab a packet from the device
+  Res = pcap_next_ex(pDev->If.pCap,
+                     &pPcapHdr,
+                     (const uint8_t **)&pPcapPkt);
+  d_printf(D_DBG, NULL, "pcap_next_ex() = %d\n", Res);
+  switch (Res)
+  {
+    case 1: // Read success
+      d_printf(D_DBG, NULL, "Received a packet\n");
+      *pLen = pPcapHdr->caplen;
+      *ppBuf = pPcapPkt;
+      Res = 0;
+      break;
+
+    case 0: // Read timeout (or nothing to read in non-blocking mode)
+      d_printf(D_DBG, NULL, "read timeout\n");
+      *pLen = 0;
+      *ppBuf = NULL;
+      Res = -EAGAIN;
+      break;
+
+    case -1: // Error
+    case -2: // EOF
+    default:
+      d_printf(D_ERR, NULL, "pcap_next_ex() = %s\n",
+               pcap_geterr(pDev->If.pCap));
+      Res = -ENODEV;
+      break;
+  }
+  return Res;
+}
+
+/// libpcap (the fallback, and the only transport on QNX)
+const tLLCTransport LLC_TransportPcap =
+{
+  .pName = "pcap",
+  .NoDriver = false,
+  .Setup = LLC_PcapSetup,
+  .Release = LLC_PcapRelease,
+  .Send = LLC_PcapSend,
+  .SendBatch = NULL,
+  .Recv = LLC_PcapRecv,
+  .NonBlock = LLC_PcapNonBlock,
+  .RxHold = NULL,
+  .RxRelease = NULL,
+};
+
+/**
+ * @}
+ */
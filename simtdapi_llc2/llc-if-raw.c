@@ -0,0 +1,309 @@
+/**
+ * @addtogroup cohda_llc_intern_lib LLC API library
+ * @{
+ *
+ * @file
+ * LLC: 'cw-llc' raw interface transport (AF_PACKET socket, recvmmsg/sendmmsg)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2013 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#if !defined(__QNX__) // Linux only
+#define _GNU_SOURCE // recvmmsg(), sendmmsg()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+
+#include "linux/cohda/llc/llc-api.h"
+#include "llc-lib.h"
+
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Most frames taken with one recvmmsg()
+#define LLC_RAW_BATCH (32)
+/// Largest frame received (matches the libpcap 4kB snaplen)
+#define LLC_RAW_FRAME_SIZE (4 * 1024)
+/// Socket receive buffer size (as for libpcap)
+#define LLC_RAW_RCVBUF (256 * 1024)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+/// Batch receive state
+typedef struct LLCRaw
+{
+  /// Number of frames taken by the last recvmmsg()
+  unsigned int Cnt;
+  /// Next of those frames to return
+  unsigned int Next;
+  /// recvmmsg() headers, buffer descriptors and source addresses
+  struct mmsghdr Msgs[LLC_RAW_BATCH];
+  struct iovec Iovs[LLC_RAW_BATCH];
+  struct sockaddr_ll Addrs[LLC_RAW_BATCH];
+  /// Frame storage
+  uint8_t Bufs[LLC_RAW_BATCH][LLC_RAW_FRAME_SIZE];
+} tLLCRaw;
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions definitions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Bind a raw AF_PACKET socket to a netdev (in promiscuous mode)
+ * @param Fd AF_PACKET socket
+ * @param pIfName Network interface name
+ * @return zero on success, otherwise a negative errno
+ */
+int LOCAL LLC_RawBind (int Fd,
+                       const char *pIfName)
+{
+  struct sockaddr_ll Addr;
+  struct packet_mreq Mreq;
+  int IfIndex;
+
+  IfIndex = if_nametoindex(pIfName);
+  if (IfIndex == 0)
+    return -ENODEV;
+
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sll_family = AF_PACKET;
+  Addr.sll_protocol = htons(ETH_P_ALL);
+  Addr.sll_ifindex = IfIndex;
+  if (bind(Fd, (struct sockaddr *)&Addr, sizeof(Addr)) < 0)
+    return -errno;
+
+  // Same behaviour as the libpcap backend (which opens in promiscuous mode)
+  memset(&Mreq, 0, sizeof(Mreq));
+  Mreq.mr_ifindex = IfIndex;
+  Mreq.mr_type = PACKET_MR_PROMISC;
+  if (setsockopt(Fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP,
+                 &Mreq, sizeof(Mreq)) < 0)
+    d_printf(D_WARN, NULL, "Cannot enable promiscuous mode %s\n",
+             strerror(errno));
+  return 0;
+}
+
+/**
+ * @brief Send a message on the raw AF_PACKET socket (bound to the netdev)
+ * @param pDev
+ * @param pBuf
+ * @param Len
+ * @return The number of bytes sent, or -1
+ */
+int LOCAL LLC_RawSend (struct LLCDev *pDev,
+                       char *pBuf,
+                       int Len)
+{
+  int Cnt;
+
+  Cnt = send(pDev->If.Fd, pBuf, Len, 0);
+  if (Cnt < 0)
+    d_error(D_WARN, NULL, "send(%d, %p, %d) = %s\n",
+            pDev->If.Fd, pBuf, Len, strerror(errno));
+  return Cnt;
+}
+
+/**
+ * @brief Send several messages with one sendmmsg() on the raw AF_PACKET socket
+ * @param pDev
+ * @param ppBuf Array of Cnt buffers
+ * @param pLen Array of Cnt buffer lengths
+ * @param pRes Set to the number of bytes sent, or a negative errno, for each
+ * @param Cnt Number of buffers (at most LLC_TX_BATCH_MAX)
+ * @return The number of buffers that were sent
+ */
+int LOCAL LLC_RawSendBatch (struct LLCDev *pDev,
+                            char **ppBuf,
+                            const int *pLen,
+                            int *pRes,
+                            int Cnt)
+{
+  struct mmsghdr Msgs[LLC_TX_BATCH_MAX];
+  struct iovec Iovs[LLC_TX_BATCH_MAX];
+  int Sent = 0;
+  int i;
+
+  memset(Msgs, 0, sizeof(Msgs));
+  for (i = 0; i < Cnt; i++)
+  {
+    Iovs[i].iov_base = ppBuf[i];
+    Iovs[i].iov_len = pLen[i];
+    Msgs[i].msg_hdr.msg_iov = &(Iovs[i]);
+    Msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  i = 0;
+  while (i < Cnt)
+  {
+    int Res = sendmmsg(pDev->If.Fd, &(Msgs[i]), Cnt - i, 0);
+    if (Res < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      // sendmmsg() stops at the first failure: skip over it and carry on
+      pRes[i] = -errno;
+      d_error(D_WARN, NULL, "sendmmsg(%d, %p, %d) = %s\n",
+              pDev->If.Fd, ppBuf[i], pLen[i], strerror(errno));
+      i++;
+      continue;
+    }
+    for (; Res > 0; Res--, i++)
+    {
+      pRes[i] = Msgs[i].msg_len;
+      Sent++;
+    }
+  }
+  return Sent;
+}
+
+/**
+ * @brief Close the raw AF_PACKET socket
+ * @param pDev
+ */
+static void LLC_RawRelease (struct LLCDev *pDev)
+{
+  if (pDev->If.Fd >= 0)
+    close(pDev->If.Fd);
+  pDev->If.Fd = -1;
+  free(pDev->If.pRaw);
+  pDev->If.pRaw = NULL;
+}
+
+/**
+ * @brief Open a raw AF_PACKET socket on the netdev
+ * @param pDev
+ * @return zero on success, otherwise a negative errno
+ */
+static int LLC_RawSetup (struct LLCDev *pDev)
+{
+  int Res = -ENOSYS;
+  int BufLen = LLC_RAW_RCVBUF;
+  tLLCRaw *pRaw;
+  int i;
+
+  d_fnstart(D_TST, NULL, "(%s)\n", pDev->If.Name);
+
+  pDev->If.pRaw = NULL;
+  pDev->If.Fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+  if (pDev->If.Fd < 0)
+  {
+    Res = -errno;
+    goto Error;
+  }
+  setsockopt(pDev->If.Fd, SOL_SOCKET, SO_RCVBUF, &BufLen, sizeof(BufLen));
+
+  pRaw = calloc(1, sizeof(tLLCRaw));
+  if (pRaw == NULL)
+  {
+    Res = -ENOMEM;
+    goto Error;
+  }
+  for (i = 0; i < LLC_RAW_BATCH; i++)
+  {
+    pRaw->Iovs[i].iov_base = pRaw->Bufs[i];
+    pRaw->Iovs[i].iov_len = LLC_RAW_FRAME_SIZE;
+    pRaw->Msgs[i].msg_hdr.msg_iov = &(pRaw->Iovs[i]);
+    pRaw->Msgs[i].msg_hdr.msg_iovlen = 1;
+    pRaw->Msgs[i].msg_hdr.msg_name = &(pRaw->Addrs[i]);
+  }
+  pDev->If.pRaw = pRaw;
+
+  Res = LLC_RawBind(pDev->If.Fd, pDev->If.Name);
+
+Error:
+  if (Res != 0)
+    LLC_RawRelease(pDev);
+  d_fnend(D_TST, NULL, "(%s) = %d\n", pDev->If.Name, Res);
+  return Res;
+}
+
+/**
+ * @brief Get the next frame, taking a batch from the socket when needed
+ * @param pDev
+ * @param ppBuf Set to the frame (valid until the next call)
+ * @param pLen Set to the frame length
+ * @return zero on success, -EAGAIN if no frames are ready
+ */
+static int LLC_RawRecv (struct LLCDev *pDev,
+                        char **ppBuf,
+                        int *pLen)
+{
+  tLLCRaw *pRaw = pDev->If.pRaw;
+  int Res;
+  int i;
+
+  while (1)
+  {
+    while (pRaw->Next < pRaw->Cnt)
+    {
+      i = pRaw->Next++;
+      // Our own transmissions are looped back to ETH_P_ALL sockets
+      if (pRaw->Addrs[i].sll_pkttype == PACKET_OUTGOING)
+        continue;
+      *ppBuf = (char *)pRaw->Bufs[i];
+      *pLen = pRaw->Msgs[i].msg_len;
+      return 0;
+    }
+
+    for (i = 0; i < LLC_RAW_BATCH; i++)
+      pRaw->Msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_ll);
+    pRaw->Cnt = 0;
+    pRaw->Next = 0;
+    Res = recvmmsg(pDev->If.Fd, pRaw->Msgs, LLC_RAW_BATCH, MSG_DONTWAIT, NULL);
+    if (Res < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      Res = (errno == EWOULDBLOCK) ? -EAGAIN : -errno;
+      break;
+    }
+    pRaw->Cnt = Res;
+    d_printf(D_DBG, NULL, "recvmmsg() = %d\n", Res);
+  }
+
+  *ppBuf = NULL;
+  *pLen = 0;
+  return Res;
+}
+
+/// AF_PACKET socket, a batch of frames per recvmmsg()
+const tLLCTransport LLC_TransportRaw =
+{
+  .pName = "raw",
+  .NoDriver = false,
+  .Setup = LLC_RawSetup,
+  .Release = LLC_RawRelease,
+  .Send = LLC_RawSend,
+  .SendBatch = LLC_RawSendBatch,
+  .Recv = LLC_RawRecv,
+  .NonBlock = NULL,
+  .RxHold = NULL,
+  .RxRelease = NULL,
+};
+
+#endif // !__QNX__
+
+/**
+ * @}
+ */
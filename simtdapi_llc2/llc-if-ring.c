@@ -0,0 +1,319 @@
+/**
+ * @addtogroup cohda_llc_intern_lib LLC API library
+ * @{
+ *
+ * @file
+ * LLC: 'cw-llc' raw interface transport (AF_PACKET socket, TPACKET_V3 ring)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2013 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#if !defined(__QNX__) // Linux only
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+
+#include "linux/cohda/llc/llc-api.h"
+#include "llc-lib.h"
+
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Size of each TPACKET_V3 ring block (a multiple of the page size)
+#define LLC_RING_BLOCK_SIZE (64 * 1024)
+/// Number of blocks in the ring (1MB total)
+#define LLC_RING_BLOCK_CNT  (16)
+/// Nominal frame size (matches the libpcap 4kB snaplen)
+#define LLC_RING_FRAME_SIZE (4 * 1024)
+/// Retire a partially filled block after this long [ms]
+#define LLC_RING_BLOCK_TMO  (1)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions definitions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Release the TPACKET_V3 receive ring
+ * @param pDev
+ */
+static void LLC_RingRelease (struct LLCDev *pDev)
+{
+  if (pDev->If.Ring.pMap != NULL)
+    munmap(pDev->If.Ring.pMap, pDev->If.Ring.MapLen);
+  free(pDev->If.Ring.pBlocks);
+  if (pDev->If.Fd >= 0)
+    close(pDev->If.Fd);
+  memset(&(pDev->If.Ring), 0, sizeof(pDev->If.Ring));
+  pDev->If.Fd = -1;
+}
+
+/**
+ * @brief Open a raw AF_PACKET socket on the netdev with a TPACKET_V3 Rx ring
+ * @param pDev
+ * @return zero on success, otherwise a negative errno
+ *
+ * The kernel fills whole blocks of frames which are then walked in place by
+ * LLC_RingRecv(), so a wakeup costs one poll() instead of one read() and one
+ * copy per MKxIF message.
+ */
+static int LLC_RingSetup (struct LLCDev *pDev)
+{
+  int Res = -ENOSYS;
+  int Fd;
+  struct tpacket_req3 Req;
+  int Version = TPACKET_V3;
+
+  d_fnstart(D_TST, NULL, "(%s)\n", pDev->If.Name);
+
+  memset(&(pDev->If.Ring), 0, sizeof(pDev->If.Ring));
+  pDev->If.Fd = -1;
+
+  if (if_nametoindex(pDev->If.Name) == 0)
+  {
+    Res = -ENODEV;
+    goto Error;
+  }
+
+  Fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+  if (Fd < 0)
+  {
+    Res = -errno;
+    goto Error;
+  }
+  pDev->If.Fd = Fd;
+
+  Res = setsockopt(Fd, SOL_PACKET, PACKET_VERSION, &Version, sizeof(Version));
+  if (Res < 0)
+    goto ErrorErrno;
+
+  memset(&Req, 0, sizeof(Req));
+  Req.tp_block_size = LLC_RING_BLOCK_SIZE;
+  Req.tp_block_nr = LLC_RING_BLOCK_CNT;
+  Req.tp_frame_size = LLC_RING_FRAME_SIZE;
+  Req.tp_frame_nr = (LLC_RING_BLOCK_SIZE / LLC_RING_FRAME_SIZE) *
+                    LLC_RING_BLOCK_CNT;
+  Req.tp_retire_blk_tov = LLC_RING_BLOCK_TMO;
+  Res = setsockopt(Fd, SOL_PACKET, PACKET_RX_RING, &Req, sizeof(Req));
+  if (Res < 0)
+    goto ErrorErrno;
+
+  pDev->If.Ring.MapLen = (size_t)Req.tp_block_size * Req.tp_block_nr;
+  pDev->If.Ring.pMap = mmap(NULL, pDev->If.Ring.MapLen,
+                            PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0);
+  if (pDev->If.Ring.pMap == MAP_FAILED)
+  {
+    pDev->If.Ring.pMap = NULL;
+    goto ErrorErrno;
+  }
+  pDev->If.Ring.BlockSize = Req.tp_block_size;
+  pDev->If.Ring.BlockCnt = Req.tp_block_nr;
+  pDev->If.Ring.pBlocks = calloc(Req.tp_block_nr, sizeof(tLLCRingBlock));
+  if (pDev->If.Ring.pBlocks == NULL)
+    goto ErrorErrno;
+
+  // Bind only once the ring exists so nothing is queued outside of it
+  Res = LLC_RawBind(Fd, pDev->If.Name);
+  if (Res < 0)
+  {
+    LLC_RingRelease(pDev);
+    goto Error;
+  }
+
+  d_printf(D_INFO, NULL, "TPACKET_V3 ring on %s: %u x %u bytes\n",
+           pDev->If.Name, pDev->If.Ring.BlockCnt, pDev->If.Ring.BlockSize);
+  Res = 0;
+  goto Success;
+
+ErrorErrno:
+  Res = -errno;
+  LLC_RingRelease(pDev);
+Error:
+Success:
+  d_fnend(D_TST, NULL, "(%s) = %d\n", pDev->If.Name, Res);
+  return Res;
+}
+
+/**
+ * @brief Drop a reference on a ring block, returning it to the kernel on the
+ *        last one
+ * @param pDev
+ * @param Block Index of the block in the ring
+ */
+static void LLC_RingBlockPut (struct LLCDev *pDev,
+                              unsigned int Block)
+{
+  struct tpacket_block_desc *pBD;
+
+  if (__atomic_sub_fetch(&(pDev->If.Ring.pBlocks[Block].Refs), 1,
+                         __ATOMIC_ACQ_REL) != 0)
+    return;
+
+  pBD = (struct tpacket_block_desc *)
+    (pDev->If.Ring.pMap + (Block * pDev->If.Ring.BlockSize));
+  __atomic_store_n(&(pBD->hdr.bh1.block_status), TP_STATUS_KERNEL,
+                   __ATOMIC_RELEASE);
+  d_printf(D_DBG, NULL, "Block %u returned\n", Block);
+}
+
+/**
+ * @brief Get the next frame from the TPACKET_V3 receive ring
+ * @param pDev
+ * @param ppBuf Set to the frame (in place, inside the ring)
+ * @param pLen Set to the frame length
+ * @return zero on success, -EAGAIN if no frames are ready
+ *
+ * A block stays owned by userspace while its frames are being dispatched and
+ * is handed back to the kernel on the call after its last frame, i.e. once
+ * LLC_MsgRecv() has finished with every frame in it, or later if frames from
+ * it are still held by the application (see LLC_InterfaceRxHold()).
+ */
+static int LLC_RingRecv (struct LLCDev *pDev,
+                         char **ppBuf,
+                         int *pLen)
+{
+  struct tpacket_block_desc *pBD;
+  struct tpacket3_hdr *pHdr;
+  struct sockaddr_ll *pAddr;
+
+  while (1)
+  {
+    pBD = pDev->If.Ring.pBlockDesc;
+    if (pBD == NULL)
+    {
+      // Take ownership of the next block (if the kernel has retired it)
+      pBD = (struct tpacket_block_desc *)
+        (pDev->If.Ring.pMap + (pDev->If.Ring.Block * pDev->If.Ring.BlockSize));
+      if ((__atomic_load_n(&(pBD->hdr.bh1.block_status), __ATOMIC_ACQUIRE) &
+           TP_STATUS_USER) == 0)
+        break;
+      // Still held from the previous lap of the ring (the kernel cannot
+      // have refilled it, so don't dispatch its frames twice)
+      if (__atomic_load_n(&(pDev->If.Ring.pBlocks[pDev->If.Ring.Block].Refs),
+                          __ATOMIC_ACQUIRE) != 0)
+        break;
+      // The dispatcher's own reference
+      __atomic_store_n(&(pDev->If.Ring.pBlocks[pDev->If.Ring.Block].Refs), 1,
+                       __ATOMIC_RELAXED);
+      pDev->If.Ring.pBlockDesc = pBD;
+      pDev->If.Ring.FramesLeft = pBD->hdr.bh1.num_pkts;
+      pDev->If.Ring.pFrame = (uint8_t *)pBD + pBD->hdr.bh1.offset_to_first_pkt;
+      d_printf(D_DBG, NULL, "Block %u: %u frames\n",
+               pDev->If.Ring.Block, pDev->If.Ring.FramesLeft);
+    }
+
+    if (pDev->If.Ring.FramesLeft == 0)
+    {
+      // All frames dispatched: return the block to the kernel (unless the
+      // application still holds frames from it)
+      LLC_RingBlockPut(pDev, pDev->If.Ring.Block);
+      pDev->If.Ring.pBlockDesc = NULL;
+      pDev->If.Ring.Block = (pDev->If.Ring.Block + 1) % pDev->If.Ring.BlockCnt;
+      continue;
+    }
+
+    pHdr = (struct tpacket3_hdr *)pDev->If.Ring.pFrame;
+    pDev->If.Ring.FramesLeft--;
+    pDev->If.Ring.pFrame += pHdr->tp_next_offset;
+
+    // Our own transmissions are looped back to ETH_P_ALL sockets
+    pAddr = (struct sockaddr_ll *)
+      ((uint8_t *)pHdr + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+    if (pAddr->sll_pkttype == PACKET_OUTGOING)
+      continue;
+
+    *ppBuf = (char *)pHdr + pHdr->tp_mac;
+    *pLen = pHdr->tp_snaplen;
+    return 0;
+  }
+
+  *ppBuf = NULL;
+  *pLen = 0;
+  return -EAGAIN;
+}
+
+/**
+ * @brief Take a reference on the ring block of the frame most recently
+ *        returned by LLC_RingRecv()
+ * @param pDev
+ * @return A handle for LLC_RingRxRelease(), or NULL if not possible
+ */
+static void *LLC_RingRxHold (struct LLCDev *pDev)
+{
+  tLLCRingBlock *pBlock = NULL;
+
+  if (pDev->If.Ring.pBlockDesc == NULL)
+    goto Error;
+
+  pBlock = &(pDev->If.Ring.pBlocks[pDev->If.Ring.Block]);
+  __atomic_add_fetch(&(pBlock->Refs), 1, __ATOMIC_RELAXED);
+Error:
+  return pBlock;
+}
+
+/**
+ * @brief Drop a reference taken with LLC_RingRxHold()
+ * @param pDev
+ * @param pPriv The handle returned by LLC_RingRxHold()
+ * @return zero on success, otherwise a negative errno
+ */
+static int LLC_RingRxRelease (struct LLCDev *pDev,
+                              void *pPriv)
+{
+  int Res = -EINVAL;
+  tLLCRingBlock *pBlock = (tLLCRingBlock *)pPriv;
+
+  if ((pDev->If.Ring.pBlocks == NULL) ||
+      (pBlock < pDev->If.Ring.pBlocks) ||
+      (pBlock >= (pDev->If.Ring.pBlocks + pDev->If.Ring.BlockCnt)))
+    goto Error;
+
+  LLC_RingBlockPut(pDev, pBlock - pDev->If.Ring.pBlocks);
+  Res = 0;
+Error:
+  return Res;
+}
+
+/// AF_PACKET socket with a TPACKET_V3 receive ring (the default)
+const tLLCTransport LLC_TransportRing =
+{
+  .pName = "ring",
+  .NoDriver = false,
+  .Setup = LLC_RingSetup,
+  .Release = LLC_RingRelease,
+  .Send = LLC_RawSend,
+  .SendBatch = LLC_RawSendBatch,
+  .Recv = LLC_RingRecv,
+  .NonBlock = NULL,
+  .RxHold = LLC_RingRxHold,
+  .RxRelease = LLC_RingRxRelease,
+};
+
+#endif // !__QNX__
+
+/**
+ * @}
+ */
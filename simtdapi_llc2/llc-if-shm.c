@@ -0,0 +1,283 @@
+/**
+ * @addtogroup cohda_llc_intern_lib LLC API library
+ * @{
+ *
+ * @file
+ * LLC: Shared memory transport (to the llc-standin program, see llc-shm.h)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2013 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#if !defined(__QNX__) // Linux only
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "linux/cohda/llc/llc-api.h"
+#include "llc-lib.h"
+#include "llc-shm.h"
+
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// How long LLC_ShmSend() waits for space in a full ring [ms]
+#define LLC_SHM_TX_WAIT (100)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+/// Shared memory transport state
+typedef struct LLCShm
+{
+  /// The shared memory
+  tLLCShmMap *pMap;
+  /// The message last returned by LLC_ShmRecv() is still in its slot
+  bool RxPending;
+} tLLCShm;
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions definitions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Unmap the shared memory and close the doorbell socket
+ * @param pDev
+ */
+static void LLC_ShmRelease (struct LLCDev *pDev)
+{
+  if (pDev->If.pShm != NULL)
+  {
+    if (pDev->If.pShm->pMap != NULL)
+      munmap(pDev->If.pShm->pMap, sizeof(tLLCShmMap));
+    free(pDev->If.pShm);
+    pDev->If.pShm = NULL;
+  }
+  if (pDev->If.Fd >= 0)
+    close(pDev->If.Fd);
+  pDev->If.Fd = -1;
+}
+
+/**
+ * @brief Connect to the MKx stand-in and map the shared memory it sends
+ * @param pDev
+ * @return zero on success, otherwise a negative errno
+ */
+static int LLC_ShmSetup (struct LLCDev *pDev)
+{
+  int Res = -ENOSYS;
+  struct sockaddr_un Addr;
+  socklen_t AddrLen;
+  struct msghdr Msg;
+  struct iovec Iov;
+  struct cmsghdr *pCmsg;
+  union
+  {
+    struct cmsghdr Hdr;
+    char Buf[CMSG_SPACE(sizeof(int))];
+  } Ctrl;
+  struct stat Stat;
+  char Byte;
+  int MemFd = -1;
+
+  d_fnstart(D_TST, NULL, "(%s)\n", pDev->If.Name);
+
+  pDev->If.pShm = calloc(1, sizeof(tLLCShm));
+  pDev->If.Fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if ((pDev->If.pShm == NULL) || (pDev->If.Fd < 0))
+  {
+    Res = (pDev->If.pShm == NULL) ? -ENOMEM : -errno;
+    goto Error;
+  }
+
+  // Abstract socket name (leading '\0')
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_UNIX;
+  snprintf(Addr.sun_path + 1, sizeof(Addr.sun_path) - 1,
+           LLC_SHM_SOCKET_FMT, pDev->If.Name);
+  AddrLen = offsetof(struct sockaddr_un, sun_path) + 1 +
+            strlen(Addr.sun_path + 1);
+  if (connect(pDev->If.Fd, (struct sockaddr *)&Addr, AddrLen) < 0)
+  {
+    Res = -errno;
+    d_error(D_ERR, NULL, "Cannot connect to @%s: %s\n",
+            Addr.sun_path + 1, strerror(errno));
+    goto Error;
+  }
+
+  // The first byte carries the shared memory file descriptor
+  memset(&Msg, 0, sizeof(Msg));
+  Iov.iov_base = &Byte;
+  Iov.iov_len = 1;
+  Msg.msg_iov = &Iov;
+  Msg.msg_iovlen = 1;
+  Msg.msg_control = Ctrl.Buf;
+  Msg.msg_controllen = sizeof(Ctrl.Buf);
+  if (recvmsg(pDev->If.Fd, &Msg, MSG_CMSG_CLOEXEC) <= 0)
+  {
+    Res = -EPROTO;
+    goto Error;
+  }
+  pCmsg = CMSG_FIRSTHDR(&Msg);
+  if ((pCmsg == NULL) || (pCmsg->cmsg_level != SOL_SOCKET) ||
+      (pCmsg->cmsg_type != SCM_RIGHTS))
+  {
+    Res = -EPROTO;
+    goto Error;
+  }
+  memcpy(&MemFd, CMSG_DATA(pCmsg), sizeof(MemFd));
+
+  if ((fstat(MemFd, &Stat) < 0) || (Stat.st_size < (off_t)sizeof(tLLCShmMap)))
+  {
+    Res = -EPROTO;
+    goto Error;
+  }
+  pDev->If.pShm->pMap = mmap(NULL, sizeof(tLLCShmMap), PROT_READ | PROT_WRITE,
+                             MAP_SHARED, MemFd, 0);
+  if (pDev->If.pShm->pMap == MAP_FAILED)
+  {
+    pDev->If.pShm->pMap = NULL;
+    Res = -errno;
+    goto Error;
+  }
+  if (pDev->If.pShm->pMap->Magic != LLC_SHM_MAGIC)
+  {
+    Res = -EPROTO;
+    goto Error;
+  }
+
+  // The doorbell is only ever drained, never waited on
+  fcntl(pDev->If.Fd, F_SETFL, fcntl(pDev->If.Fd, F_GETFL) | O_NONBLOCK);
+  d_printf(D_INFO, NULL, "Shared memory transport to @%s\n",
+           Addr.sun_path + 1);
+  Res = 0;
+
+Error:
+  if (MemFd >= 0)
+    close(MemFd);
+  if (Res != 0)
+    LLC_ShmRelease(pDev);
+  d_fnend(D_TST, NULL, "(%s) = %d\n", pDev->If.Name, Res);
+  return Res;
+}
+
+/**
+ * @brief Put a message in the ring to the MKx (ringing the doorbell if the
+ *        MKx end may be waiting for it)
+ * @param pDev
+ * @param pBuf
+ * @param Len
+ * @return The number of bytes sent, or -1
+ */
+static int LLC_ShmSend (struct LLCDev *pDev,
+                        char *pBuf,
+                        int Len)
+{
+  bool WasEmpty = false;
+  int Wait = 0;
+  int Res;
+
+  while (1)
+  {
+    Res = LLC_ShmPut(&(pDev->If.pShm->pMap->ToMKx), pBuf, Len, &WasEmpty);
+    if ((Res != -ENOBUFS) || (Wait++ >= LLC_SHM_TX_WAIT))
+      break;
+    // Full (as a socket's send buffer would be): give the MKx end a moment
+    usleep(1000);
+  }
+  if (Res != 0)
+  {
+    d_error(D_WARN, NULL, "LLC_ShmPut(%p, %d) = %d\n", pBuf, Len, Res);
+    errno = -Res;
+    return -1;
+  }
+
+  if (WasEmpty)
+    (void)send(pDev->If.Fd, "", 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+  return Len;
+}
+
+/**
+ * @brief Get the next message from the ring from the MKx
+ * @param pDev
+ * @param ppBuf Set to the message (in its slot, valid until the next call)
+ * @param pLen Set to the message length
+ * @return zero on success, -EAGAIN if there is none, -ENODEV if the MKx end
+ *         has gone
+ */
+static int LLC_ShmRecv (struct LLCDev *pDev,
+                        char **ppBuf,
+                        int *pLen)
+{
+  tLLCShmRing *pRing = &(pDev->If.pShm->pMap->FromMKx);
+  char Buf[64];
+  int Res;
+
+  // Done with the previous message
+  if (pDev->If.pShm->RxPending)
+    LLC_ShmPop(pRing);
+  pDev->If.pShm->RxPending = false;
+
+  *ppBuf = LLC_ShmPeek(pRing, pLen);
+  if (*ppBuf == NULL)
+  {
+    // Drain the doorbell before checking again (see llc-shm.h)
+    while ((Res = recv(pDev->If.Fd, Buf, sizeof(Buf), MSG_DONTWAIT)) > 0)
+      ;
+    if ((Res == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK)))
+    {
+      d_error(D_ERR, NULL, "MKx stand-in gone (%d)\n", Res);
+      return -ENODEV;
+    }
+    *ppBuf = LLC_ShmPeek(pRing, pLen);
+  }
+  if (*ppBuf == NULL)
+  {
+    *pLen = 0;
+    return -EAGAIN;
+  }
+  pDev->If.pShm->RxPending = true;
+  return 0;
+}
+
+/// Shared memory rings to a userspace MKx (the llc-standin program)
+const tLLCTransport LLC_TransportShm =
+{
+  .pName = "shm",
+  .NoDriver = true,
+  .Setup = LLC_ShmSetup,
+  .Release = LLC_ShmRelease,
+  .Send = LLC_ShmSend,
+  .SendBatch = NULL,
+  .Recv = LLC_ShmRecv,
+  .NonBlock = NULL,
+  .RxHold = NULL,
+  .RxRelease = NULL,
+};
+
+#endif // !__QNX__
+
+/**
+ * @}
+ */
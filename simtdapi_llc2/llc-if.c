@@ -5,6 +5,15 @@
  * @file
  * LLC: 'cw-llc' monitoring application (raw interface handling)
  *
+ * The messages to and from the MKx go through one of several transports
+ * (see tLLCTransport), selected at runtime with the LLC_TRANSPORT
+ * environment variable:
+ * - "ring": AF_PACKET socket with a TPACKET_V3 receive ring (llc-if-ring.c)
+ * - "raw":  AF_PACKET socket, recvmmsg()/sendmmsg() (llc-if-raw.c)
+ * - "pcap": libpcap (llc-if-pcap.c)
+ * - "shm":  shared memory rings to the llc-standin program (llc-if-shm.c)
+ * By default the ring is used, falling back to libpcap (the only transport
+ * on QNX).
  */
 
 //------------------------------------------------------------------------------
@@ -31,6 +40,9 @@
 // Macros & Constants
 //------------------------------------------------------------------------------
 
+/// Environment variable selecting the transport
+#define LLC_TRANSPORT_ENV "LLC_TRANSPORT"
+
 //------------------------------------------------------------------------------
 // Type definitions
 //------------------------------------------------------------------------------
@@ -39,127 +51,161 @@
 // Variables
 //------------------------------------------------------------------------------
 
+/// Transports that can be selected by name
+static const tLLCTransport *LLC_Transports[] =
+{
+  #if !defined(__QNX__)
+  &LLC_TransportRing,
+  &LLC_TransportRaw,
+  &LLC_TransportShm,
+  #endif
+  &LLC_TransportPcap,
+  NULL,
+};
+
 //------------------------------------------------------------------------------
 // Functions definitions
 //------------------------------------------------------------------------------
 
 /**
- * @brief Open the raw interface (using libpcap)
+ * @brief Can received frames be held in place (e.g. is the Rx ring in use)?
+ * @param pDev
+ * @return true if LLC_InterfaceRxHold() can succeed
+ */
+bool LOCAL LLC_InterfaceRxInPlace (struct LLCDev *pDev)
+{
+  return (pDev->If.pTransport != NULL) &&
+         (pDev->If.pTransport->RxHold != NULL);
+}
+
+/**
+ * @brief Take a reference on the frame most recently returned by
+ *        LLC_InterfaceRecv() so that it stays valid after the next call
+ * @param pDev
+ * @return A handle for LLC_InterfaceRxRelease(), or NULL if not possible
+ */
+void LOCAL *LLC_InterfaceRxHold (struct LLCDev *pDev)
+{
+  if (LLC_InterfaceRxInPlace(pDev) == false)
+    return NULL;
+  return pDev->If.pTransport->RxHold(pDev);
+}
+
+/**
+ * @brief Drop a reference taken with LLC_InterfaceRxHold()
+ * @param pDev
+ * @param pPriv The handle returned by LLC_InterfaceRxHold()
+ * @return zero on success, otherwise a negative errno
+ */
+int LOCAL LLC_InterfaceRxRelease (struct LLCDev *pDev,
+                                  void *pPriv)
+{
+  if (LLC_InterfaceRxInPlace(pDev) == false)
+    return -EINVAL;
+  return pDev->If.pTransport->RxRelease(pDev, pPriv);
+}
+
+/**
+ * @brief Make LLC_InterfaceRecv() return -EAGAIN at once when there is
+ *        nothing to receive (rather than after the pcap read timeout)
+ * @param pDev
+ * @return zero on success, otherwise a negative errno
+ */
+int LOCAL LLC_InterfaceNonBlock (struct LLCDev *pDev)
+{
+  int Res = 0;
+
+  d_fnstart(D_TST, NULL, "()\n");
+
+  // Only libpcap ever blocks
+  if ((pDev->If.NonBlock == true) || (pDev->If.pTransport == NULL) ||
+      (pDev->If.pTransport->NonBlock == NULL))
+    goto Error;
+
+  Res = pDev->If.pTransport->NonBlock(pDev);
+  if (Res == 0)
+    pDev->If.NonBlock = true;
+
+Error:
+  d_fnend(D_TST, NULL, "(pDev %p) = %d\n", pDev, Res);
+  return Res;
+}
+
+/**
+ * @brief Open the raw interface with the selected transport (the TPACKET_V3
+ *        ring, or libpcap as a fallback, unless LLC_TRANSPORT says otherwise)
  * @param pDev
  * @return zero on success, otherwise a negative errno
  */
 int LOCAL LLC_InterfaceSetup (struct LLCDev *pDev)
 {
   int Res = -ENOSYS;
-  char *pInputFileName = NULL;
-  #if defined(__QNX__)
-  char *pInputInterfaceName = "llc0";
-  #else
-  char *pInputInterfaceName = "cw-llc";
-  #endif
-  char ErrorString[PCAP_ERRBUF_SIZE];
+  const char *pName = getenv(LLC_TRANSPORT_ENV);
+  int i;
 
   d_fnstart(D_TST, NULL, "()\n");
   d_assert(pDev != NULL);
 
-  // Open the capture file or interface
-  if (pInputFileName != NULL)
+  pDev->If.pCap = NULL;
+  pDev->If.Fd = -1;
+  pDev->If.pTransport = NULL;
+
+  if ((pName != NULL) && (pName[0] != '\0'))
   {
-    pDev->If.pCap = pcap_open_offline(pInputFileName, ErrorString);
-    if (pDev->If.pCap == NULL)
+    // Only the requested transport (no fallback)
+    for (i = 0; LLC_Transports[i] != NULL; i++)
     {
-      d_error(D_ERR, NULL, "Open failed on '%s', %s\n",
-              pInputFileName, ErrorString);
+      if (strcmp(LLC_Transports[i]->pName, pName) == 0)
+        break;
+    }
+    if (LLC_Transports[i] == NULL)
+    {
+      d_error(D_ERR, NULL, "Unknown %s '%s'\n", LLC_TRANSPORT_ENV, pName);
       Res = -EINVAL;
       goto Error;
     }
+    Res = LLC_Transports[i]->Setup(pDev);
+    if (Res != 0)
+      goto Error;
+    pDev->If.pTransport = LLC_Transports[i];
   }
-  // OR: Open live pcap interface
-  else if (pInputInterfaceName != NULL)
+  else
   {
-    // PCAP: Max packet length
-    int SnapLength = (1024 * 4); // 4kB
-    // PCAP: promiscious mode?
-    int Promisc = 1;
-    // PCAP: pcap read time-out [ms]
-#ifdef BOARD_QNX
-    int ReadTimeout = 1;
-#else
-    int ReadTimeout = 1;
-#endif
-
-    pDev->If.pCap = pcap_open_live(pInputInterfaceName,
-                                   SnapLength,
-                                   Promisc,
-                                   ReadTimeout,
-                                   ErrorString);
-#if defined(__QNX__)
-    if (pDev->If.pCap == NULL)
+    #if !defined(__QNX__)
+    // Prefer the TPACKET_V3 ring, libpcap is only the fallback
+    Res = LLC_TransportRing.Setup(pDev);
+    if (Res == 0)
     {
-      // try again using a different SOCK prefix to get the correct io-pkt instance
-      setenv("SOCK", "/llc", 0);
-      pDev->If.pCap = pcap_open_live(pInputInterfaceName,
-                                     SnapLength,
-                                     Promisc,
-                                     ReadTimeout,
-                                     ErrorString);
+      pDev->If.pTransport = &LLC_TransportRing;
     }
-#endif
-    if (pDev->If.pCap == NULL)
+    else
     {
-      d_error(D_ERR, NULL, "Open failed on %s, %s\n",
-              pInputInterfaceName, ErrorString);
-      Res = -EINVAL;
-      goto Error;
+      d_printf(D_WARN, NULL, "No TPACKET_V3 ring on %s (%d), using libpcap\n",
+               pDev->If.Name, Res);
     }
-
-    #if defined(__QNX__)
-    // Set 'immediate' mode (no delay before returning Rx packets)
+    #endif
+    if (pDev->If.pTransport == NULL)
     {
-      unsigned int Immediate = 1;
-      Res =  ioctl(pcap_fileno(pDev->If.pCap), BIOCIMMEDIATE, &Immediate);
+      Res = LLC_TransportPcap.Setup(pDev);
       if (Res != 0)
-      {
-        d_printf(D_WARN, NULL, "Cannot enable immediate mode %d %s\n",
-                 Res, strerror(errno));
-      }
-    }
-    #endif // __QNX__
-
-    // Set the socket Rx buffer size
-    {
-      // ... Requires some inside knowledge of pcap_t (from pcap-int.h)
-      int BufLen = 256*1024; // 256 KB Rx buffer
-      setsockopt(pcap_fileno(pDev->If.pCap), SOL_SOCKET, SO_RCVBUF,
-                 (char *)&BufLen, sizeof(BufLen));
-    }
-
-    // Check that the linktype is appropriate - i.e. RAW mode
-    {
-      int LinkType = pcap_datalink(pDev->If.pCap);
-      d_printf(D_INFO, NULL, "PCAP LinkType is: %d\n", LinkType);
-
-      ; // Nothing yet
-    }
-
-    // Setup the ioctl() and netdev parameters
-    {
-      pDev->If.Fd = pcap_fileno(pDev->If.pCap);
-      d_printf(D_DBG, NULL, "pDev->If.Fd %d\n", pDev->If.Fd);
-
-      #if defined(__QNX__)
-      memset(&(pDev->If.Ifd), 0, sizeof(pDev->If.Ifd));
-      snprintf(pDev->If.Ifd.ifd_name, sizeof(pDev->If.Ifd.ifd_name),
-               "%s", pInputInterfaceName);
-      #else
-      memset(&(pDev->If.Ifr), 0, sizeof(pDev->If.Ifr));
-      snprintf(pDev->If.Ifr.ifr_name, sizeof(pDev->If.Ifr.ifr_name),
-               "%s", pInputInterfaceName);
-      #endif
+        goto Error;
+      pDev->If.pTransport = &LLC_TransportPcap;
     }
+  }
+  d_printf(D_DBG, NULL, "pDev->If.Fd %d (%s)\n",
+           pDev->If.Fd, pDev->If.pTransport->pName);
 
-    Res = 0;
-  } // else if (pInputInterfaceName)
+  // Setup the ioctl() and netdev parameters
+  #if defined(__QNX__)
+  memset(&(pDev->If.Ifd), 0, sizeof(pDev->If.Ifd));
+  snprintf(pDev->If.Ifd.ifd_name, sizeof(pDev->If.Ifd.ifd_name),
+           "%s", pDev->If.Name);
+  #else
+  memset(&(pDev->If.Ifr), 0, sizeof(pDev->If.Ifr));
+  snprintf(pDev->If.Ifr.ifr_name, sizeof(pDev->If.Ifr.ifr_name),
+           "%s", pDev->If.Name);
+  #endif
+  Res = 0;
 
 Error:
   d_fnend(D_TST, NULL, "() = %d\n", Res);
@@ -167,7 +213,7 @@ Error:
 }
 
 /**
- * @brief Close the raw interface (via libpcap)
+ * @brief Close the raw interface
  * @param pDev
  * @return zero on success, otherwise a negative errno
  */
@@ -176,11 +222,11 @@ void LOCAL LLC_InterfaceRelease (struct LLCDev *pDev)
 
   d_fnstart(D_TST, NULL, "()\n");
 
-  if (pDev->If.pCap == NULL)
+  if (pDev->If.pTransport == NULL)
     goto Error;
 
-  pcap_close(pDev->If.pCap);
-  pDev->If.pCap = NULL;
+  pDev->If.pTransport->Release(pDev);
+  pDev->If.pTransport = NULL;
 
 Error:
   d_fnend(D_TST, NULL, "(pDev %p) = void\n", pDev);
@@ -199,59 +245,73 @@ int LOCAL LLC_InterfaceSend (struct LLCDev *pDev,
                              int Len)
 {
   int Cnt;
-  #if defined(__QNX__)
-  // QNX BPF over LLC intefaces seems to assume a header to be reserved.(radiotap or something?)
-  // Bytes 13,14 is used as a 16bits payload length which overlaps with LLC's IfMsg.Radio
-  // Bytes 3,4 is modified(not sure the usage,it is static)
-  // Bytes 5,6 seems to be sequence number.
-  // Data beyound 12 seems not touched by pcap.
-  const int OrigLen = Len;
-  #endif
 
   d_fnstart(D_TST, NULL, "()\n");
 
-  // Send packet to over the raw interface using libpcap
-  #if defined(__QNX__)
-  // The hack to add 14 more byte at the head to be trashed by pcap
-  // Since pcap_inject is a sink only, it should be safe to do following dirty hack.
-  // The 14 bytes extra head will be dropped in llc driver.
-  pBuf -= 14;
-  Len += 14;
-  #endif
+  Cnt = pDev->If.pTransport->Send(pDev, pBuf, Len);
+
+  d_fnend(D_TST, NULL, "(pDev %p) = %d\n", pDev, Cnt);
+  return Cnt;
+}
 
-  Cnt = pcap_inject(pDev->If.pCap, pBuf, Len);
-  if (Cnt < 0)
+
+/**
+ * @brief Send several messages over the raw interface
+ * @param pDev
+ * @param ppBuf Array of Cnt buffers
+ * @param pLen Array of Cnt buffer lengths
+ * @param pRes Set to the number of bytes sent, or a negative errno, for each
+ * @param Cnt Number of buffers (at most LLC_TX_BATCH_MAX)
+ * @return The number of buffers that were sent
+ */
+int LOCAL LLC_InterfaceSendBatch (struct LLCDev *pDev,
+                                  char **ppBuf,
+                                  const int *pLen,
+                                  int *pRes,
+                                  int Cnt)
+{
+  int Sent = 0;
+  int i;
+
+  d_fnstart(D_TST, NULL, "(Cnt %d)\n", Cnt);
+  d_assert(Cnt <= LLC_TX_BATCH_MAX);
+
+  // e.g. one sendmmsg() for the whole batch on the raw AF_PACKET socket
+  if (pDev->If.pTransport->SendBatch != NULL)
   {
-    d_error(D_WARN, NULL, "pcap_inject(%p, %p, %d) = %s\n",
-            pDev->If.pCap, pBuf, Len,
-            pcap_geterr(pDev->If.pCap));
-    Cnt = -1;
+    Sent = pDev->If.pTransport->SendBatch(pDev, ppBuf, pLen, pRes, Cnt);
+    goto Exit;
   }
-  #if defined(__QNX__)
-  // make sure we return the number of bytes which the caller expected
-  if (Cnt > OrigLen)
-    Cnt = OrigLen;
-  #endif
 
+  // No batched send (e.g. libpcap has no batched inject)
+  for (i = 0; i < Cnt; i++)
+  {
+    pRes[i] = pDev->If.pTransport->Send(pDev, ppBuf[i], pLen[i]);
+    if (pRes[i] < 0)
+      pRes[i] = -EIO;
+    else
+      Sent++;
+  }
 
-  d_fnend(D_TST, NULL, "(pDev %p) = %d\n", pDev, Cnt);
-  return Cnt;
+Exit:
+  d_fnend(D_TST, NULL, "(Cnt %d) = %d\n", Cnt, Sent);
+  return Sent;
 }
 
 
 /**
- * @brief Forward all raw interface messages
+ * @brief Get the next message from the raw interface
  * @param pDev
- * @return zero on success, otherwise a negative errno:
- *         The functions only returns on signal interrupts or failures
+ * @param ppBuf Set to the message (valid until the next call)
+ * @param pLen Set to the message length
+ * @return zero on success, -EAGAIN if there is nothing to receive, otherwise
+ *         a negative errno
  */
 int LOCAL LLC_InterfaceRecv (struct LLCDev *pDev,
                              char **ppBuf,
                              int *pLen)
 {
   int Res = -ENOSYS;
-  struct pcap_pkthdr *pPcapHdr; // The header that pcap gives us
-  char *pPcapPkt;      // The actual packet
 
   d_fnstart(D_TST, NULL, "()\n");
   if ((ppBuf == NULL) || (pLen == NULL))
@@ -260,35 +320,7 @@ int LOCAL LLC_InterfaceRecv (struct LLCDev *pDev,
     goto Error;
   }
 
-  // Grab a packet from the device
-  Res = pcap_next_ex(pDev->If.pCap,
-                     &pPcapHdr,
-                     (const uint8_t **)&pPcapPkt);
-  d_printf(D_DBG, NULL, "pcap_next_ex() = %d\n", Res);
-  switch (Res)
-  {
-    case 1: // Read success
-      d_printf(D_DBG, NULL, "Received a packet\n");
-      *pLen = pPcapHdr->caplen;
-      *ppBuf = pPcapPkt;
-      Res = 0;
-      break;
-
-    case 0: // Read timeout
-      d_printf(D_DBG, NULL, "read timeout\n");
-      *pLen = 0;
-      *ppBuf = NULL;
-      Res = -EAGAIN;
-      break;
-
-    case -1: // Error
-    case -2: // EOF
-    default:
-      d_printf(D_ERR, NULL, "pcap_next_ex() = %s\n",
-               pcap_geterr(pDev->If.pCap));
-      Res = -ENODEV;
-      break;
-  }
+  Res = pDev->If.pTransport->Recv(pDev, ppBuf, pLen);
 
 Error:
   d_fnend(D_TST, NULL, "() = %d\n", Res);
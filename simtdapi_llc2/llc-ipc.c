@@ -0,0 +1,887 @@
+/**
+ * @addtogroup cohda_llc_intern_app LLC application
+ * @{
+ *
+ * @file
+ * LLC: Local (Android) IPC server (see llc-ipc.h)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2015 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#define _GNU_SOURCE // accept4()
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "llc-ipc.h"
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions definitions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Release a queue's (or the sender's) hold on a message
+ */
+static void LLC_IPCMsgPut (tLLCIPCMsg *pMsg)
+{
+  if (--pMsg->RefCnt == 0)
+    free(pMsg);
+}
+
+/**
+ * @brief Find a free client slot
+ * @return The slot, or NULL
+ */
+static tLLCIPCClient *LLC_IPCAlloc (tLLCIPC *pIPC)
+{
+  int i;
+
+  for (i = 0; i < LLC_IPC_CLIENT_MAX; i++)
+  {
+    if (!pIPC->Clients[i].Used)
+      return &(pIPC->Clients[i]);
+  }
+  pIPC->Rejected++;
+  return NULL;
+}
+
+/**
+ * @brief Wait for room in the datagram socket while any peer has a backlog
+ * @param pIPC
+ */
+static void LLC_IPCArmDgram (tLLCIPC *pIPC)
+{
+  bool Out = false;
+  int i;
+
+  for (i = 0; (i < LLC_IPC_CLIENT_MAX) && (!Out); i++)
+    Out = pIPC->Clients[i].Used && pIPC->Clients[i].Dgram &&
+          ((pIPC->Clients[i].Cnt > 0) || pIPC->Clients[i].ShareReq);
+  if (Out != pIPC->DgramOutArmed)
+    (void)LLC_EventMod(pIPC->pLoop, pIPC->DgramFd,
+                       LLC_EVENT_IN | (Out ? LLC_EVENT_OUT : 0));
+  pIPC->DgramOutArmed = Out;
+}
+
+/**
+ * @brief Register (or unregister) interest in room in a client's socket
+ * @param pIPC
+ * @param pClient
+ */
+static void LLC_IPCArm (tLLCIPC *pIPC,
+                        tLLCIPCClient *pClient)
+{
+  bool Out = (pClient->Cnt > 0) || pClient->ShareReq;
+
+  if (pClient->Dgram)
+  {
+    // The socket is shared
+    pClient->OutArmed = Out;
+    LLC_IPCArmDgram(pIPC);
+    return;
+  }
+  if (Out != pClient->OutArmed)
+    (void)LLC_EventMod(pIPC->pLoop, pClient->Fd,
+                       LLC_EVENT_IN | (Out ? LLC_EVENT_OUT : 0));
+  pClient->OutArmed = Out;
+}
+
+/**
+ * @brief Disconnect a client, dropping whatever is queued for it
+ * @param pIPC
+ * @param pClient
+ */
+static void LLC_IPCDrop (tLLCIPC *pIPC,
+                         tLLCIPCClient *pClient)
+{
+  bool Dgram = pClient->Dgram;
+  uint32_t i;
+
+  d_printf(D_INFO, NULL, "IPC client %d gone (sent %u dropped %u filtered %u, "
+           "frames %u bad %u skipped %u)\n",
+           (int)(pClient - pIPC->Clients), pClient->Stats.Sent,
+           pClient->Stats.Dropped, pClient->Filter.Filtered,
+           pClient->Parser.Stats.Frames,
+           pClient->Parser.Stats.Bad, pClient->Parser.Stats.Skipped);
+
+  if (pClient->Fd >= 0)
+  {
+    (void)LLC_EventDel(pIPC->pLoop, pClient->Fd);
+    close(pClient->Fd);
+  }
+  for (i = 0; i < pClient->Cnt; i++)
+    LLC_IPCMsgPut(pClient->pQueue[(pClient->Head + i) % LLC_IPC_QUEUE_DEPTH]);
+  memset(pClient, 0, sizeof(*pClient));
+  pClient->Fd = -1;
+  pIPC->ClientCnt--;
+  if (Dgram)
+    LLC_IPCArmDgram(pIPC);
+}
+
+/**
+ * @brief Send a client the ring's descriptor (see LLC_IPC_PROTO_SHARE)
+ * @param pIPC
+ * @param pClient
+ * @return Zero, or a negative errno
+ */
+static int LLC_IPCSendFd (tLLCIPC *pIPC,
+                          tLLCIPCClient *pClient)
+{
+  uint8_t Reply[LLC_IPC_SHARE_LEN];
+  union
+  {
+    struct cmsghdr Align;
+    char Buf[CMSG_SPACE(sizeof(int))];
+  } Ctrl;
+  struct iovec Iov;
+  struct msghdr Msg;
+  struct cmsghdr *pCmsg;
+  int Fd = LLC_ShmRingFd(pIPC->pRing);
+  int i;
+
+  Reply[0] = LLC_FRAME_SYNC;
+  Reply[1] = LLC_FRAME_SYNC;
+  Reply[2] = LLC_IPC_PROTO_SHARE;
+  for (i = 0; i < 8; i++)
+    Reply[3 + i] = (pClient->ShareSeq >> (8 * i)) & 0xff;
+
+  memset(&Msg, 0, sizeof(Msg));
+  memset(&Ctrl, 0, sizeof(Ctrl));
+  Iov.iov_base = Reply;
+  Iov.iov_len = sizeof(Reply);
+  Msg.msg_iov = &Iov;
+  Msg.msg_iovlen = 1;
+  Msg.msg_control = Ctrl.Buf;
+  Msg.msg_controllen = sizeof(Ctrl.Buf);
+  if (pClient->Dgram)
+  {
+    Msg.msg_name = &(pClient->Addr);
+    Msg.msg_namelen = pClient->AddrLen;
+  }
+  pCmsg = CMSG_FIRSTHDR(&Msg);
+  pCmsg->cmsg_level = SOL_SOCKET;
+  pCmsg->cmsg_type = SCM_RIGHTS;
+  pCmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(pCmsg), &Fd, sizeof(int));
+
+  // Short enough to go in one piece (or not at all) on a stream
+  if (sendmsg(pClient->Dgram ? pIPC->DgramFd : pClient->Fd, &Msg,
+              MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+    return -errno;
+  return 0;
+}
+
+/**
+ * @brief Write as much of a client's queue as its socket will take
+ * @param pIPC
+ * @param pClient
+ * @return Zero, or a negative errno if the client has gone (and was dropped)
+ */
+static int LLC_IPCFlush (tLLCIPC *pIPC,
+                         tLLCIPCClient *pClient)
+{
+  tLLCIPCMsg *pMsg;
+  ssize_t Len;
+
+  while (pClient->Cnt > 0)
+  {
+    pMsg = pClient->pQueue[pClient->Head];
+    if (pClient->Dgram)
+      Len = sendto(pIPC->DgramFd, pMsg->Data, pMsg->Len,
+                   MSG_DONTWAIT | MSG_NOSIGNAL,
+                   (struct sockaddr *)&(pClient->Addr), pClient->AddrLen);
+    else
+      Len = send(pClient->Fd, pMsg->Data + pClient->Offset,
+                 pMsg->Len - pClient->Offset, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (Len < 0)
+    {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+        break;
+      if (pClient->Dgram && (errno != ECONNREFUSED) && (errno != ENOENT))
+      {
+        // Lose the message, not the peer
+        pClient->Stats.Dropped++;
+        Len = pMsg->Len;
+      }
+      else
+      {
+        Len = -errno;
+        LLC_IPCDrop(pIPC, pClient);
+        return Len;
+      }
+    }
+    else if (!pClient->Dgram)
+    {
+      pClient->Offset += Len;
+      if (pClient->Offset < pMsg->Len)
+        break;
+      pClient->Stats.Sent++;
+    }
+    else
+    {
+      pClient->Stats.Sent++;
+    }
+
+    pClient->Offset = 0;
+    pClient->Head = (pClient->Head + 1) % LLC_IPC_QUEUE_DEPTH;
+    pClient->Cnt--;
+    LLC_IPCMsgPut(pMsg);
+  }
+
+  // Everything before the ring takes over has gone, so hand it over
+  if ((pClient->Cnt == 0) && pClient->ShareReq)
+  {
+    Len = LLC_IPCSendFd(pIPC, pClient);
+    if (Len == 0)
+    {
+      pClient->ShareReq = false;
+      pClient->Shared = true;
+      d_printf(D_INFO, NULL, "IPC client %d reads the ring from %llu\n",
+               (int)(pClient - pIPC->Clients),
+               (unsigned long long)pClient->ShareSeq);
+    }
+    else if ((Len != -EAGAIN) && (Len != -EWOULDBLOCK) && (Len != -EINTR))
+    {
+      LLC_IPCDrop(pIPC, pClient);
+      return Len;
+    }
+  }
+
+  LLC_IPCArm(pIPC, pClient);
+  return 0;
+}
+
+/**
+ * @brief Queue a message for a client, making room as per the policy
+ * @param pIPC
+ * @param pClient
+ * @param pMsg
+ */
+static void LLC_IPCEnqueue (tLLCIPC *pIPC,
+                            tLLCIPCClient *pClient,
+                            tLLCIPCMsg *pMsg)
+{
+  uint32_t First;
+  uint32_t Victim;
+  uint32_t i;
+
+  if (pClient->Cnt == LLC_IPC_QUEUE_DEPTH)
+  {
+    // The partly written message has to be finished
+    First = (pClient->Offset > 0) ? 1 : 0;
+    Victim = First;
+    if (pIPC->Policy == LLC_IPC_DROP_LOWEST)
+    {
+      for (i = First; i < pClient->Cnt; i++)
+      {
+        if (pClient->pQueue[(pClient->Head + i) % LLC_IPC_QUEUE_DEPTH]->Priority <
+            pClient->pQueue[(pClient->Head + Victim) % LLC_IPC_QUEUE_DEPTH]->Priority)
+          Victim = i;
+      }
+      if (pMsg->Priority <
+          pClient->pQueue[(pClient->Head + Victim) % LLC_IPC_QUEUE_DEPTH]->Priority)
+      {
+        pClient->Stats.Dropped++;
+        return;
+      }
+    }
+
+    LLC_IPCMsgPut(pClient->pQueue[(pClient->Head + Victim) % LLC_IPC_QUEUE_DEPTH]);
+    for (i = Victim; i + 1 < pClient->Cnt; i++)
+      pClient->pQueue[(pClient->Head + i) % LLC_IPC_QUEUE_DEPTH] =
+        pClient->pQueue[(pClient->Head + i + 1) % LLC_IPC_QUEUE_DEPTH];
+    pClient->Cnt--;
+    pClient->Stats.Dropped++;
+  }
+
+  pMsg->RefCnt++;
+  pClient->pQueue[(pClient->Head + pClient->Cnt) % LLC_IPC_QUEUE_DEPTH] = pMsg;
+  pClient->Cnt++;
+  if (pClient->Cnt > pClient->Stats.QueueMax)
+    pClient->Stats.QueueMax = pClient->Cnt;
+}
+
+/**
+ * @brief Get the current (monotonic) time
+ * @return CLOCK_MONOTONIC time [ms]
+ */
+static uint64_t LLC_IPCTime (void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return ((uint64_t)Now.tv_sec * 1000) + (Now.tv_nsec / 1000000);
+}
+
+/**
+ * @brief Check a message against a client's subscription
+ * @param pFilter The client's subscription
+ * @param pMeta What the message is
+ * @param Now [ms]
+ * @param Update It will be sent (so restart the MinInterval)
+ * @return true if the client wants it
+ */
+static bool LLC_IPCFilterPass (tLLCIPCFilter *pFilter,
+                               const tLLCIPCMeta *pMeta,
+                               uint64_t Now,
+                               bool Update)
+{
+  uint32_t Slot;
+
+  if (!pFilter->Set)
+    return true;
+  if (!(pFilter->Mask[pMeta->Protocol / 8] & (1 << (pMeta->Protocol % 8))))
+    return false;
+  if ((pFilter->MaxDistance != 0) &&
+      (pMeta->Distance != LLC_IPC_DISTANCE_UNKNOWN) &&
+      (pMeta->Distance > pFilter->MaxDistance))
+    return false;
+  if (pFilter->MinInterval == 0)
+    return true;
+
+  Slot = ((pMeta->Source * 2654435761U) ^ pMeta->Protocol) %
+         LLC_IPC_RATE_SLOTS;
+  if ((pFilter->Last[Slot].Time != 0) &&
+      (pFilter->Last[Slot].Source == pMeta->Source) &&
+      (pFilter->Last[Slot].Protocol == pMeta->Protocol) &&
+      ((Now - pFilter->Last[Slot].Time) < pFilter->MinInterval))
+    return false;
+  if (Update)
+  {
+    pFilter->Last[Slot].Source = pMeta->Source;
+    pFilter->Last[Slot].Protocol = pMeta->Protocol;
+    pFilter->Last[Slot].Time = Now;
+  }
+  return true;
+}
+
+/**
+ * @brief Check whether any client wants a message (before encoding it)
+ * @param pIPC
+ * @param pMeta What the message is
+ * @return true if LLC_IPCSend() would send it to anyone
+ */
+bool LLC_IPCWanted (tLLCIPC *pIPC,
+                    const tLLCIPCMeta *pMeta)
+{
+  tLLCIPCClient *pClient;
+  uint64_t Now = 0;
+  int i;
+
+  for (i = 0; i < LLC_IPC_CLIENT_MAX; i++)
+  {
+    pClient = &(pIPC->Clients[i]);
+    if (!pClient->Used)
+      continue;
+    // Ring readers see everything
+    if (pClient->ShareReq || pClient->Shared || (pMeta == NULL))
+      return true;
+    if (pClient->Filter.Set && (Now == 0))
+      Now = LLC_IPCTime();
+    if (LLC_IPCFilterPass(&(pClient->Filter), pMeta, Now, false))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Send a message to every client that wants it
+ * @param pIPC
+ * @param pBuf The (encoded) message
+ * @param Len Its length [bytes]
+ * @param pMeta What it is (for the subscriptions and queue priority), or NULL
+ *              to send it to everyone at the lowest priority
+ * @return The number of clients it was queued for, or a negative errno
+ */
+int LLC_IPCSend (tLLCIPC *pIPC,
+                 const void *pBuf,
+                 int Len,
+                 const tLLCIPCMeta *pMeta)
+{
+  tLLCIPCClient *pClient;
+  tLLCIPCMsg *pMsg = NULL;
+  uint8_t Priority = (pMeta != NULL) ? pMeta->Priority : 0;
+  uint64_t Now = 0;
+  int Cnt = 0;
+  int i;
+
+  if (pIPC->ClientCnt == 0)
+    return 0;
+  if ((Len <= 0) || (Len > LLC_IPC_MSG_MAX))
+    return -EMSGSIZE;
+
+  // One copy for every ring reader
+  if (pIPC->pRing != NULL)
+    (void)LLC_ShmRingPut(pIPC->pRing, pBuf, Len, Priority);
+
+  for (i = 0; i < LLC_IPC_CLIENT_MAX; i++)
+  {
+    pClient = &(pIPC->Clients[i]);
+    if ((!pClient->Used) || pClient->ShareReq || pClient->Shared)
+      continue;
+    if ((pMeta != NULL) && pClient->Filter.Set)
+    {
+      if (Now == 0)
+        Now = LLC_IPCTime();
+      if (!LLC_IPCFilterPass(&(pClient->Filter), pMeta, Now, true))
+      {
+        pClient->Filter.Filtered++;
+        continue;
+      }
+    }
+
+    // Only copied once someone wants it
+    if (pMsg == NULL)
+    {
+      pMsg = malloc(sizeof(*pMsg) + Len);
+      if (pMsg == NULL)
+        return -ENOMEM;
+      // The sender's hold, released below
+      pMsg->RefCnt = 1;
+      pMsg->Priority = Priority;
+      pMsg->Len = Len;
+      memcpy(pMsg->Data, pBuf, Len);
+    }
+    LLC_IPCEnqueue(pIPC, pClient, pMsg);
+    Cnt++;
+    // Otherwise the event loop writes it once there is room
+    if (!pClient->OutArmed)
+      (void)LLC_IPCFlush(pIPC, pClient);
+  }
+
+  if (pMsg != NULL)
+    LLC_IPCMsgPut(pMsg);
+  return Cnt;
+}
+
+/**
+ * @brief Set (or clear) a client's subscription
+ * @param pIPC
+ * @param pClient
+ * @param pData Mask[32] MaxDistance[2] MinInterval[2] (the last two optional)
+ * @param Len Length of pData [bytes] (zero to clear it)
+ */
+static void LLC_IPCSubscribe (tLLCIPC *pIPC,
+                              tLLCIPCClient *pClient,
+                              const uint8_t *pData,
+                              int Len)
+{
+  tLLCIPCFilter *pFilter = &(pClient->Filter);
+  uint32_t Filtered = pFilter->Filtered;
+
+  memset(pFilter, 0, sizeof(*pFilter));
+  pFilter->Filtered = Filtered;
+  if (Len < (int)sizeof(pFilter->Mask))
+  {
+    d_printf(D_INFO, NULL, "IPC client %d unsubscribed\n",
+             (int)(pClient - pIPC->Clients));
+    return;
+  }
+  memcpy(pFilter->Mask, pData, sizeof(pFilter->Mask));
+  if (Len >= 34)
+    pFilter->MaxDistance = pData[32] | (pData[33] << 8);
+  if (Len >= 36)
+    pFilter->MinInterval = pData[34] | (pData[35] << 8);
+  pFilter->Set = true;
+  d_printf(D_INFO, NULL, "IPC client %d subscribed (%u m, %u ms)\n",
+           (int)(pClient - pIPC->Clients), pFilter->MaxDistance,
+           pFilter->MinInterval);
+}
+
+/**
+ * @brief Handle a request meant for the server itself
+ * @param pIPC
+ * @param pClient The client it came from (or NULL if it can't be replied to)
+ * @param pBuf The message
+ * @param Len Its length [bytes]
+ * @param Framed It is a whole frame (so its data follows the frame header)
+ * @return true if it was such a request
+ */
+static bool LLC_IPCControl (tLLCIPC *pIPC,
+                            tLLCIPCClient *pClient,
+                            const uint8_t *pBuf,
+                            int Len,
+                            bool Framed)
+{
+  if ((Len < 3) || (pBuf[0] != LLC_FRAME_SYNC) || (pBuf[1] != LLC_FRAME_SYNC))
+    return false;
+
+  if (pBuf[2] == LLC_IPC_PROTO_SUBSCRIBE)
+  {
+    if (pClient == NULL)
+      d_printf(D_WARN, NULL, "IPC subscription from an unbound peer\n");
+    else if (Framed)
+      LLC_IPCSubscribe(pIPC, pClient, pBuf + LLC_FRAME_HDR_LEN,
+                       Len - (LLC_FRAME_HDR_LEN + 2));
+    else
+      LLC_IPCSubscribe(pIPC, pClient, pBuf + 3, Len - 3);
+    return true;
+  }
+  if (pBuf[2] != LLC_IPC_PROTO_SHARE)
+    return false;
+
+  if ((pIPC->pRing == NULL) || (pClient == NULL) || pClient->Shared)
+  {
+    d_printf(D_WARN, NULL, "IPC ring request ignored\n");
+    return true;
+  }
+  if (!pClient->ShareReq)
+  {
+    pClient->ShareReq = true;
+    pClient->ShareSeq = pIPC->pRing->Head;
+  }
+  // Otherwise it is sent once there's room
+  if (!pClient->OutArmed)
+    (void)LLC_IPCFlush(pIPC, pClient);
+  return true;
+}
+
+/**
+ * @brief Pass on a message parsed from a stream client (see LLC_FrameFeed())
+ */
+static void LLC_IPCStreamFrame (uint8_t *pFrame,
+                                int Len,
+                                bool Legacy,
+                                void *pPriv)
+{
+  tLLCIPCClient *pClient = (tLLCIPCClient *)pPriv;
+  tLLCIPC *pIPC = pClient->pIPC;
+
+  if (LLC_IPCControl(pIPC, pClient, pFrame, Len, !Legacy))
+    return;
+  if (pIPC->Recv != NULL)
+    pIPC->Recv(pIPC, Legacy ? LLC_IPC_RECV_STREAM : LLC_IPC_RECV_FRAME,
+               pFrame, Len);
+}
+
+/**
+ * @brief Data, room or a hang up on a stream client's socket
+ */
+static int LLC_IPCStreamEvent (int Fd,
+                               uint32_t Events,
+                               void *pPriv)
+{
+  tLLCIPCClient *pClient = (tLLCIPCClient *)pPriv;
+  tLLCIPC *pIPC = pClient->pIPC;
+  ssize_t Len;
+
+  if (Events & LLC_EVENT_IN)
+  {
+    Len = recv(Fd, pIPC->RxBuf, sizeof(pIPC->RxBuf), MSG_DONTWAIT);
+    if (Len == 0)
+    {
+      LLC_IPCDrop(pIPC, pClient);
+      return 0;
+    }
+    if (Len < 0)
+    {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+        return 0;
+      Len = -errno;
+      LLC_IPCDrop(pIPC, pClient);
+      return Len;
+    }
+    // Reads needn't line up with messages: yields zero or more of them
+    (void)LLC_FrameFeed(&(pClient->Parser), pIPC->RxBuf, Len,
+                        LLC_IPCStreamFrame, pClient);
+    // Sending a reply may have found it gone
+    if (!pClient->Used)
+      return 0;
+  }
+  else if (Events & LLC_EVENT_ERROR)
+  {
+    LLC_IPCDrop(pIPC, pClient);
+    return 0;
+  }
+
+  if (Events & LLC_EVENT_OUT)
+    return LLC_IPCFlush(pIPC, pClient);
+  return 0;
+}
+
+/**
+ * @brief A client is connecting to the stream socket
+ */
+static int LLC_IPCListenEvent (int Fd,
+                               uint32_t Events,
+                               void *pPriv)
+{
+  tLLCIPC *pIPC = (tLLCIPC *)pPriv;
+  tLLCIPCClient *pClient;
+  int Res;
+  int ClientFd;
+
+  ClientFd = accept4(Fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (ClientFd < 0)
+    return ((errno == EAGAIN) || (errno == EINTR)) ? 0 : -errno;
+
+  pClient = LLC_IPCAlloc(pIPC);
+  if (pClient == NULL)
+  {
+    d_printf(D_WARN, NULL, "IPC client refused (%d connected)\n",
+             pIPC->ClientCnt);
+    close(ClientFd);
+    return 0;
+  }
+
+  pClient->Fd = ClientFd;
+  LLC_FrameReset(&(pClient->Parser));
+  Res = LLC_EventAdd(pIPC->pLoop, ClientFd, LLC_EVENT_IN, LLC_IPCStreamEvent,
+                     pClient);
+  if (Res < 0)
+  {
+    close(ClientFd);
+    pClient->Fd = -1;
+    return Res;
+  }
+  pClient->pIPC = pIPC;
+  pClient->Used = true;
+  pIPC->ClientCnt++;
+  d_printf(D_INFO, NULL, "IPC client %d connected\n",
+           (int)(pClient - pIPC->Clients));
+  return 0;
+}
+
+/**
+ * @brief Find (or add) the datagram peer a message came from
+ * @param pIPC
+ * @param pAddr
+ * @param AddrLen
+ * @return The peer, or NULL if it can't be replied to (an unbound socket) or
+ *         there is no free slot
+ */
+static tLLCIPCClient *LLC_IPCPeer (tLLCIPC *pIPC,
+                                   const struct sockaddr_un *pAddr,
+                                   socklen_t AddrLen)
+{
+  tLLCIPCClient *pClient;
+  int i;
+
+  if (AddrLen <= offsetof(struct sockaddr_un, sun_path))
+    return NULL;
+
+  for (i = 0; i < LLC_IPC_CLIENT_MAX; i++)
+  {
+    pClient = &(pIPC->Clients[i]);
+    if (pClient->Used && pClient->Dgram && (pClient->AddrLen == AddrLen) &&
+        (memcmp(&(pClient->Addr), pAddr, AddrLen) == 0))
+      return pClient;
+  }
+
+  pClient = LLC_IPCAlloc(pIPC);
+  if (pClient == NULL)
+    return NULL;
+  memcpy(&(pClient->Addr), pAddr, AddrLen);
+  pClient->AddrLen = AddrLen;
+  pClient->Fd = -1;
+  pClient->Dgram = true;
+  pClient->pIPC = pIPC;
+  pClient->Used = true;
+  pIPC->ClientCnt++;
+  d_printf(D_INFO, NULL, "IPC peer %d added\n",
+           (int)(pClient - pIPC->Clients));
+  return pClient;
+}
+
+/**
+ * @brief A message on (or room in) the datagram socket
+ */
+static int LLC_IPCDgramEvent (int Fd,
+                              uint32_t Events,
+                              void *pPriv)
+{
+  tLLCIPC *pIPC = (tLLCIPC *)pPriv;
+  tLLCIPCClient *pClient;
+  struct sockaddr_un Addr;
+  socklen_t AddrLen = sizeof(Addr);
+  ssize_t Len;
+  int i;
+
+  if (Events & LLC_EVENT_IN)
+  {
+    Len = recvfrom(Fd, pIPC->RxBuf, sizeof(pIPC->RxBuf), MSG_DONTWAIT,
+                   (struct sockaddr *)&Addr, &AddrLen);
+    if (Len > 0)
+    {
+      // Replies go to every peer, so remember it first
+      pClient = LLC_IPCPeer(pIPC, &Addr, AddrLen);
+      if ((!LLC_IPCControl(pIPC, pClient, pIPC->RxBuf, Len, false)) &&
+          (pIPC->Recv != NULL))
+        pIPC->Recv(pIPC, LLC_IPC_RECV_DGRAM, pIPC->RxBuf, Len);
+    }
+  }
+
+  if (Events & LLC_EVENT_OUT)
+  {
+    for (i = 0; i < LLC_IPC_CLIENT_MAX; i++)
+    {
+      if (pIPC->Clients[i].Used && pIPC->Clients[i].Dgram)
+        (void)LLC_IPCFlush(pIPC, &(pIPC->Clients[i]));
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Create and bind a socket to an abstract unix socket name
+ * @param Type SOCK_STREAM or SOCK_DGRAM
+ * @param pName
+ * @return The socket, or a negative errno
+ */
+static int LLC_IPCSocket (int Type,
+                          const char *pName)
+{
+  struct sockaddr_un Addr;
+  socklen_t AddrLen;
+  const int On = 1;
+  int Res;
+  int Fd;
+
+  Fd = socket(AF_LOCAL, Type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (Fd < 0)
+    return -errno;
+
+  // Abstract socket name (leading '\0')
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_LOCAL;
+  strncpy(Addr.sun_path + 1, pName, sizeof(Addr.sun_path) - 2);
+  AddrLen = offsetof(struct sockaddr_un, sun_path) + 1 +
+            strlen(Addr.sun_path + 1);
+
+  if ((Type == SOCK_STREAM) &&
+      (setsockopt(Fd, SOL_SOCKET, SO_REUSEADDR, &On, sizeof(On)) < 0))
+    goto Error;
+  if (bind(Fd, (struct sockaddr *)&Addr, AddrLen) < 0)
+    goto Error;
+  if ((Type == SOCK_STREAM) && (listen(Fd, LLC_IPC_CLIENT_MAX) < 0))
+    goto Error;
+  return Fd;
+
+Error:
+  Res = -errno;
+  d_error(D_ERR, NULL, "Socket @%s: %s\n", pName, strerror(errno));
+  close(Fd);
+  return Res;
+}
+
+/**
+ * @brief Create the sockets and register them with the event loop
+ * @param pIPC
+ * @param pLoop
+ * @param pStreamName Abstract name of the stream socket
+ * @param pDgramName Abstract name of the datagram socket
+ * @param Policy What to drop when a client's queue is full
+ * @param Recv Called with each message from a client
+ * @return Zero or a negative errno
+ */
+int LLC_IPCInit (tLLCIPC *pIPC,
+                 tLLCEventLoop *pLoop,
+                 const char *pStreamName,
+                 const char *pDgramName,
+                 eLLCIPCPolicy Policy,
+                 fLLCIPCRecv Recv)
+{
+  int Res;
+  int i;
+
+  d_fnstart(D_TST, NULL, "(@%s @%s)\n", pStreamName, pDgramName);
+
+  memset(pIPC, 0, sizeof(*pIPC));
+  pIPC->pLoop = pLoop;
+  pIPC->Policy = Policy;
+  pIPC->Recv = Recv;
+  for (i = 0; i < LLC_IPC_CLIENT_MAX; i++)
+    pIPC->Clients[i].Fd = -1;
+
+  pIPC->ListenFd = LLC_IPCSocket(SOCK_STREAM, pStreamName);
+  pIPC->DgramFd = LLC_IPCSocket(SOCK_DGRAM, pDgramName);
+  if ((pIPC->ListenFd < 0) || (pIPC->DgramFd < 0))
+  {
+    Res = (pIPC->ListenFd < 0) ? pIPC->ListenFd : pIPC->DgramFd;
+    goto Error;
+  }
+
+  Res = LLC_EventAdd(pLoop, pIPC->ListenFd, LLC_EVENT_IN, LLC_IPCListenEvent,
+                     pIPC);
+  if (Res < 0)
+    goto Error;
+  Res = LLC_EventAdd(pLoop, pIPC->DgramFd, LLC_EVENT_IN, LLC_IPCDgramEvent,
+                     pIPC);
+
+Error:
+  if (Res < 0)
+    LLC_IPCExit(pIPC);
+  d_fnend(D_TST, NULL, "(@%s @%s) = %d\n", pStreamName, pDgramName, Res);
+  return Res;
+}
+
+/**
+ * @brief Offer clients a shared memory ring (see LLC_IPC_PROTO_SHARE)
+ * @param pIPC
+ * @param pRing The ring (written by LLC_IPCSend() from now on)
+ */
+void LLC_IPCShare (tLLCIPC *pIPC,
+                   tLLCShmRing *pRing)
+{
+  pIPC->pRing = pRing;
+}
+
+/**
+ * @brief Disconnect the clients and close the sockets
+ * @param pIPC
+ */
+void LLC_IPCExit (tLLCIPC *pIPC)
+{
+  int i;
+
+  if (pIPC->pLoop == NULL)
+    return;
+
+  for (i = 0; i < LLC_IPC_CLIENT_MAX; i++)
+  {
+    if (pIPC->Clients[i].Used)
+      LLC_IPCDrop(pIPC, &(pIPC->Clients[i]));
+  }
+  if (pIPC->ListenFd >= 0)
+  {
+    (void)LLC_EventDel(pIPC->pLoop, pIPC->ListenFd);
+    close(pIPC->ListenFd);
+  }
+  if (pIPC->DgramFd >= 0)
+  {
+    (void)LLC_EventDel(pIPC->pLoop, pIPC->DgramFd);
+    close(pIPC->DgramFd);
+  }
+  pIPC->ListenFd = -1;
+  pIPC->DgramFd = -1;
+  pIPC->pLoop = NULL;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,267 @@
+/**
+ * @addtogroup cohda_llc_intern_app LLC application
+ * @{
+ *
+ * @file
+ * LLC: Local (Android) IPC server
+ *
+ * Any number of clients (up to LLC_IPC_CLIENT_MAX) connect to the stream
+ * socket, or send from a bound socket to the datagram socket. Each message is
+ * encoded once and queued (by reference) for every client. A client's queue
+ * is bounded and only drained when its socket has room, so a stalled client
+ * loses its own messages (oldest or lowest priority first) rather than
+ * holding up the radio.
+ *
+ * With a shared memory ring (see LLC_IPCShare()) each message is also written
+ * to the ring, once. A client asks for the ring by sending
+ * '0x29 0x29 LLC_IPC_PROTO_SHARE' (as a legacy write, a frame or a datagram).
+ * Once its queue has drained it is sent '0x29 0x29 LLC_IPC_PROTO_SHARE' and
+ * the number of the first record it wasn't sent (8 bytes, little endian),
+ * with the ring's descriptor attached (SCM_RIGHTS). It is then sent nothing
+ * more on the socket, but must keep it open.
+ *
+ * A client can limit what it is sent with a subscription:
+ * @verbatim
+    0x29 0x29 LLC_IPC_PROTO_SUBSCRIBE Mask[32] MaxDistance[2] MinInterval[2]
+   @endverbatim
+ * (or the same fields as the data of a frame). Bit N of the mask (bit N % 8
+ * of byte N / 8) lets through protocol N. MaxDistance [m] drops messages
+ * from further away (if their distance is known), and MinInterval [ms] any
+ * that follow one of the same protocol from the same sender too soon. Both
+ * are optional (zero for no limit), and a subscription with no mask at all
+ * lets everything through again. Ring readers filter for themselves.
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2015 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+#ifndef __LLC_IPC_H__
+#define __LLC_IPC_H__
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "llc-event.h"
+#include "llc-frame.h"
+#include "llc-shmring.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Most clients (stream and datagram together)
+#define LLC_IPC_CLIENT_MAX  (8)
+/// Messages queued per client
+#define LLC_IPC_QUEUE_DEPTH (64)
+/// Largest message [bytes]
+#define LLC_IPC_MSG_MAX     (2048)
+/// Protocol byte of a request for the shared memory ring
+#define LLC_IPC_PROTO_SHARE (0xfe)
+/// Length of the reply to a LLC_IPC_PROTO_SHARE request [bytes]
+#define LLC_IPC_SHARE_LEN   (3 + 8)
+/// Protocol byte of a subscription
+#define LLC_IPC_PROTO_SUBSCRIBE (0xfd)
+/// Senders whose last message is remembered per client (for MinInterval)
+#define LLC_IPC_RATE_SLOTS  (32)
+/// Distance of a message whose sender's position isn't known
+#define LLC_IPC_DISTANCE_UNKNOWN (UINT32_MAX)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+/// What to drop when a client's queue is full
+typedef enum LLCIPCPolicy
+{
+  /// The oldest queued message
+  LLC_IPC_DROP_OLDEST = 0,
+  /// The oldest of the lowest priority messages (or the new message, if its
+  /// priority is lower still)
+  LLC_IPC_DROP_LOWEST = 1,
+} eLLCIPCPolicy;
+
+/// An encoded message (shared by the client queues)
+typedef struct LLCIPCMsg
+{
+  /// Number of queues (and senders) holding it
+  uint32_t RefCnt;
+  /// Higher is more important
+  uint8_t Priority;
+  /// Length [bytes]
+  uint16_t Len;
+  /// The message
+  uint8_t Data[];
+} tLLCIPCMsg;
+
+/// What a message is (for the client subscriptions)
+typedef struct LLCIPCMeta
+{
+  /// Protocol byte
+  uint8_t Protocol;
+  /// Higher is more important (see LLC_IPC_DROP_LOWEST)
+  uint8_t Priority;
+  /// Identifies the sender (zero if there isn't one)
+  uint32_t Source;
+  /// From here [m] (or LLC_IPC_DISTANCE_UNKNOWN)
+  uint32_t Distance;
+} tLLCIPCMeta;
+
+/// A client's subscription
+typedef struct LLCIPCFilter
+{
+  /// Subscribed (otherwise everything is let through)
+  bool Set;
+  /// Protocols let through
+  uint8_t Mask[32];
+  /// Furthest sender [m] (zero for any)
+  uint16_t MaxDistance;
+  /// Least time between messages of the same sender and protocol [ms]
+  uint16_t MinInterval;
+  /// The last message let through, by sender and protocol (a hash table
+  /// without chaining, so a collision can let one through early)
+  struct
+  {
+    uint32_t Source;
+    uint8_t Protocol;
+    /// [ms] (zero if unused)
+    uint64_t Time;
+  } Last[LLC_IPC_RATE_SLOTS];
+  /// Messages filtered out
+  uint32_t Filtered;
+} tLLCIPCFilter;
+
+struct LLCIPC;
+
+/// A client
+typedef struct LLCIPCClient
+{
+  /// The server it is connected to
+  struct LLCIPC *pIPC;
+  /// Slot in use
+  bool Used;
+  /// A datagram peer (sent to at Addr through the datagram socket)
+  bool Dgram;
+  /// Waiting for room in the socket (EPOLLOUT registered)
+  bool OutArmed;
+  /// Asked for the ring (sent once the queue has drained)
+  bool ShareReq;
+  /// Reads the ring (so is sent nothing more)
+  bool Shared;
+  /// First ring record it wasn't sent on the socket
+  uint64_t ShareSeq;
+  /// Stream socket (-1 for datagram peers)
+  int Fd;
+  /// Datagram peer address
+  struct sockaddr_un Addr;
+  socklen_t AddrLen;
+  /// Outbound queue
+  tLLCIPCMsg *pQueue[LLC_IPC_QUEUE_DEPTH];
+  /// Oldest queued message
+  uint32_t Head;
+  /// Number of queued messages
+  uint32_t Cnt;
+  /// Bytes of the oldest message already written (stream only)
+  uint32_t Offset;
+  /// Inbound frame parser (stream only)
+  tLLCFrameParser Parser;
+  /// Subscription
+  tLLCIPCFilter Filter;
+  /// Counters
+  struct
+  {
+    uint32_t Sent;
+    uint32_t Dropped;
+    uint32_t QueueMax;
+  } Stats;
+} tLLCIPCClient;
+
+/// How an inbound message arrived
+typedef enum LLCIPCRecvType
+{
+  /// A datagram
+  LLC_IPC_RECV_DGRAM = 0,
+  /// A whole read from a stream client that hasn't sent a frame (legacy)
+  LLC_IPC_RECV_STREAM = 1,
+  /// A complete, checked frame from a stream client (see llc-frame.h)
+  LLC_IPC_RECV_FRAME = 2,
+} eLLCIPCRecvType;
+
+/**
+ * @brief Called with each message from a client
+ * @param pIPC
+ * @param Type How it arrived
+ * @param pBuf The message
+ * @param Len Its length [bytes]
+ */
+typedef void (*fLLCIPCRecv) (struct LLCIPC *pIPC,
+                             eLLCIPCRecvType Type,
+                             uint8_t *pBuf,
+                             int Len);
+
+/// IPC server state
+typedef struct LLCIPC
+{
+  /// Event loop the sockets are registered with
+  tLLCEventLoop *pLoop;
+  /// Listening stream socket
+  int ListenFd;
+  /// Datagram socket
+  int DgramFd;
+  /// EPOLLOUT registered on the datagram socket
+  bool DgramOutArmed;
+  /// Queue overflow policy
+  eLLCIPCPolicy Policy;
+  /// Inbound message handler
+  fLLCIPCRecv Recv;
+  /// Shared memory ring (or NULL)
+  tLLCShmRing *pRing;
+  /// Number of clients
+  int ClientCnt;
+  /// Clients turned away (no free slot)
+  uint32_t Rejected;
+  /// Clients
+  tLLCIPCClient Clients[LLC_IPC_CLIENT_MAX];
+  /// Inbound message buffer
+  uint8_t RxBuf[LLC_IPC_MSG_MAX];
+} tLLCIPC;
+
+//------------------------------------------------------------------------------
+// Function declarations
+//------------------------------------------------------------------------------
+
+int LLC_IPCInit (tLLCIPC *pIPC,
+                 tLLCEventLoop *pLoop,
+                 const char *pStreamName,
+                 const char *pDgramName,
+                 eLLCIPCPolicy Policy,
+                 fLLCIPCRecv Recv);
+void LLC_IPCExit (tLLCIPC *pIPC);
+void LLC_IPCShare (tLLCIPC *pIPC,
+                   tLLCShmRing *pRing);
+
+bool LLC_IPCWanted (tLLCIPC *pIPC,
+                    const tLLCIPCMeta *pMeta);
+int LLC_IPCSend (tLLCIPC *pIPC,
+                 const void *pBuf,
+                 int Len,
+                 const tLLCIPCMeta *pMeta);
+
+/**
+ * @brief Number of connected clients (no point encoding anything if zero)
+ */
+static inline int LLC_IPCClientCnt (const tLLCIPC *pIPC)
+{
+  return pIPC->ClientCnt;
+}
+
+#endif // __LLC_IPC_H__
+
+/**
+ * @}
+ */
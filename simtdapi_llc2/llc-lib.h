@@ -23,9 +23,11 @@
 #include <netinet/in.h>
 #include <sys/ioctl.h>
 #include <net/if.h>
+#include <pthread.h>
 #include <pcap.h>
 
 #include "linux/cohda/llc/llc-api.h"
+#include "llc-api-ext.h"
 
 //------------------------------------------------------------------------------
 // Macros & Constants
@@ -41,21 +43,159 @@
 /// 'Magic' value inside a #tLLCDev
 #define LLC_DEV_MAGIC          (MKX_API_MAGIC)
 
+/// Default MKx network interface (used by MKx_Init())
+#if defined(__QNX__)
+#define LLC_IFNAME_DEFAULT "llc0"
+#else
+#define LLC_IFNAME_DEFAULT "cw-llc"
+#endif
+
 /// Maximum possible seqnum to allocate for outgoing TxReq's
 #define LLC_SEQNUM_MAX 4095
 
+/// End of a TxReqs list (not a valid seqnum)
+#define LLC_SEQNUM_NONE 0xFFFF
+
+/// Default time to wait for a TxCnf before reclaiming the TxReq slot [ms]
+#define LLC_TXCNF_TIMEOUT_DEFAULT 2000
+
+/// Maximum number of TxReq's passed to the transport in one go
+#define LLC_TX_BATCH_MAX 32
+
+/// Radio and channel are in range (for indexing per radio/channel state)
+#define LLC_RADIO_CHAN_VALID(Radio, Chan) \
+  (((Radio) >= MKX_RADIO_A) && ((Radio) < MKX_RADIO_COUNT) && \
+   ((Chan) >= MKX_CHANNEL_0) && ((Chan) < MKX_CHANNEL_COUNT))
+
+/// Receive thread delivery queues (see llc-thread.c)
+#define LLC_QUEUE_TXEVENT 0
+#define LLC_QUEUE_RXPACKET 1
+#define LLC_QUEUE_OTHER 2
+#define LLC_QUEUE_COUNT 3
+
 //------------------------------------------------------------------------------
 // Type definitions
 //------------------------------------------------------------------------------
 
+struct tpacket_block_desc;
+struct LLCDev;
+struct LLCRaw;
+struct LLCShm;
+
+/// Raw interface transport backend (see llc-if.c)
+typedef struct LLCTransport
+{
+  /// Name (as selected with the LLC_TRANSPORT environment variable)
+  const char *pName;
+  /// There is no LLC driver behind it (MKx_Get() keeps the local state)
+  bool NoDriver;
+  /// Open the interface (pDev->If.Name), setting pDev->If.Fd
+  int (*Setup) (struct LLCDev *pDev);
+  /// Close the interface
+  void (*Release) (struct LLCDev *pDev);
+  /// Send a message, returning the number of bytes sent or -1
+  int (*Send) (struct LLCDev *pDev,
+               char *pBuf,
+               int Len);
+  /// Send several messages (optional, else one Send() per message)
+  int (*SendBatch) (struct LLCDev *pDev,
+                    char **ppBuf,
+                    const int *pLen,
+                    int *pRes,
+                    int Cnt);
+  /// Get the next message (valid until the next call), or -EAGAIN
+  int (*Recv) (struct LLCDev *pDev,
+               char **ppBuf,
+               int *pLen);
+  /// Stop Recv() from waiting (optional, if it can wait at all)
+  int (*NonBlock) (struct LLCDev *pDev);
+  /// Hold the last received message in place (optional, for zero-copy)
+  void *(*RxHold) (struct LLCDev *pDev);
+  /// Drop a hold taken with RxHold()
+  int (*RxRelease) (struct LLCDev *pDev,
+                    void *pPriv);
+} tLLCTransport;
+
+/// Reference count on a TPACKET_V3 ring block (the zero-copy RxInd() pPriv)
+typedef struct LLCRingBlock
+{
+  /// Outstanding references (one is held while its frames are dispatched)
+  uint32_t Refs;
+} tLLCRingBlock;
+
 typedef struct LLCTxReq
 {
   /// Copy of the original TxReq message
   struct MKxTxPacket *pTxPacket;
   /// Storage for the private data passed to MKx_TxReq()
   void *pPriv;
+  /// When the TxReq was sent (CLOCK_MONOTONIC) [us]
+  uint64_t Time;
+  /// Next slot in the free list, the in-flight list or a software queue
+  uint16_t Next;
+  /// Previous slot in the in-flight list
+  uint16_t Prev;
+  /// Radio, channel and queue of the TxReq (for TxFlush())
+  tMKxRadio Radio;
+  tMKxChannel Chan;
+  tMKxTxQueue TxQ;
 } tLLCTxReq;
 
+/// Software transmit queue (see MKx_TxQueueConfig())
+typedef struct LLCTxQ
+{
+  /// Held TxReqs slots (oldest first, linked by Next)
+  uint16_t Head;
+  uint16_t Tail;
+  /// Dequeues left in the current weighted round
+  uint16_t Credit;
+  /// Counters (see MKx_TxQueueStats())
+  tLLCTxQStats Stats;
+} tLLCTxQ;
+
+/// Header of an entry in a receive thread delivery queue (the copy of the
+/// message follows it)
+typedef struct LLCQueueEntry
+{
+  /// CLOCK_MONOTONIC time the message was received [us]
+  uint64_t Time;
+  /// Reference on the message's Rx ring slot (if delivered in place)
+  void *pHold;
+  /// The message (the copy after this header, or in place in the Rx ring)
+  struct MKxIFMsg *pMsg;
+} tLLCQueueEntry;
+
+/// Single-producer (receive thread), single-consumer (MKx_Recv()) queue
+typedef struct LLCQueue
+{
+  /// Next entry to consume (only written by the consumer)
+  uint32_t Head __attribute__((aligned(64)));
+  /// Next entry to produce (only written by the producer)
+  uint32_t Tail __attribute__((aligned(64)));
+  /// Number of entries (a power of two)
+  uint32_t Cnt;
+  /// Size of each entry, including its tLLCQueueEntry header [bytes]
+  uint32_t Size;
+  /// Largest message that can be copied into an entry [bytes]
+  uint32_t MaxLen;
+  /// Entry storage (Cnt x Size bytes)
+  uint8_t *pEntries;
+} tLLCQueue;
+
+/// MKXIF_FLUSHQ message (the payload is not defined in llc-api.h)
+typedef struct LLCFlushQ
+{
+  /// Interface message header
+  tMKxIFMsg Hdr;
+  /// Radio to flush
+  tMKxRadio RadioID;
+  /// Channel to flush
+  tMKxChannel ChannelID;
+  /// Queue to flush (LLC_TXQ_ALL for every queue)
+  tMKxTxQueue TxQueue;
+  uint8_t Pad;
+} __attribute__((packed)) tLLCFlushQ;
+
 /// LLC device structure
 typedef struct LLCDev
 {
@@ -66,18 +206,54 @@ typedef struct LLCDev
   /// The MKx API object
   struct MKx MKx;
 
+  /// Next device in the list of all devices (see llc-device.c)
+  struct LLCDev *pNext;
+
   /// Interface handling parameters
   struct
   {
+    /// Name of the MKx network interface (e.g. 'cw-llc')
+    char Name[IFNAMSIZ];
+    /// Transport backend in use
+    const tLLCTransport *pTransport;
     /// libpcap handle for the raw socket
     pcap_t *pCap;
     /// The 'llc' interface file number (for internal ioctls)
     int Fd;
+    /// Receiving never waits for the pcap read timeout
+    bool NonBlock;
     /// Structure for issuing ioctl requests
     struct ifreq Ifr;
     #if defined(__QNX__)
     /// Structure for issuing ioctl requests
     struct ifdrv Ifd;
+    #else
+    /// TPACKET_V3 mmap()'d receive ring (pMap is NULL when using libpcap)
+    struct
+    {
+      /// Base address of the mapped ring
+      uint8_t *pMap;
+      /// Length of the mapping
+      size_t MapLen;
+      /// Size of each ring block [bytes]
+      unsigned int BlockSize;
+      /// Number of blocks in the ring
+      unsigned int BlockCnt;
+      /// Index of the next block to take from the kernel
+      unsigned int Block;
+      /// Per-block reference counts (BlockCnt entries)
+      tLLCRingBlock *pBlocks;
+      /// Block currently owned by userspace (NULL if none)
+      struct tpacket_block_desc *pBlockDesc;
+      /// Next frame to dispatch from the owned block
+      uint8_t *pFrame;
+      /// Number of frames not yet dispatched from the owned block
+      unsigned int FramesLeft;
+    } Ring;
+    /// AF_PACKET socket batch receive state (see llc-if-raw.c)
+    struct LLCRaw *pRaw;
+    /// Shared memory rings (see llc-if-shm.c)
+    struct LLCShm *pShm;
     #endif
   } If;
 
@@ -90,13 +266,160 @@ typedef struct LLCDev
     uint8_t *pRxBuf;
     /// RxAlloc() private pointer
     void *pRxPriv;
+    /// Reference already held on the current message's Rx ring slot
+    void *pRxHold;
+    /// When the current message was received (CLOCK_MONOTONIC) [us]
+    uint64_t RxTime;
+    /// Pass received packets to RxInd() in place (see MKx_RxZeroCopy())
+    bool RxZeroCopy;
+    /// Message statistics (see MKx_GetLibStats())
+    tLLCLibStats Stats;
 
     /// Storage of outgoing TxReq's (to associate with corresponding TxCnf)
     tLLCTxReq TxReqs[LLC_SEQNUM_MAX + 1];
-    /// Counter for next sequence number into TxReqs
-    uint16_t Cnt;
+    /// Free TxReqs slots (FIFO, so seqnums are reused as late as possible)
+    struct
+    {
+      uint16_t Head;
+      uint16_t Tail;
+    } Free;
+    /// TxReqs slots awaiting a TxCnf (oldest first)
+    struct
+    {
+      uint16_t Head;
+      uint16_t Tail;
+      /// Number of slots in the list
+      int Cnt;
+      /// ... for each radio/channel
+      int ChanCnt[MKX_RADIO_COUNT][MKX_CHANNEL_COUNT];
+    } InFlight;
+    /// Reclaim slots with no TxCnf after this long [ms] (0: never)
+    unsigned int TxCnfTimeout;
+    /// Wait up to this long for a free slot in TxReq() [ms] (0: don't wait)
+    unsigned int TxBlock;
+    /// LLC_MsgRecv() is running (i.e. we may be inside a callback)
+    bool InRecv;
+    /// Software transmit queues (see MKx_TxQueueConfig())
+    struct
+    {
+      tLLCTxQConfig Config;
+      /// Releasing or flushing held frames (nothing more is released, even
+      /// from the TxCnf callbacks)
+      bool Busy;
+      /// Number of frames held in all queues
+      uint32_t Held;
+      /// Per radio, channel and queue
+      tLLCTxQ Q[MKX_RADIO_COUNT][MKX_CHANNEL_COUNT][MKX_TXQ_COUNT];
+    } TxQ;
   } Msg;
 
+  /// Receive thread (see llc-thread.c and MKx_RxThread())
+  struct
+  {
+    /// The receive thread is running
+    bool Enabled;
+    /// The receive thread
+    pthread_t Thread;
+    /// Readable while messages are queued (returned by MKx_Fd())
+    int EventFd;
+    /// Written to stop the receive thread
+    int StopFd;
+    /// Error that ended the receive thread (reported by MKx_Recv())
+    int Res;
+    /// Delivery queues: TxEvent's, RxPacket's and everything else
+    tLLCQueue Queue[LLC_QUEUE_COUNT];
+    /// RxPacket's dropped because their queue was full
+    uint32_t RxDropped;
+  } Thread;
+
+  /// Local TSF estimate (see llc-tsf.c)
+  struct
+  {
+    /// A TSF has been seen (the rest is valid)
+    bool Valid;
+    /// Reference point: estimated TSF at RefTime
+    tMKxTSF RefTSF;
+    /// Reference point: CLOCK_MONOTONIC time [us]
+    uint64_t RefTime;
+    /// Start of the current drift measurement: TSF
+    tMKxTSF AnchorTSF;
+    /// Start of the current drift measurement: CLOCK_MONOTONIC time [us]
+    uint64_t AnchorTime;
+    /// TSF rate relative to CLOCK_MONOTONIC, minus one
+    double Drift;
+    /// Uncertainty in Drift
+    double DriftErr;
+    /// Error bound at the reference point [us]
+    double Err;
+  } TSF;
+
+  /// Channel load history (see llc-cbr.c)
+  struct
+  {
+    /// When each radio's last stats message was received [us] (0 if none)
+    uint64_t LastTime[MKX_RADIO_COUNT];
+    /// The TSF in each radio's last stats message
+    tMKxTSF LastTSF[MKX_RADIO_COUNT];
+    /// Per radio and channel
+    struct LLCCBRChan
+    {
+      /// Airtime of our own transmissions since the last sample [us]
+      uint32_t TxAirtime;
+      /// Number of samples taken
+      uint32_t Cnt;
+      /// Smoothed CBR, TxDuty and RxDuty [0.1% << LLC_CBR_EWMA_SHIFT]
+      uint32_t CBR;
+      uint32_t TxDuty;
+      uint32_t RxDuty;
+      /// Sample ring (the latest is Samples[(Cnt - 1) % LLC_CBR_SAMPLE_CNT])
+      tLLCChannelSample Samples[LLC_CBR_SAMPLE_CNT];
+    } Chan[MKX_RADIO_COUNT][MKX_CHANNEL_COUNT];
+  } CBR;
+
+  /// Radio config shadow and requests (see llc-cfg.c)
+  struct LLCCfgRadio
+  {
+    /// The config last confirmed by the MKx
+    tMKxRadioConfigData Confirmed;
+    /// Confirmed is valid
+    bool Valid;
+    /// Sent is waiting for the MKx's reply
+    bool Busy;
+    /// Held is waiting for Sent to be confirmed
+    bool Held;
+    /// When Sent was sent [us]
+    uint64_t SentTime;
+    /// The request in flight, and the one held behind it
+    struct LLCCfgReq
+    {
+      tMKxRadioConfig Config;
+      /// LLC_CFG_CHANGED_* bits
+      uint32_t Changed;
+      fLLC_ConfigDone Done;
+      void *pPriv;
+    } Sent, Next;
+    tLLCConfigStats Stats;
+  } Cfg[MKX_RADIO_COUNT];
+
+  /// C2X security command pipeline (see llc-sec.c)
+  struct
+  {
+    tLLCC2XSecConfig Config;
+    /// USN to try next (LLC_SEC_USN_FIRST or above)
+    uint16_t NextUSN;
+    /// Outstanding commands, at [USN % LLC_SEC_WINDOW_MAX]
+    struct LLCSecCmd
+    {
+      bool Used;
+      uint16_t USN;
+      /// When it was sent [us]
+      uint64_t Time;
+      fLLC_C2XSecDone Done;
+      void *pPriv;
+    } Cmds[LLC_SEC_WINDOW_MAX];
+    tLLCC2XSecStats Stats;
+  } Sec;
+
   /// Exit flag
   bool Exit;
 
@@ -106,9 +429,12 @@ typedef struct LLCDev
 // Function declarations
 //------------------------------------------------------------------------------
 
-int LOCAL LLC_DeviceSetup (struct LLCDev *pDev);
+int LOCAL LLC_DeviceSetup (struct LLCDev *pDev,
+                           const char *pIfName);
 void LOCAL LLC_DeviceRelease (struct LLCDev *pDev);
-struct LOCAL LLCDev *LLC_DeviceGet (void);
+int LOCAL LLC_DeviceGet (const char *pIfName,
+                         struct LLCDev **ppDev);
+void LOCAL LLC_DeviceExitAll (void);
 struct LOCAL LLCDev *LLC_Device (struct MKx *pMKx);
 
 int LOCAL LLC_InterfaceSetup (struct LLCDev *pDev);
@@ -116,10 +442,43 @@ void LOCAL LLC_InterfaceRelease (struct LLCDev *pDev);
 int LOCAL LLC_InterfaceSend (struct LLCDev *pDev,
                              char *pBuf,
                              int Len);
+int LOCAL LLC_InterfaceSendBatch (struct LLCDev *pDev,
+                                  char **ppBuf,
+                                  const int *pLen,
+                                  int *pRes,
+                                  int Cnt);
 int LOCAL LLC_InterfaceRecv (struct LLCDev *pDev,
                              char **ppBuf,
                              int *pLen);
+int LOCAL LLC_InterfaceNonBlock (struct LLCDev *pDev);
+bool LOCAL LLC_InterfaceRxInPlace (struct LLCDev *pDev);
+void LOCAL *LLC_InterfaceRxHold (struct LLCDev *pDev);
+int LOCAL LLC_InterfaceRxRelease (struct LLCDev *pDev,
+                                  void *pPriv);
 
+extern const tLLCTransport LOCAL LLC_TransportPcap;
+#if !defined(__QNX__)
+extern const tLLCTransport LOCAL LLC_TransportRing;
+extern const tLLCTransport LOCAL LLC_TransportRaw;
+extern const tLLCTransport LOCAL LLC_TransportShm;
+int LOCAL LLC_RawBind (int Fd,
+                       const char *pIfName);
+int LOCAL LLC_RawSend (struct LLCDev *pDev,
+                       char *pBuf,
+                       int Len);
+int LOCAL LLC_RawSendBatch (struct LLCDev *pDev,
+                            char **ppBuf,
+                            const int *pLen,
+                            int *pRes,
+                            int Cnt);
+#endif
+
+
+void LOCAL LLC_ThreadSetup (struct LLCDev *pDev);
+int LOCAL LLC_ThreadStart (struct LLCDev *pDev);
+void LOCAL LLC_ThreadStop (struct LLCDev *pDev,
+                           bool Deliver);
+int LOCAL LLC_ThreadRecv (struct LLCDev *pDev);
 
 tMKxStatus LOCAL LLC_Config (struct MKx *pMKx,
                              tMKxRadio Radio,
@@ -161,9 +520,69 @@ tMKxStatus LLC_C2XSecReq (struct MKx *pMKx,
                           tMKxC2XSec *pMsg);
 tMKxStatus LLC_C2XSecInd (struct MKx *pMKx,
                           tMKxC2XSec *pMsg);
+void LOCAL LLC_TSFSetup (struct LLCDev *pDev);
+void LOCAL LLC_TSFSample (struct LLCDev *pDev,
+                          tMKxTSF TSF,
+                          uint64_t Now);
+int LOCAL LLC_TSFGet (struct LLCDev *pDev,
+                      tMKxTSF *pTSF,
+                      uint32_t *pErr);
+void LOCAL LLC_CBRSetup (struct LLCDev *pDev);
+void LOCAL LLC_CBRTx (struct LLCDev *pDev,
+                      tMKxTxPacket *pTxPkt);
+void LOCAL LLC_CBRSample (struct LLCDev *pDev,
+                          tMKxRadio Radio,
+                          tMKxChannel Chan,
+                          const tMKxRadioStatsData *pStats,
+                          uint64_t Now);
+int LOCAL LLC_CBRGet (struct LLCDev *pDev,
+                      tMKxRadio Radio,
+                      tMKxChannel Chan,
+                      tLLCChannelLoad *pLoad);
+int LOCAL LLC_CBRSamples (struct LLCDev *pDev,
+                          tMKxRadio Radio,
+                          tMKxChannel Chan,
+                          tLLCChannelSample *pSamples,
+                          int Cnt);
+void LOCAL LLC_CfgSetup (struct LLCDev *pDev);
+int LOCAL LLC_CfgApply (struct LLCDev *pDev,
+                        tMKxRadio Radio,
+                        const tMKxRadioConfigData *pConfig,
+                        fLLC_ConfigDone Done,
+                        void *pPriv);
+void LOCAL LLC_CfgInd (struct LLCDev *pDev,
+                       tMKxRadio Radio,
+                       const tMKxRadioConfigData *pConfig,
+                       tMKxStatus Ret);
+void LOCAL LLC_CfgReclaim (struct LLCDev *pDev);
+int LOCAL LLC_CfgStats (struct LLCDev *pDev,
+                        tMKxRadio Radio,
+                        tLLCConfigStats *pStats);
+void LOCAL LLC_SecSetup (struct LLCDev *pDev);
+int LOCAL LLC_SecConfig (struct LLCDev *pDev,
+                         const tLLCC2XSecConfig *pConfig);
+int LOCAL LLC_SecSubmit (struct LLCDev *pDev,
+                         tMKxC2XSec *pMsg,
+                         fLLC_C2XSecDone Done,
+                         void *pPriv);
+bool LOCAL LLC_SecInd (struct LLCDev *pDev,
+                       tMKxC2XSec *pMsg);
+void LOCAL LLC_SecReclaim (struct LLCDev *pDev);
+
+uint64_t LOCAL LLC_MsgTime (void);
 int LOCAL LLC_MsgSetup (struct LLCDev *pDev);
 int LOCAL LLC_MsgRelease (struct LLCDev *pDev);
+int LOCAL LLC_MsgFd (struct LLCDev *pDev);
+int LOCAL LLC_MsgGet (struct LLCDev *pDev,
+                      struct MKxIFMsg **ppMsg);
+int LOCAL LLC_MsgDispatch (struct LLCDev *pDev,
+                           struct MKxIFMsg *pMsg,
+                           uint64_t Time,
+                           void *pHold);
 int LOCAL LLC_MsgRecv (struct LLCDev *pDev);
+int LOCAL LLC_MsgSend (struct LLCDev *pDev,
+                      struct MKxIFMsg *pMsg);
+void LOCAL LLC_MsgTxReclaim (struct LLCDev *pDev);
 
 int LOCAL LLC_MsgCfgReq (struct LLCDev *pDev,
                          tMKxRadio Radio,
@@ -171,6 +590,21 @@ int LOCAL LLC_MsgCfgReq (struct LLCDev *pDev,
 int LOCAL LLC_MsgTxReq (struct LLCDev *pDev,
                         tMKxTxPacket *pTxPkt,
                         void *pPriv);
+int LOCAL LLC_MsgTxReqBatch (struct LLCDev *pDev,
+                             tMKxTxPacket **ppTxPkt,
+                             void **ppPriv,
+                             int Cnt,
+                             tMKxStatus *pResults);
+int LOCAL LLC_MsgTxQConfig (struct LLCDev *pDev,
+                            const tLLCTxQConfig *pConfig);
+int LOCAL LLC_MsgTxQStats (struct LLCDev *pDev,
+                           tMKxRadio Radio,
+                           tMKxChannel Chan,
+                           tLLCTxQStats *pStats);
+int LOCAL LLC_MsgTxFlushReq (struct LLCDev *pDev,
+                             tMKxRadio Radio,
+                             tMKxChannel Chan,
+                             tMKxTxQueue TxQ);
 int LOCAL LLC_MsgTempCfgReq (struct LLCDev *pDev,
                              tMKxTempConfig *pCfg);
 int LOCAL LLC_MsgPowerDetCfgReq (struct LLCDev *pDev,
@@ -15,6 +15,8 @@
 // Included headers
 //------------------------------------------------------------------------------
 #include <errno.h>
+#include <poll.h>
+#include <time.h>
 #include "llc-lib.h"
 
 #include "debug-levels.h"
@@ -22,6 +24,19 @@
 // Macros & Constants
 //------------------------------------------------------------------------------
 
+/// Longest single poll() while TxReq() waits for a free slot [ms]
+#define LLC_TXBLOCK_POLL_MAX 10
+
+/// 802.11 frame control (first octet): type field mask and 'data' type
+#define LLC_FC0_TYPE_MASK   (0x0C)
+#define LLC_FC0_TYPE_DATA   (0x08)
+/// 802.11 frame control (first octet): QoS bit of the subtype field
+#define LLC_FC0_SUBTYPE_QOS (0x80)
+/// Offset of the QoS control field in a (3 address) QoS data frame
+#define LLC_QOSCTRL_OFFSET  (24)
+/// User priority (TID) bits of the QoS control field
+#define LLC_QOSCTRL_UP_MASK (0x07)
+
 //------------------------------------------------------------------------------
 // Type definitions
 //------------------------------------------------------------------------------
@@ -30,6 +45,19 @@
 // Variables
 //------------------------------------------------------------------------------
 
+/// 802.11 user priority to MKx access category queue
+static const tMKxTxQueue LLC_UPTxQ[8] =
+{
+  MKX_TXQ_AC_BE, MKX_TXQ_AC_BK, MKX_TXQ_AC_BK, MKX_TXQ_AC_BE,
+  MKX_TXQ_AC_VI, MKX_TXQ_AC_VI, MKX_TXQ_AC_VO, MKX_TXQ_AC_VO,
+};
+
+/// Order in which the software transmit queues are served (highest first)
+static const tMKxTxQueue LLC_TxQOrder[MKX_TXQ_COUNT] =
+{
+  MKX_TXQ_AC_VO, MKX_TXQ_AC_VI, MKX_TXQ_AC_BE, MKX_TXQ_NON_QOS, MKX_TXQ_AC_BK,
+};
+
 //------------------------------------------------------------------------------
 // Functions
 //------------------------------------------------------------------------------
@@ -54,6 +82,499 @@ static int LLC_MsgSecInd (struct LLCDev *pDev,
                           struct MKxIFMsg *pMsg);
 
 
+/**
+ * @brief Get the current (monotonic) time
+ * @return CLOCK_MONOTONIC time [us]
+ */
+uint64_t LOCAL LLC_MsgTime (void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return ((uint64_t)Now.tv_sec * 1000000) + (Now.tv_nsec / 1000);
+}
+
+/**
+ * @brief Get the current (monotonic) time with full resolution
+ * @return CLOCK_MONOTONIC time [ns]
+ */
+static uint64_t LLC_MsgTimeNs (void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return ((uint64_t)Now.tv_sec * 1000000000) + Now.tv_nsec;
+}
+
+/**
+ * @brief Count a handled message (see MKx_GetLibStats())
+ * @param pDev LLC device pointer
+ * @param pMsg The message
+ * @param Time How long it took to handle [ns]
+ */
+static void LLC_MsgCount (struct LLCDev *pDev,
+                          struct MKxIFMsg *pMsg,
+                          uint64_t Time)
+{
+  tLLCMsgTypeStats *pStats;
+  uint64_t Us = Time / 1000;
+  int Bin = 0;
+
+  if (pMsg->Type >= LLC_STATS_TYPE_CNT)
+  {
+    pDev->Msg.Stats.Unknown++;
+    return;
+  }
+  pStats = &(pDev->Msg.Stats.Type[pMsg->Type]);
+  pStats->Cnt++;
+  pStats->Bytes += pMsg->Len;
+  pStats->Time += Time;
+
+  // log2 buckets: <1us, [1, 2)us, [2, 4)us ...
+  if (Us != 0)
+    Bin = 64 - __builtin_clzll(Us);
+  if (Bin >= LLC_STATS_HIST_BINS)
+    Bin = LLC_STATS_HIST_BINS - 1;
+  pStats->Hist[Bin]++;
+}
+
+/**
+ * @brief Work out which MKx queue a packet will be transmitted from
+ * @param pTxPkt The packet passed to TxReq()
+ * @return The access category queue (from the QoS TID) or MKX_TXQ_NON_QOS
+ */
+static tMKxTxQueue LLC_MsgTxQueue (const tMKxTxPacket *pTxPkt)
+{
+  const uint8_t *pFrame = pTxPkt->TxPacketData.TxFrame;
+
+  if (pTxPkt->TxPacketData.TxFrameLength < (LLC_QOSCTRL_OFFSET + 2))
+    return MKX_TXQ_NON_QOS;
+  if ((pFrame[0] & LLC_FC0_TYPE_MASK) != LLC_FC0_TYPE_DATA)
+    return MKX_TXQ_NON_QOS;
+  if ((pFrame[0] & LLC_FC0_SUBTYPE_QOS) == 0)
+    return MKX_TXQ_NON_QOS;
+  return LLC_UPTxQ[pFrame[LLC_QOSCTRL_OFFSET] & LLC_QOSCTRL_UP_MASK];
+}
+
+/**
+ * @brief Take the oldest free TxReqs slot
+ * @param pDev LLC device pointer
+ * @return The slot's seqnum, or -ENOMEM if there are none
+ */
+static int LLC_MsgTxSlotGet (struct LLCDev *pDev)
+{
+  int Seq = pDev->Msg.Free.Head;
+
+  if (Seq == LLC_SEQNUM_NONE)
+    return -ENOMEM;
+
+  pDev->Msg.Free.Head = pDev->Msg.TxReqs[Seq].Next;
+  if (pDev->Msg.Free.Head == LLC_SEQNUM_NONE)
+    pDev->Msg.Free.Tail = LLC_SEQNUM_NONE;
+  pDev->Msg.TxReqs[Seq].Next = LLC_SEQNUM_NONE;
+  return Seq;
+}
+
+/**
+ * @brief Return a TxReqs slot to the (tail of the) free list
+ * @param pDev LLC device pointer
+ * @param Seq The slot's seqnum
+ */
+static void LLC_MsgTxSlotPut (struct LLCDev *pDev,
+                              uint16_t Seq)
+{
+  tLLCTxReq *pTxReq = &(pDev->Msg.TxReqs[Seq]);
+
+  pTxReq->pTxPacket = NULL;
+  pTxReq->pPriv = NULL;
+  pTxReq->Next = LLC_SEQNUM_NONE;
+  if (pDev->Msg.Free.Tail == LLC_SEQNUM_NONE)
+    pDev->Msg.Free.Head = Seq;
+  else
+    pDev->Msg.TxReqs[pDev->Msg.Free.Tail].Next = Seq;
+  pDev->Msg.Free.Tail = Seq;
+}
+
+/**
+ * @brief Record a TxReq in its slot and add it to the in-flight list
+ * @param pDev LLC device pointer
+ * @param Seq The slot's seqnum
+ * @param pTxPkt The packet passed to TxReq()
+ * @param pPriv The private data passed to TxReq()
+ */
+static void LLC_MsgTxSlotSend (struct LLCDev *pDev,
+                               uint16_t Seq,
+                               tMKxTxPacket *pTxPkt,
+                               void *pPriv)
+{
+  tLLCTxReq *pTxReq = &(pDev->Msg.TxReqs[Seq]);
+
+  pTxReq->pTxPacket = pTxPkt;
+  pTxReq->pPriv = pPriv;
+  // Once sent the packet may be freed before the TxCnf, so keep what
+  // TxFlush() needs
+  pTxReq->Radio = pTxPkt->TxPacketData.RadioID;
+  pTxReq->Chan = pTxPkt->TxPacketData.ChannelID;
+  pTxReq->TxQ = LLC_MsgTxQueue(pTxPkt);
+  pTxReq->Time = LLC_MsgTime();
+  pTxReq->Next = LLC_SEQNUM_NONE;
+  pTxReq->Prev = pDev->Msg.InFlight.Tail;
+  if (pDev->Msg.InFlight.Tail == LLC_SEQNUM_NONE)
+    pDev->Msg.InFlight.Head = Seq;
+  else
+    pDev->Msg.TxReqs[pDev->Msg.InFlight.Tail].Next = Seq;
+  pDev->Msg.InFlight.Tail = Seq;
+  pDev->Msg.InFlight.Cnt++;
+  if (LLC_RADIO_CHAN_VALID(pTxReq->Radio, pTxReq->Chan))
+    pDev->Msg.InFlight.ChanCnt[pTxReq->Radio][pTxReq->Chan]++;
+}
+
+/**
+ * @brief Remove a TxReq from the in-flight list and free its slot
+ * @param pDev LLC device pointer
+ * @param Seq The slot's seqnum
+ */
+static void LLC_MsgTxSlotDone (struct LLCDev *pDev,
+                               uint16_t Seq)
+{
+  tLLCTxReq *pTxReq = &(pDev->Msg.TxReqs[Seq]);
+
+  if (pTxReq->Prev == LLC_SEQNUM_NONE)
+    pDev->Msg.InFlight.Head = pTxReq->Next;
+  else
+    pDev->Msg.TxReqs[pTxReq->Prev].Next = pTxReq->Next;
+  if (pTxReq->Next == LLC_SEQNUM_NONE)
+    pDev->Msg.InFlight.Tail = pTxReq->Prev;
+  else
+    pDev->Msg.TxReqs[pTxReq->Next].Prev = pTxReq->Prev;
+  pTxReq->Prev = LLC_SEQNUM_NONE;
+  pDev->Msg.InFlight.Cnt--;
+  if (LLC_RADIO_CHAN_VALID(pTxReq->Radio, pTxReq->Chan))
+    pDev->Msg.InFlight.ChanCnt[pTxReq->Radio][pTxReq->Chan]--;
+
+  LLC_MsgTxSlotPut(pDev, Seq);
+}
+
+/**
+ * @brief Call TxCnf() for a TxReq completed locally (its slot already freed)
+ * @param pDev LLC device pointer
+ * @param Seq The slot's seqnum
+ * @param pTxPkt The packet passed to TxReq()
+ * @param pPriv The private data passed to TxReq()
+ * @param Status The TxCnf status (and Hdr.Ret) to report
+ */
+static void LLC_MsgTxCnfLocal (struct LLCDev *pDev,
+                               uint16_t Seq,
+                               tMKxTxPacket *pTxPkt,
+                               void *pPriv,
+                               tMKxStatus Status)
+{
+  struct MKxTxEvent Evt;
+
+  d_printf(D_INFO, NULL, "TxCnf(%u) %d {%p, %p}\n", Seq, Status, pTxPkt, pPriv);
+
+  memset(&Evt, 0, sizeof(Evt));
+  Evt.Hdr.Type = MKXIF_TXEVENT;
+  Evt.Hdr.Len = sizeof(Evt);
+  Evt.Hdr.Seq = Seq;
+  Evt.Hdr.Ret = Status;
+  Evt.TxEventData.TxStatus = Status;
+  (void)LLC_TxCnf(&(pDev->MKx), pTxPkt, &Evt, pPriv);
+}
+
+/**
+ * @brief Complete an in-flight TxReq locally, as if its TxCnf had arrived
+ * @param pDev LLC device pointer
+ * @param Seq The slot's seqnum
+ * @param Status The TxCnf status (and Hdr.Ret) to report
+ */
+static void LLC_MsgTxComplete (struct LLCDev *pDev,
+                               uint16_t Seq,
+                               tMKxStatus Status)
+{
+  tMKxTxPacket *pTxPkt = pDev->Msg.TxReqs[Seq].pTxPacket;
+  void *pPriv = pDev->Msg.TxReqs[Seq].pPriv;
+
+  // Free the slot first so that the callback can reuse it
+  LLC_MsgTxSlotDone(pDev, Seq);
+  LLC_MsgTxCnfLocal(pDev, Seq, pTxPkt, pPriv, Status);
+}
+
+/**
+ * @brief Allocate a TxReqs slot, reclaiming timed out slots and (optionally)
+ *        waiting for TxCnf's if there are none free
+ * @param pDev LLC device pointer
+ * @return The slot's seqnum, or a negative errno (-ENOMEM, -ETIMEDOUT)
+ */
+static int LLC_MsgTxSlotAlloc (struct LLCDev *pDev)
+{
+  int Seq;
+  uint64_t Now;
+  uint64_t Deadline = 0;
+
+  while (1)
+  {
+    Seq = LLC_MsgTxSlotGet(pDev);
+    if (Seq >= 0)
+      break;
+
+    // Reclaim any slots whose TxCnf has been lost
+    LLC_MsgTxReclaim(pDev);
+    Seq = LLC_MsgTxSlotGet(pDev);
+    if (Seq >= 0)
+      break;
+
+    // Waiting from within a callback could recurse without bound
+    if ((pDev->Msg.TxBlock == 0) || (pDev->Msg.InRecv == true))
+    {
+      Seq = -ENOMEM;
+      break;
+    }
+    Now = LLC_MsgTime();
+    if (Deadline == 0)
+      Deadline = Now + (pDev->Msg.TxBlock * 1000ULL);
+    else if (Now >= Deadline)
+    {
+      Seq = -ETIMEDOUT;
+      break;
+    }
+
+    // Process what has already arrived, otherwise wait for more
+    if (LLC_MsgRecv(pDev) == 0)
+      continue;
+    {
+      struct pollfd Fds = { LLC_MsgFd(pDev), POLLIN, 0 };
+      int Timeout = (Deadline - Now + 999) / 1000;
+
+      if (Timeout > LLC_TXBLOCK_POLL_MAX)
+        Timeout = LLC_TXBLOCK_POLL_MAX;
+      (void)poll(&Fds, 1, Timeout);
+    }
+  }
+
+  if (Seq < 0)
+    d_printf(D_WARN, NULL, "No free TxReq slot (%d in flight) = %d\n",
+             pDev->Msg.InFlight.Cnt, Seq);
+  return Seq;
+}
+
+/**
+ * @brief Hold a TxReq in its software transmit queue
+ * @param pDev LLC device pointer
+ * @param Seq The slot's seqnum
+ * @param pTxPkt The packet passed to TxReq() (with a valid radio/channel)
+ * @param pPriv The private data passed to TxReq()
+ * @return Zero, or MKXSTATUS_TX_FAIL_QUEUEFULL
+ *
+ * Only the pointer is kept: the caller's buffer must stay valid until its
+ * TxCnf (see MKx_TxQueueConfig()).
+ */
+static int LLC_MsgTxQPut (struct LLCDev *pDev,
+                          uint16_t Seq,
+                          tMKxTxPacket *pTxPkt,
+                          void *pPriv)
+{
+  tLLCTxReq *pTxReq = &(pDev->Msg.TxReqs[Seq]);
+  tMKxRadio Radio = pTxPkt->TxPacketData.RadioID;
+  tMKxChannel Chan = pTxPkt->TxPacketData.ChannelID;
+  tMKxTxQueue TxQ = LLC_MsgTxQueue(pTxPkt);
+  tLLCTxQ *pQ = &(pDev->Msg.TxQ.Q[Radio][Chan][TxQ]);
+
+  if (pQ->Stats.Depth >= pDev->Msg.TxQ.Config.Depth)
+  {
+    pQ->Stats.Full++;
+    return MKXSTATUS_TX_FAIL_QUEUEFULL;
+  }
+
+  pTxReq->pTxPacket = pTxPkt;
+  pTxReq->pPriv = pPriv;
+  pTxReq->Radio = Radio;
+  pTxReq->Chan = Chan;
+  pTxReq->TxQ = TxQ;
+  pTxReq->Time = LLC_MsgTime();
+  pTxReq->Next = LLC_SEQNUM_NONE;
+  pTxReq->Prev = LLC_SEQNUM_NONE;
+  if (pQ->Tail == LLC_SEQNUM_NONE)
+    pQ->Head = Seq;
+  else
+    pDev->Msg.TxReqs[pQ->Tail].Next = Seq;
+  pQ->Tail = Seq;
+
+  pQ->Stats.Depth++;
+  if (pQ->Stats.Depth > pQ->Stats.DepthMax)
+    pQ->Stats.DepthMax = pQ->Stats.Depth;
+  pDev->Msg.TxQ.Held++;
+  return 0;
+}
+
+/**
+ * @brief Take the next held TxReq of a radio/channel, as scheduled
+ * @param pDev LLC device pointer
+ * @param Radio
+ * @param Chan
+ * @return The slot's seqnum, or LLC_SEQNUM_NONE if nothing is held
+ *
+ * Weighted scheduling serves the queues in priority order, each up to its
+ * weight, in rounds that start again once every non-empty queue has had its
+ * share.
+ */
+static uint16_t LLC_MsgTxQGet (struct LLCDev *pDev,
+                               tMKxRadio Radio,
+                               tMKxChannel Chan)
+{
+  tLLCTxQ *pQ = NULL;
+  bool Waiting = false;
+  uint16_t Seq;
+  int Round;
+  int i;
+
+  for (Round = 0; Round < 2; Round++)
+  {
+    for (i = 0; i < MKX_TXQ_COUNT; i++)
+    {
+      pQ = &(pDev->Msg.TxQ.Q[Radio][Chan][LLC_TxQOrder[i]]);
+      if (pQ->Head == LLC_SEQNUM_NONE)
+        continue;
+      if (pDev->Msg.TxQ.Config.Sched != LLC_TXQ_SCHED_WEIGHTED)
+        goto Found;
+      if (pQ->Credit > 0)
+      {
+        pQ->Credit--;
+        goto Found;
+      }
+      Waiting = true;
+    }
+    if (Waiting == false)
+      break;
+
+    // Start a new weighted round
+    for (i = 0; i < MKX_TXQ_COUNT; i++)
+    {
+      pQ = &(pDev->Msg.TxQ.Q[Radio][Chan][i]);
+      pQ->Credit = pDev->Msg.TxQ.Config.Weight[i];
+      if (pQ->Credit == 0)
+        pQ->Credit = 1;
+    }
+  }
+  return LLC_SEQNUM_NONE;
+
+Found:
+  Seq = pQ->Head;
+  pQ->Head = pDev->Msg.TxReqs[Seq].Next;
+  if (pQ->Head == LLC_SEQNUM_NONE)
+    pQ->Tail = LLC_SEQNUM_NONE;
+  pDev->Msg.TxReqs[Seq].Next = LLC_SEQNUM_NONE;
+  pQ->Stats.Depth--;
+  pDev->Msg.TxQ.Held--;
+  return Seq;
+}
+
+/**
+ * @brief Pass held TxReqs to the MKx while there is room in flight for them
+ * @param pDev LLC device pointer
+ *
+ * Frames whose Expiry has passed (by the local TSF estimate) are dropped
+ * rather than sent. With the queues disabled everything held is sent.
+ */
+static void LLC_MsgTxQRun (struct LLCDev *pDev)
+{
+  tMKxTSF TSF = 0;
+  bool HaveTSF;
+  tMKxRadio Radio;
+  tMKxChannel Chan;
+
+  // Not from the TxCnf callbacks of frames completed here
+  if ((pDev->Msg.TxQ.Held == 0) || (pDev->Msg.TxQ.Busy))
+    return;
+  pDev->Msg.TxQ.Busy = true;
+
+  // Don't let lost TxCnf's hold up the queues
+  LLC_MsgTxReclaim(pDev);
+  HaveTSF = (LLC_TSFGet(pDev, &TSF, NULL) == 0);
+
+  for (Radio = MKX_RADIO_A; Radio < MKX_RADIO_COUNT; Radio++)
+  {
+    for (Chan = MKX_CHANNEL_0; Chan < MKX_CHANNEL_COUNT; Chan++)
+    {
+      while ((pDev->Msg.TxQ.Config.Sched == LLC_TXQ_SCHED_OFF) ||
+             (pDev->Msg.InFlight.ChanCnt[Radio][Chan] <
+              pDev->Msg.TxQ.Config.InFlightMax))
+      {
+        uint16_t Seq = LLC_MsgTxQGet(pDev, Radio, Chan);
+        tLLCTxReq *pTxReq;
+        tMKxTxPacket *pTxPkt;
+        void *pPriv;
+
+        if (Seq == LLC_SEQNUM_NONE)
+          break;
+        pTxReq = &(pDev->Msg.TxReqs[Seq]);
+        pTxPkt = pTxReq->pTxPacket;
+        pPriv = pTxReq->pPriv;
+
+        if ((HaveTSF) && (pTxPkt->TxPacketData.Expiry != 0) &&
+            (pTxPkt->TxPacketData.Expiry <= TSF))
+        {
+          pDev->Msg.TxQ.Q[Radio][Chan][pTxReq->TxQ].Stats.Expired++;
+          LLC_MsgTxSlotPut(pDev, Seq);
+          LLC_MsgTxCnfLocal(pDev, Seq, pTxPkt, pPriv, MKXSTATUS_TX_FAIL_TTL);
+          continue;
+        }
+
+        pDev->Msg.TxQ.Q[Radio][Chan][pTxReq->TxQ].Stats.Sent++;
+        LLC_MsgTxSlotSend(pDev, Seq, pTxPkt, pPriv);
+        d_printf(D_DEBUG, NULL, "-> TxReq(%u) {%p, %p}\n", Seq, pTxPkt, pPriv);
+        if (LLC_MsgSend(pDev, (struct MKxIFMsg *)pTxPkt) != 0)
+        {
+          // Never reached the MKx so no TxCnf will arrive
+          LLC_MsgTxSlotDone(pDev, Seq);
+          LLC_MsgTxCnfLocal(pDev, Seq, pTxPkt, pPriv, -EIO);
+        }
+      }
+    }
+  }
+
+  pDev->Msg.TxQ.Busy = false;
+}
+
+/**
+ * @brief Complete the held TxReqs of a radio/channel queue as flushed
+ * @param pDev LLC device pointer
+ * @param Radio
+ * @param Chan
+ * @param TxQ The queue
+ * @return The number of TxReqs flushed
+ */
+static int LLC_MsgTxQFlush (struct LLCDev *pDev,
+                            tMKxRadio Radio,
+                            tMKxChannel Chan,
+                            tMKxTxQueue TxQ)
+{
+  tLLCTxQ *pQ = &(pDev->Msg.TxQ.Q[Radio][Chan][TxQ]);
+  uint16_t Seq = pQ->Head;
+  int Cnt = 0;
+
+  // Detach the whole queue first (the TxCnf callbacks may add new ones)
+  pDev->Msg.TxQ.Held -= pQ->Stats.Depth;
+  pQ->Stats.Flushed += pQ->Stats.Depth;
+  pQ->Stats.Depth = 0;
+  pQ->Head = LLC_SEQNUM_NONE;
+  pQ->Tail = LLC_SEQNUM_NONE;
+
+  while (Seq != LLC_SEQNUM_NONE)
+  {
+    tMKxTxPacket *pTxPkt = pDev->Msg.TxReqs[Seq].pTxPacket;
+    void *pPriv = pDev->Msg.TxReqs[Seq].pPriv;
+    uint16_t Next = pDev->Msg.TxReqs[Seq].Next;
+
+    LLC_MsgTxSlotPut(pDev, Seq);
+    LLC_MsgTxCnfLocal(pDev, Seq, pTxPkt, pPriv, LLC_TXSTATUS_FLUSHED);
+    Seq = Next;
+    Cnt++;
+  }
+  return Cnt;
+}
+
+
 /**
  * @brief Setup the LLC messaging handling
  * @param pDev LLC device pointer
@@ -69,6 +590,48 @@ int LOCAL LLC_MsgSetup (struct LLCDev *pDev)
   pDev->Msg.RxLen = -1;
   pDev->Msg.pRxBuf = NULL;
   pDev->Msg.pRxPriv = NULL;
+  pDev->Msg.pRxHold = NULL;
+  pDev->Msg.RxTime = 0;
+  pDev->Msg.RxZeroCopy = false;
+
+  // Every TxReqs slot starts on the free list
+  {
+    int Seq;
+
+    for (Seq = 0; Seq <= LLC_SEQNUM_MAX; Seq++)
+    {
+      pDev->Msg.TxReqs[Seq].pTxPacket = NULL;
+      pDev->Msg.TxReqs[Seq].pPriv = NULL;
+      pDev->Msg.TxReqs[Seq].Next = Seq + 1;
+      pDev->Msg.TxReqs[Seq].Prev = LLC_SEQNUM_NONE;
+    }
+    pDev->Msg.TxReqs[LLC_SEQNUM_MAX].Next = LLC_SEQNUM_NONE;
+    pDev->Msg.Free.Head = 0;
+    pDev->Msg.Free.Tail = LLC_SEQNUM_MAX;
+    pDev->Msg.InFlight.Head = LLC_SEQNUM_NONE;
+    pDev->Msg.InFlight.Tail = LLC_SEQNUM_NONE;
+    pDev->Msg.InFlight.Cnt = 0;
+    memset(pDev->Msg.InFlight.ChanCnt, 0, sizeof(pDev->Msg.InFlight.ChanCnt));
+  }
+  // No software transmit queues until MKx_TxQueueConfig()
+  {
+    tMKxRadio Radio;
+    tMKxChannel Chan;
+    int TxQ;
+
+    memset(&(pDev->Msg.TxQ), 0, sizeof(pDev->Msg.TxQ));
+    pDev->Msg.TxQ.Config.Sched = LLC_TXQ_SCHED_OFF;
+    for (Radio = MKX_RADIO_A; Radio < MKX_RADIO_COUNT; Radio++)
+      for (Chan = MKX_CHANNEL_0; Chan < MKX_CHANNEL_COUNT; Chan++)
+        for (TxQ = 0; TxQ < MKX_TXQ_COUNT; TxQ++)
+        {
+          pDev->Msg.TxQ.Q[Radio][Chan][TxQ].Head = LLC_SEQNUM_NONE;
+          pDev->Msg.TxQ.Q[Radio][Chan][TxQ].Tail = LLC_SEQNUM_NONE;
+        }
+  }
+  pDev->Msg.TxCnfTimeout = LLC_TXCNF_TIMEOUT_DEFAULT;
+  pDev->Msg.TxBlock = 0;
+  pDev->Msg.InRecv = false;
 
   Res = 0;
 
@@ -98,57 +661,107 @@ int LOCAL LLC_MsgRelease (struct LLCDev *pDev)
 
 
 /**
- * @brief Handle a message from the MKx
+ * @brief Get the file descriptor that becomes readable when there are
+ *        messages for LLC_MsgRecv()
+ * @param pDev LLC device pointer
+ * @return The receive thread's eventfd if it is running, else the interface's
  */
-int LOCAL LLC_MsgRecv (struct LLCDev *pDev)
+int LOCAL LLC_MsgFd (struct LLCDev *pDev)
+{
+  if (pDev->Thread.Enabled)
+    return pDev->Thread.EventFd;
+  return pDev->If.Fd;
+}
+
+
+/**
+ * @brief Get the next message from the interface (without handling it)
+ * @param pDev LLC device pointer
+ * @param ppMsg Set to the message, or NULL if it was discarded
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *         (-EAGAIN if there is nothing to receive)
+ *
+ * The message stays valid until the next call.
+ */
+int LOCAL LLC_MsgGet (struct LLCDev *pDev,
+                      struct MKxIFMsg **ppMsg)
 {
   int Res = LLC_STATUS_ERROR;
   int Len = -1;
+  char *pBuf = NULL;
   struct MKxIFMsg *pMsg = NULL;
 
   d_fnstart(D_VERBOSE, NULL, "(pDev %p)\n", pDev);
   d_assert(pDev != NULL);
 
-  pDev->Msg.RxLen = 0;
-  pDev->Msg.pRxBuf = NULL;
-  pDev->Msg.pRxPriv = NULL;
-
   // Get the buffer from the interface
-  {
-    char *pBuf = NULL;
-
-    Res = LLC_InterfaceRecv(pDev, &pBuf, &Len);
-    if ((Res < 0) || (pBuf == NULL) || (Len < 0))
-      goto Error;
-    if ((Len <= 0) || (pBuf == NULL))
-      goto Error;
-
-    pDev->Msg.RxLen = Len;
-    pDev->Msg.pRxBuf = (uint8_t *)pBuf;
-    pDev->Msg.pRxPriv = NULL; // TODO
-  }
+  Res = LLC_InterfaceRecv(pDev, &pBuf, &Len);
+  if ((Res < 0) || (pBuf == NULL) || (Len < 0))
+    goto Error;
+  if ((Len <= 0) || (pBuf == NULL))
+    goto Error;
 
-  pMsg = (struct MKxIFMsg *)(pDev->Msg.pRxBuf);
-  // Sanity check the lengths then trim off the header
+  pMsg = (struct MKxIFMsg *)pBuf;
+  // Sanity check the lengths
   if ((Len < sizeof(struct MKxIFMsg)) || (Len < pMsg->Len))
   {
     d_error(D_WARN, NULL, "Truncated message: pBuf %d pMsg %d\n",
             Len, pMsg->Len);
+    pDev->Msg.Stats.Truncated++;
     //d_dump(D_WARN, NULL, pMsg, pMsg->Len);
+    pMsg = NULL;
     goto Error;
   }
-  Len = pMsg->Len - sizeof(struct MKxIFMsg);
 
   d_printf(D_DBG, NULL, "Msg: Type:%d Len:%d Seq:%d Ret:%d\n",
            pMsg->Type, pMsg->Len, pMsg->Seq, pMsg->Ret);
- 
-  // Ignore driver usb send echo 
+
+  // Ignore driver usb send echo
   if (pMsg->Ret == (int16_t)MKXSTATUS_RESERVED)
   {
+    pDev->Msg.Stats.Echoes++;
     Res = MKXSTATUS_SUCCESS;
+    pMsg = NULL;
     goto Error;
   }
-    
+
+Error:
+  *ppMsg = pMsg;
+  d_fnend(D_VERBOSE, NULL, "(pDev %p) = %d\n", pDev, Res);
+  return Res;
+}
+
+
+/**
+ * @brief Handle a message from the MKx (i.e. call the API callbacks)
+ * @param pDev LLC device pointer
+ * @param pMsg The message (from LLC_MsgGet())
+ * @param Time When the message was received (CLOCK_MONOTONIC) [us]
+ * @param pHold Reference already held on the message's Rx ring slot (or NULL)
+ * @return The result of the message handler
+ */
+int LOCAL LLC_MsgDispatch (struct LLCDev *pDev,
+                           struct MKxIFMsg *pMsg,
+                           uint64_t Time,
+                           void *pHold)
+{
+  int Res = LLC_STATUS_ERROR;
+  bool InRecv;
+  uint64_t Start = LLC_MsgTimeNs();
+
+  d_fnstart(D_VERBOSE, NULL, "(pDev %p pMsg %p)\n", pDev, pMsg);
+  d_assert(pDev != NULL);
+  d_assert(pMsg != NULL);
+
+  InRecv = pDev->Msg.InRecv;
+  pDev->Msg.InRecv = true;
+
+  pDev->Msg.RxLen = pMsg->Len;
+  pDev->Msg.pRxBuf = (uint8_t *)pMsg;
+  pDev->Msg.pRxPriv = NULL; // TODO
+  pDev->Msg.pRxHold = pHold;
+  pDev->Msg.RxTime = Time;
+
   switch (pMsg->Type)
   {
     case MKXIF_TXEVENT: // A transmit confirm (message data is tMKxTxEvent)
@@ -200,6 +813,47 @@ int LOCAL LLC_MsgRecv (struct LLCDev *pDev)
       break;
   }
 
+  // A held Rx ring slot that wasn't passed on to RxInd()
+  if (pDev->Msg.pRxHold != NULL)
+    (void)LLC_InterfaceRxRelease(pDev, pDev->Msg.pRxHold);
+  pDev->Msg.pRxHold = NULL;
+
+  LLC_MsgCount(pDev, pMsg, LLC_MsgTimeNs() - Start);
+  pDev->Msg.InRecv = InRecv;
+  d_fnend(D_VERBOSE, NULL, "(pDev %p) = %d\n", pDev, Res);
+  return Res;
+}
+
+
+/**
+ * @brief Handle a message from the MKx
+ * @param pDev LLC device pointer
+ * @return The result of the message handler, or a negative errno
+ *         (-EAGAIN if there was nothing to handle)
+ *
+ * Takes the message from the receive thread's queues when it is running,
+ * otherwise directly from the interface.
+ */
+int LOCAL LLC_MsgRecv (struct LLCDev *pDev)
+{
+  int Res = LLC_STATUS_ERROR;
+  struct MKxIFMsg *pMsg = NULL;
+
+  d_fnstart(D_VERBOSE, NULL, "(pDev %p)\n", pDev);
+  d_assert(pDev != NULL);
+
+  if (pDev->Thread.Enabled)
+  {
+    Res = LLC_ThreadRecv(pDev);
+    goto Error;
+  }
+
+  Res = LLC_MsgGet(pDev, &pMsg);
+  if ((Res != 0) || (pMsg == NULL))
+    goto Error;
+
+  Res = LLC_MsgDispatch(pDev, pMsg, LLC_MsgTime(), NULL);
+
 Error:
   d_fnend(D_VERBOSE, NULL, "(pDev %p) = %d\n", pDev, Res);
   return Res;
@@ -237,23 +891,17 @@ int LOCAL LLC_MsgTxReq (struct LLCDev *pDev,
                         void *pPriv)
 {
   int Res;
+  int Seq;
   struct MKxIFMsg *pMsg = (struct MKxIFMsg *)(pTxPkt);
-  tLLCTxReq *pTxReq;
 
   d_fnstart(D_TST, NULL, "(pDev %p)\n", pDev);
   d_assert(pDev != NULL);
 
-  // store the pTxPkt pointer and pPriv pointer
-  pTxReq = &pDev->Msg.TxReqs[pDev->Msg.Cnt];
-  if (pTxReq->pTxPacket != NULL)
+  // Get a free slot to store the pTxPkt pointer and pPriv pointer
+  Seq = LLC_MsgTxSlotAlloc(pDev);
+  if (Seq < 0)
   {
-    d_printf(D_WARN, NULL, "Slot %u already in use - will try next on next TxReq\n",
-             pDev->Msg.Cnt);
-
-    // no free slots left (we could look for an empty slot?)
-    Res = -ENOMEM;
-    // try the next slot on next tx
-    pDev->Msg.Cnt = (pDev->Msg.Cnt + 1) % (LLC_SEQNUM_MAX + 1);
+    Res = Seq;
     goto Error;
   }
 
@@ -261,19 +909,31 @@ int LOCAL LLC_MsgTxReq (struct LLCDev *pDev,
   pMsg->Type = MKXIF_TXPACKET;
   pMsg->Len = sizeof(struct MKxTxPacket) + \
               pTxPkt->TxPacketData.TxFrameLength;
-  pMsg->Seq = pDev->Msg.Cnt;
+  pMsg->Seq = Seq;
   pMsg->Ret = MKXSTATUS_RESERVED; 
 
-  pDev->Msg.Cnt = (pDev->Msg.Cnt + 1) % (LLC_SEQNUM_MAX + 1);
+  // Hold it in a software queue (sent by LLC_MsgTxQRun() when there's room)
+  if ((pDev->Msg.TxQ.Config.Sched != LLC_TXQ_SCHED_OFF) &&
+      LLC_RADIO_CHAN_VALID(pTxPkt->TxPacketData.RadioID,
+                           pTxPkt->TxPacketData.ChannelID))
+  {
+    Res = LLC_MsgTxQPut(pDev, Seq, pTxPkt, pPriv);
+    if (Res != 0)
+      LLC_MsgTxSlotPut(pDev, Seq);
+    LLC_MsgTxQRun(pDev);
+    goto Error;
+  }
 
-  pTxReq->pTxPacket = pTxPkt;
-  pTxReq->pPriv = pPriv;
+  LLC_MsgTxSlotSend(pDev, Seq, pTxPkt, pPriv);
 
   d_printf(D_DEBUG, NULL, "-> TxReq(%u) {%p, %p}\n", pMsg->Seq,
-           pTxReq->pTxPacket, pTxReq->pPriv);
+           pTxPkt, pPriv);
 
   // Pass it to the underlying transport layer (blocks until sent)
   Res = LLC_MsgSend(pDev, pMsg);
+  // Never reached the MKx so no TxCnf will arrive: free the slot
+  if (Res != 0)
+    LLC_MsgTxSlotDone(pDev, Seq);
 
 Error:
   d_fnend(D_TST, NULL, "(pDev %p) = %d\n", pDev, Res);
@@ -281,6 +941,101 @@ Error:
 }
 
 
+/**
+ * @brief Create TxReq messages for a batch of packets and pass them to the
+ *        underlying transport together
+ *
+ */
+int LOCAL LLC_MsgTxReqBatch (struct LLCDev *pDev,
+                             tMKxTxPacket **ppTxPkt,
+                             void **ppPriv,
+                             int Cnt,
+                             tMKxStatus *pResults)
+{
+  int Res = 0;
+  int Off;
+  int i;
+
+  d_fnstart(D_TST, NULL, "(pDev %p Cnt %d)\n", pDev, Cnt);
+  d_assert(pDev != NULL);
+
+  for (Off = 0; Off < Cnt; Off += LLC_TX_BATCH_MAX)
+  {
+    char *ppBuf[LLC_TX_BATCH_MAX];
+    int Lens[LLC_TX_BATCH_MAX];
+    int SendRes[LLC_TX_BATCH_MAX];
+    int Idx[LLC_TX_BATCH_MAX];
+    int Num = 0;
+
+    // Assign sequence numbers (and TxReqs slots) to this part of the batch
+    for (i = Off; (i < Cnt) && (i < Off + LLC_TX_BATCH_MAX); i++)
+    {
+      struct MKxIFMsg *pMsg = (struct MKxIFMsg *)(ppTxPkt[i]);
+      int Seq = LLC_MsgTxSlotAlloc(pDev);
+
+      if (Seq < 0)
+      {
+        pResults[i] = Seq;
+        continue;
+      }
+
+      pMsg->Type = MKXIF_TXPACKET;
+      pMsg->Len = sizeof(struct MKxTxPacket) + \
+                  ppTxPkt[i]->TxPacketData.TxFrameLength;
+      pMsg->Seq = Seq;
+      pMsg->Ret = MKXSTATUS_RESERVED;
+
+      // Hold it in a software queue (sent by LLC_MsgTxQRun())
+      if ((pDev->Msg.TxQ.Config.Sched != LLC_TXQ_SCHED_OFF) &&
+          LLC_RADIO_CHAN_VALID(ppTxPkt[i]->TxPacketData.RadioID,
+                               ppTxPkt[i]->TxPacketData.ChannelID))
+      {
+        pResults[i] = LLC_MsgTxQPut(pDev, Seq, ppTxPkt[i],
+                                    (ppPriv != NULL) ? ppPriv[i] : NULL);
+        if (pResults[i] == 0)
+          Res++;
+        else
+          LLC_MsgTxSlotPut(pDev, Seq);
+        continue;
+      }
+
+      LLC_MsgTxSlotSend(pDev, Seq, ppTxPkt[i],
+                        (ppPriv != NULL) ? ppPriv[i] : NULL);
+
+      d_printf(D_DEBUG, NULL, "-> TxReq(%u) {%p, %p}\n", pMsg->Seq,
+               ppTxPkt[i], (ppPriv != NULL) ? ppPriv[i] : NULL);
+
+      ppBuf[Num] = (char *)pMsg;
+      Lens[Num] = pMsg->Len;
+      Idx[Num] = i;
+      Num++;
+    }
+    if (Num == 0)
+      continue;
+
+    // Pass them to the underlying transport layer (blocks until sent)
+    (void)LLC_InterfaceSendBatch(pDev, ppBuf, Lens, SendRes, Num);
+
+    for (i = 0; i < Num; i++)
+    {
+      if (SendRes[i] == Lens[i])
+      {
+        pResults[Idx[i]] = 0;
+        Res++;
+        continue;
+      }
+      // Never reached the MKx so no TxCnf will arrive: free the slot
+      pResults[Idx[i]] = -EIO;
+      LLC_MsgTxSlotDone(pDev, ((struct MKxIFMsg *)ppBuf[i])->Seq);
+    }
+  }
+  LLC_MsgTxQRun(pDev);
+
+  d_fnend(D_TST, NULL, "(pDev %p Cnt %d) = %d\n", pDev, Cnt, Res);
+  return Res;
+}
+
+
 /**
  * @brief Parse a TxCnf message and pass it to the API
  *
@@ -291,7 +1046,8 @@ static int LLC_MsgTxCnf (struct LLCDev *pDev,
   int Res = LLC_STATUS_ERROR;
   int Len;
   struct MKxTxEvent *pEvt = (struct MKxTxEvent *)pMsg;
-  tLLCTxReq *pTxReq;
+  tMKxTxPacket *pTxPkt;
+  void *pPriv;
   tMKxStatus Result = LLC_STATUS_ERROR;
 
   d_fnstart(D_VERBOSE, NULL, "(pDev %p)\n", pDev);
@@ -312,18 +1068,33 @@ static int LLC_MsgTxCnf (struct LLCDev *pDev,
     Result = pEvt->TxEventData.TxStatus;
 
   // Try lookup the original packet
-  if (pEvt->Hdr.Seq <= LLC_SEQNUM_MAX)
+  if ((pEvt->Hdr.Seq <= LLC_SEQNUM_MAX) &&
+      (pDev->Msg.TxReqs[pEvt->Hdr.Seq].pTxPacket != NULL))
   {
-    pTxReq = &pDev->Msg.TxReqs[pEvt->Hdr.Seq];
+    pTxPkt = pDev->Msg.TxReqs[pEvt->Hdr.Seq].pTxPacket;
+    pPriv = pDev->Msg.TxReqs[pEvt->Hdr.Seq].pPriv;
 
     d_printf(D_DEBUG, NULL, "<- TxCnf(%u) {%p, %p}\n", pMsg->Seq,
-             pTxReq->pTxPacket, pTxReq->pPriv);
+             pTxPkt, pPriv);
 
-    // Call the TxCnf API function
-    Res = LLC_TxCnf(&(pDev->MKx), pTxReq->pTxPacket,  pEvt, pTxReq->pPriv);
+    if (Result == MKXSTATUS_SUCCESS)
+    {
+      LLC_TSFSample(pDev, pEvt->TxEventData.TxTime,
+                    pDev->Msg.RxTime);
+      LLC_CBRTx(pDev, pTxPkt);
+    }
+
+    // Free the slot first so that the callback can reuse it
+    LLC_MsgTxSlotDone(pDev, pEvt->Hdr.Seq);
 
-    pTxReq->pTxPacket = NULL;
-    pTxReq->pPriv = NULL;
+    // Call the TxCnf API function
+    Res = LLC_TxCnf(&(pDev->MKx), pTxPkt, pEvt, pPriv);
+  }
+  else if (pEvt->Hdr.Seq <= LLC_SEQNUM_MAX)
+  {
+    // Most likely already completed by LLC_MsgTxReclaim()
+    d_printf(D_INFO, NULL, "Received a TxCnf for free slot: %u\n",
+             pEvt->Hdr.Seq);
   }
   else
   {
@@ -333,12 +1104,195 @@ static int LLC_MsgTxCnf (struct LLCDev *pDev,
              "Received a TxCnf with invalid Seq: %u\n", pEvt->Hdr.Seq);
   }
 
+  // There may be room in flight for a held TxReq now
+  LLC_MsgTxQRun(pDev);
+
 Error:
   d_fnend(D_VERBOSE, NULL, "(pDev %p) = %d\n", pDev, Res);
   return Res;
 }
 
 
+/**
+ * @brief Complete the TxReq's that have been waiting longer than the TxCnf
+ *        timeout, as if a TxCnf had arrived with LLC_TXSTATUS_TIMEOUT
+ * @param pDev LLC device pointer
+ */
+void LOCAL LLC_MsgTxReclaim (struct LLCDev *pDev)
+{
+  uint64_t Now;
+  uint64_t Timeout;
+
+  d_assert(pDev != NULL);
+
+  if (pDev->Msg.TxCnfTimeout == 0)
+    return;
+  Now = LLC_MsgTime();
+  Timeout = pDev->Msg.TxCnfTimeout * 1000ULL;
+
+  // The in-flight list is in sending order, so stop at the first young one
+  while (pDev->Msg.InFlight.Head != LLC_SEQNUM_NONE)
+  {
+    uint16_t Seq = pDev->Msg.InFlight.Head;
+
+    if ((Now - pDev->Msg.TxReqs[Seq].Time) < Timeout)
+      break;
+
+    d_printf(D_WARN, NULL, "TxCnf(%u) timeout\n", Seq);
+    LLC_MsgTxComplete(pDev, Seq, LLC_TXSTATUS_TIMEOUT);
+  }
+}
+
+
+/**
+ * @brief Create a FlushQ message, pass it to the underlying transport and
+ *        complete the matching held and in-flight TxReq's
+ *
+ */
+int LOCAL LLC_MsgTxFlushReq (struct LLCDev *pDev,
+                             tMKxRadio Radio,
+                             tMKxChannel Chan,
+                             tMKxTxQueue TxQ)
+{
+  int Res = LLC_STATUS_ERROR;
+  uint16_t Seqs[LLC_SEQNUM_MAX + 1];
+  int Cnt = 0;
+  int Held = 0;
+  bool Busy;
+  int i;
+
+  d_fnstart(D_TST, NULL, "(pDev %p Radio %d Chan %d TxQ %d)\n",
+            pDev, Radio, Chan, TxQ);
+  d_assert(pDev != NULL);
+
+  if ((Radio < MKX_RADIO_A) || (Radio >= MKX_RADIO_COUNT) ||
+      (Chan < MKX_CHANNEL_0) || (Chan >= MKX_CHANNEL_COUNT) ||
+      (TxQ > LLC_TXQ_ALL))
+  {
+    Res = MKXSTATUS_FAILURE_INVALID_PARAM;
+    goto Error;
+  }
+
+  // Populate the 'out' bits that we know
+  {
+    tLLCFlushQ Msg;
+
+    memset(&Msg, 0, sizeof(Msg));
+    Msg.Hdr.Type = MKXIF_FLUSHQ;
+    Msg.Hdr.Len = sizeof(Msg);
+    Msg.Hdr.Seq = 0xC0DA;
+    Msg.Hdr.Ret = MKXSTATUS_RESERVED;
+    Msg.RadioID = Radio;
+    Msg.ChannelID = Chan;
+    Msg.TxQueue = TxQ;
+
+    // Pass it to the underlying transport layer (blocks until sent)
+    Res = LLC_MsgSend(pDev, &(Msg.Hdr));
+    if (Res != 0)
+      goto Error;
+  }
+
+  // Find the purged TxReq's first (the TxCnf callbacks may add new ones)
+  for (i = pDev->Msg.InFlight.Head; i != LLC_SEQNUM_NONE;
+       i = pDev->Msg.TxReqs[i].Next)
+  {
+    tLLCTxReq *pTxReq = &(pDev->Msg.TxReqs[i]);
+
+    if ((pTxReq->Radio == Radio) && (pTxReq->Chan == Chan) &&
+        ((TxQ == LLC_TXQ_ALL) || (pTxReq->TxQ == TxQ)))
+      Seqs[Cnt++] = i;
+  }
+  // Nothing held is released until the end (a TxCnf callback's TxReq would
+  // otherwise send frames of the flushed queues into the room freed here)
+  Busy = pDev->Msg.TxQ.Busy;
+  pDev->Msg.TxQ.Busy = true;
+  // Purge those still held in the software queues
+  for (i = 0; i < MKX_TXQ_COUNT; i++)
+  {
+    if ((TxQ == LLC_TXQ_ALL) || (TxQ == i))
+      Held += LLC_MsgTxQFlush(pDev, Radio, Chan, i);
+  }
+  // Then complete the in-flight ones (any later TxCnf's from the MKx are
+  // ignored)
+  for (i = 0; i < Cnt; i++)
+  {
+    if (pDev->Msg.TxReqs[Seqs[i]].pTxPacket == NULL)
+      continue; // Already completed by a callback
+    LLC_MsgTxComplete(pDev, Seqs[i], LLC_TXSTATUS_FLUSHED);
+  }
+  pDev->Msg.TxQ.Busy = Busy;
+  d_printf(D_INFO, NULL, "Flushed %d TxReq's\n", Cnt + Held);
+  LLC_MsgTxQRun(pDev);
+
+Error:
+  d_fnend(D_TST, NULL, "(pDev %p) = %d\n", pDev, Res);
+  return Res;
+}
+
+
+/**
+ * @brief Configure (or disable) the software transmit queues
+ * @param pDev LLC device pointer
+ * @param pConfig The queue configuration
+ * @return Zero (LLC_STATUS_SUCCESS) or -EINVAL
+ */
+int LOCAL LLC_MsgTxQConfig (struct LLCDev *pDev,
+                            const tLLCTxQConfig *pConfig)
+{
+  int Res = -EINVAL;
+  tMKxRadio Radio;
+  tMKxChannel Chan;
+  int TxQ;
+
+  d_fnstart(D_TST, NULL, "(pDev %p Sched %d)\n", pDev, pConfig->Sched);
+  d_assert(pDev != NULL);
+
+  if ((pConfig->Sched > LLC_TXQ_SCHED_WEIGHTED) ||
+      ((pConfig->Sched != LLC_TXQ_SCHED_OFF) &&
+       ((pConfig->InFlightMax == 0) || (pConfig->Depth == 0))))
+    goto Error;
+
+  pDev->Msg.TxQ.Config = *pConfig;
+  // Start a new weighted round
+  for (Radio = MKX_RADIO_A; Radio < MKX_RADIO_COUNT; Radio++)
+    for (Chan = MKX_CHANNEL_0; Chan < MKX_CHANNEL_COUNT; Chan++)
+      for (TxQ = 0; TxQ < MKX_TXQ_COUNT; TxQ++)
+        pDev->Msg.TxQ.Q[Radio][Chan][TxQ].Credit = 0;
+
+  // Release whatever the new configuration allows (all of it if disabled)
+  LLC_MsgTxQRun(pDev);
+  Res = LLC_STATUS_SUCCESS;
+
+Error:
+  d_fnend(D_TST, NULL, "(pDev %p) = %d\n", pDev, Res);
+  return Res;
+}
+
+
+/**
+ * @brief Get the software transmit queue counters of a radio and channel
+ * @param pDev LLC device pointer
+ * @param Radio
+ * @param Chan
+ * @param pStats Array of MKX_TXQ_COUNT, indexed by tMKxTxQueue
+ * @return Zero (LLC_STATUS_SUCCESS) or -EINVAL
+ */
+int LOCAL LLC_MsgTxQStats (struct LLCDev *pDev,
+                           tMKxRadio Radio,
+                           tMKxChannel Chan,
+                           tLLCTxQStats *pStats)
+{
+  int TxQ;
+
+  if (!LLC_RADIO_CHAN_VALID(Radio, Chan))
+    return -EINVAL;
+
+  for (TxQ = 0; TxQ < MKX_TXQ_COUNT; TxQ++)
+    pStats[TxQ] = pDev->Msg.TxQ.Q[Radio][Chan][TxQ].Stats;
+  return LLC_STATUS_SUCCESS;
+}
+
+
 /**
  * @brief Parse a RxPkt message and pass it to the API
  *
@@ -364,6 +1318,33 @@ static int LLC_MsgRxPkt (struct LLCDev *pDev,
   }
   ; // TODO more
 
+  if (pMsg->Ret == MKXSTATUS_SUCCESS)
+    LLC_TSFSample(pDev, ((struct MKxRxPacket *)pMsg)->RxPacketData.RxTSF,
+                  pDev->Msg.RxTime);
+
+  // Zero-copy: hand over the message in place, with a reference on its slot
+  // in the receive ring as the pPriv (dropped by the client's MKx_RxRelease())
+  if (pDev->Msg.RxZeroCopy)
+  {
+    if (pDev->MKx.API.Callbacks.RxInd == NULL)
+      goto Error;
+
+    // The receive thread takes the reference (and owns the Rx ring)
+    if (pDev->Msg.pRxHold != NULL)
+      pDev->Msg.pRxPriv = pDev->Msg.pRxHold;
+    else if (pDev->Thread.Enabled == false)
+      pDev->Msg.pRxPriv = LLC_InterfaceRxHold(pDev);
+    pDev->Msg.pRxHold = NULL;
+    if (pDev->Msg.pRxPriv == NULL)
+    {
+      d_error(D_ERR, NULL, "LLC_InterfaceRxHold failed.\n");
+      goto Error;
+    }
+    Res = LLC_RxInd(&(pDev->MKx), (struct MKxRxPacket *)pMsg,
+                    pDev->Msg.pRxPriv);
+    goto Error;
+  }
+
   // don't bother trying to call LLC_RxAlloc() if there is no RxAlloc Callback
   // since it will fail (and clearly if there is no RxAlloc Callback then no-one
   // cares about trying to receive the packet anyway)
@@ -420,17 +1401,11 @@ int LOCAL LLC_MsgCfgReq (struct LLCDev *pDev,
     pMsg->Ret = MKXSTATUS_RESERVED;
 
     // Pass it to the underlying transport layer (blocks until sent)
+    // (the requested config is already in the MKx structure, see
+    // LLC_CfgApply())
     Res = LLC_MsgSend(pDev, pMsg);
   }
 
-  // Optimistically apply the requested config to the MKx structure
-  // (eventually overwritten by the contents of the reply message)
-  {
-    memcpy((void *)&(pDev->MKx.Config.Radio[Radio]),
-           &(pConfig->RadioConfigData),
-           sizeof(struct MKxRadioConfigData));
-  }
-
 Error:
   d_fnend(D_TST, NULL, "(pDev %p) = %d\n", pDev, Res);
   return Res;
@@ -471,6 +1446,8 @@ static int LLC_MsgCfgInd (struct LLCDev *pDev,
     memcpy((void *)&(pDev->MKx.Config.Radio[Radio]),
            &(pRadioConfig->RadioConfigData),
            sizeof(struct MKxRadioConfigData));
+    // Confirms (or fails) the outstanding request, if any
+    LLC_CfgInd(pDev, Radio, &(pRadioConfig->RadioConfigData), pMsg->Ret);
   }
   // Set the notification
   if (pMsg->Ret != 0)
@@ -848,8 +1825,12 @@ static int LLC_MsgSecInd (struct LLCDev *pDev,
     goto Error;
   }
 
-  // Call the C2XSecInd API function
-  Res = LLC_C2XSecInd(&(pDev->MKx), (tMKxC2XSec *)pMsg);
+  // Complete the pipelined command (MKx_C2XSecSubmit()) it answers, or
+  // call the C2XSecInd API function
+  if (LLC_SecInd(pDev, (tMKxC2XSec *)pMsg))
+    Res = LLC_STATUS_SUCCESS;
+  else
+    Res = LLC_C2XSecInd(&(pDev->MKx), (tMKxC2XSec *)pMsg);
 
 Error:
   d_fnend(D_VERBOSE, NULL, "(pDev %p) = %d\n", pDev, Res);
@@ -889,6 +1870,14 @@ static int LLC_MsgStatsInd (struct LLCDev *pDev,
   memcpy((void *)&(pDev->MKx.State.Stats[Radio].RadioStatsData),
          (struct tMKxRadioStatsData *)(pMsg->Data),
          sizeof(tMKxRadioStatsData));
+  if (pMsg->Ret == MKXSTATUS_SUCCESS)
+  {
+    LLC_TSFSample(pDev, pDev->MKx.State.Stats[Radio].RadioStatsData.TSF,
+                  pDev->Msg.RxTime);
+    LLC_CBRSample(pDev, Radio, (pMsg->Seq == 0) ? MKX_CHANNEL_0 : MKX_CHANNEL_1,
+                  &(pDev->MKx.State.Stats[Radio].RadioStatsData),
+                  pDev->Msg.RxTime);
+  }
 
   // Send the 'stats' notification
   Notif = MKX_NOTIF_MASK_STATS;
@@ -0,0 +1,248 @@
+/**
+ * @addtogroup cohda_llc_intern_lib LLC API library
+ * @{
+ *
+ * @file
+ * LLC: Pipelined C2X security commands (matched to their responses by USN)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2013 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include "llc-lib.h"
+
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Shortest message that carries a USN [bytes]
+#define LLC_SEC_USN_LEN (offsetof(tMKxC2XSec, APDU) + 2)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Reset the pipeline to its defaults (nothing outstanding)
+ * @param pDev LLC device pointer
+ */
+void LOCAL LLC_SecSetup (struct LLCDev *pDev)
+{
+  d_assert(pDev != NULL);
+
+  memset(&(pDev->Sec), 0, sizeof(pDev->Sec));
+  pDev->Sec.NextUSN = LLC_SEC_USN_FIRST;
+  pDev->Sec.Config.Window = LLC_SEC_WINDOW_DEFAULT;
+  pDev->Sec.Config.Timeout = LLC_SEC_TIMEOUT_DEFAULT;
+}
+
+/**
+ * @brief Set the window and timeout
+ * @param pDev LLC device pointer
+ * @param pConfig
+ * @return Zero (LLC_STATUS_SUCCESS) or -EINVAL
+ */
+int LOCAL LLC_SecConfig (struct LLCDev *pDev,
+                         const tLLCC2XSecConfig *pConfig)
+{
+  if ((pConfig->Window == 0) || (pConfig->Window > LLC_SEC_WINDOW_MAX) ||
+      (pConfig->Timeout == 0))
+    return -EINVAL;
+
+  pDev->Sec.Config = *pConfig;
+  return LLC_STATUS_SUCCESS;
+}
+
+/**
+ * @brief Finish with an outstanding command
+ * @param pDev LLC device pointer
+ * @param pCmd The command's slot
+ * @param pRsp Its response (or NULL)
+ * @param Result Passed to its callback
+ */
+static void LLC_SecComplete (struct LLCDev *pDev,
+                             struct LLCSecCmd *pCmd,
+                             tMKxC2XSec *pRsp,
+                             tMKxStatus Result)
+{
+  struct LLCSecCmd Cmd = *pCmd;
+
+  // Free the slot first: the callback may well submit the next command
+  pCmd->Used = false;
+  pDev->Sec.Stats.InFlight--;
+
+  if (Cmd.Done != NULL)
+    Cmd.Done(&(pDev->MKx), Cmd.USN, pRsp, Result, Cmd.pPriv);
+}
+
+/**
+ * @brief Send a command, giving it a USN and a slot in the window
+ * @param pDev LLC device pointer
+ * @param pMsg The command
+ * @param Done Called on completion
+ * @param pPriv Passed to Done
+ * @return The USN, or a negative errno
+ */
+int LOCAL LLC_SecSubmit (struct LLCDev *pDev,
+                         tMKxC2XSec *pMsg,
+                         fLLC_C2XSecDone Done,
+                         void *pPriv)
+{
+  int Res = -EBUSY;
+  struct LLCSecCmd *pCmd = NULL;
+  uint16_t USN;
+  int i;
+
+  d_fnstart(D_TST, NULL, "(pDev %p)\n", pDev);
+  d_assert(pDev != NULL);
+
+  if (pMsg->Hdr.Len < LLC_SEC_USN_LEN)
+  {
+    Res = -EINVAL;
+    goto Error;
+  }
+
+  // Make room by timing out any lost responses
+  if (pDev->Sec.Stats.InFlight >= pDev->Sec.Config.Window)
+    LLC_SecReclaim(pDev);
+  if (pDev->Sec.Stats.InFlight >= pDev->Sec.Config.Window)
+  {
+    pDev->Sec.Stats.Full++;
+    goto Error;
+  }
+
+  // Next USN whose slot is free (there is one, as InFlight < Window),
+  // wrapping within the pipelined range
+  for (i = 0; i < LLC_SEC_WINDOW_MAX; i++)
+  {
+    USN = pDev->Sec.NextUSN;
+    pDev->Sec.NextUSN = (USN == 0xFFFF) ? LLC_SEC_USN_FIRST : (USN + 1);
+    pCmd = &(pDev->Sec.Cmds[USN % LLC_SEC_WINDOW_MAX]);
+    if (!pCmd->Used)
+      break;
+  }
+  d_assert(!pCmd->Used);
+
+  pMsg->APDU.Cmd.USN[0] = USN >> 8;
+  pMsg->APDU.Cmd.USN[1] = USN & 0xFF;
+  pCmd->Used = true;
+  pCmd->USN = USN;
+  pCmd->Time = LLC_MsgTime();
+  pCmd->Done = Done;
+  pCmd->pPriv = pPriv;
+  pDev->Sec.Stats.InFlight++;
+  if (pDev->Sec.Stats.InFlight > pDev->Sec.Stats.InFlightMax)
+    pDev->Sec.Stats.InFlightMax = pDev->Sec.Stats.InFlight;
+
+  Res = LLC_MsgSecReq(pDev, pMsg);
+  if (Res < 0)
+  {
+    pCmd->Used = false;
+    pDev->Sec.Stats.InFlight--;
+    goto Error;
+  }
+  pDev->Sec.Stats.Sent++;
+  Res = USN;
+
+Error:
+  d_fnend(D_TST, NULL, "(pDev %p) = %d\n", pDev, Res);
+  return Res;
+}
+
+/**
+ * @brief Complete the command a response belongs to
+ * @param pDev LLC device pointer
+ * @param pMsg The response
+ * @return true if it matched an outstanding command, false if it is for the
+ *         C2XSecRsp() callback (as are all those to C2XSecCmd() commands)
+ */
+bool LOCAL LLC_SecInd (struct LLCDev *pDev,
+                       tMKxC2XSec *pMsg)
+{
+  struct LLCSecCmd *pCmd;
+  tLLCC2XSecStats *pStats = &(pDev->Sec.Stats);
+  uint64_t Latency;
+  uint16_t USN;
+  int Bin = 0;
+
+  if (pMsg->Hdr.Len < LLC_SEC_USN_LEN)
+    goto Unmatched;
+  USN = (pMsg->APDU.Rsp.USN[0] << 8) | pMsg->APDU.Rsp.USN[1];
+  // Below the pipelined range, so a response to a C2XSecCmd() command
+  if (USN < LLC_SEC_USN_FIRST)
+    return false;
+  pCmd = &(pDev->Sec.Cmds[USN % LLC_SEC_WINDOW_MAX]);
+  if ((!pCmd->Used) || (pCmd->USN != USN))
+    goto Unmatched;
+
+  Latency = pDev->Msg.RxTime - pCmd->Time;
+  if (pDev->Msg.RxTime < pCmd->Time)
+    Latency = 0;
+  pStats->Completed++;
+  pStats->Latency += Latency;
+  if (Latency > pStats->LatencyMax)
+    pStats->LatencyMax = Latency;
+  // log2 buckets, as for MKx_GetLibStats()
+  if (Latency != 0)
+    Bin = 64 - __builtin_clzll(Latency);
+  if (Bin >= LLC_STATS_HIST_BINS)
+    Bin = LLC_STATS_HIST_BINS - 1;
+  pStats->Hist[Bin]++;
+
+  LLC_SecComplete(pDev, pCmd, pMsg, pMsg->Hdr.Ret);
+  return true;
+
+Unmatched:
+  pStats->Unmatched++;
+  return false;
+}
+
+/**
+ * @brief Complete the commands whose response is overdue with -ETIMEDOUT
+ * @param pDev LLC device pointer
+ */
+void LOCAL LLC_SecReclaim (struct LLCDev *pDev)
+{
+  struct LLCSecCmd *pCmd;
+  uint64_t Now;
+  uint64_t Timeout;
+  int i;
+
+  if (pDev->Sec.Stats.InFlight == 0)
+    return;
+  Now = LLC_MsgTime();
+  Timeout = pDev->Sec.Config.Timeout * 1000ULL;
+
+  for (i = 0; i < LLC_SEC_WINDOW_MAX; i++)
+  {
+    pCmd = &(pDev->Sec.Cmds[i]);
+    if ((!pCmd->Used) || ((Now - pCmd->Time) < Timeout))
+      continue;
+
+    d_printf(D_WARN, NULL, "C2X security USN %u timeout\n", pCmd->USN);
+    pDev->Sec.Stats.TimedOut++;
+    LLC_SecComplete(pDev, pCmd, NULL, -ETIMEDOUT);
+  }
+}
+
+/**
+ * @}
+ */
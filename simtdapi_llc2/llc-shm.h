@@ -0,0 +1,156 @@
+/**
+ * @addtogroup cohda_llc_intern_lib LLC API library
+ * @{
+ *
+ * @file
+ * LLC: Shared memory transport layout (shared by llc-if-shm.c and the
+ *      llc-standin program)
+ *
+ * The MKx end (llc-standin) creates the shared memory and listens on the
+ * abstract unix socket LLC_SHM_SOCKET_FMT. The LLC connects to it and is sent
+ * the shared memory's file descriptor (SCM_RIGHTS) with the first byte. Each
+ * direction is a single-producer single-consumer ring of fixed size slots.
+ * The socket stays open as the doorbell: a byte is written when a message is
+ * put into an empty ring, and the consumer drains the socket before it
+ * re-checks the ring, so neither end misses a wakeup or makes a system call
+ * per message while the other keeps up.
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2013 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+#ifndef __COHDA__APP__LLC__LIB__LLC_SHM_H__
+#define __COHDA__APP__LLC__LIB__LLC_SHM_H__
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// 'Magic' value at the start of the shared memory ('LLCS')
+#define LLC_SHM_MAGIC (0x4C4C4353)
+
+/// Abstract unix socket name (formatted with the interface name)
+#define LLC_SHM_SOCKET_FMT "llc-shm-%s"
+
+/// Number of slots in each ring (a power of two, 4MB as for a socket buffer)
+#define LLC_SHM_SLOT_CNT (1024)
+/// Size of each slot, including its length [bytes]
+#define LLC_SHM_SLOT_SIZE (4 * 1024)
+/// Largest message that fits in a slot [bytes]
+#define LLC_SHM_MSG_MAX (LLC_SHM_SLOT_SIZE - sizeof(uint32_t))
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+/// A message slot
+typedef struct LLCShmSlot
+{
+  /// Length of the message [bytes]
+  uint32_t Len;
+  /// The message
+  uint8_t Data[LLC_SHM_MSG_MAX];
+} tLLCShmSlot;
+
+/// Single-producer single-consumer ring of message slots
+typedef struct LLCShmRing
+{
+  /// Next slot to consume (only written by the consumer)
+  uint32_t Head __attribute__((aligned(64)));
+  /// Next slot to produce (only written by the producer)
+  uint32_t Tail __attribute__((aligned(64)));
+  /// Slot storage
+  tLLCShmSlot Slots[LLC_SHM_SLOT_CNT] __attribute__((aligned(64)));
+} tLLCShmRing;
+
+/// The shared memory
+typedef struct LLCShmMap
+{
+  /// LLC_SHM_MAGIC once initialised
+  uint32_t Magic;
+  /// Messages from the LLC to the MKx
+  tLLCShmRing ToMKx;
+  /// Messages from the MKx to the LLC
+  tLLCShmRing FromMKx;
+} tLLCShmMap;
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Put a message into a ring
+ * @param pRing
+ * @param pBuf Message
+ * @param Len Message length [bytes]
+ * @param pWasEmpty Set to true if the ring was empty (the doorbell is needed)
+ * @return zero on success, -ENOBUFS if the ring is full, -EMSGSIZE if the
+ *         message doesn't fit in a slot
+ */
+static inline int LLC_ShmPut (tLLCShmRing *pRing,
+                              const void *pBuf,
+                              int Len,
+                              bool *pWasEmpty)
+{
+  uint32_t Tail = pRing->Tail;
+  tLLCShmSlot *pSlot;
+
+  if ((Len < 0) || ((unsigned int)Len > LLC_SHM_MSG_MAX))
+    return -EMSGSIZE;
+  if ((Tail - __atomic_load_n(&(pRing->Head), __ATOMIC_ACQUIRE)) >=
+      LLC_SHM_SLOT_CNT)
+    return -ENOBUFS;
+
+  pSlot = &(pRing->Slots[Tail & (LLC_SHM_SLOT_CNT - 1)]);
+  pSlot->Len = Len;
+  memcpy(pSlot->Data, pBuf, Len);
+  // Sequentially consistent with the consumer's Head update and Tail
+  // re-check (LLC_ShmPop()), so that one of the two sides sees the other
+  __atomic_store_n(&(pRing->Tail), Tail + 1, __ATOMIC_SEQ_CST);
+  *pWasEmpty = (__atomic_load_n(&(pRing->Head), __ATOMIC_SEQ_CST) == Tail);
+  return 0;
+}
+
+/**
+ * @brief Get the oldest message in a ring (it stays there until LLC_ShmPop())
+ * @param pRing
+ * @param pLen Set to the message length [bytes]
+ * @return The message, or NULL if the ring is empty
+ */
+static inline void *LLC_ShmPeek (tLLCShmRing *pRing,
+                                 int *pLen)
+{
+  uint32_t Head = pRing->Head;
+  tLLCShmSlot *pSlot;
+
+  if (__atomic_load_n(&(pRing->Tail), __ATOMIC_SEQ_CST) == Head)
+    return NULL;
+
+  pSlot = &(pRing->Slots[Head & (LLC_SHM_SLOT_CNT - 1)]);
+  *pLen = (pSlot->Len > LLC_SHM_MSG_MAX) ? LLC_SHM_MSG_MAX : pSlot->Len;
+  return pSlot->Data;
+}
+
+/**
+ * @brief Release the oldest message in a ring (see LLC_ShmPeek())
+ * @param pRing
+ */
+static inline void LLC_ShmPop (tLLCShmRing *pRing)
+{
+  __atomic_store_n(&(pRing->Head), pRing->Head + 1, __ATOMIC_SEQ_CST);
+}
+
+#endif // __COHDA__APP__LLC__LIB__LLC_SHM_H__
+
+/**
+ * @}
+ */
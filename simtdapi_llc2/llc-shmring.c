@@ -0,0 +1,364 @@
+/**
+ * @addtogroup cohda_llc_intern_app LLC application
+ * @{
+ *
+ * @file
+ * LLC: Shared memory message ring (see llc-shmring.h)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2015 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#define _GNU_SOURCE // F_ADD_SEALS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "llc-shmring.h"
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Name of the memfd (only seen in /proc/<pid>/fd)
+#define LLC_SHMRING_NAME  "llc-rx-ring"
+/// Slot alignment [bytes] (a cache line)
+#define LLC_SHMRING_ALIGN (64)
+/// Most slots
+#define LLC_SHMRING_MAX   (65536)
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC       (0x0001U)
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING (0x0002U)
+#endif
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions definitions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Create the (anonymous) shared memory file
+ * @return Its descriptor, or a negative errno
+ *
+ * Kernels older than 3.17 have no memfd_create(), so use an unlinked file in
+ * /dev/shm instead.
+ */
+static int LLC_ShmRingCreate (void)
+{
+  char Name[] = "/dev/shm/" LLC_SHMRING_NAME "-XXXXXX";
+  int Fd = -1;
+
+#ifdef __NR_memfd_create
+  Fd = syscall(__NR_memfd_create, LLC_SHMRING_NAME,
+               MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (Fd >= 0)
+    return Fd;
+  if (errno != ENOSYS)
+    return -errno;
+#endif
+
+  Fd = mkostemp(Name, O_CLOEXEC);
+  if (Fd < 0)
+    return -errno;
+  (void)unlink(Name);
+  return Fd;
+}
+
+/**
+ * @brief Get the address of a slot
+ */
+static inline tLLCShmRingSlot *LLC_ShmRingSlot (const tLLCShmRingHdr *pHdr,
+                                                uint64_t Seq)
+{
+  return (tLLCShmRingSlot *)((uint8_t *)pHdr + pHdr->HdrLen +
+                             ((size_t)(Seq & (pHdr->SlotCnt - 1)) *
+                              pHdr->SlotSize));
+}
+
+/**
+ * @brief Create the ring
+ * @param pRing
+ * @param SlotCnt Number of records kept (rounded up to a power of two)
+ * @param MaxLen Longest record [bytes]
+ * @return Zero, or a negative errno
+ */
+int LLC_ShmRingInit (tLLCShmRing *pRing,
+                     uint32_t SlotCnt,
+                     uint32_t MaxLen)
+{
+  tLLCShmRingHdr *pHdr;
+  char Path[32];
+  uint32_t SlotSize;
+  uint32_t Cnt = 1;
+  int Res = -EINVAL;
+
+  d_fnstart(D_TST, NULL, "(SlotCnt %u MaxLen %u)\n", SlotCnt, MaxLen);
+
+  memset(pRing, 0, sizeof(*pRing));
+  pRing->Fd = -1;
+  pRing->ReadFd = -1;
+  if ((SlotCnt == 0) || (SlotCnt > LLC_SHMRING_MAX) || (MaxLen == 0) ||
+      (MaxLen > UINT16_MAX))
+    goto Error;
+
+  while (Cnt < SlotCnt)
+    Cnt <<= 1;
+  SlotSize = (sizeof(tLLCShmRingSlot) + MaxLen + LLC_SHMRING_ALIGN - 1) &
+             ~(LLC_SHMRING_ALIGN - 1);
+  pRing->MapLen = sizeof(tLLCShmRingHdr) + ((size_t)Cnt * SlotSize);
+
+  pRing->Fd = LLC_ShmRingCreate();
+  if (pRing->Fd < 0)
+  {
+    Res = pRing->Fd;
+    goto Error;
+  }
+  if (ftruncate(pRing->Fd, pRing->MapLen) != 0)
+  {
+    Res = -errno;
+    goto Error;
+  }
+#ifdef F_ADD_SEALS
+  // Readers can rely on the size (no SIGBUS from a shrunk file)
+  (void)fcntl(pRing->Fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+#endif
+
+  pHdr = mmap(NULL, pRing->MapLen, PROT_READ | PROT_WRITE, MAP_SHARED,
+              pRing->Fd, 0);
+  if (pHdr == MAP_FAILED)
+  {
+    Res = -errno;
+    goto Error;
+  }
+  pRing->pHdr = pHdr;
+  // A fresh file is zero filled, so no slot looks complete
+  pHdr->Version = LLC_SHMRING_VERSION;
+  pHdr->HdrLen = sizeof(tLLCShmRingHdr);
+  pHdr->SlotCnt = Cnt;
+  pHdr->SlotSize = SlotSize;
+  pHdr->Head = 0;
+  __atomic_store_n(&(pHdr->Magic), LLC_SHMRING_MAGIC, __ATOMIC_RELEASE);
+
+  // Readers get a descriptor they can't map writable
+  snprintf(Path, sizeof(Path), "/proc/self/fd/%d", pRing->Fd);
+  pRing->ReadFd = open(Path, O_RDONLY | O_CLOEXEC);
+  if (pRing->ReadFd < 0)
+  {
+    d_printf(D_WARN, NULL, "No read-only descriptor (%s)\n", strerror(errno));
+    pRing->ReadFd = pRing->Fd;
+  }
+  d_printf(D_INFO, NULL, "%u slots of %u bytes (%zu bytes)\n",
+           Cnt, SlotSize, pRing->MapLen);
+  Res = 0;
+
+Error:
+  if (Res < 0)
+    LLC_ShmRingExit(pRing);
+  d_fnend(D_TST, NULL, "(SlotCnt %u MaxLen %u) = %d\n", SlotCnt, MaxLen, Res);
+  return Res;
+}
+
+/**
+ * @brief Destroy the ring (readers keep their mappings)
+ * @param pRing
+ */
+void LLC_ShmRingExit (tLLCShmRing *pRing)
+{
+  if (pRing->pHdr != NULL)
+    munmap(pRing->pHdr, pRing->MapLen);
+  if ((pRing->ReadFd >= 0) && (pRing->ReadFd != pRing->Fd))
+    close(pRing->ReadFd);
+  if (pRing->Fd >= 0)
+    close(pRing->Fd);
+  memset(pRing, 0, sizeof(*pRing));
+  pRing->Fd = -1;
+  pRing->ReadFd = -1;
+}
+
+/**
+ * @brief Write a record, overwriting the oldest
+ * @param pRing
+ * @param pBuf The record
+ * @param Len Its length [bytes]
+ * @param Priority Passed on to the readers
+ * @return Zero, or a negative errno
+ */
+int LLC_ShmRingPut (tLLCShmRing *pRing,
+                    const void *pBuf,
+                    int Len,
+                    uint8_t Priority)
+{
+  tLLCShmRingHdr *pHdr = pRing->pHdr;
+  tLLCShmRingSlot *pSlot;
+  struct timespec Now;
+
+  if (pHdr == NULL)
+    return -ENODEV;
+  if ((Len < 0) || ((sizeof(*pSlot) + Len) > pHdr->SlotSize))
+    return -EMSGSIZE;
+
+  pSlot = LLC_ShmRingSlot(pHdr, pRing->Head);
+  // Mark it before touching the contents (see LLC_ShmRingRead())
+  __atomic_store_n(&(pSlot->Seq), LLC_SHMRING_BUSY, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  pSlot->Time = ((uint64_t)Now.tv_sec * 1000000) + (Now.tv_nsec / 1000);
+  pSlot->Len = Len;
+  pSlot->Priority = Priority;
+  memcpy(pSlot->Data, pBuf, Len);
+
+  pRing->Head++;
+  __atomic_store_n(&(pSlot->Seq), pRing->Head, __ATOMIC_RELEASE);
+  __atomic_store_n(&(pHdr->Head), pRing->Head, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/**
+ * @brief Map a ring (as a reader), starting with the next record written
+ * @param pReader
+ * @param Fd The descriptor (e.g. received from the IPC server)
+ * @return Zero, or a negative errno
+ */
+int LLC_ShmRingAttach (tLLCShmRingReader *pReader,
+                       int Fd)
+{
+  const tLLCShmRingHdr *pHdr;
+  struct stat Stat;
+  int Res;
+
+  memset(pReader, 0, sizeof(*pReader));
+  if (fstat(Fd, &Stat) != 0)
+    return -errno;
+  if ((size_t)Stat.st_size < sizeof(tLLCShmRingHdr))
+    return -EINVAL;
+
+  pHdr = mmap(NULL, Stat.st_size, PROT_READ, MAP_SHARED, Fd, 0);
+  if (pHdr == MAP_FAILED)
+    return -errno;
+  pReader->pHdr = pHdr;
+  pReader->MapLen = Stat.st_size;
+
+  Res = -EPROTO;
+  if ((__atomic_load_n(&(pHdr->Magic), __ATOMIC_ACQUIRE) != LLC_SHMRING_MAGIC) ||
+      (pHdr->Version != LLC_SHMRING_VERSION))
+    goto Error;
+  if ((pHdr->SlotCnt == 0) || (pHdr->SlotCnt & (pHdr->SlotCnt - 1)) ||
+      (pHdr->SlotSize <= sizeof(tLLCShmRingSlot)) ||
+      ((pHdr->HdrLen + ((size_t)pHdr->SlotCnt * pHdr->SlotSize)) >
+       pReader->MapLen))
+    goto Error;
+
+  pReader->Next = __atomic_load_n(&(pHdr->Head), __ATOMIC_ACQUIRE);
+  return 0;
+
+Error:
+  LLC_ShmRingDetach(pReader);
+  return Res;
+}
+
+/**
+ * @brief Unmap a ring
+ * @param pReader
+ */
+void LLC_ShmRingDetach (tLLCShmRingReader *pReader)
+{
+  if (pReader->pHdr != NULL)
+    munmap((void *)pReader->pHdr, pReader->MapLen);
+  memset(pReader, 0, sizeof(*pReader));
+}
+
+/**
+ * @brief Read the next record (skipping any that have been overwritten)
+ * @param pReader
+ * @param pBuf Where to copy it
+ * @param Len Size of pBuf [bytes]
+ * @param pSeq Set to the record number (may be NULL)
+ * @return The record's length, zero if there's nothing new, or -EMSGSIZE if
+ *         it doesn't fit in pBuf (and was skipped)
+ *
+ * Records lost to overruns are counted in pReader->Stats.Lost (and show as
+ * gaps in the record numbers).
+ */
+int LLC_ShmRingRead (tLLCShmRingReader *pReader,
+                     void *pBuf,
+                     int Len,
+                     uint64_t *pSeq)
+{
+  const tLLCShmRingHdr *pHdr = pReader->pHdr;
+  const tLLCShmRingSlot *pSlot;
+  uint64_t Head;
+  uint64_t Seq;
+  int RecLen;
+
+  if (pHdr == NULL)
+    return -ENODEV;
+
+  while (1)
+  {
+    Head = __atomic_load_n(&(pHdr->Head), __ATOMIC_ACQUIRE);
+    if (pReader->Next == Head)
+      return 0;
+    // Lapped: the oldest records still there are the last SlotCnt
+    if ((Head - pReader->Next) > pHdr->SlotCnt)
+    {
+      pReader->Stats.Lost += (Head - pHdr->SlotCnt) - pReader->Next;
+      pReader->Next = Head - pHdr->SlotCnt;
+    }
+
+    pSlot = LLC_ShmRingSlot(pHdr, pReader->Next);
+    Seq = __atomic_load_n(&(pSlot->Seq), __ATOMIC_ACQUIRE);
+    if (Seq == pReader->Next + 1)
+    {
+      RecLen = pSlot->Len;
+      if ((sizeof(*pSlot) + RecLen) <= pHdr->SlotSize)
+      {
+        if (RecLen <= Len)
+          memcpy(pBuf, pSlot->Data, RecLen);
+        // Still the same record, so the copy is good
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&(pSlot->Seq), __ATOMIC_RELAXED) == Seq)
+        {
+          if (pSeq != NULL)
+            *pSeq = pReader->Next;
+          pReader->Next++;
+          if (RecLen > Len)
+            return -EMSGSIZE;
+          pReader->Stats.Read++;
+          return RecLen;
+        }
+      }
+    }
+
+    // Overwritten (or being overwritten) since Head was read
+    pReader->Stats.Lost++;
+    pReader->Next++;
+  }
+}
+
+/**
+ * @}
+ */
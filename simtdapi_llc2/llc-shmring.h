@@ -0,0 +1,146 @@
+/**
+ * @addtogroup cohda_llc_intern_app LLC application
+ * @{
+ *
+ * @file
+ * LLC: Shared memory message ring (one writer, any number of readers)
+ *
+ * The ring lives in a memfd that readers map read-only (the descriptor is
+ * passed to them over the IPC socket, see llc-ipc.h). The writer never waits
+ * for a reader: each reader keeps its own position, reads at its own pace and
+ * counts the records that were overwritten before it got to them.
+ *
+ * Record N is written to slot (N % SlotCnt). While a slot is being written
+ * its Seq is LLC_SHMRING_BUSY, and once complete it is N + 1, after which the
+ * header's Head becomes N + 1. A reader copies a record out and then checks
+ * that the slot's Seq hasn't changed (i.e. it wasn't overwritten meanwhile).
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2015 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+#ifndef __LLC_SHMRING_H__
+#define __LLC_SHMRING_H__
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Header magic ('LLCR')
+#define LLC_SHMRING_MAGIC   (0x4C4C4352)
+/// Layout version
+#define LLC_SHMRING_VERSION (1)
+/// Slot Seq while the slot is being written
+#define LLC_SHMRING_BUSY    (UINT64_MAX)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+/// Start of the shared memory
+typedef struct LLCShmRingHdr
+{
+  /// LLC_SHMRING_MAGIC
+  uint32_t Magic;
+  /// LLC_SHMRING_VERSION
+  uint16_t Version;
+  /// Offset of the first slot [bytes]
+  uint16_t HdrLen;
+  /// Number of slots (a power of two)
+  uint32_t SlotCnt;
+  /// Size of each slot, including its tLLCShmRingSlot header [bytes]
+  uint32_t SlotSize;
+  /// Number of records written (on its own cache line)
+  uint64_t Head __attribute__((aligned(64)));
+} tLLCShmRingHdr;
+
+/// A slot
+typedef struct LLCShmRingSlot
+{
+  /// Record number + 1 (or LLC_SHMRING_BUSY)
+  uint64_t Seq;
+  /// When it was written (CLOCK_MONOTONIC) [us]
+  uint64_t Time;
+  /// Length of the record [bytes]
+  uint16_t Len;
+  /// As passed to LLC_ShmRingPut()
+  uint8_t Priority;
+  uint8_t Reserved[5];
+  /// The record
+  uint8_t Data[];
+} tLLCShmRingSlot;
+
+/// Writer state
+typedef struct LLCShmRing
+{
+  /// The memfd
+  int Fd;
+  /// A read-only descriptor of it (for the readers)
+  int ReadFd;
+  /// Mapping
+  tLLCShmRingHdr *pHdr;
+  size_t MapLen;
+  /// Number of records written
+  uint64_t Head;
+} tLLCShmRing;
+
+/// Reader state
+typedef struct LLCShmRingReader
+{
+  /// Mapping (read-only)
+  const tLLCShmRingHdr *pHdr;
+  size_t MapLen;
+  /// Next record to read
+  uint64_t Next;
+  /// Counters
+  struct
+  {
+    /// Records read
+    uint64_t Read;
+    /// Records overwritten before they were read
+    uint64_t Lost;
+  } Stats;
+} tLLCShmRingReader;
+
+//------------------------------------------------------------------------------
+// Function declarations
+//------------------------------------------------------------------------------
+
+int LLC_ShmRingInit (tLLCShmRing *pRing,
+                     uint32_t SlotCnt,
+                     uint32_t MaxLen);
+void LLC_ShmRingExit (tLLCShmRing *pRing);
+int LLC_ShmRingPut (tLLCShmRing *pRing,
+                    const void *pBuf,
+                    int Len,
+                    uint8_t Priority);
+
+int LLC_ShmRingAttach (tLLCShmRingReader *pReader,
+                       int Fd);
+void LLC_ShmRingDetach (tLLCShmRingReader *pReader);
+int LLC_ShmRingRead (tLLCShmRingReader *pReader,
+                     void *pBuf,
+                     int Len,
+                     uint64_t *pSeq);
+
+/**
+ * @brief Read-only descriptor of the ring (to pass to readers)
+ */
+static inline int LLC_ShmRingFd (const tLLCShmRing *pRing)
+{
+  return pRing->ReadFd;
+}
+
+#endif // __LLC_SHMRING_H__
+
+/**
+ * @}
+ */
@@ -0,0 +1,1048 @@
+/**
+ * @addtogroup cohda_llc_intern_lib LLC API library
+ * @{
+ *
+ * @file
+ * LLC: Userspace stand-in for the MKx (SAF5100) end of the 'cw-llc' interface
+ *
+ * Speaks the MKxIF protocol over a TAP interface that it creates (or over an
+ * existing interface, e.g. one end of a veth pair) so that the LLC library,
+ * android_llc2 and the test applications can be run (and benchmarked) at
+ * full rate without any MKx hardware:
+ * - MKXIF_TXPACKET is answered with a MKXIF_TXEVENT after a configurable
+ *   latency. A configurable fraction fail, or get no TxEvent at all.
+ * - Transmitted frames are looped back as MKXIF_RXPACKET with a synthetic
+ *   RxTSF, RSSI and noise floor (minus a configurable loss).
+ * - Radio config, temperature (config) and power detector config requests
+ *   are echoed back as the MKx would confirm them. MKXIF_SET_TSF and
+ *   MKXIF_FLUSHQ are honoured.
+ * - C2X security commands get an immediate (empty) success response with
+ *   the command's USN.
+ * - Radio stats (with the TSF and a channel busy ratio) are sent
+ *   periodically.
+ *
+ * The applications find the stand-in with LLC_IFNAME (if it isn't 'cw-llc').
+ * With -m there is no network interface at all: the stand-in serves the
+ * shared memory transport (LLC_TRANSPORT=shm, see llc-shm.h) instead.
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2013 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#define _GNU_SOURCE // ppoll(), memfd_create()
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+
+#include "linux/cohda/llc/llc-api.h"
+#include "llc-api-ext.h"
+#include "llc-shm.h"
+
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Default interface to create
+#define LLC_STANDIN_IFNAME_DEFAULT "cw-llc"
+
+/// Most TxEvent's waiting for their latency to expire (a power of two)
+#define LLC_STANDIN_PENDING_MAX 4096
+
+/// Largest MKxIF message [bytes]
+#define LLC_STANDIN_MSG_MAX (4 * 1024)
+
+/// Nominal PHY rate used for the synthetic airtime (6 Mbps, 10 MHz) [bit/us]
+#define LLC_STANDIN_PHY_RATE 6
+/// Nominal preamble + header airtime [us]
+#define LLC_STANDIN_PHY_OVERHEAD 40
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+/// A TxEvent waiting for its latency to expire
+typedef struct LLCStandInPending
+{
+  /// When the TxEvent is due (CLOCK_MONOTONIC) [us]
+  uint64_t Due;
+  /// The TxReq's sequence number
+  uint16_t Seq;
+  /// The TxReq's radio and channel (for FLUSHQ and the stats)
+  tMKxRadio Radio;
+  tMKxChannel Chan;
+  /// Transmit result
+  int16_t TxStatus;
+  /// Send the TxEvent at all?
+  bool Lost;
+  /// Transmitted frame (looped back when the TxEvent is sent)
+  uint16_t Len;
+  uint8_t *pFrame;
+  /// MCS of the frame
+  tMKxMCS MCS;
+} tLLCStandInPending;
+
+/// Stand-in state
+typedef struct LLCStandIn
+{
+  /// Options
+  struct
+  {
+    /// Interface to create (TAP) or attach to (Peer)
+    char IfName[IFNAMSIZ];
+    /// Attach to an existing interface instead of creating a TAP
+    bool Peer;
+    /// Serve the shared memory transport instead
+    bool Shm;
+    /// TxReq to TxEvent latency [us]
+    unsigned int Latency;
+    /// Percentage of TxEvent's never sent
+    unsigned int TxEventLoss;
+    /// Percentage of TxReq's that fail (MKXSTATUS_TX_FAIL_RETRIES)
+    unsigned int TxFail;
+    /// Percentage of looped back frames not received
+    unsigned int RxLoss;
+    /// Loop transmitted frames back as received packets
+    bool Loopback;
+    /// RxPowerA/B of looped back frames [0.5 dBm]
+    tMKxPower RSSI;
+    /// RxNoiseA/B of looped back frames [0.5 dBm]
+    tMKxPower Noise;
+    /// Radio stats period [ms] (0: none)
+    unsigned int StatsPeriod;
+  } Opts;
+
+  /// TAP or AF_PACKET file descriptor (or the connected shared memory
+  /// transport client, -1 if none)
+  int Fd;
+  /// Shared memory transport: listening socket, memory and its descriptor
+  int ListenFd;
+  int MemFd;
+  tLLCShmMap *pMap;
+  /// Peer interface index (AF_PACKET only)
+  int IfIndex;
+  /// TSF - CLOCK_MONOTONIC [us]
+  int64_t TSFOffset;
+  /// Next MAC sequence number
+  uint16_t MACSeq;
+  /// Radio modes (from the config requests)
+  tMKxRadioMode Mode[MKX_RADIO_COUNT];
+  /// Pending TxEvent's (FIFO: the latency is constant)
+  tLLCStandInPending Pending[LLC_STANDIN_PENDING_MAX];
+  uint32_t Head;
+  uint32_t Tail;
+  /// Stats (cumulative, as the MKx reports them)
+  tMKxRadioStatsData Stats[MKX_RADIO_COUNT];
+  /// Airtime in the current stats period [us]
+  uint32_t Airtime[MKX_RADIO_COUNT][MKX_CHANNEL_COUNT];
+  /// When the next stats are due (CLOCK_MONOTONIC) [us]
+  uint64_t StatsDue;
+  /// Channel whose stats are sent next (for MKX_MODE_SWITCHED)
+  tMKxChannel StatsChan[MKX_RADIO_COUNT];
+} tLLCStandIn;
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+/// Cleared by SIGINT/SIGTERM
+static volatile bool LLC_StandInRun = true;
+
+//------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Get the current (monotonic) time
+ * @return CLOCK_MONOTONIC time [us]
+ */
+static uint64_t LLC_StandInTime (void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return ((uint64_t)Now.tv_sec * 1000000) + (Now.tv_nsec / 1000);
+}
+
+/**
+ * @brief Get the (synthetic) TSF at a given time
+ * @param pSI Stand-in state
+ * @param Time CLOCK_MONOTONIC time [us]
+ * @return TSF [us]
+ */
+static tMKxTSF LLC_StandInTSF (tLLCStandIn *pSI,
+                               uint64_t Time)
+{
+  return (tMKxTSF)((int64_t)Time + pSI->TSFOffset);
+}
+
+/**
+ * @brief Decide whether something happens, given its percentage chance
+ * @param Percent Chance [%]
+ * @return true if it happens
+ */
+static bool LLC_StandInChance (unsigned int Percent)
+{
+  return (Percent != 0) && ((unsigned int)(rand() % 100) < Percent);
+}
+
+/**
+ * @brief Send a message to the LLC
+ * @param pSI Stand-in state
+ * @param pMsg Message (the buffer must have room for an Ethernet minimum frame)
+ * @return Zero or a negative errno
+ */
+static int LLC_StandInSend (tLLCStandIn *pSI,
+                            struct MKxIFMsg *pMsg)
+{
+  // Short frames are rejected by the kernel, pad them (pMsg->Len is kept)
+  int Len = (pMsg->Len < ETH_ZLEN) ? ETH_ZLEN : pMsg->Len;
+  int Res;
+
+  if (pSI->Opts.Shm)
+  {
+    bool WasEmpty = false;
+
+    if (pSI->Fd < 0)
+      return -ENOTCONN;
+    Res = LLC_ShmPut(&(pSI->pMap->FromMKx), pMsg, pMsg->Len, &WasEmpty);
+    if (Res != 0)
+    {
+      d_error(D_WARN, NULL, "LLC_ShmPut(Type %d Len %d) = %d\n",
+              pMsg->Type, pMsg->Len, Res);
+      return Res;
+    }
+    if (WasEmpty)
+      (void)send(pSI->Fd, "", 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    return 0;
+  }
+
+  if (Len > pMsg->Len)
+    memset((uint8_t *)pMsg + pMsg->Len, 0, Len - pMsg->Len);
+
+  if (pSI->Opts.Peer)
+    Res = send(pSI->Fd, pMsg, Len, 0);
+  else
+    Res = write(pSI->Fd, pMsg, Len);
+  if (Res < 0)
+  {
+    d_error(D_WARN, NULL, "send(Type %d Len %d) = %s\n",
+            pMsg->Type, Len, strerror(errno));
+    return -errno;
+  }
+  return 0;
+}
+
+/**
+ * @brief Loop a transmitted frame back as a received packet
+ * @param pSI Stand-in state
+ * @param pPend The transmitted frame
+ * @param TxTime When it was transmitted (TSF) [us]
+ */
+static void LLC_StandInLoopback (tLLCStandIn *pSI,
+                                 tLLCStandInPending *pPend,
+                                 tMKxTSF TxTime)
+{
+  uint8_t Buf[LLC_STANDIN_MSG_MAX + ETH_ZLEN];
+  tMKxRxPacket *pRx = (tMKxRxPacket *)Buf;
+
+  if (LLC_StandInChance(pSI->Opts.RxLoss))
+    return;
+  if ((sizeof(tMKxRxPacket) + pPend->Len) > LLC_STANDIN_MSG_MAX)
+    return;
+
+  memset(pRx, 0, sizeof(tMKxRxPacket));
+  pRx->Hdr.Type = MKXIF_RXPACKET;
+  pRx->Hdr.Len = sizeof(tMKxRxPacket) + pPend->Len;
+  pRx->Hdr.Seq = 0;
+  pRx->Hdr.Ret = MKXSTATUS_SUCCESS;
+  pRx->RxPacketData.RadioID = pPend->Radio;
+  pRx->RxPacketData.ChannelID = pPend->Chan;
+  pRx->RxPacketData.MCS = pPend->MCS;
+  pRx->RxPacketData.FCSPass = 1;
+  // A little (+/- 1dB) variation around the configured levels
+  pRx->RxPacketData.RxPowerA = pSI->Opts.RSSI + (rand() % 5) - 2;
+  pRx->RxPacketData.RxPowerB = pSI->Opts.RSSI + (rand() % 5) - 2;
+  pRx->RxPacketData.RxNoiseA = pSI->Opts.Noise;
+  pRx->RxPacketData.RxNoiseB = pSI->Opts.Noise;
+  // Timestamped at the end of the frame
+  pRx->RxPacketData.RxTSF = TxTime + LLC_STANDIN_PHY_OVERHEAD +
+                            ((pPend->Len * 8) / LLC_STANDIN_PHY_RATE);
+  pRx->RxPacketData.RxFrameLength = pPend->Len;
+  memcpy(pRx->RxPacketData.RxFrame, pPend->pFrame, pPend->Len);
+
+  if (LLC_StandInSend(pSI, &(pRx->Hdr)) == 0)
+    pSI->Stats[pPend->Radio].Chan[pPend->Chan].RxInd++;
+}
+
+/**
+ * @brief Send the TxEvent's (and loopbacks) that are due
+ * @param pSI Stand-in state
+ * @param Now CLOCK_MONOTONIC time [us]
+ */
+static void LLC_StandInTxEvents (tLLCStandIn *pSI,
+                                 uint64_t Now)
+{
+  while (pSI->Head != pSI->Tail)
+  {
+    tLLCStandInPending *pPend =
+      &(pSI->Pending[pSI->Head & (LLC_STANDIN_PENDING_MAX - 1)]);
+    tMKxChannelStats *pStats = &(pSI->Stats[pPend->Radio].Chan[pPend->Chan]);
+    tMKxTSF TxTime = LLC_StandInTSF(pSI, pPend->Due);
+
+    if (pPend->Due > Now)
+      break;
+
+    if (pPend->TxStatus == MKXSTATUS_SUCCESS)
+    {
+      pStats->TxValid++;
+      pSI->Airtime[pPend->Radio][pPend->Chan] += LLC_STANDIN_PHY_OVERHEAD +
+        ((pPend->Len * 8) / LLC_STANDIN_PHY_RATE);
+      if (pSI->Opts.Loopback)
+        LLC_StandInLoopback(pSI, pPend, TxTime);
+    }
+    else
+    {
+      pStats->TxFail++;
+    }
+
+    if (pPend->Lost == false)
+    {
+      uint8_t Buf[sizeof(tMKxTxEvent) + ETH_ZLEN];
+      tMKxTxEvent *pEvt = (tMKxTxEvent *)Buf;
+
+      memset(pEvt, 0, sizeof(tMKxTxEvent));
+      pEvt->Hdr.Type = MKXIF_TXEVENT;
+      pEvt->Hdr.Len = sizeof(tMKxTxEvent);
+      pEvt->Hdr.Seq = pPend->Seq;
+      pEvt->Hdr.Ret = MKXSTATUS_SUCCESS;
+      pEvt->TxEventData.TxStatus = pPend->TxStatus;
+      pEvt->TxEventData.MACSequenceNumber = pSI->MACSeq++ & 0x0FFF;
+      pEvt->TxEventData.TxTime = TxTime;
+      pEvt->TxEventData.NumRetries =
+        (pPend->TxStatus == MKXSTATUS_SUCCESS) ? 0 : 7;
+      if (LLC_StandInSend(pSI, &(pEvt->Hdr)) == 0)
+        pStats->TxCnf++;
+    }
+
+    free(pPend->pFrame);
+    pPend->pFrame = NULL;
+    pSI->Head++;
+  }
+}
+
+/**
+ * @brief Accept a TxReq
+ * @param pSI Stand-in state
+ * @param pMsg The MKXIF_TXPACKET message
+ * @param Now CLOCK_MONOTONIC time [us]
+ */
+static void LLC_StandInTxPacket (tLLCStandIn *pSI,
+                                 struct MKxIFMsg *pMsg,
+                                 uint64_t Now)
+{
+  tMKxTxPacket *pTx = (tMKxTxPacket *)pMsg;
+  tLLCStandInPending *pPend;
+  tMKxRadio Radio = pTx->TxPacketData.RadioID;
+  tMKxChannel Chan = pTx->TxPacketData.ChannelID;
+  int16_t TxStatus = MKXSTATUS_SUCCESS;
+  uint16_t Len = pTx->TxPacketData.TxFrameLength;
+
+  if ((pMsg->Len < sizeof(tMKxTxPacket)) ||
+      (pMsg->Len < (sizeof(tMKxTxPacket) + Len)))
+    TxStatus = MKXSTATUS_TX_FAIL_MALFORMED;
+  if ((Radio >= MKX_RADIO_COUNT) || (Chan >= MKX_CHANNEL_COUNT))
+  {
+    TxStatus = MKXSTATUS_TX_FAIL_RADIO_NOT_PRESENT;
+    Radio = MKX_RADIO_A;
+    Chan = MKX_CHANNEL_0;
+  }
+  if (TxStatus != MKXSTATUS_SUCCESS)
+    Len = 0;
+  pSI->Stats[Radio].Chan[Chan].TxReq++;
+
+  if ((pSI->Tail - pSI->Head) >= LLC_STANDIN_PENDING_MAX)
+  {
+    d_printf(D_WARN, NULL, "TxReq(%u) dropped: queue full\n", pMsg->Seq);
+    pSI->Stats[Radio].Chan[Chan].TxErr++;
+    return;
+  }
+
+  pPend = &(pSI->Pending[pSI->Tail & (LLC_STANDIN_PENDING_MAX - 1)]);
+  pPend->Due = Now + pSI->Opts.Latency;
+  pPend->Seq = pMsg->Seq;
+  pPend->Radio = Radio;
+  pPend->Chan = Chan;
+  pPend->MCS = pTx->TxPacketData.MCS;
+  pPend->Lost = LLC_StandInChance(pSI->Opts.TxEventLoss);
+  if ((TxStatus == MKXSTATUS_SUCCESS) && LLC_StandInChance(pSI->Opts.TxFail))
+    TxStatus = MKXSTATUS_TX_FAIL_RETRIES;
+  pPend->TxStatus = TxStatus;
+  pPend->Len = 0;
+  pPend->pFrame = NULL;
+  if ((TxStatus == MKXSTATUS_SUCCESS) && pSI->Opts.Loopback && (Len > 0))
+  {
+    pPend->pFrame = malloc(Len);
+    if (pPend->pFrame != NULL)
+    {
+      memcpy(pPend->pFrame, pTx->TxPacketData.TxFrame, Len);
+      pPend->Len = Len;
+    }
+  }
+  pSI->Tail++;
+}
+
+/**
+ * @brief Purge the pending TxEvent's of a radio/channel (no TxEvent is sent)
+ * @param pSI Stand-in state
+ * @param pMsg The MKXIF_FLUSHQ message
+ *
+ * The queue is not tracked here, so every queue of the channel is purged (the
+ * LLC completes the flushed TxReq's itself and ignores later TxEvent's).
+ */
+static void LLC_StandInFlushQ (tLLCStandIn *pSI,
+                               struct MKxIFMsg *pMsg)
+{
+  tMKxRadio Radio;
+  tMKxChannel Chan;
+  uint32_t i;
+
+  if (pMsg->Len < (sizeof(struct MKxIFMsg) + 2))
+    return;
+  Radio = pMsg->Data[0];
+  Chan = pMsg->Data[1];
+
+  for (i = pSI->Head; i != pSI->Tail; i++)
+  {
+    tLLCStandInPending *pPend =
+      &(pSI->Pending[i & (LLC_STANDIN_PENDING_MAX - 1)]);
+
+    if ((pPend->Radio != Radio) || (pPend->Chan != Chan))
+      continue;
+    pPend->Lost = true;
+    pPend->TxStatus = LLC_TXSTATUS_FLUSHED;
+    free(pPend->pFrame);
+    pPend->pFrame = NULL;
+    pPend->Len = 0;
+  }
+}
+
+/**
+ * @brief Turn a C2X security command into its (empty, successful) response
+ * @param pSI Stand-in state
+ * @param pMsg The command, overwritten with the response
+ */
+static void LLC_StandInC2XSec (tLLCStandIn *pSI,
+                               struct MKxIFMsg *pMsg)
+{
+  tMKxC2XSec *pSec = (tMKxC2XSec *)pMsg;
+  uint8_t USN[2];
+
+  if (pMsg->Len < (offsetof(tMKxC2XSec, APDU.Cmd.USN) + sizeof(USN)))
+    return;
+  memcpy(USN, pSec->APDU.Cmd.USN, sizeof(USN));
+
+  // Response APDU: USN, (no payload), SW1 SW2 = 0x9000 (success)
+  pSec->APDU.Data[0] = USN[0];
+  pSec->APDU.Data[1] = USN[1];
+  pSec->APDU.Data[2] = 0x90;
+  pSec->APDU.Data[3] = 0x00;
+  pMsg->Len = offsetof(tMKxC2XSec, APDU) + 4;
+}
+
+/**
+ * @brief Send the radio stats (as the MKx does at the end of each interval)
+ * @param pSI Stand-in state
+ * @param Now CLOCK_MONOTONIC time [us]
+ */
+static void LLC_StandInStats (tLLCStandIn *pSI,
+                              uint64_t Now)
+{
+  tMKxRadio Radio;
+
+  for (Radio = MKX_RADIO_A; Radio < MKX_RADIO_COUNT; Radio++)
+  {
+    uint8_t Buf[sizeof(tMKxRadioStats) + ETH_ZLEN];
+    tMKxRadioStats *pStats = (tMKxRadioStats *)Buf;
+    tMKxChannel Chan = pSI->StatsChan[Radio];
+    uint32_t Period = pSI->Opts.StatsPeriod * 1000;
+    uint32_t Busy;
+
+    // The interval that just ended
+    if (pSI->Mode[Radio] == MKX_MODE_CHANNEL_1)
+      Chan = MKX_CHANNEL_1;
+    else if (pSI->Mode[Radio] != MKX_MODE_SWITCHED)
+      Chan = MKX_CHANNEL_0;
+    pSI->StatsChan[Radio] = (Chan == MKX_CHANNEL_0) ?
+                            MKX_CHANNEL_1 : MKX_CHANNEL_0;
+
+    // Our own transmissions are the only thing on the (synthetic) air
+    Busy = (pSI->Airtime[Radio][Chan] * 255ULL) / Period;
+    pSI->Stats[Radio].Chan[Chan].ChannelBusyRatio = (Busy > 255) ? 255 : Busy;
+    pSI->Stats[Radio].Chan[Chan].AverageIdlePower = pSI->Opts.Noise;
+    pSI->Airtime[Radio][Chan] = 0;
+    pSI->Stats[Radio].TSF = LLC_StandInTSF(pSI, Now);
+
+    memset(pStats, 0, sizeof(tMKxRadioStats));
+    pStats->Hdr.Type = (Radio == MKX_RADIO_A) ?
+                       MKXIF_RADIOASTATS : MKXIF_RADIOBSTATS;
+    pStats->Hdr.Len = sizeof(tMKxRadioStats);
+    pStats->Hdr.Seq = Chan;
+    pStats->Hdr.Ret = MKXSTATUS_SUCCESS;
+    memcpy(&(pStats->RadioStatsData), &(pSI->Stats[Radio]),
+           sizeof(tMKxRadioStatsData));
+    (void)LLC_StandInSend(pSI, &(pStats->Hdr));
+  }
+}
+
+/**
+ * @brief Handle a message from the LLC
+ * @param pSI Stand-in state
+ * @param pMsg The message
+ * @param Len Length of the received frame [bytes]
+ * @param Now CLOCK_MONOTONIC time [us]
+ */
+static void LLC_StandInRecv (tLLCStandIn *pSI,
+                             struct MKxIFMsg *pMsg,
+                             int Len,
+                             uint64_t Now)
+{
+  if ((Len < (int)sizeof(struct MKxIFMsg)) || (Len < pMsg->Len) ||
+      (pMsg->Len < sizeof(struct MKxIFMsg)))
+  {
+    d_printf(D_WARN, NULL, "Truncated message: %d < %d\n", Len, pMsg->Len);
+    return;
+  }
+  // Only requests (replies would be our own, e.g. on a veth)
+  if (pMsg->Ret != (int16_t)MKXSTATUS_RESERVED)
+    return;
+
+  d_printf(D_DEBUG, NULL, "Msg: Type:%d Len:%d Seq:%d\n",
+           pMsg->Type, pMsg->Len, pMsg->Seq);
+
+  switch (pMsg->Type)
+  {
+    case MKXIF_TXPACKET:
+      LLC_StandInTxPacket(pSI, pMsg, Now);
+      return;
+
+    case MKXIF_FLUSHQ:
+      LLC_StandInFlushQ(pSI, pMsg);
+      return;
+
+    case MKXIF_SET_TSF:
+      if (pMsg->Len >= (sizeof(struct MKxIFMsg) + sizeof(tMKxTSF)))
+      {
+        tMKxTSF TSF;
+
+        memcpy(&TSF, pMsg->Data, sizeof(TSF));
+        pSI->TSFOffset = (int64_t)TSF - (int64_t)Now;
+        d_printf(D_INFO, NULL, "TSF set to %llu\n", (unsigned long long)TSF);
+      }
+      return;
+
+    case MKXIF_RADIOACFG:
+    case MKXIF_RADIOBCFG:
+      if (pMsg->Len >= sizeof(tMKxRadioConfig))
+      {
+        tMKxRadio Radio = (pMsg->Type == MKXIF_RADIOACFG) ?
+                          MKX_RADIO_A : MKX_RADIO_B;
+
+        pSI->Mode[Radio] =
+          ((tMKxRadioConfig *)pMsg)->RadioConfigData.Mode;
+        d_printf(D_INFO, NULL, "Radio %c mode %d\n",
+                 'A' + Radio, pSI->Mode[Radio]);
+      }
+      break; // Confirm by echoing it back
+
+    case MKXIF_TEMP:
+      if (pMsg->Len >= sizeof(tMKxTemp))
+      {
+        // A plausible (and constant) PA temperature [degC]
+        ((tMKxTemp *)pMsg)->TempData.TempPAAnt1 = 40;
+        ((tMKxTemp *)pMsg)->TempData.TempPAAnt2 = 40;
+      }
+      break;
+
+    case MKXIF_TEMPCFG:
+    case MKXIF_POWERDETCFG:
+    case MKXIF_DEBUG:
+      break; // Confirm by echoing it back
+
+    case MKXIF_C2XSEC:
+      LLC_StandInC2XSec(pSI, pMsg);
+      break;
+
+    default:
+      d_printf(D_NOTICE, NULL, "Unsupported message type %d\n", pMsg->Type);
+      pMsg->Ret = MKXSTATUS_FAILURE_INVALID_PARAM;
+      (void)LLC_StandInSend(pSI, pMsg);
+      return;
+  }
+
+  pMsg->Ret = MKXSTATUS_SUCCESS;
+  (void)LLC_StandInSend(pSI, pMsg);
+}
+
+/**
+ * @brief Create (and bring up) the TAP interface, or attach to an existing one
+ * @param pSI Stand-in state
+ * @return Zero or a negative errno
+ */
+static int LLC_StandInOpen (tLLCStandIn *pSI)
+{
+  int Res = -ENOSYS;
+  struct ifreq Ifr;
+  int Sock = -1;
+
+  memset(&Ifr, 0, sizeof(Ifr));
+  snprintf(Ifr.ifr_name, sizeof(Ifr.ifr_name), "%s", pSI->Opts.IfName);
+
+  if (pSI->Opts.Peer)
+  {
+    struct sockaddr_ll Addr;
+
+    pSI->IfIndex = if_nametoindex(pSI->Opts.IfName);
+    pSI->Fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if ((pSI->IfIndex == 0) || (pSI->Fd < 0))
+    {
+      Res = -errno;
+      d_error(D_ERR, NULL, "Cannot open %s: %s\n",
+              pSI->Opts.IfName, strerror(errno));
+      goto Error;
+    }
+    memset(&Addr, 0, sizeof(Addr));
+    Addr.sll_family = AF_PACKET;
+    Addr.sll_protocol = htons(ETH_P_ALL);
+    Addr.sll_ifindex = pSI->IfIndex;
+    if (bind(pSI->Fd, (struct sockaddr *)&Addr, sizeof(Addr)) < 0)
+    {
+      Res = -errno;
+      d_error(D_ERR, NULL, "Cannot bind to %s: %s\n",
+              pSI->Opts.IfName, strerror(errno));
+      goto Error;
+    }
+  }
+  else
+  {
+    pSI->Fd = open("/dev/net/tun", O_RDWR);
+    if (pSI->Fd < 0)
+    {
+      Res = -errno;
+      d_error(D_ERR, NULL, "Cannot open /dev/net/tun: %s\n", strerror(errno));
+      goto Error;
+    }
+    Ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    if (ioctl(pSI->Fd, TUNSETIFF, &Ifr) < 0)
+    {
+      Res = -errno;
+      d_error(D_ERR, NULL, "Cannot create %s: %s\n",
+              pSI->Opts.IfName, strerror(errno));
+      goto Error;
+    }
+  }
+
+  // Bring the interface up
+  Sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if ((Sock < 0) || (ioctl(Sock, SIOCGIFFLAGS, &Ifr) < 0))
+  {
+    Res = -errno;
+    goto Error;
+  }
+  Ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+  if (ioctl(Sock, SIOCSIFFLAGS, &Ifr) < 0)
+  {
+    Res = -errno;
+    d_error(D_ERR, NULL, "Cannot bring %s up: %s\n",
+            pSI->Opts.IfName, strerror(errno));
+    goto Error;
+  }
+  (void)fcntl(pSI->Fd, F_SETFL, fcntl(pSI->Fd, F_GETFL) | O_NONBLOCK);
+  Res = 0;
+
+Error:
+  if (Sock >= 0)
+    close(Sock);
+  if ((Res != 0) && (pSI->Fd >= 0))
+  {
+    close(pSI->Fd);
+    pSI->Fd = -1;
+  }
+  return Res;
+}
+
+/**
+ * @brief Handle everything that has arrived on the TAP or AF_PACKET socket
+ * @param pSI Stand-in state
+ */
+static void LLC_StandInNetRecv (tLLCStandIn *pSI)
+{
+  uint8_t Buf[LLC_STANDIN_MSG_MAX];
+  struct sockaddr_ll Addr;
+  socklen_t AddrLen;
+  int Len;
+
+  while (1)
+  {
+    AddrLen = sizeof(Addr);
+    if (pSI->Opts.Peer)
+      Len = recvfrom(pSI->Fd, Buf, sizeof(Buf), 0,
+                     (struct sockaddr *)&Addr, &AddrLen);
+    else
+      Len = read(pSI->Fd, Buf, sizeof(Buf));
+    if (Len < 0)
+      break;
+    // Our own transmissions on the AF_PACKET socket
+    if (pSI->Opts.Peer && (Addr.sll_pkttype == PACKET_OUTGOING))
+      continue;
+    LLC_StandInRecv(pSI, (struct MKxIFMsg *)Buf, Len, LLC_StandInTime());
+  }
+}
+
+/**
+ * @brief Create the shared memory and listen for the LLC
+ * @param pSI Stand-in state
+ * @return Zero or a negative errno
+ */
+static int LLC_StandInShmOpen (tLLCStandIn *pSI)
+{
+  int Res = -ENOSYS;
+  struct sockaddr_un Addr;
+  socklen_t AddrLen;
+
+  pSI->MemFd = memfd_create("llc-shm", MFD_CLOEXEC);
+  if ((pSI->MemFd < 0) || (ftruncate(pSI->MemFd, sizeof(tLLCShmMap)) < 0))
+  {
+    Res = -errno;
+    d_error(D_ERR, NULL, "Cannot create the shared memory: %s\n",
+            strerror(errno));
+    goto Error;
+  }
+  pSI->pMap = mmap(NULL, sizeof(tLLCShmMap), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, pSI->MemFd, 0);
+  if (pSI->pMap == MAP_FAILED)
+  {
+    pSI->pMap = NULL;
+    Res = -errno;
+    goto Error;
+  }
+  pSI->pMap->Magic = LLC_SHM_MAGIC;
+
+  // Abstract socket name (leading '\0')
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_UNIX;
+  snprintf(Addr.sun_path + 1, sizeof(Addr.sun_path) - 1,
+           LLC_SHM_SOCKET_FMT, pSI->Opts.IfName);
+  AddrLen = offsetof(struct sockaddr_un, sun_path) + 1 +
+            strlen(Addr.sun_path + 1);
+  pSI->ListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if ((pSI->ListenFd < 0) ||
+      (bind(pSI->ListenFd, (struct sockaddr *)&Addr, AddrLen) < 0) ||
+      (listen(pSI->ListenFd, 1) < 0))
+  {
+    Res = -errno;
+    d_error(D_ERR, NULL, "Cannot listen on @%s: %s\n",
+            Addr.sun_path + 1, strerror(errno));
+    goto Error;
+  }
+  Res = 0;
+
+Error:
+  return Res;
+}
+
+/**
+ * @brief Accept the LLC and send it the shared memory
+ * @param pSI Stand-in state
+ *
+ * Only one LLC at a time, as there is only one 'cw-llc'.
+ */
+static void LLC_StandInShmAccept (tLLCStandIn *pSI)
+{
+  struct msghdr Msg;
+  struct iovec Iov;
+  struct cmsghdr *pCmsg;
+  union
+  {
+    struct cmsghdr Hdr;
+    char Buf[CMSG_SPACE(sizeof(int))];
+  } Ctrl;
+  char Byte = 0;
+  int Fd;
+
+  Fd = accept4(pSI->ListenFd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+  if (Fd < 0)
+    return;
+  if (pSI->Fd >= 0)
+  {
+    d_printf(D_WARN, NULL, "Already connected, refused another LLC\n");
+    close(Fd);
+    return;
+  }
+
+  // Start afresh (a previous LLC may have left messages behind)
+  pSI->pMap->ToMKx.Head = pSI->pMap->ToMKx.Tail = 0;
+  pSI->pMap->FromMKx.Head = pSI->pMap->FromMKx.Tail = 0;
+
+  memset(&Msg, 0, sizeof(Msg));
+  memset(&Ctrl, 0, sizeof(Ctrl));
+  Iov.iov_base = &Byte;
+  Iov.iov_len = 1;
+  Msg.msg_iov = &Iov;
+  Msg.msg_iovlen = 1;
+  Msg.msg_control = Ctrl.Buf;
+  Msg.msg_controllen = sizeof(Ctrl.Buf);
+  pCmsg = CMSG_FIRSTHDR(&Msg);
+  pCmsg->cmsg_level = SOL_SOCKET;
+  pCmsg->cmsg_type = SCM_RIGHTS;
+  pCmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(pCmsg), &(pSI->MemFd), sizeof(int));
+  if (sendmsg(Fd, &Msg, MSG_NOSIGNAL) != 1)
+  {
+    d_error(D_WARN, NULL, "Cannot send the shared memory: %s\n",
+            strerror(errno));
+    close(Fd);
+    return;
+  }
+  pSI->Fd = Fd;
+  d_printf(D_INFO, NULL, "LLC connected\n");
+}
+
+/**
+ * @brief Handle everything in the ring from the LLC
+ * @param pSI Stand-in state
+ */
+static void LLC_StandInShmRecv (tLLCStandIn *pSI)
+{
+  char Buf[64];
+  void *pMsg;
+  int Res;
+  int Len;
+
+  // Drain the doorbell before emptying the ring (see llc-shm.h)
+  while ((Res = recv(pSI->Fd, Buf, sizeof(Buf), MSG_DONTWAIT)) > 0)
+    ;
+  if ((Res == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK)))
+  {
+    d_printf(D_INFO, NULL, "LLC disconnected\n");
+    close(pSI->Fd);
+    pSI->Fd = -1;
+    return;
+  }
+
+  while ((pMsg = LLC_ShmPeek(&(pSI->pMap->ToMKx), &Len)) != NULL)
+  {
+    LLC_StandInRecv(pSI, (struct MKxIFMsg *)pMsg, Len, LLC_StandInTime());
+    LLC_ShmPop(&(pSI->pMap->ToMKx));
+  }
+}
+
+/**
+ * @brief Stop the main loop
+ * @param SigNum Signal number
+ */
+static void LLC_StandInSignal (int SigNum)
+{
+  (void)SigNum;
+  LLC_StandInRun = false;
+}
+
+/**
+ * @brief Print the usage
+ */
+static void LLC_StandInUsage (void)
+{
+  printf("llc-standin <Option>\n"
+         "-i <name>  Interface to create as a TAP (default "
+         LLC_STANDIN_IFNAME_DEFAULT ")\n"
+         "-p <name>  Attach to an existing interface instead (e.g. a veth)\n"
+         "-m         Serve the shared memory transport instead (for -i <name>)\n"
+         "-l <us>    TxReq to TxEvent latency (default 100)\n"
+         "-x <%%>     TxEvent's lost (default 0)\n"
+         "-f <%%>     TxReq's failed with TX_FAIL_RETRIES (default 0)\n"
+         "-X <%%>     Looped back frames lost (default 0)\n"
+         "-n         No loopback of transmitted frames\n"
+         "-r <0.5dBm> RSSI of looped back frames (default -120)\n"
+         "-N <0.5dBm> Noise floor (default -190)\n"
+         "-s <ms>    Radio stats period (default 50, 0 for none)\n"
+         "-h         Print this usage\n");
+}
+
+/**
+ * @brief Stand-in entry point
+ * @param Argc Number of command line arguments
+ * @param ppArgv Array of command line arguments
+ * @return Zero if successful, otherwise a negative errno
+ */
+int main (int Argc, char **ppArgv)
+{
+  static tLLCStandIn SI;
+  tLLCStandIn *pSI = &SI;
+  int Res;
+  int c;
+
+  memset(pSI, 0, sizeof(*pSI));
+  pSI->Fd = -1;
+  pSI->ListenFd = -1;
+  pSI->MemFd = -1;
+  snprintf(pSI->Opts.IfName, sizeof(pSI->Opts.IfName), "%s",
+           LLC_STANDIN_IFNAME_DEFAULT);
+  pSI->Opts.Latency = 100;
+  pSI->Opts.Loopback = true;
+  pSI->Opts.RSSI = -120;
+  pSI->Opts.Noise = -190;
+  pSI->Opts.StatsPeriod = 50;
+
+  while ((c = getopt(Argc, ppArgv, "i:p:ml:x:f:X:nr:N:s:h")) != -1)
+  {
+    switch (c)
+    {
+      case 'p': // Attach to an existing interface
+        pSI->Opts.Peer = true;
+        // Fall through
+      case 'i': // Interface name
+        snprintf(pSI->Opts.IfName, sizeof(pSI->Opts.IfName), "%s", optarg);
+        break;
+      case 'm': // Shared memory transport
+        pSI->Opts.Shm = true;
+        break;
+      case 'l': // TxEvent latency
+        pSI->Opts.Latency = strtoul(optarg, NULL, 0);
+        break;
+      case 'x': // TxEvent loss
+        pSI->Opts.TxEventLoss = strtoul(optarg, NULL, 0);
+        break;
+      case 'f': // TxReq failures
+        pSI->Opts.TxFail = strtoul(optarg, NULL, 0);
+        break;
+      case 'X': // Loopback loss
+        pSI->Opts.RxLoss = strtoul(optarg, NULL, 0);
+        break;
+      case 'n': // No loopback
+        pSI->Opts.Loopback = false;
+        break;
+      case 'r': // RSSI
+        pSI->Opts.RSSI = strtol(optarg, NULL, 0);
+        break;
+      case 'N': // Noise floor
+        pSI->Opts.Noise = strtol(optarg, NULL, 0);
+        break;
+      case 's': // Stats period
+        pSI->Opts.StatsPeriod = strtoul(optarg, NULL, 0);
+        break;
+      case 'h':
+      default:
+        LLC_StandInUsage();
+        return (c == 'h') ? 0 : -EINVAL;
+    }
+  }
+
+  signal(SIGINT, LLC_StandInSignal);
+  signal(SIGTERM, LLC_StandInSignal);
+  srand(time(NULL));
+
+  if (pSI->Opts.Shm)
+    Res = LLC_StandInShmOpen(pSI);
+  else
+    Res = LLC_StandInOpen(pSI);
+  if (Res != 0)
+    goto Error;
+  printf("MKx stand-in on %s%s: latency %uus, TxEvent loss %u%%, "
+         "TxReq fail %u%%, loopback %s (loss %u%%)\n",
+         pSI->Opts.Shm ? "(shm) " : "", pSI->Opts.IfName, pSI->Opts.Latency,
+         pSI->Opts.TxEventLoss, pSI->Opts.TxFail,
+         pSI->Opts.Loopback ? "on" : "off", pSI->Opts.RxLoss);
+
+  pSI->StatsDue = LLC_StandInTime() + (pSI->Opts.StatsPeriod * 1000ULL);
+  while (LLC_StandInRun)
+  {
+    struct pollfd Fds[2] =
+    {
+      { pSI->Fd, POLLIN, 0 },
+      { pSI->ListenFd, POLLIN, 0 }, // Shared memory transport only
+    };
+    uint64_t Now = LLC_StandInTime();
+    uint64_t Next = UINT64_MAX;
+    struct timespec Timeout = { 0, 0 };
+
+    // Sleep until the next TxEvent or stats are due (to the microsecond, as
+    // the latency is often well below a millisecond)
+    if (pSI->Head != pSI->Tail)
+      Next = pSI->Pending[pSI->Head & (LLC_STANDIN_PENDING_MAX - 1)].Due;
+    if ((pSI->Opts.StatsPeriod != 0) && (pSI->StatsDue < Next))
+      Next = pSI->StatsDue;
+    if (Next > Now)
+    {
+      Timeout.tv_sec = (Next - Now) / 1000000;
+      Timeout.tv_nsec = ((Next - Now) % 1000000) * 1000;
+    }
+
+    if ((ppoll(Fds, 2, (Next == UINT64_MAX) ? NULL : &Timeout, NULL) < 0) &&
+        (errno != EINTR))
+    {
+      Res = -errno;
+      break;
+    }
+
+    // Take everything that has arrived
+    if (pSI->Opts.Shm)
+    {
+      if (Fds[1].revents & POLLIN)
+        LLC_StandInShmAccept(pSI);
+      if (pSI->Fd >= 0)
+        LLC_StandInShmRecv(pSI);
+    }
+    else
+    {
+      LLC_StandInNetRecv(pSI);
+    }
+
+    Now = LLC_StandInTime();
+    LLC_StandInTxEvents(pSI, Now);
+    if ((pSI->Opts.StatsPeriod != 0) && (Now >= pSI->StatsDue))
+    {
+      LLC_StandInStats(pSI, Now);
+      pSI->StatsDue += pSI->Opts.StatsPeriod * 1000ULL;
+      if (pSI->StatsDue < Now)
+        pSI->StatsDue = Now + (pSI->Opts.StatsPeriod * 1000ULL);
+    }
+  }
+
+Error:
+  if (pSI->Fd >= 0)
+    close(pSI->Fd);
+  if (pSI->ListenFd >= 0)
+    close(pSI->ListenFd);
+  if (pSI->pMap != NULL)
+    munmap(pSI->pMap, sizeof(tLLCShmMap));
+  if (pSI->MemFd >= 0)
+    close(pSI->MemFd);
+  return Res;
+}
+
+/**
+ * @}
+ */
@@ -27,7 +27,6 @@
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
-#include <poll.h>
 #include <math.h>
 #include <stdbool.h>
 #include <arpa/inet.h>
@@ -40,6 +39,7 @@
 #include "linux/cohda/pktbuf.h"
 #include "linux/cohda/llc/llc.h"
 #include "linux/cohda/llc/llc-api.h"
+#include "llc-api-ext.h"
 #include "dot4-internal.h"
 #include "mk2mac-api-types.h"
 #include "test-common.h"
@@ -51,6 +51,9 @@
 #include "CarSta.h"
 #include "TimerTask.h"
 #include "timer_queue.h"
+#include "llc-event.h"
+#include "llc-ipc.h"
+#include "llc-crc32c.h"
 
 // this is defined via endian.h except on the 12.04 VM
 #ifndef htobe16
@@ -76,8 +79,38 @@ uint16_t htole16(uint16_t host_16bits);
 #define LLC_ALLOC_EXTRA_HEADER (56)
 #define LLC_ALLOC_EXTRA_FOOTER (16)
 
-const int POLL_INPUT = (POLLIN | POLLPRI);
-const int POLL_ERROR = (POLLERR | POLLHUP | POLLNVAL); 
+/// Most MKx messages handled per main loop pass (see MKx_RecvBudget())
+#define LLC_RX_BUDGET_MSGS (32)
+/// Longest time spent handling MKx messages per main loop pass [us]
+#define LLC_RX_BUDGET_US (2000)
+
+/// Frames passed to the MKx per channel when the software queues are used
+#define LLC_TXQ_INFLIGHT (4)
+/// Frames held per software queue
+#define LLC_TXQ_DEPTH (64)
+/// Tx buffers (each held from Tx_Send() until its TxCnf)
+#define LLC_TX_POOL_CNT (2 * LLC_TXQ_DEPTH)
+/// Messages kept in the shared memory ring for the local readers
+#define LLC_RING_SLOTS (256)
+/// Positions are kept in thousandths of a degree (see Tx_Um220Event())
+#define TX_GPS_SCALE (1000.0)
+/// Mean earth radius [m]
+#define TX_EARTH_RADIUS (6371000.0)
+/// Second start byte of the frames checked by a CRC32C (see packetmessage())
+#define TX_SYNC_CRC32C (0x2A)
+/// How long XOR frames are sent after hearing a node that needs them [s]
+#define TX_CHECK_HOLDOFF (10)
+/// Number of senders remembered as sending CRC32C frames
+#define TX_CHECK_PEERS (64)
+
+/// Number of prebuilt Tx headers kept (see Tx_Template())
+#define TX_TEMPLATE_CNT (8)
+
+/// Priorities of the messages to the Android/HMI clients (see Tx_IPCPriority())
+#define TX_IPC_PRIO_STATUS    (0)
+#define TX_IPC_PRIO_NEIGHBOUR (1)
+#define TX_IPC_PRIO_REQUEST   (2)
+#define TX_IPC_PRIO_ALERT     (3)
 
 
 //------------------------------------------------------------------------------
@@ -113,6 +146,41 @@ union uint32_t2char
 	unsigned char data[4];
 };
 
+/// Headers at the start of every transmitted frame
+typedef struct TxFrameHdr
+{
+  struct IEEE80211QoSHeader MAC;
+  struct SNAPHeader SNAP;
+} __attribute__ ((packed)) tTxFrameHdr;
+
+/// Prebuilt headers for one destination/priority/service/ethertype/channel
+typedef struct TxTemplate
+{
+  /// Radio config generation this was built against (zero if unused)
+  uint32_t Gen;
+  /// Lookup key
+  tMK2MACAddr DestAddr;
+  tMK2Priority Priority;
+  tMK2Service Service;
+  uint16_t EtherType;
+  tMK2ChannelNumber ChannelNumber;
+  /// Where ChannelNumber is currently configured
+  tMKxRadio RadioID;
+  tMKxChannel ChannelID;
+  /// The headers, ready to copy into the frame
+  tTxFrameHdr Hdr;
+} tTxTemplate;
+
+/// Prebuilt Tx header cache
+typedef struct TxTemplates
+{
+  /// Bumped by each radio config notification (see LLC_TxNotifInd())
+  uint32_t Gen;
+  /// Entry to replace next
+  unsigned int Next;
+  tTxTemplate Entry[TX_TEMPLATE_CNT];
+} tTxTemplates;
+
 //------------------------------------------------------------------------------
 // Function Prototypes
 //------------------------------------------------------------------------------
@@ -138,15 +206,23 @@ static struct LLCTx _Dev =
 struct LLCTx *pDev = &(_Dev);//pDevһ̬ṹ
 tTxOpts *pTxOpts;
 pstRMCmsg result = NULL;
-static bool UdpEnabled,TcpEnabled;
-static struct sockaddr_un UdpCltaddr, TcpCltaddr;
-static int tcpfd, udpfd, listenfd, um220fd;
-socklen_t tcpaddrlen, udpaddrlen;
-struct pollfd Fds[4] = { {-1, },  //MKx Recv
-					  {-1, }, //Tcp Socket
-					  {-1, },  //Udp Socket
-					  {-1, },  //um220 & mpu6050
-			};
+static int um220fd;
+/// Prebuilt Tx headers (generation 1 onwards, so unused entries never match)
+static tTxTemplates TxTemplates = { .Gen = 1, };
+/// Main loop (see llc-event.h)
+static tLLCEventLoop Loop = { .EpollFd = -1, };
+/// Android/HMI clients (see llc-ipc.h)
+static tLLCIPC IPC;
+/// Shared memory copy of the messages to the clients (see llc-shmring.h)
+static tLLCShmRing Ring = { .Fd = -1, .ReadFd = -1, };
+/// Frame check negotiation (see Tx_CheckCrc())
+static struct
+{
+  /// Senders heard sending CRC32C frames (by plate hash)
+  uint32_t Peers[TX_CHECK_PEERS];
+  /// When an XOR frame was last heard from a sender not known to do CRC32C
+  time_t XorHeard;
+} TxCheck;
 
 extern CStatus CarS;
 
@@ -252,13 +328,6 @@ static void LLC_TxSignal (int SigNum)
 	{
 			  
 		  case SIGPIPE:
-			  TcpEnabled = false;
-			  Fds[1].fd = listenfd;
-			  Fds[1].events = POLL_INPUT;
-			  if(tcpfd != -1){
-				  close(tcpfd);
-				  tcpfd = -1;
-			  }
 			  printf("SIGPIPE SigNum: %d\n", SigNum);
 			  break;
 		  case SIGSEGV:printf("SEGMENTATION FAULT!!!! Exiting!!! \n To get a core dump, compile with DEBUG option.\n");
@@ -279,15 +348,87 @@ static void LLC_TxSignal (int SigNum)
 
 char checkSum(char * buf, uint16_t size)
 {
-	char check;
-    int i;
-	check = buf[0];
-	for(i = 1; i < size; i++)
-		check = check ^ buf[i];
+	uint64_t word, wide = 0;
+	uint8_t check = 0;
+	int i;
+
+	// Eight bytes at a time, then folded into one
+	for(i = 0; i + 8 <= size; i += 8){
+		memcpy(&word, &buf[i], 8);
+		wide ^= word;
+	}
+	for(; i < size; i++)
+		check ^= buf[i];
+	wide ^= wide >> 32;
+	wide ^= wide >> 16;
+	wide ^= wide >> 8;
+	check ^= (uint8_t)wide;
 
 	return check; //这个函数会不会返回的时候就被清0 ？
 }
 
+/**
+ * @brief Whether to send a CRC32C frame (rather than an XOR one)
+ */
+static bool Tx_CheckCrc (void)
+{
+	switch(pTxOpts->Check){
+		case TXOPTS_CHECK_CRC32C:
+			return true;
+		case TXOPTS_CHECK_AUTO:
+			return (time(NULL) - TxCheck.XorHeard) >= TX_CHECK_HOLDOFF;
+		default:
+			return false;
+	}
+}
+
+/**
+ * @brief Note how a sender checks its frames (see Tx_CheckCrc())
+ * @param Crc Whether its frame had a CRC32C
+ * @param Source Its plate hash (or zero if unknown)
+ *
+ * Nodes that do CRC32C also send XOR frames (e.g. while an older node is
+ * around), so those from senders already heard doing CRC32C are ignored.
+ */
+static void Tx_CheckHeard (bool Crc, uint32_t Source)
+{
+	uint32_t *pPeer = &TxCheck.Peers[Source % TX_CHECK_PEERS];
+
+	if(Crc){
+		if(Source != 0)
+			*pPeer = Source;
+		return;
+	}
+	if((Source != 0) && (*pPeer == Source))
+		return;
+	if((pTxOpts->Check == TXOPTS_CHECK_AUTO) && Tx_CheckCrc())
+		d_printf(D_INFO, NULL, "XOR frames from 0x%08x, sending XOR for %d s\n",
+		         Source, TX_CHECK_HOLDOFF);
+	TxCheck.XorHeard = time(NULL);
+}
+
+/**
+ * @brief Finish a frame in buff with a CRC32C (rather than the XOR check byte)
+ * @param DataLen Length of its data [bytes]
+ * @return The frame's length
+ */
+static int Tx_Crc32cFrame (int DataLen)
+{
+	uint32_t Crc;
+
+	buff[1] = TX_SYNC_CRC32C;
+	// Covers the data, CRC and end byte (as for the XOR frames)
+	buff[9] = ((DataLen + LLC_CRC32C_LEN + 1) >> 8) & 0xff;
+	buff[8] = (DataLen + LLC_CRC32C_LEN + 1) & 0xff;
+	Crc = LLC_Crc32c(0, buff, DataLen + 10);
+	buff[DataLen + 10] = Crc & 0xff;
+	buff[DataLen + 11] = (Crc >> 8) & 0xff;
+	buff[DataLen + 12] = (Crc >> 16) & 0xff;
+	buff[DataLen + 13] = (Crc >> 24) & 0xff;
+	buff[DataLen + 14] = 0x0d;
+	return DataLen + LLC_CRC32C_LEN + 11;
+}
+
 //这里是否可以考虑发送的路由，就是根据目的节点是广播节点还是单播节点进行路由选择？？
 int packetmessage(CwMessage *message)
 {
@@ -303,17 +444,141 @@ int packetmessage(CwMessage *message)
 	buff[9] = (message->length >> 8) & 0x00ff;//取高8~15位
 	buff[8] = message->length & 0x00ff;//取低0~7位
 	memcpy(&buff[10], message->data, message->length);
+	if(Tx_CheckCrc() && (message->length + 13 <= (int)sizeof(buff))){
+		// |0x29,0x2A,protocol,seq,hop,length,data,crc32c,0x0d|
+		return Tx_Crc32cFrame(message->length - 2);
+	}
 	buff[message->length+8] = checkSum(buff, message->length + 8);//除了校验和包尾
 	buff[message->length+9] = 0x0d;    //包尾
 	return message->length + 10;//整个要发送的包长
 //    Tx_Send(message->pTxOpts,  message->length + 12);	
 }
 
+/**
+ * @brief Priority of a message to the Android/HMI clients (by its protocol)
+ *
+ * When a client falls behind, alerts are kept over requests and replies, and
+ * those over the periodic status messages (a newer one of which soon follows).
+ */
+static uint8_t Tx_IPCPriority (uint8_t Protocol)
+{
+	switch(Protocol){
+		case 0x23:
+		case 0x24:
+		case 0x25:
+		case 0x26:
+		case 0x27:
+			return TX_IPC_PRIO_ALERT;
+		case 0x10:
+		case 0x11:
+		case 0x20:
+		case 0x21:
+			return TX_IPC_PRIO_REQUEST;
+		case 0x22:
+			return TX_IPC_PRIO_NEIGHBOUR;
+		default:
+			return TX_IPC_PRIO_STATUS;
+	}
+}
+
+/**
+ * @brief Distance to a position (by the equirectangular approximation)
+ * @param Lat Latitude (as kept in GpsLocation)
+ * @param Lon Longitude (as kept in GpsLocation)
+ * @return [m], or LLC_IPC_DISTANCE_UNKNOWN without a GPS fix
+ */
+static uint32_t Tx_Distance (double Lat, double Lon)
+{
+	double Rad = M_PI / (180.0 * TX_GPS_SCALE);
+	double dLat, dLon, Dist;
+
+	if(!IsValid())
+		return LLC_IPC_DISTANCE_UNKNOWN;
+	dLat = (Lat - CarS.location.latitude) * Rad;
+	dLon = (Lon - CarS.location.longitude) * Rad * cos(CarS.location.latitude * Rad);
+	Dist = TX_EARTH_RADIUS * sqrt(dLat * dLat + dLon * dLon);
+	if(!(Dist < (double)LLC_IPC_DISTANCE_UNKNOWN))
+		return LLC_IPC_DISTANCE_UNKNOWN;
+	return (uint32_t)Dist;
+}
+
+/**
+ * @brief Identify a sender by its plate (for the IPC subscriptions)
+ */
+static uint32_t Tx_PlateHash (const uint8_t *pPlate)
+{
+	uint32_t Hash = 2166136261U; // FNV-1a
+	int i;
+
+	for(i = 0; i < 9; i++)
+		Hash = (Hash ^ pPlate[i]) * 16777619U;
+	return Hash ? Hash : 1;
+}
+
+/**
+ * @brief What a message to the Android/HMI clients is (see LLC_IPCWanted())
+ * @param Protocol The protocol byte
+ * @param pData The data (following the length field)
+ * @param Len Length of the data [bytes]
+ * @param pMeta Filled in
+ */
+static void Tx_IPCMeta (uint8_t Protocol, const uint8_t *pData, int Len,
+                        tLLCIPCMeta *pMeta)
+{
+	double Lat, Lon;
+
+	pMeta->Protocol = Protocol;
+	pMeta->Priority = Tx_IPCPriority(Protocol);
+	pMeta->Source = 0;
+	pMeta->Distance = LLC_IPC_DISTANCE_UNKNOWN;
+	switch(Protocol){
+		case 0x11://target plate, plate, latitude, longitude...
+			if(Len >= 34){
+				pMeta->Source = Tx_PlateHash(&pData[9]);
+				memcpy(&Lat, &pData[18], 8);
+				memcpy(&Lon, &pData[26], 8);
+				pMeta->Distance = Tx_Distance(Lat, Lon);
+			}
+			break;
+		case 0x20:
+		case 0x21://target plate, source plate...
+			if(Len >= 18)
+				pMeta->Source = Tx_PlateHash(&pData[9]);
+			break;
+		case 0x22://plate, latitude, longitude...
+			if(Len >= 25){
+				memcpy(&Lat, &pData[9], 8);
+				memcpy(&Lon, &pData[17], 8);
+				pMeta->Distance = Tx_Distance(Lat, Lon);
+			}
+			/* fall through */
+		case 0x10:
+		case 0x23:
+		case 0x24:
+		case 0x25:
+		case 0x26:
+		case 0x27://plate...
+			if(Len >= 9)
+				pMeta->Source = Tx_PlateHash(pData);
+			break;
+		case 0x56://our own status
+			pMeta->Distance = 0;
+			break;
+		default:
+			break;
+	}
+}
+
 void packetandroidmessage(CwMessage *message)
 {
-	struct sockaddr_in UdpCltaddr;
-//	socklen_t addrlen;
-//    addrlen = sizeof(UdpCltaddr);
+	tLLCIPCMeta Meta;
+
+	if(LLC_IPCClientCnt(&IPC) == 0)
+		return;
+	// Not worth encoding if every client has filtered it out
+	Tx_IPCMeta(message->protocol, message->data, message->length - 2, &Meta);
+	if(!LLC_IPCWanted(&IPC, &Meta))
+		return;
 	memset(buff, 0, sizeof(buff));//将缓存buffer清零
 	buff[0] = 0x29;
 	buff[1] = 0x29;
@@ -329,68 +594,71 @@ void packetandroidmessage(CwMessage *message)
 	buff[message->length+8] = checkSum(buff, message->length + 8);//除了校验和包尾
 	buff[message->length+9] = 0x0d;    //包尾
 
-	if(UdpEnabled){
-		 sendto(udpfd, buff, message->length + 10, 0, (struct sockaddr*)&UdpCltaddr, udpaddrlen);
-	}
-
-	if(TcpEnabled){
-		 if(write(tcpfd, buff, message->length + 10) < 0){
-			 perror("Socet error");
-			 //这里应该有出错处理的，但是在这里不是很方便处理
-		 }
-	} 
+	// Encoded once for all of them
+	(void)LLC_IPCSend(&IPC, buff, message->length + 10, &Meta);
 }
 
 /**
- * @brief Transmit frame(s) on the opened interface using the CCH or SCH config
- * @param pTxOpts the options used to config the channel for sending
- * @param Pause_us wait this long inline with tx Loop
- * @return the number of bytes sent (-1 is failure)
- *
- * Loops through several variables transmitting several packets in a single call.
- * Loops though
- *   - Packet Length
- *   - Tx Power
- *   - MCS
+ * @brief Find (or build) the prebuilt headers for the current Tx options
+ * @param pTxCHOpts Destination, priority, service, ethertype and channel
+ * @return The template, or NULL if the channel isn't configured on any radio
  *
- * Source Address already loaded into tTx object
+ * The MAC and SNAP headers only depend on the lookup key (the source address
+ * is fixed at start up), and the radio/channel only on the radio config, so
+ * both are worked out once and reused until the next MKXIF_RADIOxCFG.
  */
-static int Tx_Send (tTxOpts * pTxOpts, int length)
+static const tTxTemplate *Tx_Template (const tTxCHOpts *pTxCHOpts)
 {
-  tTxErrCode ErrCode = TX_ERR_NONE;
-
-  int m; // loop vars
-  int ThisFrameLen;
+  const tMKxRadioConfigData *pRadio = pDev->pMKx->Config.Radio;
+  uint32_t Gen = __atomic_load_n(&(TxTemplates.Gen), __ATOMIC_ACQUIRE);
+  tTxTemplate *pTemplate;
   struct IEEE80211QoSHeader *pMAC;
   struct SNAPHeader *pSNAP;
-
-  unsigned char *pPayload;
-  long TxPower;
-  tTxCHOpts *pTxCHOpts;
-  tMKxRadio RadioID;
-  tMKxChannel ChannelID;
+  tMKxRadio Radio;
+  tMKxChannel Chan;
   int Freq;
-  struct MKxTxPacket *pTxPacket = malloc(MALLOC_SIZE_MKxTxPacket);
-  struct MKxTxPacketData *pPacket = &pTxPacket->TxPacketData;
-  fMKx_TxReq LLC_TxReq = pDev->pMKx->API.Functions.TxReq;
-  const tMKxRadioConfigData *pRadio = pDev->pMKx->Config.Radio;
+  int i;
 
-//  d_fnstart(D_DEBUG, pDev, "(pDev %p, pTxOpts %p, Pause_us %d)\n", pDev, pTxOpts,Pause_us);
-  d_assert(pTxOpts != NULL);
+  for (i = 0; i < TX_TEMPLATE_CNT; i++)
+  {
+    pTemplate = &(TxTemplates.Entry[i]);
+    if ((pTemplate->Gen == Gen) &&
+        (pTemplate->ChannelNumber == pTxCHOpts->ChannelNumber) &&
+        (pTemplate->Priority == pTxCHOpts->Priority) &&
+        (pTemplate->Service == pTxCHOpts->Service) &&
+        (pTemplate->EtherType == pTxCHOpts->EtherType) &&
+        (memcmp(pTemplate->DestAddr, pTxCHOpts->DestAddr, ETH_ALEN) == 0))
+      return pTemplate;
+  }
 
-  memset(pTxPacket, 0, MALLOC_SIZE_MKxTxPacket);
+  // Not cached (or the radio config has changed): replace the oldest entry
+  pTemplate = &(TxTemplates.Entry[TxTemplates.Next]);
+  TxTemplates.Next = (TxTemplates.Next + 1) % TX_TEMPLATE_CNT;
+  memset(pTemplate, 0, sizeof(*pTemplate));
 
-  // Get existing handles from Tx Object
-  pTxCHOpts = &(pTxOpts->TxCHOpts);
+  // Channel 0 on either radio, then channel 1
   Freq = pTxCHOpts->ChannelNumber * 5 + 5000;
+  for (Chan = MKX_CHANNEL_0; Chan < MKX_CHANNEL_COUNT; Chan++)
+  {
+    for (Radio = MKX_RADIO_A; Radio < MKX_RADIO_COUNT; Radio++)
+    {
+      if (Freq == pRadio[Radio].ChanConfig[Chan].PHY.ChannelFreq)
+        goto Found;
+    }
+  }
+  return NULL;
 
-  d_assert(pTxCHOpts != NULL);
+Found:
+  pTemplate->RadioID = Radio;
+  pTemplate->ChannelID = Chan;
+  memcpy(pTemplate->DestAddr, pTxCHOpts->DestAddr, ETH_ALEN);
+  pTemplate->Priority = pTxCHOpts->Priority;
+  pTemplate->Service = pTxCHOpts->Service;
+  pTemplate->EtherType = pTxCHOpts->EtherType;
+  pTemplate->ChannelNumber = pTxCHOpts->ChannelNumber;
 
-  //--------------------------------------------------------------------------
-  // WAVE-RAW frame: | TxDesc | Eth Header | Protocol & Payload |
-  pMAC = (struct IEEE80211QoSHeader *)pPacket->TxFrame;
-  pSNAP = (struct SNAPHeader *) (pPacket->TxFrame + sizeof(*pMAC));
-  pPayload = (unsigned char *) (pPacket->TxFrame + sizeof(*pMAC) + sizeof(*pSNAP));
+  pMAC = &(pTemplate->Hdr.MAC);
+  pSNAP = &(pTemplate->Hdr.SNAP);
 
   // Setup the 802.11 MAC QoS header
   pMAC->FrameControl.FrameCtrl = 0;
@@ -422,37 +690,96 @@ static int Tx_Send (tTxOpts * pTxOpts, int length)
   pSNAP->Type = pTxCHOpts->EtherType;
   cpu_to_be16s(&pSNAP->Type);
 
-  // Get loops specs for RangeSpec variants
+  pTemplate->Gen = Gen;
+  d_printf(D_DEBUG, pDev, "Tx template %d: Channel %u on %c%d\n",
+           (int)(pTemplate - TxTemplates.Entry), pTxCHOpts->ChannelNumber,
+           (Radio == MKX_RADIO_A) ? 'A' : 'B', Chan);
+  return pTemplate;
+}
 
-  if (Freq == pRadio[MKX_RADIO_A].ChanConfig[MKX_CHANNEL_0].PHY.ChannelFreq)
-  {
-    RadioID = MKX_RADIO_A;
-    ChannelID = MKX_CHANNEL_0;
-  }
-  else if (Freq == pRadio[MKX_RADIO_B].ChanConfig[MKX_CHANNEL_0].PHY.ChannelFreq)
-  {
-    RadioID = MKX_RADIO_B;
-    ChannelID = MKX_CHANNEL_0;
-  }
-  else if (Freq == pRadio[MKX_RADIO_A].ChanConfig[MKX_CHANNEL_1].PHY.ChannelFreq)
-  {
-    RadioID = MKX_RADIO_A;
-    ChannelID = MKX_CHANNEL_1;
-  }
-  else if (Freq == pRadio[MKX_RADIO_B].ChanConfig[MKX_CHANNEL_1].PHY.ChannelFreq)
+/**
+ * @brief Transmit frame(s) on the opened interface using the CCH or SCH config
+ * @param pTxOpts the options used to config the channel for sending
+ * @param Pause_us wait this long inline with tx Loop
+ * @return the number of bytes sent (-1 is failure)
+ *
+ * Loops through several variables transmitting several packets in a single call.
+ * Loops though
+ *   - Packet Length
+ *   - Tx Power
+ *   - MCS
+ *
+ * Source Address already loaded into tTx object
+ */
+static int Tx_Send (tTxOpts * pTxOpts, int length)
+{
+  tTxErrCode ErrCode = TX_ERR_NONE;
+
+  int m; // loop vars
+  int ThisFrameLen;
+  const tTxTemplate *pTemplate;
+
+  unsigned char *pPayload;
+  long TxPower;
+  tTxCHOpts *pTxCHOpts;
+  tMKxRadio RadioID;
+  tMKxChannel ChannelID;
+  struct MKxTxPacket *pTxPacket;
+  struct MKxTxPacketData *pPacket;
+  // One frame per MCS, all handed to the LLC in a single batch
+  struct MKxTxPacket *pTxPackets[TXOPTS_MAXOPTARGLISTLEN];
+  void *pPrivs[TXOPTS_MAXOPTARGLISTLEN];
+  tMKxStatus Results[TXOPTS_MAXOPTARGLISTLEN];
+  int Cnt;
+  int Res;
+
+//  d_fnstart(D_DEBUG, pDev, "(pDev %p, pTxOpts %p, Pause_us %d)\n", pDev, pTxOpts,Pause_us);
+  d_assert(pTxOpts != NULL);
+
+  // Get existing handles from Tx Object
+  pTxCHOpts = &(pTxOpts->TxCHOpts);
+
+  d_assert(pTxCHOpts != NULL);
+
+  //--------------------------------------------------------------------------
+  // WAVE-RAW frame: | TxDesc | Eth Header | Protocol & Payload |
+  ThisFrameLen = sizeof(tTxFrameHdr) + length;
+  if ((length < 0) ||
+      ((sizeof(struct MKxTxPacket) + ThisFrameLen) > MALLOC_SIZE_MKxTxPacket))
   {
-    RadioID = MKX_RADIO_B;
-    ChannelID = MKX_CHANNEL_1;
+    ErrCode = TX_ERR_INVALIDOPTIONARG;
+    goto Error;
   }
-  else
+
+  // Prebuilt MAC + SNAP headers, and the radio/channel to use
+  pTemplate = Tx_Template(pTxCHOpts);
+  if (pTemplate == NULL)
   {
     ErrCode = TX_ERR_INVALIDOPTIONARG;
     goto Error;
   }
+  RadioID = pTemplate->RadioID;
+  ChannelID = pTemplate->ChannelID;
 
   // MCS Loop
   for (m = 0; m < pTxCHOpts->NMCS; m++)
   {
+        // Held by the library until its TxCnf (see LLC_TxCnf())
+        pTxPacket = LLC_TxPoolGet(&(pDev->TxPool));
+        if (pTxPacket == NULL)
+        {
+          d_printf(D_WARN, pDev, "No Tx buffer (%d in use)\n",
+                   LLC_TxPoolInUse(&(pDev->TxPool)));
+          ErrCode = TX_ERR_NULLBUFFER;
+          break;
+        }
+        pPacket = &pTxPacket->TxPacketData;
+        pPayload = (unsigned char *) (pPacket->TxFrame + sizeof(tTxFrameHdr));
+
+        // Only the descriptor: all of the frame is written below
+        memset(pTxPacket, 0, sizeof(struct MKxTxPacket));
+        memcpy(pPacket->TxFrame, &(pTemplate->Hdr), sizeof(pTemplate->Hdr));
+
         // Setup the Mk2Descriptor
         pPacket->RadioID = RadioID;
         pPacket->ChannelID = ChannelID;
@@ -466,32 +793,38 @@ static int Tx_Send (tTxOpts * pTxOpts, int length)
 		TxPower = 40;
         pPacket->TxPower = (tMK2Power) TxPower; // from long
 
-
-        size_t overhead = (char*)pPayload - (char*)(pPacket->TxFrame);
 //		strcpy((char *)pPayload, "hello world!");
 		memcpy((char *)pPayload, buff, length);
 //		printf("send message hello world!\n");
 
-        // add any header overhead that we may have incurred
-        ThisFrameLen = overhead + length;
-
         pPacket->TxFrameLength = ThisFrameLen;
 
-        // Now send the packet
-        ErrCode = LLC_TxReq(pDev->pMKx, pTxPacket, pDev);
-        if (ErrCode)
-        {
-          fprintf(stderr, "LLC_TxReq %s (%d)\n", strerror(ErrCode), ErrCode);
-        }
-        else
-        {
-          (pDev->SeqNum)++; // increment unique ID of packets
-        }
-        // Wait a little whle before next transmission (attempt to set tx rate)
-//        usleep(Pause_us);
+        pTxPackets[m] = pTxPacket;
+        pPrivs[m] = pDev;
   } // MCS Loop
 
-  free(pTxPacket);
+  // Now send the packets
+  Cnt = m;
+  Res = MKx_TxReqBatch(pDev->pMKx, pTxPackets, pPrivs, Cnt, Results);
+  if (Res < 0)
+  {
+    fprintf(stderr, "MKx_TxReqBatch %s (%d)\n", strerror(-Res), Res);
+    for (m = 0; m < Cnt; m++)
+      Results[m] = Res;
+  }
+  for (m = 0; m < Cnt; m++)
+  {
+    if (Results[m] == 0)
+    {
+      (pDev->SeqNum)++; // increment unique ID of packets
+      continue;
+    }
+    if (Res >= 0)
+      fprintf(stderr, "LLC_TxReq %s (%d)\n",
+              strerror(-Results[m]), Results[m]);
+    // Refused, so there won't be a TxCnf to return it
+    (void)LLC_TxPoolPut(&(pDev->TxPool), pTxPackets[m]);
+  }
 
   d_fnend(D_DEBUG, pDev, "(pDev %p) = %d\n", pDev, ErrCode);
 
@@ -549,261 +882,282 @@ int Tx_SendAtRate(tTxOpts * pTxOpts, int length)
 
 }
 
-static int wsmp_receive(void *buf, uint16_t len)
+/// A received frame, parsed once (see wsmp_receive())
+typedef struct TxRxFrame
 {
-	int Result = 0;
-	char * bufk =	(char *)buf;
-	char pPayload[MALLOC_SIZE_MKxTxPacket];
-	memcpy(pPayload, bufk, len);
-	int i = 0;
-//	while(i < len){
-//		printf("%x", *(pPayload+i));
-//		i++;
-//	}
-//	printf("\n");
-	if((pPayload[0]== 0x29)&&(pPayload[1] == 0x29))
-  	{
-		uint16_t length = pPayload[9] << 8 | pPayload[8];
-		if(checkSum(pPayload, length + 9) != 0){//不算包尾0x0d
-			Result = -1;
+	/// The whole frame (0x29 0x29 ... 0x0d)
+	const uint8_t *pRaw;
+	int Len;
+	uint8_t Protocol;
+	uint32_t Seq;
+	uint8_t Hop;
+	/// Length field (the data, check and end bytes)
+	uint16_t Length;
+	/// The data
+	const uint8_t *pData;
+	int DataLen;
+	/// Checked by a CRC32C (rather than the XOR check byte)
+	bool Crc;
+} tTxRxFrame;
+
+/// What to do with a frame once its handler has run
+typedef enum TxRxAction
+{
+	/// Nothing more (e.g. a repeat, or for another vehicle)
+	TX_RX_DROP = 0,
+	/// Pass it on to the Android/HMI clients
+	TX_RX_FORWARD = 1,
+} eTxRxAction;
+
+/// Handles one protocol (see Tx_RxHandlers)
+typedef eTxRxAction (*fTxRxHandler)(const tTxRxFrame *pFrame);
+
+static eTxRxAction Tx_RxAlert(const tTxRxFrame *pFrame);
+
+/**
+ * @brief Parse (and check) a received frame
+ * @param pBuf The frame
+ * @param Len Bytes received
+ * @param pFrame Filled in
+ * @return Zero, or -1 if it isn't a valid frame
+ */
+static int Tx_RxParse(const uint8_t *pBuf, int Len, tTxRxFrame *pFrame)
+{
+	const uint8_t *pCrc;
+
+	if((Len < 12) || (pBuf[0] != 0x29))
+		return -1;
+	pFrame->Length = pBuf[9] << 8 | pBuf[8];
+	if(pFrame->Length + 10 > Len)
+		return -1;
+	if(pBuf[1] == TX_SYNC_CRC32C){
+		// |0x29,0x2A,protocol,seq,hop,length,data,crc32c,0x0d|
+		if(pFrame->Length < LLC_CRC32C_LEN + 1)
+			return -1;
+		pFrame->DataLen = pFrame->Length - LLC_CRC32C_LEN - 1;
+		pCrc = &pBuf[pFrame->DataLen + 10];
+		if(LLC_Crc32c(0, pBuf, pFrame->DataLen + 10) !=
+		   (pCrc[0] | pCrc[1] << 8 | pCrc[2] << 16 | (uint32_t)pCrc[3] << 24)){
+			printf("CRC32C not correct\n");
+			return -1;
+		}
+		pFrame->Crc = true;
+	}else if(pBuf[1] == 0x29){
+		if(pFrame->Length < 2)
+			return -1;
+		if(checkSum((char *)pBuf, pFrame->Length + 9) != 0){//不算包尾0x0d
 			printf("checkSum not correct\n");
+			return -1;
 		}
+		pFrame->DataLen = pFrame->Length - 2;
+		pFrame->Crc = false;
 	}else{
-		Result = -1;
+		return -1;
 	}
-    //Result����У��ɹ�
-   if(Result == 0){
-       union double2char d2c;
-       union float2char f2c;
-       union uint32_t2char i2c;
-       LocalStatu locals;				
-	   UniPacket up;
-	   int packetlength;
-	   CwMessage WsmMessage;
-	   memset(&WsmMessage, 0, sizeof(struct CwMessage));
-	   if(UdpEnabled){
-	   	switch(pPayload[2]){
-			//没有转发情况下，其实不需要记录packet的唯一性？
-                case 0x10://|0x29��0x29,0x10,seq,hop,length(�ֽ�),plate,check,0x0d|
-					WsmMessage.protocol = 0x11;
-					WsmMessage.seq = pDev->SeqNum;
-					WsmMessage.hop = 1; //������Ϊ�ǽ����Ϣ�����Բ��ö����㲥��ȥ
-					WsmMessage.length = 68;//data�ĳ���
-					memcpy(WsmMessage.data, &pPayload[10], 9);//Ŀ�공�ƺ�(������Ϣ�ĳ��ƺ�)
-					memcpy(&WsmMessage.data[9], CarS.plate, 9);//������ƺ�
-					d2c.d = CarS.location.latitude;
-					memcpy(&WsmMessage.data[18], d2c.data, 8);
-					d2c.d = CarS.location.longitude;
-					memcpy(&WsmMessage.data[26], d2c.data, 8);
-					f2c.d = CarS.location.speed;
-					memcpy(&WsmMessage.data[34], f2c.data, 4);
-					f2c.d = CarS.location.bearing;
-					memcpy(&WsmMessage.data[38], f2c.data, 4);
-					f2c.d = CarS.accel.x;
-					memcpy(&WsmMessage.data[42], f2c.data, 4);
-					f2c.d = CarS.accel.y;
-					memcpy(&WsmMessage.data[46], f2c.data, 4);
-					f2c.d = CarS.accel.z;
-					memcpy(&WsmMessage.data[50], f2c.data, 4);
-					//54~61 海拔高度
-					i2c.d = GetDriveStatus();
-					memcpy(&WsmMessage.data[62], i2c.data, 4);
-					packetlength = packetmessage(&WsmMessage);
-					Tx_SendAtRate(pTxOpts, packetlength);
-					return 0;
-				case 0x11:
-					if(memcmp(&pPayload[10], CarS.plate, 9) != 0){//自己发送了请求信息
-							return 0;
-					}
-					break;
-				case 0x20://这个可能有多跳，所以需要记录唯一性，不用重复接收
-				case 0x21:
-					memcpy(up.plate, &pPayload[19], 9);//19是源节点地址
-					up.seqno = pPayload[6]<<24 |pPayload[5]<<16 |pPayload[4]<<8 |pPayload[3];
-					if(!unipacket_find(up.plate, up.seqno)){
-						up.Newtime = time(NULL);
-						unipacket_insert(up);
-					}else{
-						return 0;//已经接收过这个packet,所以不再出理
-					}
-					if(memcmp(&pPayload[10], CarS.plate, 9) != 0)
-						return 0;
-					break;
-			    case 0x22://广播包不需要判断唯一性
-			    	memcpy(locals.status.plate, &pPayload[10], 9);//邻居车牌号
-					memcpy(d2c.data, &pPayload[19], 8);//经度
-					locals.status.location.latitude = d2c.d;
-					memcpy(d2c.data, &pPayload[27], 8);
-					locals.status.location.longitude = d2c.d;//纬度
-					memcpy(f2c.data, &pPayload[35], 4);
-					locals.status.location.speed = f2c.d;//速度
-					memcpy(f2c.data, &pPayload[39], 4);
-					locals.status.location.bearing = f2c.d;//航向角度
-					memcpy(f2c.data, &pPayload[43], 4);
-					locals.status.accel.x = f2c.d;
-					memcpy(f2c.data, &pPayload[47], 4);
-					locals.status.accel.y = f2c.d;
-					memcpy(f2c.data, &pPayload[51], 4);
-					locals.status.accel.z = f2c.d;
-					memcpy(f2c.data, &pPayload[55], 4);
-					locals.status.carstatus = f2c.d; //这个是车辆状态
-					locals.status.expiretime = 5.0f;
-					locals.status.seqno = pPayload[6]<<24|pPayload[5]<<16|pPayload[4]<<8|pPayload[3];
-					locals.status.valid = true;
-					locals.status.Newtime = time(NULL);
-					if(neigh_find(locals.status.plate) != NULL)
-						neigh_update(locals);
-					else
-						neigh_insert(locals);
-				case 0x23://报警信息，多跳，所以需要记录plate/seq
-				case 0x24:
-				case 0x25:
-				case 0x26:
-				case 0x27:
-					memcpy(up.plate, &pPayload[10], 9);//10是源节点地址
-					up.seqno = pPayload[6]<<24 |pPayload[5]<<16 |pPayload[4]<<8 |pPayload[3];
-					if(!unipacket_find(up.plate, up.seqno)){
-						up.Newtime = time(NULL);
-						unipacket_insert(up);
-					}else{
-						return 0;//已经接收过这个packet,所以不再出理
-					}
-					if((pPayload[7] > 1)&&(pPayload[7]!= 0xFA) ){
-						pPayload[7]--;
-						WsmMessage.protocol = pPayload[2];
-						WsmMessage.seq = up.seqno;
-						WsmMessage.length = pPayload[9]<<8 | pPayload[8];
-					    memcpy(WsmMessage.data, &pPayload[10], WsmMessage.length - 2);//因为是广播，广播节点车牌号不变，需要重新校验
-						packetlength = packetmessage(&WsmMessage);
-						Tx_SendAtRate(pTxOpts, packetlength);
-					}
-					break;
-				case 0x28:break;
-				default:break;
-			}
-			sendto(udpfd, pPayload, len, 0, (struct sockaddr*)&UdpCltaddr, udpaddrlen);
-	   }
-
-	   if(TcpEnabled){
-	       switch(pPayload[2]){
-                case 0x10:
-					WsmMessage.protocol = 0x11;
-					WsmMessage.seq = pDev->SeqNum;;
-					WsmMessage.hop = 1; 
-					WsmMessage.length = 68;
-					memcpy(WsmMessage.data, &pPayload[10], 9);
-					memcpy(&WsmMessage.data[9], CarS.plate, 9);
-					d2c.d = CarS.location.latitude;
-					memcpy(&WsmMessage.data[18], d2c.data, 8);
-					d2c.d = CarS.location.longitude;
-					memcpy(&WsmMessage.data[26], d2c.data, 8);
-					f2c.d = CarS.location.speed;
-					memcpy(&WsmMessage.data[34], f2c.data, 4);
-					f2c.d = CarS.location.bearing;
-					memcpy(&WsmMessage.data[38], f2c.data, 4);
-					f2c.d = CarS.accel.x;
-					memcpy(&WsmMessage.data[42], f2c.data, 4);
-					f2c.d = CarS.accel.y;
-					memcpy(&WsmMessage.data[46], f2c.data, 4);
-					f2c.d = CarS.accel.z;
-					memcpy(&WsmMessage.data[50], f2c.data, 4);
-					//54~61 海拔高度
-					i2c.d = GetDriveStatus();
-					memcpy(&WsmMessage.data[62], i2c.data, 4);
-					packetlength = packetmessage(&WsmMessage);
-					Tx_SendAtRate(pTxOpts, packetlength);
-		   			return 0;
-				case 0x11:
-					if(memcmp(&pPayload[10], CarS.plate, 9) != 0)
-						return 0;
-					break;
-				case 0x20:
-				case 0x21:
-					memcpy(up.plate, &pPayload[19], 9);//19是源节点地址
-					up.seqno = pPayload[6]<<24 |pPayload[5]<<16 |pPayload[4]<<8 |pPayload[3];
-					if(!unipacket_find(up.plate, up.seqno)){
-						up.Newtime = time(NULL);
-						unipacket_insert(up);
-					}else{
-						return 0;//已经接收过这个packet,所以不再出理
-					}
-					if(memcmp(&pPayload[10], CarS.plate, 9) != 0)
-						return 0;
-					break;
-
-			    case 0x22:
-						while(i < len){
-							printf("%x", *(pPayload+i));
-							i++;
-						}
-						printf("\n");
-					memcpy(locals.status.plate, &pPayload[10], 9);//邻居车牌号
-					memcpy(d2c.data, &pPayload[19], 8);//经度
-					locals.status.location.latitude = d2c.d;
-					memcpy(d2c.data, &pPayload[27], 8);
-					locals.status.location.longitude = d2c.d;//纬度
-					memcpy(f2c.data, &pPayload[35], 4);
-					locals.status.location.speed = f2c.d;//速度
-					memcpy(f2c.data, &pPayload[39], 4);
-					locals.status.location.bearing = f2c.d;//航向角度
-					memcpy(f2c.data, &pPayload[43], 4);
-					locals.status.accel.x = f2c.d;
-					memcpy(f2c.data, &pPayload[47], 4);
-					locals.status.accel.y = f2c.d;
-					memcpy(f2c.data, &pPayload[51], 4);
-					locals.status.accel.z = f2c.d;
-					memcpy(f2c.data, &pPayload[55], 4);
-					locals.status.carstatus = f2c.d; //这个是车辆状态
-					locals.status.expiretime = 5.0f;
-					locals.status.seqno = pPayload[6]<<24|pPayload[5]<<16|pPayload[4]<<8|pPayload[3];
-					locals.status.valid = true;
-					locals.status.Newtime = time(NULL);
-					if(neigh_find(locals.status.plate) != NULL)
-						neigh_update(locals);
-					else
-						neigh_insert(locals);
-				case 0x23:
-				case 0x24:
-				case 0x25:
-				case 0x26:
-				case 0x27:
-					memcpy(up.plate, &pPayload[10], 9);//10是源节点地址
-					up.seqno = pPayload[6]<<24 |pPayload[5]<<16 |pPayload[4]<<8 |pPayload[3];
-					if(!unipacket_find(up.plate, up.seqno)){
-						up.Newtime = time(NULL);
-						unipacket_insert(up);
-					}else{
-						return 0;//已经接收过这个packet,所以不再出理
-					}
-					if((pPayload[7] > 1)&&(pPayload[7]!= 0xFA) ){
-						pPayload[7]--;
-						WsmMessage.protocol = pPayload[2];
-						WsmMessage.seq = up.seqno;
-						WsmMessage.length = pPayload[9]<<8 | pPayload[8];
-					    memcpy(WsmMessage.data, &pPayload[10], WsmMessage.length - 2);//因为是广播，广播节点车牌号不变，需要重新校验
-						packetlength = packetmessage(&WsmMessage);
-						Tx_SendAtRate(pTxOpts, packetlength);
-					}
-					break;
-
-				case 0x28:break;
-				default:break;
-	       }
-			if(write(tcpfd, pPayload, len) < 0){
-				perror("Socet error");
-				TcpEnabled = false;
-				Fds[1].fd = listenfd;
-				Fds[1].events = POLL_INPUT;
-				if(tcpfd != -1){
-					close(tcpfd);
-					tcpfd = -1;
-				}
-			}else{
-				printf("write to android message\n");
-			}
-	   }
-   	}
-	return Result;
+	pFrame->pRaw = pBuf;
+	pFrame->Len = pFrame->Length + 10;
+	pFrame->Protocol = pBuf[2];
+	pFrame->Seq = pBuf[6]<<24 | pBuf[5]<<16 | pBuf[4]<<8 | pBuf[3];
+	pFrame->Hop = pBuf[7];
+	pFrame->pData = &pBuf[10];
+	return 0;
+}
+
+/**
+ * @brief 0x10: a query for our status, answered with a 0x11
+ */
+static eTxRxAction Tx_RxQuery(const tTxRxFrame *pFrame)
+{
+	union double2char d2c;
+	union float2char f2c;
+	union uint32_t2char i2c;
+	int packetlength;
+	CwMessage WsmMessage;
+
+	//|0x29��0x29,0x10,seq,hop,length(�ֽ�),plate,check,0x0d|
+	memset(&WsmMessage, 0, sizeof(struct CwMessage));
+	WsmMessage.protocol = 0x11;
+	WsmMessage.seq = pDev->SeqNum;
+	WsmMessage.hop = 1; //������Ϊ�ǽ����Ϣ�����Բ��ö����㲥��ȥ
+	WsmMessage.length = 68;//data�ĳ���
+	memcpy(WsmMessage.data, pFrame->pData, 9);//Ŀ�공�ƺ�(������Ϣ�ĳ��ƺ�)
+	memcpy(&WsmMessage.data[9], CarS.plate, 9);//������ƺ�
+	d2c.d = CarS.location.latitude;
+	memcpy(&WsmMessage.data[18], d2c.data, 8);
+	d2c.d = CarS.location.longitude;
+	memcpy(&WsmMessage.data[26], d2c.data, 8);
+	f2c.d = CarS.location.speed;
+	memcpy(&WsmMessage.data[34], f2c.data, 4);
+	f2c.d = CarS.location.bearing;
+	memcpy(&WsmMessage.data[38], f2c.data, 4);
+	f2c.d = CarS.accel.x;
+	memcpy(&WsmMessage.data[42], f2c.data, 4);
+	f2c.d = CarS.accel.y;
+	memcpy(&WsmMessage.data[46], f2c.data, 4);
+	f2c.d = CarS.accel.z;
+	memcpy(&WsmMessage.data[50], f2c.data, 4);
+	//54~61 海拔高度
+	i2c.d = GetDriveStatus();
+	memcpy(&WsmMessage.data[62], i2c.data, 4);
+	packetlength = packetmessage(&WsmMessage);
+	Tx_SendAtRate(pTxOpts, packetlength);
+	return TX_RX_DROP;
+}
+
+/**
+ * @brief 0x11: a reply to a query (only ours are passed on)
+ */
+static eTxRxAction Tx_RxReply(const tTxRxFrame *pFrame)
+{
+	if(memcmp(pFrame->pData, CarS.plate, 9) != 0)//自己发送了请求信息
+		return TX_RX_DROP;
+	return TX_RX_FORWARD;
+}
+
+/**
+ * @brief 0x20, 0x21: (multi-hop) messages to one vehicle
+ */
+static eTxRxAction Tx_RxUnicast(const tTxRxFrame *pFrame)
+{
+	UniPacket up;
+
+	//这个可能有多跳，所以需要记录唯一性，不用重复接收
+	memcpy(up.plate, &pFrame->pData[9], 9);//19是源节点地址
+	up.seqno = pFrame->Seq;
+	if(!unipacket_find(up.plate, up.seqno)){
+		up.Newtime = time(NULL);
+		unipacket_insert(up);
+	}else{
+		return TX_RX_DROP;//已经接收过这个packet,所以不再出理
+	}
+	if(memcmp(pFrame->pData, CarS.plate, 9) != 0)
+		return TX_RX_DROP;
+	return TX_RX_FORWARD;
+}
+
+/**
+ * @brief 0x22: a neighbour's periodic status
+ */
+static eTxRxAction Tx_RxStatus(const tTxRxFrame *pFrame)
+{
+	union double2char d2c;
+	union float2char f2c;
+	LocalStatu locals;
+
+	//广播包不需要判断唯一性
+	memcpy(locals.status.plate, pFrame->pData, 9);//邻居车牌号
+	memcpy(d2c.data, &pFrame->pData[9], 8);//经度
+	locals.status.location.latitude = d2c.d;
+	memcpy(d2c.data, &pFrame->pData[17], 8);
+	locals.status.location.longitude = d2c.d;//纬度
+	memcpy(f2c.data, &pFrame->pData[25], 4);
+	locals.status.location.speed = f2c.d;//速度
+	memcpy(f2c.data, &pFrame->pData[29], 4);
+	locals.status.location.bearing = f2c.d;//航向角度
+	memcpy(f2c.data, &pFrame->pData[33], 4);
+	locals.status.accel.x = f2c.d;
+	memcpy(f2c.data, &pFrame->pData[37], 4);
+	locals.status.accel.y = f2c.d;
+	memcpy(f2c.data, &pFrame->pData[41], 4);
+	locals.status.accel.z = f2c.d;
+	memcpy(f2c.data, &pFrame->pData[45], 4);
+	locals.status.carstatus = f2c.d; //这个是车辆状态
+	locals.status.expiretime = 5.0f;
+	locals.status.seqno = pFrame->Seq;
+	locals.status.valid = true;
+	locals.status.Newtime = time(NULL);
+	if(neigh_find(locals.status.plate) != NULL)
+		neigh_update(locals);
+	else
+		neigh_insert(locals);
+	// and then, like the alerts, it is relayed
+	return Tx_RxAlert(pFrame);
+}
+
+/**
+ * @brief 0x23 - 0x27: alerts (relayed until their hop count runs out)
+ */
+static eTxRxAction Tx_RxAlert(const tTxRxFrame *pFrame)
+{
+	UniPacket up;
+	int packetlength;
+	CwMessage WsmMessage;
+
+	//报警信息，多跳，所以需要记录plate/seq
+	memcpy(up.plate, pFrame->pData, 9);//10是源节点地址
+	up.seqno = pFrame->Seq;
+	if(!unipacket_find(up.plate, up.seqno)){
+		up.Newtime = time(NULL);
+		unipacket_insert(up);
+	}else{
+		return TX_RX_DROP;//已经接收过这个packet,所以不再出理
+	}
+	if((pFrame->Hop > 1)&&(pFrame->Hop != 0xFA)){
+		memset(&WsmMessage, 0, sizeof(struct CwMessage));
+		WsmMessage.protocol = pFrame->Protocol;
+		WsmMessage.seq = up.seqno;
+		WsmMessage.hop = pFrame->Hop - 1;
+		WsmMessage.length = pFrame->DataLen + 2;
+		memcpy(WsmMessage.data, pFrame->pData, pFrame->DataLen);//因为是广播，广播节点车牌号不变，需要重新校验
+		packetlength = packetmessage(&WsmMessage);
+		Tx_SendAtRate(pTxOpts, packetlength);
+	}
+	return TX_RX_FORWARD;
+}
+
+/// Handler of each protocol (those without one are just passed on)
+static const fTxRxHandler Tx_RxHandlers[256] = {
+	[0x10] = Tx_RxQuery,
+	[0x11] = Tx_RxReply,
+	[0x20] = Tx_RxUnicast,
+	[0x21] = Tx_RxUnicast,
+	[0x22] = Tx_RxStatus,
+	[0x23 ... 0x27] = Tx_RxAlert,
+};
+
+/**
+ * @brief A frame from another vehicle (see LLC_RxInd())
+ * @param buf The frame
+ * @param len Its length [bytes]
+ * @return Zero, or -1 if it isn't a valid frame
+ *
+ * The frame is parsed once, handled once by its protocol's handler and then
+ * sent once to all of the Android/HMI clients (however they are connected).
+ */
+static int wsmp_receive(void *buf, uint16_t len)
+{
+	tTxRxFrame Frame;
+	fTxRxHandler Handler;
+	tLLCIPCMeta Meta;
+
+	if(Tx_RxParse((const uint8_t *)buf, len, &Frame) != 0)
+		return -1;
+	Tx_IPCMeta(Frame.Protocol, Frame.pData, Frame.DataLen, &Meta);
+	Tx_CheckHeard(Frame.Crc, Meta.Source);
+
+	// The same for all clients (and only once, or it is seen as a repeat)
+	if(LLC_IPCClientCnt(&IPC) == 0)
+		return 0;
+	Handler = Tx_RxHandlers[Frame.Protocol];
+	if((Handler != NULL) && (Handler(&Frame) != TX_RX_FORWARD))
+		return 0;
+
+	// The clients only know the XOR check
+	if(Frame.Crc){
+		if(Frame.DataLen + 12 > (int)sizeof(buff))
+			return 0;
+		memcpy(buff, Frame.pRaw, 10);
+		buff[1] = 0x29;
+		buff[9] = ((Frame.DataLen + 2) >> 8) & 0xff;
+		buff[8] = (Frame.DataLen + 2) & 0xff;
+		memcpy(&buff[10], Frame.pData, Frame.DataLen);
+		buff[Frame.DataLen + 10] = checkSum(buff, Frame.DataLen + 10);
+		buff[Frame.DataLen + 11] = 0x0d;
+		(void)LLC_IPCSend(&IPC, buff, Frame.DataLen + 12, &Meta);
+		return 0;
+	}
+	(void)LLC_IPCSend(&IPC, Frame.pRaw, Frame.Len, &Meta);
+	return 0;
 }
 
 /**
@@ -988,7 +1342,11 @@ tMKxStatus LLC_RxInd (struct MKx *pMKx,
 
   // Count number of unblocks
 Exit:
-  PktBuf_Free(pPkb);
+  // Delivered in place (see MKx_RxZeroCopy()) or copied into a pktbuf
+  if (((struct LLCTx *)pMKx->pPriv)->RxZeroCopy)
+    MKx_RxRelease(pMKx, pPriv);
+  else
+    PktBuf_Free(pPkb);
   return Res;
 }
 
@@ -1088,6 +1446,7 @@ tMKxStatus LLC_TxCnf (struct MKx *pMKx,
                       void *pPriv)
 {
   int Res = MKXSTATUS_SUCCESS;
+  struct LLCTx *pTx = (struct LLCTx *)pPriv;
   tMKxStatus Result = pTxEvent->Hdr.Ret == MKXSTATUS_SUCCESS ?
     pTxEvent->TxEventData.TxStatus ://¼״̬
     pTxEvent->Hdr.Ret;//Txevent޸
@@ -1108,11 +1467,40 @@ tMKxStatus LLC_TxCnf (struct MKx *pMKx,
              (Result == MKXSTATUS_TX_FAIL_RETRIES ? "Fail Retries" :
               (Result == MKXSTATUS_TX_FAIL_QUEUEFULL ? "Fail Queue Full" :
                (Result == MKXSTATUS_TX_FAIL_RADIO_NOT_PRESENT ? "Fail Radio Not Present" :
-                (Result == MKXSTATUS_TX_FAIL_MALFORMED ? "Fail Malfomed Frame" : "Unknown error")))))),
+                (Result == MKXSTATUS_TX_FAIL_MALFORMED ? "Fail Malfomed Frame" :
+                 (Result == LLC_TXSTATUS_TIMEOUT ? "Fail TxCnf Timeout" :
+                  (Result == LLC_TXSTATUS_FLUSHED ? "Flushed" : "Unknown error")))))))),
            Result);
+
+  // Sent, failed, timed out or flushed: the library is done with the buffer
+  if ((pTx != NULL) && (pTxPkt != NULL))
+    (void)LLC_TxPoolPut(&(pTx->TxPool), pTxPkt);
   return Res;
 }
 
+/**
+ * @brief MKx notification: a new radio config invalidates the Tx templates
+ * @param pMKx MKx handle
+ * @param Notif The notification (see tMKxNotif)
+ * @return MKXSTATUS_SUCCESS
+ *
+ * Called from within MKx_Recv() (even with MKx_RxThread() the callbacks run
+ * on the thread that calls MKx_Recv()).
+ */
+tMKxStatus LLC_TxNotifInd (struct MKx *pMKx,
+                           tMKxNotif Notif)
+{
+  // Only MKXIF_RADIOxCFG notifications are just a radio bit
+  if ((Notif & (MKX_NOTIF_MASK_RADIOA | MKX_NOTIF_MASK_RADIOB)) &&
+      !(Notif & (MKX_NOTIF_MASK_STATS | MKX_NOTIF_MASK_ACTIVE |
+                 MKX_NOTIF_MASK_CHANNEL0 | MKX_NOTIF_MASK_CHANNEL1)))
+  {
+    (void)__atomic_add_fetch(&(TxTemplates.Gen), 1, __ATOMIC_RELEASE);
+    d_printf(D_INFO, NULL, "Radio config changed (0x%08X)\n", Notif);
+  }
+  return MKXSTATUS_SUCCESS;
+}
+
 /**
  * @brief Initiate the 'dbg' command
  */
@@ -1177,11 +1565,53 @@ int LLC_TxInit (struct LLCTx *pDev)
 
   pDev->TxContinue = true;
 
+  // Every frame's buffer, allocated once (see Tx_Send())
+  Res = LLC_TxPoolInit(&(pDev->TxPool), LLC_TX_POOL_CNT,
+                       MALLOC_SIZE_MKxTxPacket);
+  if (Res != 0)
+    goto Error;
+
   pDev->pMKx->API.Callbacks.TxCnf = LLC_TxCnf;
+  pDev->pMKx->API.Callbacks.NotifInd = LLC_TxNotifInd;
   /*ǽղҪõ*/
   pDev->pMKx->API.Callbacks.RxInd = LLC_RxInd;  
   pDev->pMKx->API.Callbacks.RxAlloc = LLC_RxAlloc;
   pDev->pMKx->pPriv = (void *)pDev;
+  // Skip the RxAlloc() + copy when the library can deliver in place
+  pDev->RxZeroCopy = (MKx_RxZeroCopy(pDev->pMKx, true) == 0);
+  d_printf(D_INFO, pDev, "Zero-copy Rx %s\n",
+           pDev->RxZeroCopy ? "enabled" : "unavailable");
+  d_printf(D_INFO, pDev, "Frame check %d (CRC32C by %s)\n",
+           pTxOpts->Check, LLC_Crc32cImpl());
+
+  // Keep draining cw-llc while the callbacks run (MKx_Fd() then changes)
+  if (pTxOpts->RxThread)
+  {
+    Res = MKx_RxThread(pDev->pMKx, true);
+    if (Res != 0)
+      goto Error;
+    pDev->Fd = MKx_Fd(pDev->pMKx);
+  }
+
+  // Hold bursts in the library (by priority) rather than in the MKx queues
+  if (pTxOpts->TxQueues != LLC_TXQ_SCHED_OFF)
+  {
+    tLLCTxQConfig TxQConfig;
+
+    memset(&TxQConfig, 0, sizeof(TxQConfig));
+    TxQConfig.Sched = pTxOpts->TxQueues;
+    TxQConfig.InFlightMax = LLC_TXQ_INFLIGHT;
+    TxQConfig.Depth = LLC_TXQ_DEPTH;
+    TxQConfig.Weight[MKX_TXQ_AC_VO] = 8;
+    TxQConfig.Weight[MKX_TXQ_AC_VI] = 4;
+    TxQConfig.Weight[MKX_TXQ_AC_BE] = 2;
+    TxQConfig.Weight[MKX_TXQ_NON_QOS] = 2;
+    TxQConfig.Weight[MKX_TXQ_AC_BK] = 1;
+    // Held frames are sent later from their pool buffers (kept until TxCnf)
+    Res = MKx_TxQueueConfig(pDev->pMKx, &TxQConfig);
+    if (Res != 0)
+      goto Error;
+  }
 
 Error:
   if (Res != 0)
@@ -1191,6 +1621,38 @@ Error:
   return Res;
 }
 
+/**
+ * @brief Print the counters of the software transmit queues that were used
+ */
+static void LLC_TxQueueReport (struct LLCTx *pDev)
+{
+  tLLCTxQStats Stats[MKX_TXQ_COUNT];
+  tMKxRadio Radio;
+  tMKxChannel Chan;
+  int TxQ;
+
+  for (Radio = MKX_RADIO_A; Radio < MKX_RADIO_COUNT; Radio++)
+  {
+    for (Chan = MKX_CHANNEL_0; Chan < MKX_CHANNEL_COUNT; Chan++)
+    {
+      if (MKx_TxQueueStats(pDev->pMKx, Radio, Chan, Stats) != 0)
+        continue;
+      for (TxQ = 0; TxQ < MKX_TXQ_COUNT; TxQ++)
+      {
+        if ((Stats[TxQ].Sent + Stats[TxQ].Full + Stats[TxQ].Expired) == 0)
+          continue;
+        printf("TxQ %c%d/%d: Sent %llu Full %llu Expired %llu Flushed %llu "
+               "Depth %u (max %u)\n", (Radio == MKX_RADIO_A) ? 'A' : 'B',
+               Chan, TxQ, (unsigned long long)Stats[TxQ].Sent,
+               (unsigned long long)Stats[TxQ].Full,
+               (unsigned long long)Stats[TxQ].Expired,
+               (unsigned long long)Stats[TxQ].Flushed,
+               Stats[TxQ].Depth, Stats[TxQ].DepthMax);
+      }
+    }
+  }
+}
+
 /**
  * @brief Cancel any 'dbg' command(s)
  */
@@ -1204,14 +1666,218 @@ int LLC_TxExit (struct LLCTx *pDev)
   // Break the MKx_Recv() loops
   (void)MKx_Recv(NULL);
 
+  if ((pDev->pMKx != NULL) && (pDev->TxOpts.TxQueues != LLC_TXQ_SCHED_OFF))
+    LLC_TxQueueReport(pDev);
+
   if (pDev->pMKx != NULL)
     MKx_Exit(pDev->pMKx);
+
+  // No more TxCnf's, so nothing is still held by the library
+  printf("TxPool: Gets %u Puts %u Exhausted %u Bad %u "
+         "InUse %d (max %u of %d)\n", pDev->TxPool.Stats.Gets, pDev->TxPool.Stats.Puts,
+         pDev->TxPool.Stats.Exhausted, pDev->TxPool.Stats.Bad,
+         LLC_TxPoolInUse(&(pDev->TxPool)), pDev->TxPool.Stats.InUseMax,
+         pDev->TxPool.Cnt);
+  LLC_TxPoolExit(&(pDev->TxPool));
   Res = 0;
 
   d_fnend(D_TST, NULL, "() = %d\n", Res);
   return Res;
 }
 
+/**
+ * @brief MKx messages are waiting
+ * @return Greater than zero if the receive budget ran out (more are waiting)
+ */
+static int Tx_MKxEvent (int Fd, uint32_t Events, void *pPriv)
+{
+	int Res;
+
+	if (Events & LLC_EVENT_ERROR)
+	{
+		printf("Poll error on Dev cw-llc MKX (revents 0x%02x)\n", Events);
+	}
+	if ((Events & LLC_EVENT_IN) || (Events == 0))
+	{
+		// Bounded, so a burst can't starve the other descriptors
+		Res = MKx_RecvBudget(pDev->pMKx, LLC_RX_BUDGET_MSGS, LLC_RX_BUDGET_US);
+		return (Res > 0) ? 1 : 0;
+	}
+	return 0;
+}
+
+/**
+ * @brief A message from an Android/HMI client (see llc-ipc.h)
+ * @param pIPC
+ * @param Type From the 'unixdg' socket, or a legacy write or a whole frame
+ *             from the 'unixstr' socket
+ * @param pBuf The message
+ * @param Len Its length [bytes]
+ */
+static void Tx_IPCRecv (tLLCIPC *pIPC, eLLCIPCRecvType Type, uint8_t *pBuf, int Len)
+{
+	char sndbuf[MALLOC_SIZE_MKxTxPacket];
+	CwMessage WsmMessage;
+	int packetlength;
+	ssize_t n = min(Len, MALLOC_SIZE_MKxTxPacket);
+
+	memset(&WsmMessage, 0,sizeof(struct CwMessage));
+	memset(sndbuf, 0, MALLOC_SIZE_MKxTxPacket);
+	memcpy(sndbuf, pBuf, n);
+
+	if(Type == LLC_IPC_RECV_FRAME){
+		/*A whole, checked frame: forward as is, but in our sequence*/
+		WsmMessage.protocol = pBuf[2];
+		WsmMessage.hop = pBuf[7];
+		WsmMessage.seq = pDev->SeqNum;
+		WsmMessage.length = pBuf[8] | (pBuf[9] << 8);//data+check+0x0d
+		if(WsmMessage.protocol == 0x10){
+			WsmMessage.hop = 1;
+			WsmMessage.length = 11;
+			memcpy(WsmMessage.data, CarS.plate, 9);
+		}else{
+			memcpy(WsmMessage.data, &pBuf[LLC_FRAME_HDR_LEN], WsmMessage.length - 2);
+		}
+		packetlength = packetmessage(&WsmMessage);
+		Tx_SendAtRate(pTxOpts, packetlength);
+	}else if(Type == LLC_IPC_RECV_DGRAM){
+		/*DSRC forward*/
+		if((sndbuf[0]== 0x29)&&(sndbuf[1] == 0x29)&&(sndbuf[2] == 0x20))
+		{
+			WsmMessage.protocol = 0x20;
+			WsmMessage.hop = 5;
+			WsmMessage.seq = pDev->SeqNum;
+			WsmMessage.length = n - 3;//android 0x29,0x29,0x20
+			memcpy(WsmMessage.data, &sndbuf[3], WsmMessage.length);
+			packetlength = packetmessage(&WsmMessage);
+			Tx_SendAtRate(pTxOpts, packetlength);
+		}else if((sndbuf[0] == 0x29)&&(sndbuf[1] == 0x29)&&(sndbuf[2] == 0x10)){
+			WsmMessage.protocol = 0x10;
+			WsmMessage.hop = 1;
+			WsmMessage.seq = pDev->SeqNum;
+			WsmMessage.length = 11;
+			memcpy(WsmMessage.data, CarS.plate, 9);
+			packetlength = packetmessage(&WsmMessage);
+			Tx_SendAtRate(pTxOpts, packetlength);
+		}else{  
+			WsmMessage.protocol = 0x23; 
+			WsmMessage.hop = 1;
+			WsmMessage.seq = pDev->SeqNum;
+			WsmMessage.length = n;
+			memcpy(WsmMessage.data, sndbuf, WsmMessage.length);
+			packetlength = packetmessage(&WsmMessage);
+			Tx_SendAtRate(pTxOpts, packetlength);
+		}
+	}else{
+		if((sndbuf[0]== 0x29)&&(sndbuf[1] == 0x29)&&(sndbuf[2] == 0x20)){
+			WsmMessage.protocol = 0x20;
+			WsmMessage.hop = 5;
+			WsmMessage.seq = pDev->SeqNum;
+			WsmMessage.length = n - 1;//这个内容包括校验和0x0d
+			memcpy(WsmMessage.data, &sndbuf[3], WsmMessage.length - 2);
+			packetlength = packetmessage(&WsmMessage);
+			Tx_SendAtRate(pTxOpts, packetlength);
+		}else if((sndbuf[0] == 0x29)&&(sndbuf[1] == 0x29)&&(sndbuf[2] == 0x10)){
+			WsmMessage.protocol = 0x10;
+			WsmMessage.hop = 1;
+			WsmMessage.seq = pDev->SeqNum;
+			WsmMessage.length = 11;
+			memcpy(WsmMessage.data, CarS.plate, 9);
+			packetlength = packetmessage(&WsmMessage);
+			Tx_SendAtRate(pTxOpts, packetlength);
+		}else{  
+			WsmMessage.protocol = 0x23; 
+			WsmMessage.hop = 1;
+			WsmMessage.seq = pDev->SeqNum;
+			WsmMessage.length = n + 2;//内容+校验+包尾0x0d
+			memcpy(WsmMessage.data, sndbuf, WsmMessage.length - 2);
+			packetlength = packetmessage(&WsmMessage);
+			Tx_SendAtRate(pTxOpts, packetlength);
+		}
+	}
+}
+
+/**
+ * @brief NMEA sentences from the um220 GPS receiver (ttymxc1)
+ */
+static int Tx_Um220Event (int Fd, uint32_t Events, void *pPriv)
+{
+	static int GpsOn = 0;
+	char newbuf[MALLOC_SIZE_MKxTxPacket];
+	char *ret = NULL;
+	int nb;
+
+	if(Events & LLC_EVENT_ERROR)
+	{
+		printf("Poll error on ttymxc1 (revents 0x%02x)\n", Events);
+	}
+	if(!(Events & LLC_EVENT_IN))
+		return 0;
+
+	memset(newbuf, 0, 1024);
+	memset(result, 0, sizeof(struct RMCmsg));
+	int semcount = 0;
+	char *read_buf = newbuf;
+	if((nb = read(um220fd, newbuf, 1024)) < 10 ){
+		read_buf += nb;
+		usleep(10000);
+		nb = read(um220fd, read_buf, 1024);
+	}
+					
+	if (nb == -1)  
+        {  
+            perror("read uart error");
+		return 0;
+        }else{
+		printf("GPS Information %s\n",read_buf);
+		char* temp = strtok(newbuf, ",");
+		while(temp){
+			semcount++;
+			temp = strtok(NULL, ",");					
+		}
+	}
+	if(((ret = strstr(newbuf, "$GNRMC")) != NULL)&&(semcount >= 12)){
+        	parseData(newbuf, result);
+		usleep(10);
+	    if(result->status == 0x41)//'A' ASCII Ϊ0x41,��Ч��Ϣ
+	    {
+			SetValid();
+			GpsLocation gps;
+			gps.latitude = (result->lat_du + result->lat_fen/60) * 1000;
+			gps.clat = result->clat;
+			gps.longitude = (result->lon_du + result->lon_fen/60) * 1000;
+			gps.clon = result->clon;
+			gps.altitude = 0;
+			gps.speed = result->spd * 0.514f;
+			gps.bearing = result->cog;
+			SetGps(&gps);
+			if(GpsOn == 0){
+				char systime[50];
+				memset(systime, 0, sizeof(systime));
+				sprintf(systime, "data -s \"%d-%d-%d %d:%d:%lf\"",result->date_yy,result->date_mm,result->date_dd,result->time_hh,result->time_mm, result->time_ss);
+				if(system(systime) < 0)
+					printf("update system time failed!\n");
+				else
+				    GpsOn = 1;
+			}
+			struct tm tmTime;
+			time_t timetTime;
+			tmTime.tm_year = result->date_yy - 1900;
+			tmTime.tm_mon = result->date_mm - 1;
+			tmTime.tm_mday = result->date_dd;
+		    tmTime.tm_hour = result->time_hh;
+			tmTime.tm_min = result->time_mm;
+			tmTime.tm_sec = (int)result->time_ss;
+			timetTime = mktime(&tmTime);
+			SetNewTime(timetTime);
+		}else{
+			ResetValid();
+			GpsOn = 0;
+		}
+        }
+	return 0;
+}
+
 /**
  * @brief Application entry point
  * @param argc Number of command line arguments
@@ -1222,7 +1888,7 @@ int LLC_TxExit (struct LLCTx *pDev)
  * - Initialise data variables
  * - Parse user option command line variables
  * - Initialise interfaces
- * - Use poll() to wait for some input from interfaces
+ * - Wait for input from the registered interfaces (see llc-event.h)
  * - Perform actions on each input action
  * - De-initialise interfaces when Exit condition met
  *
@@ -1230,18 +1896,7 @@ int LLC_TxExit (struct LLCTx *pDev)
 
 static int LLC_TxMain (int Argc, char **ppArgv)
 {
-  int Res, nb;
-  int packetlength;
-  struct sockaddr_un servaddr;//和安卓通信用的
-  char sndbuf[MALLOC_SIZE_MKxTxPacket];
-  char newbuf[MALLOC_SIZE_MKxTxPacket]; 
-  char *ret = NULL;
-  
-  ssize_t n;
-  const int on = 1;
-  int GpsOn = 0;
-  struct timeval *timeout;
-  CwMessage WsmMessage;
+  int Res;
 //  LocalStatu *ls;
 
   result = (pstRMCmsg)malloc(sizeof(stRMCmsg) * 1);
@@ -1258,273 +1913,49 @@ static int LLC_TxMain (int Argc, char **ppArgv)
 
   pTxOpts = &pDev->TxOpts;
   func = wsmp_receive;
-  
-  Fds[0].fd = pDev->Fd;
-  Fds[0].events = POLL_INPUT;
 
-  if( 0 > (listenfd = socket(AF_LOCAL, SOCK_STREAM, 0))){
-	perror("Create Tcp Socket Error");
-	exit(1);
-  }
-//  unlink(UNIXSTRTCP_PATH);
-  bzero(&servaddr, sizeof(servaddr));
-  servaddr.sun_family = AF_LOCAL;
-  servaddr.sun_path[0] = 0;
-  strcpy(servaddr.sun_path + 1 , UNIXSTRTCP_PATH);
-  tcpaddrlen = sizeof(servaddr.sun_family) + sizeof(UNIXSTRTCP_PATH);
-
-  if(0 > (setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)))){
-	perror("Can not set socket work on Reuseaddr");
-	exit(1);
-  }
-  if(0 > (bind(listenfd, (struct sockaddr*)&servaddr, tcpaddrlen))){
-	perror("bind error");
-	exit(1);
-  }
-  if(0 > listen(listenfd, 5)){
-	perror("Can not listen Socket");
-	exit(1);
-  };
+  Res = LLC_EventInit(&Loop);
+  if (Res < 0)
+    goto Error;
 
-  Fds[1].fd = listenfd;
-  Fds[1].events = POLL_INPUT;
-  
+  Res = LLC_EventAdd(&Loop, pDev->Fd, LLC_EVENT_IN, Tx_MKxEvent, NULL);
+  if (Res < 0)
+    goto Error;
 
-  if(0 > (udpfd = socket(AF_LOCAL, SOCK_DGRAM, 0))){
-	perror("Create Udp Socket Error");
-	exit(1);
-  }
-//  unlink(UNIXSTRUDP_PATH);
-  bzero(&servaddr, sizeof(servaddr));
-  servaddr.sun_family = AF_LOCAL;
-  servaddr.sun_path[0] = 0;
-  strcpy(servaddr.sun_path + 1, UNIXSTRUDP_PATH);
-  udpaddrlen = sizeof(servaddr.sun_family) + sizeof(UNIXSTRUDP_PATH);
-
-  if( 0 > (bind(udpfd, (struct sockaddr *)&servaddr, udpaddrlen))){
-		perror("Bind error");
-		exit(1);
-  }
+  // Android/HMI clients on the 'unixstr' and 'unixdg' abstract sockets
+  Res = LLC_IPCInit(&IPC, &Loop, UNIXSTRTCP_PATH, UNIXSTRUDP_PATH,
+                    LLC_IPC_DROP_LOWEST, Tx_IPCRecv);
+  if (Res < 0)
+    goto Error;
+  // Readers that ask for it get the ring instead (the sockets still work)
+  if (LLC_ShmRingInit(&Ring, LLC_RING_SLOTS, LLC_IPC_MSG_MAX) == 0)
+    LLC_IPCShare(&IPC, &Ring);
 
-  Fds[2].fd = udpfd;
-  Fds[2].events = POLL_INPUT;
-  
-  Fds[3].fd = um220fd;
-  Fds[3].events = POLL_INPUT;
+  // Carry on without GPS if the um220 isn't there
+  if (um220fd >= 0)
+    (void)LLC_EventAdd(&Loop, um220fd, LLC_EVENT_IN, Tx_Um220Event, NULL);
 
 
-  UdpEnabled = false;
-  TcpEnabled = false;
   
   mpu6050_start();
   broadcast_start();
   neighbor_stop();
   
+  // Everything happens in the handlers (and the timer_queue timers)
   while(pDev->TxContinue){
-  	
-  	memset(&WsmMessage, 0,sizeof(struct CwMessage));
-	timeout = timer_age_queue();
-  
-	if((Res = poll(Fds, 4, timeout->tv_sec * 1000 + timeout->tv_usec / 1000)) < 0){
-		printf("Poll error %d '%s'\n", errno, strerror(errno));
-		continue;
-	}
-	
-	if(Res > 0){
-		if (Fds[0].revents & POLL_ERROR)
-		{
-			printf("Poll error on Dev cw-llc MKX (revents 0x%02x)\n", Fds[0].revents);
-		}    
-		if (Fds[0].revents & POLL_INPUT)
-		{ 
-			Res = MKx_Recv(pDev->pMKx);
-		}
-		if(Fds[1].revents & POLL_ERROR)
-		{
-			printf("Poll error on TCP Socket (revents 0x%02x)\n", Fds[1].revents);
-			TcpEnabled = false;
-			Fds[1].fd = listenfd;
-			Fds[1].events = POLL_INPUT;
-			if(tcpfd != -1){
-				close(tcpfd);
-				tcpfd = -1;
-			}
-		}
-		if (Fds[1].revents & POLL_INPUT)
-		{
-			if(TcpEnabled == false){
-				if(-1 == (tcpfd = accept(listenfd,(struct sockaddr *)&TcpCltaddr,&tcpaddrlen))){
-					perror("Accept error:");
-					TcpEnabled = false;
-					goto Error;
-				}
-				TcpEnabled = true;
-				Fds[1].fd = tcpfd;
-				Fds[1].events = POLL_INPUT;
-			}else{
-				memset(sndbuf, 0, MALLOC_SIZE_MKxTxPacket);
-				if( 0 > (n = read(tcpfd, sndbuf, MALLOC_SIZE_MKxTxPacket))){//Android -> DSRC
-					perror("Tcp read Error:");
-					TcpEnabled = false;
-					Fds[1].fd = listenfd;
-					Fds[1].events = POLL_INPUT;
-					if(tcpfd != -1){
-						close(tcpfd);
-						tcpfd = -1;
-					}
-				}else{
-				  	if((sndbuf[0]== 0x29)&&(sndbuf[1] == 0x29)&&(sndbuf[2] == 0x20)){
-						WsmMessage.protocol = 0x20;
-						WsmMessage.hop = 5;
-						WsmMessage.seq = pDev->SeqNum;
-						WsmMessage.length = n - 1;//这个内容包括校验和0x0d
-						memcpy(WsmMessage.data, &sndbuf[3], WsmMessage.length - 2);
-						packetlength = packetmessage(&WsmMessage);
-						Tx_SendAtRate(pTxOpts, packetlength);
-					}else if((sndbuf[0] == 0x29)&&(sndbuf[1] == 0x29)&&(sndbuf[2] == 0x10)){
-    					WsmMessage.protocol = 0x10;
-    					WsmMessage.hop = 1;
-    					WsmMessage.seq = pDev->SeqNum;
-    					WsmMessage.length = 11;
-    					memcpy(WsmMessage.data, CarS.plate, 9);
-    					packetlength = packetmessage(&WsmMessage);
-						Tx_SendAtRate(pTxOpts, packetlength);
-					}else{  
-						WsmMessage.protocol = 0x23; 
-						WsmMessage.hop = 1;
-						WsmMessage.seq = pDev->SeqNum;
-						WsmMessage.length = n + 2;//内容+校验+包尾0x0d
-						memcpy(WsmMessage.data, sndbuf, WsmMessage.length - 2);
-    					packetlength = packetmessage(&WsmMessage);
-						Tx_SendAtRate(pTxOpts, packetlength);
-					}
-				}
-			}
-		}
-		
-		if (Fds[2].revents & POLL_ERROR)
-		{
-			printf("Poll error on UDP Socket (revents 0x%02x)\n", Fds[2].revents);
-		}
-		if (Fds[2].revents & POLL_INPUT)
-		{
-			memset(sndbuf, 0, MALLOC_SIZE_MKxTxPacket);
-			n = recvfrom(udpfd, sndbuf, MALLOC_SIZE_MKxTxPacket,
-				0, (struct sockaddr*)&UdpCltaddr, &udpaddrlen);
-
-			if(n < 0){
-				UdpEnabled = false;
-			}else if (n == 0){
-				perror("client has been closing socket!");
-			}else{
-				/*DSRC forward*/
-				UdpEnabled = true;
-				if((sndbuf[0]== 0x29)&&(sndbuf[1] == 0x29)&&(sndbuf[2] == 0x20))
-				{
-					WsmMessage.protocol = 0x20;
-					WsmMessage.hop = 5;
-					WsmMessage.seq = pDev->SeqNum;
-					WsmMessage.length = n - 3;//android 0x29,0x29,0x20
-			    	memcpy(WsmMessage.data, &sndbuf[3], WsmMessage.length);
-					packetlength = packetmessage(&WsmMessage);
-					Tx_SendAtRate(pTxOpts, packetlength);
-				}else if((sndbuf[0] == 0x29)&&(sndbuf[1] == 0x29)&&(sndbuf[2] == 0x10)){
-					WsmMessage.protocol = 0x10;
-					WsmMessage.hop = 1;
-					WsmMessage.seq = pDev->SeqNum;
-					WsmMessage.length = 11;
-	 				memcpy(WsmMessage.data, CarS.plate, 9);
-					packetlength = packetmessage(&WsmMessage);
-					Tx_SendAtRate(pTxOpts, packetlength);
-				}else{  
-					WsmMessage.protocol = 0x23; 
-					WsmMessage.hop = 1;
-					WsmMessage.seq = pDev->SeqNum;
-					WsmMessage.length = n;
-					memcpy(WsmMessage.data, sndbuf, WsmMessage.length);
-					packetlength = packetmessage(&WsmMessage);
-					Tx_SendAtRate(pTxOpts, packetlength);
-				}
-			}
-		}
-
-		if(Fds[3].revents & POLL_ERROR)
-		{
-			printf("Poll error on ttymxc1 (revents 0x%02x)\n", Fds[3].revents);
-		}
-
-		if(Fds[3].revents & POLL_INPUT)
-		{
-			memset(newbuf, 0, 1024);
-			memset(result, 0, sizeof(struct RMCmsg));
-			int semcount = 0;
-			char *read_buf = newbuf;
-			if((nb = read(um220fd, newbuf, 1024)) < 10 ){
-				read_buf += nb;
-				usleep(10000);
-				nb = read(um220fd, read_buf, 1024);
-			}
-							
-			if (nb == -1)  
-	        {  
-	            perror("read uart error");
-				continue;
-	        }else{
-				printf("GPS Information %s\n",read_buf);
-				char* temp = strtok(newbuf, ",");
-				while(temp){
-					semcount++;
-					temp = strtok(NULL, ",");					
-				}
-			}
-			if(((ret = strstr(newbuf, "$GNRMC")) != NULL)&&(semcount >= 12)){
-	        	parseData(newbuf, result);
-				usleep(10);
-			    if(result->status == 0x41)//'A' ASCII Ϊ0x41,��Ч��Ϣ
-			    {
-					SetValid();
-					GpsLocation gps;
-					gps.latitude = (result->lat_du + result->lat_fen/60) * 1000;
-					gps.clat = result->clat;
-					gps.longitude = (result->lon_du + result->lon_fen/60) * 1000;
-					gps.clon = result->clon;
-					gps.altitude = 0;
-					gps.speed = result->spd * 0.514f;
-					gps.bearing = result->cog;
-					SetGps(&gps);
-					if(GpsOn == 0){
-						char systime[50];
-						memset(systime, 0, sizeof(systime));
-						sprintf(systime, "data -s \"%d-%d-%d %d:%d:%lf\"",result->date_yy,result->date_mm,result->date_dd,result->time_hh,result->time_mm, result->time_ss);
-						if(system(systime) < 0)
-							printf("update system time failed!\n");
-						else
-						    GpsOn = 1;
-					}
-					struct tm tmTime;
-					time_t timetTime;
-					tmTime.tm_year = result->date_yy - 1900;
-					tmTime.tm_mon = result->date_mm - 1;
-					tmTime.tm_mday = result->date_dd;
-				    tmTime.tm_hour = result->time_hh;
-					tmTime.tm_min = result->time_mm;
-					tmTime.tm_sec = (int)result->time_ss;
-					timetTime = mktime(&tmTime);
-					SetNewTime(timetTime);
-				}else{
-					ResetValid();
-					GpsOn = 0;
-				}
-	        }
-		}
+	Res = LLC_EventRun(&Loop, -1);
+	if((Res < 0) && (Res != -EINTR)){
+		printf("Poll error %d '%s'\n", -Res, strerror(-Res));
 	}
   }
+  Res = 0;
+
 Error:
   // Final actions
+  LLC_IPCExit(&IPC);
+  LLC_ShmRingExit(&Ring);
+  LLC_EventExit(&Loop);
   close(pDev->Fd);
-  close(tcpfd); 	// TCP Client
-  close(listenfd);	//TCP Service Socket
-  close(udpfd);		//UDP socket
   LLC_TxExit(pDev);
   free(result);
   result = NULL;
@@ -26,6 +26,7 @@
 // Included headers
 //------------------------------------------------------------------------------
 #include "llc-plugin.h"
+#include "llc-txpool.h"
 
 //------------------------------------------------------------------------------
 // Macros & Constants
@@ -55,6 +56,10 @@ typedef struct LLCTx
   /// Ethernet header (for preloading invariants)
   struct ethhdr EthHdr;
   bool TxContinue;
+  /// RxInd() packets are delivered in place (release with MKx_RxRelease())
+  bool RxZeroCopy;
+  /// Tx buffers (see Tx_Send() and LLC_TxCnf())
+  tLLCTxPool TxPool;
 } tLLCTx;
 //------------------------------------------------------------------------------
 // Functions
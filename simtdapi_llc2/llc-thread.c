@@ -0,0 +1,484 @@
+/**
+ * @addtogroup cohda_llc_intern_lib LLC API library
+ * @{
+ *
+ * @file
+ * LLC: Receive thread and its lock-free delivery queues (see MKx_RxThread())
+ *
+ * The receive thread is the only producer of each queue and the thread
+ * calling MKx_Recv() the only consumer, so the queues need no locks: the
+ * producer publishes an entry by advancing Tail (release) and the consumer
+ * frees it by advancing Head (release) once the callback has returned.
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2013 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#if !defined(__QNX__)
+#include <sys/eventfd.h>
+#endif
+#include "llc-lib.h"
+
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Number of entries in each queue (powers of two)
+#define LLC_QUEUE_TXEVENT_CNT  (512)
+#define LLC_QUEUE_RXPACKET_CNT (256)
+#define LLC_QUEUE_OTHER_CNT    (64)
+
+/// Largest message copied into a queue entry (the interface snaplen) [bytes]
+#define LLC_QUEUE_MSG_MAX      (4 * 1024)
+
+/// How long the thread waits before retrying a full queue, or an interface
+/// that is readable but has nothing to give (e.g. all Rx ring blocks held) [ms]
+#define LLC_THREAD_RETRY       (1)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Get an entry of a queue
+ * @param pQ Queue
+ * @param Idx Head or Tail value
+ * @return The entry
+ */
+static tLLCQueueEntry *LLC_QueueEntry (tLLCQueue *pQ,
+                                       uint32_t Idx)
+{
+  return (tLLCQueueEntry *)(pQ->pEntries + ((Idx & (pQ->Cnt - 1)) * pQ->Size));
+}
+
+/**
+ * @brief Allocate the entries of a queue
+ * @param pQ Queue
+ * @param Cnt Number of entries (a power of two)
+ * @param MaxLen Largest message to copy into an entry [bytes]
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ */
+static int LLC_QueueAlloc (tLLCQueue *pQ,
+                           uint32_t Cnt,
+                           uint32_t MaxLen)
+{
+  d_assert((Cnt & (Cnt - 1)) == 0);
+
+  pQ->Head = 0;
+  pQ->Tail = 0;
+  pQ->Cnt = Cnt;
+  pQ->MaxLen = MaxLen;
+  // Keep the copies 8 byte aligned (as the messages are in the Rx ring)
+  pQ->Size = (sizeof(tLLCQueueEntry) + MaxLen + 7) & ~7;
+  pQ->pEntries = malloc(pQ->Cnt * pQ->Size);
+  if (pQ->pEntries == NULL)
+    return -ENOMEM;
+  return LLC_STATUS_SUCCESS;
+}
+
+/**
+ * @brief Which queue a message goes in
+ * @param pMsg The message
+ * @return LLC_QUEUE_TXEVENT, LLC_QUEUE_RXPACKET or LLC_QUEUE_OTHER
+ */
+static int LLC_QueueSelect (struct MKxIFMsg *pMsg)
+{
+  if (pMsg->Type == MKXIF_TXEVENT)
+    return LLC_QUEUE_TXEVENT;
+  if (pMsg->Type == MKXIF_RXPACKET)
+    return LLC_QUEUE_RXPACKET;
+  return LLC_QUEUE_OTHER;
+}
+
+/**
+ * @brief Queue a message for MKx_Recv() (receive thread only)
+ * @param pDev LLC device pointer
+ * @param pMsg The message (from LLC_MsgGet())
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ *         (-EAGAIN if the queue is full, -EMSGSIZE if it can never fit)
+ */
+static int LLC_QueuePut (struct LLCDev *pDev,
+                         struct MKxIFMsg *pMsg)
+{
+  tLLCQueue *pQ = &(pDev->Thread.Queue[LLC_QueueSelect(pMsg)]);
+  tLLCQueueEntry *pEntry;
+  uint32_t Tail = pQ->Tail;
+
+  if ((Tail - __atomic_load_n(&(pQ->Head), __ATOMIC_ACQUIRE)) >= pQ->Cnt)
+    return -EAGAIN;
+
+  pEntry = LLC_QueueEntry(pQ, Tail);
+  pEntry->Time = LLC_MsgTime();
+  pEntry->pHold = NULL;
+
+  // Received packets stay in the Rx ring when they are delivered in place
+  if ((pMsg->Type == MKXIF_RXPACKET) && pDev->Msg.RxZeroCopy)
+    pEntry->pHold = LLC_InterfaceRxHold(pDev);
+
+  if (pEntry->pHold != NULL)
+  {
+    pEntry->pMsg = pMsg;
+  }
+  else
+  {
+    if (pMsg->Len > pQ->MaxLen)
+      return -EMSGSIZE;
+    pEntry->pMsg = (struct MKxIFMsg *)(pEntry + 1);
+    memcpy(pEntry->pMsg, pMsg, pMsg->Len);
+  }
+
+  __atomic_store_n(&(pQ->Tail), Tail + 1, __ATOMIC_RELEASE);
+  return LLC_STATUS_SUCCESS;
+}
+
+/**
+ * @brief Is anything queued?
+ * @param pDev LLC device pointer
+ * @return true if at least one queue is not empty
+ */
+static bool LLC_QueuePending (struct LLCDev *pDev)
+{
+  int i;
+
+  for (i = 0; i < LLC_QUEUE_COUNT; i++)
+  {
+    tLLCQueue *pQ = &(pDev->Thread.Queue[i]);
+
+    if (pQ->Head != __atomic_load_n(&(pQ->Tail), __ATOMIC_ACQUIRE))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Drop every queued message (without calling any callbacks)
+ * @param pDev LLC device pointer
+ */
+static void LLC_QueueFlush (struct LLCDev *pDev)
+{
+  int i;
+
+  for (i = 0; i < LLC_QUEUE_COUNT; i++)
+  {
+    tLLCQueue *pQ = &(pDev->Thread.Queue[i]);
+
+    while (pQ->Head != pQ->Tail)
+    {
+      tLLCQueueEntry *pEntry = LLC_QueueEntry(pQ, pQ->Head);
+
+      if (pEntry->pHold != NULL)
+        (void)LLC_InterfaceRxRelease(pDev, pEntry->pHold);
+      pQ->Head++;
+    }
+  }
+}
+
+/**
+ * @brief Free the queues
+ * @param pDev LLC device pointer
+ */
+static void LLC_QueueFree (struct LLCDev *pDev)
+{
+  int i;
+
+  for (i = 0; i < LLC_QUEUE_COUNT; i++)
+  {
+    free(pDev->Thread.Queue[i].pEntries);
+    pDev->Thread.Queue[i].pEntries = NULL;
+  }
+}
+
+#if !defined(__QNX__)
+/**
+ * @brief Wait until the thread should stop, or for a while
+ * @param pDev LLC device pointer
+ * @param Timeout How long to wait [ms]
+ * @return true if the thread should stop
+ */
+static bool LLC_ThreadWait (struct LLCDev *pDev,
+                            int Timeout)
+{
+  struct pollfd Fds = { pDev->Thread.StopFd, POLLIN, 0 };
+
+  return (poll(&Fds, 1, Timeout) > 0);
+}
+
+/**
+ * @brief The receive thread: drain the interface into the queues
+ * @param pArg LLC device pointer
+ * @return NULL
+ */
+static void *LLC_ThreadMain (void *pArg)
+{
+  struct LLCDev *pDev = (struct LLCDev *)pArg;
+  int Res = 0;
+
+  d_fnstart(D_TST, NULL, "(pDev %p)\n", pDev);
+
+  while (1)
+  {
+    struct pollfd Fds[2] =
+    {
+      { pDev->If.Fd, POLLIN, 0 },
+      { pDev->Thread.StopFd, POLLIN, 0 },
+    };
+    struct MKxIFMsg *pMsg;
+    int Cnt = 0;
+
+    if (poll(Fds, 2, -1) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      Res = -errno;
+      break;
+    }
+    if (Fds[1].revents != 0)
+    {
+      Res = 0;
+      break;
+    }
+
+    // Take everything the interface has, then wake MKx_Recv() once
+    while (1)
+    {
+      Res = LLC_MsgGet(pDev, &pMsg);
+      if (Res != 0)
+        break;
+      if (pMsg == NULL)
+        continue;
+
+      Res = LLC_QueuePut(pDev, pMsg);
+      // Wait for MKx_Recv() to make space (except for received packets)
+      while ((Res == -EAGAIN) && (pMsg->Type != MKXIF_RXPACKET))
+      {
+        if (Cnt > 0)
+        {
+          (void)eventfd_write(pDev->Thread.EventFd, 1);
+          Cnt = 0;
+        }
+        if (LLC_ThreadWait(pDev, LLC_THREAD_RETRY))
+        {
+          Res = 0;
+          goto Exit;
+        }
+        Res = LLC_QueuePut(pDev, pMsg);
+      }
+      if (Res == 0)
+        Cnt++;
+      else if (Res == -EAGAIN)
+        pDev->Thread.RxDropped++;
+      else
+        d_printf(D_WARN, NULL, "Dropped message type %d (Len %d) = %d\n",
+                 pMsg->Type, pMsg->Len, Res);
+    }
+    if (Cnt > 0)
+      (void)eventfd_write(pDev->Thread.EventFd, 1);
+
+    if (Res != -EAGAIN)
+      break;
+    // Readable but nothing taken: don't spin
+    if ((Cnt == 0) && LLC_ThreadWait(pDev, LLC_THREAD_RETRY))
+    {
+      Res = 0;
+      break;
+    }
+  }
+
+Exit:
+  if (Res != 0)
+  {
+    d_error(D_ERR, NULL, "Receive thread failed: %d\n", Res);
+    __atomic_store_n(&(pDev->Thread.Res), Res, __ATOMIC_RELEASE);
+    (void)eventfd_write(pDev->Thread.EventFd, 1);
+  }
+  d_fnend(D_TST, NULL, "(pDev %p) = %d\n", pDev, Res);
+  return NULL;
+}
+#endif // !__QNX__
+
+/**
+ * @brief Initialise the receive thread state (the thread is not started)
+ * @param pDev LLC device pointer
+ */
+void LOCAL LLC_ThreadSetup (struct LLCDev *pDev)
+{
+  d_assert(pDev != NULL);
+
+  memset(&(pDev->Thread), 0, sizeof(pDev->Thread));
+  pDev->Thread.Enabled = false;
+  pDev->Thread.EventFd = -1;
+  pDev->Thread.StopFd = -1;
+}
+
+/**
+ * @brief Start the receive thread
+ * @param pDev LLC device pointer
+ * @return Zero (LLC_STATUS_SUCCESS) or a negative errno
+ */
+int LOCAL LLC_ThreadStart (struct LLCDev *pDev)
+{
+  int Res = -EOPNOTSUPP;
+
+  d_fnstart(D_TST, NULL, "(pDev %p)\n", pDev);
+  d_assert(pDev != NULL);
+  d_assert(pDev->Thread.Enabled == false);
+
+  #if !defined(__QNX__)
+  Res = LLC_QueueAlloc(&(pDev->Thread.Queue[LLC_QUEUE_TXEVENT]),
+                       LLC_QUEUE_TXEVENT_CNT, sizeof(struct MKxTxEvent));
+  if (Res == 0)
+    Res = LLC_QueueAlloc(&(pDev->Thread.Queue[LLC_QUEUE_RXPACKET]),
+                         LLC_QUEUE_RXPACKET_CNT, LLC_QUEUE_MSG_MAX);
+  if (Res == 0)
+    Res = LLC_QueueAlloc(&(pDev->Thread.Queue[LLC_QUEUE_OTHER]),
+                         LLC_QUEUE_OTHER_CNT, LLC_QUEUE_MSG_MAX);
+  if (Res != 0)
+    goto Error;
+
+  pDev->Thread.EventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  pDev->Thread.StopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if ((pDev->Thread.EventFd < 0) || (pDev->Thread.StopFd < 0))
+  {
+    Res = -errno;
+    goto Error;
+  }
+  pDev->Thread.Res = 0;
+
+  Res = -pthread_create(&(pDev->Thread.Thread), NULL, LLC_ThreadMain, pDev);
+  if (Res != 0)
+    goto Error;
+  pDev->Thread.Enabled = true;
+  // Messages that arrived before the thread was started
+  (void)eventfd_write(pDev->Thread.EventFd, 1);
+
+Error:
+  if (Res != 0)
+  {
+    d_error(D_ERR, NULL, "Unable to start the receive thread: %d\n", Res);
+    if (pDev->Thread.EventFd >= 0)
+      close(pDev->Thread.EventFd);
+    if (pDev->Thread.StopFd >= 0)
+      close(pDev->Thread.StopFd);
+    pDev->Thread.EventFd = -1;
+    pDev->Thread.StopFd = -1;
+    LLC_QueueFree(pDev);
+  }
+  #endif
+  d_fnend(D_TST, NULL, "(pDev %p) = %d\n", pDev, Res);
+  return Res;
+}
+
+/**
+ * @brief Stop the receive thread
+ * @param pDev LLC device pointer
+ * @param Deliver Handle the messages still queued (else just drop them)
+ */
+void LOCAL LLC_ThreadStop (struct LLCDev *pDev,
+                           bool Deliver)
+{
+  d_fnstart(D_TST, NULL, "(pDev %p Deliver %d)\n", pDev, Deliver);
+  d_assert(pDev != NULL);
+
+  if (pDev->Thread.Enabled == false)
+    goto Error;
+
+  #if !defined(__QNX__)
+  (void)eventfd_write(pDev->Thread.StopFd, 1);
+  (void)pthread_join(pDev->Thread.Thread, NULL);
+
+  pDev->Thread.Res = 0;
+
+  // Still 'Enabled' so that these come from the queues
+  while (Deliver && LLC_QueuePending(pDev))
+    (void)LLC_ThreadRecv(pDev);
+  LLC_QueueFlush(pDev);
+  pDev->Thread.Enabled = false;
+
+  close(pDev->Thread.EventFd);
+  close(pDev->Thread.StopFd);
+  pDev->Thread.EventFd = -1;
+  pDev->Thread.StopFd = -1;
+  LLC_QueueFree(pDev);
+  if (pDev->Thread.RxDropped != 0)
+    d_printf(D_INFO, NULL, "%u RxPacket's dropped (queue full)\n",
+             pDev->Thread.RxDropped);
+  #endif
+
+Error:
+  d_fnend(D_TST, NULL, "(pDev %p) = void\n", pDev);
+  return;
+}
+
+/**
+ * @brief Handle the next queued message (the MKx_Recv() side)
+ * @param pDev LLC device pointer
+ * @return The result of the message handler, or a negative errno
+ *         (-EAGAIN if nothing is queued)
+ *
+ * TxEvent's are handled first since they free up TxReq slots.
+ */
+int LOCAL LLC_ThreadRecv (struct LLCDev *pDev)
+{
+  int Res = -EAGAIN;
+  int Retry;
+  int i;
+
+  d_assert(pDev != NULL);
+
+  // Look again after clearing the eventfd (in case a message was queued
+  // after the first look, and the thread's wakeup is the one cleared)
+  for (Retry = 0; Retry < 2; Retry++)
+  {
+    for (i = 0; i < LLC_QUEUE_COUNT; i++)
+    {
+      tLLCQueue *pQ = &(pDev->Thread.Queue[i]);
+      uint32_t Head = pQ->Head;
+      tLLCQueueEntry *pEntry;
+
+      if (Head == __atomic_load_n(&(pQ->Tail), __ATOMIC_ACQUIRE))
+        continue;
+
+      // The entry stays in the queue until the callback has returned
+      pEntry = LLC_QueueEntry(pQ, Head);
+      Res = LLC_MsgDispatch(pDev, pEntry->pMsg, pEntry->Time, pEntry->pHold);
+      __atomic_store_n(&(pQ->Head), Head + 1, __ATOMIC_RELEASE);
+      return Res;
+    }
+
+    #if !defined(__QNX__)
+    if (Retry == 0)
+    {
+      eventfd_t Val;
+      (void)eventfd_read(pDev->Thread.EventFd, &Val);
+    }
+    #endif
+  }
+
+  // Report why the thread stopped (once the queues are empty)
+  i = __atomic_load_n(&(pDev->Thread.Res), __ATOMIC_ACQUIRE);
+  if (i != 0)
+    Res = i;
+  return Res;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,203 @@
+/**
+ * @addtogroup cohda_llc_intern_lib LLC API library
+ * @{
+ *
+ * @file
+ * LLC: Local TSF estimation (from the TSF values reported by the MKx)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2013 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <errno.h>
+#include "llc-lib.h"
+
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Error bound assumed until the drift has been measured [us]
+#define LLC_TSF_ERR_INIT       (1000)
+/// Minimum interval between drift measurements [us]
+#define LLC_TSF_DRIFT_INTERVAL (1000000)
+/// Assumed drift uncertainty before (and in addition to) measurements [ppm]
+#define LLC_TSF_DRIFT_ERR_PPM  (20)
+/// A residual larger than this means the TSF was stepped (e.g. SetTSF) [us]
+#define LLC_TSF_STEP           (10000)
+/// Weight of a new sample in the averages (1/8)
+#define LLC_TSF_EWMA_SHIFT     (3)
+/// Fraction of a negative residual applied to the reference point (1/64)
+#define LLC_TSF_DECAY_SHIFT    (6)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Restart the TSF estimate from a single sample
+ * @param pDev LLC device pointer
+ * @param TSF The TSF reported by the MKx
+ * @param Now The CLOCK_MONOTONIC time it was received [us]
+ */
+static void LLC_TSFRestart (struct LLCDev *pDev,
+                            tMKxTSF TSF,
+                            uint64_t Now)
+{
+  pDev->TSF.RefTSF = TSF;
+  pDev->TSF.RefTime = Now;
+  pDev->TSF.AnchorTSF = TSF;
+  pDev->TSF.AnchorTime = Now;
+  pDev->TSF.Drift = 0.0;
+  pDev->TSF.DriftErr = LLC_TSF_DRIFT_ERR_PPM * 1e-6;
+  pDev->TSF.Err = LLC_TSF_ERR_INIT;
+  pDev->TSF.Valid = true;
+}
+
+/**
+ * @brief Reset the TSF estimate (nothing known until the next sample)
+ * @param pDev LLC device pointer
+ */
+void LOCAL LLC_TSFSetup (struct LLCDev *pDev)
+{
+  d_assert(pDev != NULL);
+
+  memset(&(pDev->TSF), 0, sizeof(pDev->TSF));
+  pDev->TSF.Valid = false;
+}
+
+/**
+ * @brief Extrapolate the TSF to a given time
+ * @param pDev LLC device pointer
+ * @param Now CLOCK_MONOTONIC time [us]
+ * @param pErr Set to the error bound of the returned estimate [us] (or NULL)
+ * @return The estimated TSF at Now
+ */
+static tMKxTSF LLC_TSFAt (struct LLCDev *pDev,
+                          uint64_t Now,
+                          uint32_t *pErr)
+{
+  double Age = (double)(int64_t)(Now - pDev->TSF.RefTime);
+
+  if (pErr != NULL)
+  {
+    double Err = pDev->TSF.Err + (Age * pDev->TSF.DriftErr);
+    *pErr = (Err > UINT32_MAX) ? UINT32_MAX : (uint32_t)Err;
+  }
+  return pDev->TSF.RefTSF + (int64_t)(Age * (1.0 + pDev->TSF.Drift));
+}
+
+/**
+ * @brief Fold a TSF reported by the MKx into the estimate
+ * @param pDev LLC device pointer
+ * @param TSF The TSF from a RxPacket, TxEvent or stats message
+ * @param Now When the message was received (CLOCK_MONOTONIC) [us]
+ *
+ * Every sample arrives some (variable) time after the event it timestamps,
+ * so each one is a lower bound on the true TSF 'now'. The reference point
+ * snaps up to any sample above the extrapolation (i.e. one that arrived with
+ * less latency than the previous best) and only decays slowly towards those
+ * below it, so it follows the low-latency envelope of the samples. The drift
+ * of that envelope against CLOCK_MONOTONIC is measured over intervals of at
+ * least LLC_TSF_DRIFT_INTERVAL.
+ */
+void LOCAL LLC_TSFSample (struct LLCDev *pDev,
+                          tMKxTSF TSF,
+                          uint64_t Now)
+{
+  int64_t Residual;
+  uint64_t Span;
+
+  if (TSF == 0)
+    return;
+
+  if (pDev->TSF.Valid == false)
+  {
+    LLC_TSFRestart(pDev, TSF, Now);
+    goto Exit;
+  }
+
+  Residual = (int64_t)(TSF - LLC_TSFAt(pDev, Now, NULL));
+  if ((Residual > LLC_TSF_STEP) || (Residual < -LLC_TSF_STEP))
+  {
+    d_printf(D_INFO, NULL, "TSF stepped by %lld us\n", (long long)Residual);
+    LLC_TSFRestart(pDev, TSF, Now);
+    goto Exit;
+  }
+
+  // Track the typical residual as the error bound at the reference point
+  {
+    double Abs = (Residual < 0) ? -Residual : Residual;
+    pDev->TSF.Err += (Abs - pDev->TSF.Err) / (1 << LLC_TSF_EWMA_SHIFT);
+  }
+
+  // Move the reference point up to date
+  pDev->TSF.RefTSF = LLC_TSFAt(pDev, Now, NULL);
+  pDev->TSF.RefTime = Now;
+  if (Residual > 0)
+    pDev->TSF.RefTSF += Residual;
+  else
+    pDev->TSF.RefTSF += Residual / (1 << LLC_TSF_DECAY_SHIFT);
+
+  // Measure the drift (of the envelope) over a long enough baseline
+  Span = Now - pDev->TSF.AnchorTime;
+  if (Span >= LLC_TSF_DRIFT_INTERVAL)
+  {
+    double Drift = ((double)(int64_t)(pDev->TSF.RefTSF - pDev->TSF.AnchorTSF) /
+                    (double)Span) - 1.0;
+    double Delta = Drift - pDev->TSF.Drift;
+
+    pDev->TSF.Drift += Delta / (1 << LLC_TSF_EWMA_SHIFT);
+    pDev->TSF.DriftErr += (((Delta < 0) ? -Delta : Delta) -
+                           pDev->TSF.DriftErr) / (1 << LLC_TSF_EWMA_SHIFT);
+    pDev->TSF.AnchorTSF = pDev->TSF.RefTSF;
+    pDev->TSF.AnchorTime = Now;
+  }
+
+Exit:
+  d_printf(D_DEBUG, NULL, "TSF %llu: Ref %llu Drift %.3fppm Err %.1fus\n",
+           (unsigned long long)TSF, (unsigned long long)pDev->TSF.RefTSF,
+           pDev->TSF.Drift * 1e6, pDev->TSF.Err);
+  return;
+}
+
+/**
+ * @brief Get the current TSF estimate (no communication with the MKx)
+ * @param pDev LLC device pointer
+ * @param pTSF Set to the estimated TSF
+ * @param pErr Set to its error bound [us] (or NULL)
+ * @return Zero (LLC_STATUS_SUCCESS) or -EAGAIN if no TSF has been seen yet
+ */
+int LOCAL LLC_TSFGet (struct LLCDev *pDev,
+                      tMKxTSF *pTSF,
+                      uint32_t *pErr)
+{
+  if (pDev->TSF.Valid == false)
+  {
+    *pTSF = 0;
+    if (pErr != NULL)
+      *pErr = UINT32_MAX;
+    return -EAGAIN;
+  }
+
+  *pTSF = LLC_TSFAt(pDev, LLC_MsgTime(), pErr);
+  return LLC_STATUS_SUCCESS;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,164 @@
+/**
+ * @addtogroup cohda_llc_intern_app LLC application
+ * @{
+ *
+ * @file
+ * LLC: Preallocated pool of transmit buffers (see llc-txpool.h)
+ *
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2015 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "llc-txpool.h"
+#include "debug-levels.h"
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+/// Buffer alignment [bytes] (a cache line)
+#define LLC_TXPOOL_ALIGN (64)
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Variables
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Functions definitions
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Allocate the buffers
+ * @param pPool
+ * @param Cnt Number of buffers (at most 65535)
+ * @param Size Size of each buffer [bytes] (e.g. the largest MKxTxPacket)
+ * @return Zero, or a negative errno
+ */
+int LLC_TxPoolInit (tLLCTxPool *pPool,
+                    int Cnt,
+                    int Size)
+{
+  int Res = -EINVAL;
+  int i;
+
+  d_fnstart(D_TST, NULL, "(Cnt %d Size %d)\n", Cnt, Size);
+
+  memset(pPool, 0, sizeof(*pPool));
+  if ((Cnt <= 0) || (Cnt > UINT16_MAX) || (Size <= 0))
+    goto Error;
+
+  // Keep each buffer on its own cache lines
+  pPool->Size = (Size + LLC_TXPOOL_ALIGN - 1) & ~(LLC_TXPOOL_ALIGN - 1);
+  pPool->Cnt = Cnt;
+  if (posix_memalign((void **)&(pPool->pMem), LLC_TXPOOL_ALIGN,
+                     (size_t)pPool->Size * Cnt) != 0)
+    pPool->pMem = NULL;
+  pPool->pFree = malloc(Cnt * sizeof(pPool->pFree[0]));
+  pPool->pInUse = calloc(Cnt, sizeof(pPool->pInUse[0]));
+  if ((pPool->pMem == NULL) || (pPool->pFree == NULL) ||
+      (pPool->pInUse == NULL))
+  {
+    Res = -ENOMEM;
+    goto Error;
+  }
+
+  // Hand out the lowest addresses first
+  for (i = 0; i < Cnt; i++)
+    pPool->pFree[i] = Cnt - 1 - i;
+  pPool->FreeCnt = Cnt;
+  Res = 0;
+
+Error:
+  if (Res < 0)
+    LLC_TxPoolExit(pPool);
+  d_fnend(D_TST, NULL, "(Cnt %d Size %d) = %d\n", Cnt, Size, Res);
+  return Res;
+}
+
+/**
+ * @brief Free the buffers (none may still be held by the library)
+ * @param pPool
+ */
+void LLC_TxPoolExit (tLLCTxPool *pPool)
+{
+  if (LLC_TxPoolInUse(pPool) != 0)
+    d_printf(D_WARN, NULL, "%d Tx buffers still in use\n",
+             LLC_TxPoolInUse(pPool));
+
+  free(pPool->pMem);
+  free(pPool->pFree);
+  free(pPool->pInUse);
+  memset(pPool, 0, sizeof(*pPool));
+}
+
+/**
+ * @brief Take a buffer from the pool
+ * @param pPool
+ * @return The buffer (its contents are undefined), or NULL if none are free
+ */
+void *LLC_TxPoolGet (tLLCTxPool *pPool)
+{
+  uint16_t Idx;
+
+  if (pPool->FreeCnt == 0)
+  {
+    pPool->Stats.Exhausted++;
+    return NULL;
+  }
+
+  Idx = pPool->pFree[--pPool->FreeCnt];
+  pPool->pInUse[Idx] = true;
+  pPool->Stats.Gets++;
+  if ((uint32_t)LLC_TxPoolInUse(pPool) > pPool->Stats.InUseMax)
+    pPool->Stats.InUseMax = LLC_TxPoolInUse(pPool);
+  return pPool->pMem + ((size_t)Idx * pPool->Size);
+}
+
+/**
+ * @brief Return a buffer to the pool
+ * @param pPool
+ * @param pBuf A buffer from LLC_TxPoolGet()
+ * @return Zero, or -EINVAL if it isn't out of this pool (e.g. already put)
+ */
+int LLC_TxPoolPut (tLLCTxPool *pPool,
+                   void *pBuf)
+{
+  uint8_t *pByte = (uint8_t *)pBuf;
+  size_t Off;
+  uint16_t Idx;
+
+  if ((pPool->pMem == NULL) || (pByte < pPool->pMem))
+    goto Bad;
+  Off = pByte - pPool->pMem;
+  if ((Off % pPool->Size) || (Off / pPool->Size >= (size_t)pPool->Cnt))
+    goto Bad;
+  Idx = Off / pPool->Size;
+  if (!pPool->pInUse[Idx])
+    goto Bad;
+
+  pPool->pInUse[Idx] = false;
+  pPool->pFree[pPool->FreeCnt++] = Idx;
+  pPool->Stats.Puts++;
+  return 0;
+
+Bad:
+  pPool->Stats.Bad++;
+  return -EINVAL;
+}
+
+/**
+ * @}
+ */
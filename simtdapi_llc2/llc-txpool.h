@@ -0,0 +1,91 @@
+/**
+ * @addtogroup cohda_llc_intern_app LLC application
+ * @{
+ *
+ * @file
+ * LLC: Preallocated pool of transmit buffers
+ *
+ * The library keeps a pointer to each packet passed to MKx_TxReq() (and may
+ * hold it in a software queue) until its TxCnf() callback, so a buffer is
+ * taken from the pool for each frame and only returned from TxCnf() (which
+ * is also called when the TxCnf times out or the frame is flushed), or
+ * straight away if the TxReq was refused.
+ */
+
+//------------------------------------------------------------------------------
+// Copyright (c) 2015 Cohda Wireless Pty Ltd
+//------------------------------------------------------------------------------
+
+#ifndef __LLC_TXPOOL_H__
+#define __LLC_TXPOOL_H__
+
+//------------------------------------------------------------------------------
+// Included headers
+//------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+
+//------------------------------------------------------------------------------
+// Macros & Constants
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+/// Transmit buffer pool state
+typedef struct LLCTxPool
+{
+  /// The buffers (one allocation)
+  uint8_t *pMem;
+  /// Size of each buffer [bytes]
+  int Size;
+  /// Number of buffers
+  int Cnt;
+  /// Free buffers (a stack, so the most recently used is reused first)
+  uint16_t *pFree;
+  int FreeCnt;
+  /// Which buffers are out of the pool
+  bool *pInUse;
+  /// Counters
+  struct
+  {
+    /// Buffers taken
+    uint32_t Gets;
+    /// Buffers returned
+    uint32_t Puts;
+    /// Gets that found the pool empty
+    uint32_t Exhausted;
+    /// Puts of a buffer that isn't out of this pool
+    uint32_t Bad;
+    /// Most buffers out at once
+    uint32_t InUseMax;
+  } Stats;
+} tLLCTxPool;
+
+//------------------------------------------------------------------------------
+// Function declarations
+//------------------------------------------------------------------------------
+
+int LLC_TxPoolInit (tLLCTxPool *pPool,
+                    int Cnt,
+                    int Size);
+void LLC_TxPoolExit (tLLCTxPool *pPool);
+
+void *LLC_TxPoolGet (tLLCTxPool *pPool);
+int LLC_TxPoolPut (tLLCTxPool *pPool,
+                   void *pBuf);
+
+/**
+ * @brief Number of buffers currently out of the pool
+ */
+static inline int LLC_TxPoolInUse (const tLLCTxPool *pPool)
+{
+  return pPool->Cnt - pPool->FreeCnt;
+}
+
+#endif // __LLC_TXPOOL_H__
+
+/**
+ * @}
+ */